@@ -1,5 +1,89 @@
 #include "Context.hpp"
+#include <utility/gl/extensions.hpp>
+#include <utility/gl/registry.hpp>
 #include <iostream>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef OPENGL_OBJ_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+#endif
+
+namespace
+{
+#ifdef OPENGL_OBJ_EGL
+    /// @returns true if name is in the space separated list of extensions.
+    bool hasExtension(const char *extensions, const char *name)
+    {
+        if(!extensions)
+        {
+            return false;
+        }
+        
+        const std::size_t length = std::strlen(name);
+        
+        for(const char *it = std::strstr(extensions, name); it; it = std::strstr(it + length, name))
+        {
+            const bool start = it == extensions || it[-1] == ' ';
+            const bool end = it[length] == ' ' || it[length] == '\0';
+            
+            if(start && end)
+            {
+                return true;
+            }
+        }
+        
+        return false;
+    }
+    
+    EGLDisplay getHeadlessDisplay()
+    {
+        // Client extensions, queried without display
+        const char *extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+        
+        auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+            eglGetProcAddress("eglGetPlatformDisplayEXT"));
+        
+        if(getPlatformDisplay)
+        {
+            // Mesa without any window system, the software rasteriser if there is no GPU
+            if(hasExtension(extensions, "EGL_MESA_platform_surfaceless"))
+            {
+                EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+                if(display != EGL_NO_DISPLAY)
+                {
+                    return display;
+                }
+            }
+            
+            // Drivers exposing the GPUs directly, like NVIDIA's
+            if(hasExtension(extensions, "EGL_EXT_platform_device"))
+            {
+                auto queryDevices = reinterpret_cast<PFNEGLQUERYDEVICESEXTPROC>(
+                    eglGetProcAddress("eglQueryDevicesEXT"));
+                
+                EGLDeviceEXT device;
+                EGLint count = 0;
+                if(queryDevices && queryDevices(1, &device, &count) && count > 0)
+                {
+                    EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_DEVICE_EXT, device, nullptr);
+                    if(display != EGL_NO_DISPLAY)
+                    {
+                        return display;
+                    }
+                }
+            }
+        }
+        
+        return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+#endif
+}
 
 Context::Context()
 {
@@ -7,6 +91,9 @@ Context::Context()
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef OPENGL_OBJ_GL_DEBUG
+    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);
+#endif
     
     // Window width and height, float first to not have rounding errors
     glm::vec2 size{0};
@@ -19,12 +106,7 @@ Context::Context()
     
     glfwMakeContextCurrent(window);
     
-    if(!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(glfwGetProcAddress)))
-    {
-        throw std::runtime_error{"Failed to initialize GLAD"};
-    }
-    
-    glViewport(0, 0, winSize.x, winSize.y);
+    init(reinterpret_cast<GLADloadproc>(glfwGetProcAddress));
     
     glfwSetFramebufferSizeCallback(window, [](GLFWwindow *, int w, int h) {
         std::cout << "window resized" << std::endl;
@@ -32,10 +114,203 @@ Context::Context()
     });
 }
 
+Context::Context(Headless headless)
+{
+    winSize = headless.size;
+    
+#ifdef OPENGL_OBJ_EGL
+    // GLFW is still used for its timer, the null platform (GLFW 3.4) initializes without display
+#if GLFW_VERSION_MAJOR > 3 || (GLFW_VERSION_MAJOR == 3 && GLFW_VERSION_MINOR >= 4)
+    glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
+    glfwInit();
+    
+    // The destructor is not called when the constructor throws
+    try
+    {
+        initHeadless();
+    }
+    catch(...)
+    {
+        release();
+        throw;
+    }
+#else
+    throw std::runtime_error{"Headless contexts need EGL, which was not found when building"};
+#endif
+}
+
+#ifdef OPENGL_OBJ_EGL
+void Context::initHeadless()
+{
+    EGLDisplay display = getHeadlessDisplay();
+    
+    EGLint major, minor;
+    if(display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+    {
+        throw std::runtime_error{"Failed to initialize an EGL display"};
+    }
+    
+    m_eglDisplay = display;
+    std::cout << "EGL " << major << "." << minor << ": " << eglQueryString(display, EGL_VENDOR) << std::endl;
+    
+    const bool surfaceless = hasExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context");
+    
+    const EGLint configAttributes[]{
+        EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    
+    EGLConfig config;
+    EGLint count = 0;
+    if(!eglBindAPI(EGL_OPENGL_API) || !eglChooseConfig(display, configAttributes, &config, 1, &count) || count == 0)
+    {
+        throw std::runtime_error{"No EGL config for desktop OpenGL"};
+    }
+    
+    const EGLint contextAttributes[]{
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 0,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+#ifdef OPENGL_OBJ_GL_DEBUG
+        EGL_CONTEXT_OPENGL_DEBUG, EGL_TRUE,
+#endif
+        EGL_NONE
+    };
+    
+    m_eglContext = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+    if(m_eglContext == EGL_NO_CONTEXT)
+    {
+        throw std::runtime_error{"Failed to create an EGL context with OpenGL 4.0 core"};
+    }
+    
+    EGLSurface surface = EGL_NO_SURFACE;
+    if(!surfaceless)
+    {
+        const EGLint pbufferAttributes[]{EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+        surface = eglCreatePbufferSurface(display, config, pbufferAttributes);
+        m_eglSurface = surface;
+    }
+    
+    if(!eglMakeCurrent(display, surface, surface, m_eglContext))
+    {
+        throw std::runtime_error{"Failed to make the EGL context current"};
+    }
+    
+    init(reinterpret_cast<GLADloadproc>(eglGetProcAddress));
+    
+    // The offscreen framebuffer replaces the window: stencil for the mirror, like the default framebuffer
+    m_offscreen = std::make_unique<Offscreen>();
+    
+    glBindRenderbuffer(GL_RENDERBUFFER, m_offscreen->color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, winSize.x, winSize.y);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_offscreen->depthStencil);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, winSize.x, winSize.y);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    
+    using gl::registry::Type;
+    gl::registry::setImageStorage(Type::Renderbuffer, m_offscreen->color, GL_RGBA8, {winSize, 1});
+    gl::registry::setImageStorage(Type::Renderbuffer, m_offscreen->depthStencil, GL_DEPTH24_STENCIL8, {winSize, 1});
+    gl::registry::setLabel(Type::Renderbuffer, m_offscreen->color, "Offscreen color");
+    gl::registry::setLabel(Type::Renderbuffer, m_offscreen->depthStencil, "Offscreen depth stencil");
+    gl::registry::setLabel(Type::Framebuffer, m_offscreen->fbo, "Offscreen");
+    
+    glBindFramebuffer(GL_FRAMEBUFFER, m_offscreen->fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_offscreen->color);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_offscreen->depthStencil);
+    
+    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        throw std::runtime_error{"The offscreen framebuffer is incomplete"};
+    }
+}
+#endif
+
+void Context::init(GLADloadproc load)
+{
+    if(!gladLoadGLLoader(load))
+    {
+        throw std::runtime_error{"Failed to initialize GLAD"};
+    }
+    
+    gl::ext::load(load);
+    
+    glViewport(0, 0, winSize.x, winSize.y);
+}
+
 Context::~Context()
 {
-    glfwDestroyWindow(window);
-    window = nullptr;
+    release();
+}
+
+void Context::release()
+{
+    // The GL objects are deleted while their context is still current
+    m_offscreen.reset();
+    
+    if(window)
+    {
+        glfwDestroyWindow(window);
+        window = nullptr;
+    }
+    
+#ifdef OPENGL_OBJ_EGL
+    if(m_eglDisplay)
+    {
+        eglMakeCurrent(m_eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        
+        if(m_eglSurface)
+        {
+            eglDestroySurface(m_eglDisplay, m_eglSurface);
+        }
+        
+        if(m_eglContext)
+        {
+            eglDestroyContext(m_eglDisplay, m_eglContext);
+        }
+        
+        eglTerminate(m_eglDisplay);
+    }
+#endif
     
     glfwTerminate();
 }
+
+bool Context::isHeadless() const
+{
+    return !window;
+}
+
+void Context::bindFramebuffer() const
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, m_offscreen ? GLuint(m_offscreen->fbo) : 0);
+}
+
+void Context::swapBuffers() const
+{
+    if(window)
+    {
+        glfwSwapBuffers(window);
+    }
+    else
+    {
+        glFlush();
+    }
+}
+
+std::vector<unsigned char> Context::readPixels() const
+{
+    std::vector<unsigned char> pixels(static_cast<std::size_t>(winSize.x) * winSize.y * 4);
+    
+    GLint framebuffer = 0;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &framebuffer);
+    
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_offscreen ? GLuint(m_offscreen->fbo) : 0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, winSize.x, winSize.y, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    
+    return pixels;
+}
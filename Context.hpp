@@ -2,16 +2,75 @@
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h> // Include after glad otherwise compilation error
+#include <utility/gl/gl.hpp>
 #include <glm/vec2.hpp>
+#include <memory>
+#include <vector>
 
-/// @brief Wraps an OpenGL context and a window
+/// @brief Wraps an OpenGL context and a window, or an offscreen framebuffer when headless.
+/// @details
+/// A headless context has no window and needs no display nor GPU: it renders into a framebuffer object which
+/// stays bound as the default one, so the rendering code is the same as with a window.
 class Context
 {
 public:
+    /// @brief Size of the offscreen framebuffer of a headless context.
+    struct Headless
+    {
+        glm::ivec2 size{1280, 720};
+    };
+    
+    /// @brief Open a window.
     Context();
+    
+    /// @brief Create a context without window, with EGL.
+    /// @details Prefers a surfaceless display (EGL_MESA_platform_surfaceless, llvmpipe on a machine without GPU),
+    /// then the first EGL device, then the default display. Without EGL_KHR_surfaceless_context, the context is
+    /// made current with a 1x1 pbuffer, which is never rendered into.
+    /// @throws std::runtime_error If there is no usable EGL display, or if compiled without EGL.
+    explicit Context(Headless headless);
+    
     ~Context();
     
-    GLFWwindow *window{nullptr};
+    Context(const Context&) = delete;
+    Context& operator=(const Context&) = delete;
+    
+    bool isHeadless() const;
+    
+    /// @brief Bind the framebuffer the frames are rendered into: the window or the offscreen framebuffer.
+    void bindFramebuffer() const;
+    
+    /// @brief Present the frame, only flushes the commands when headless.
+    void swapBuffers() const;
+    
+    /// @brief Read back the frame as RGBA 8 bits per channel, with the bottom row first.
+    std::vector<unsigned char> readPixels() const;
+    
+    GLFWwindow *window{nullptr}; ///< nullptr when headless
     glm::ivec2 winSize;
+    
+private:
+    /// @brief Load the functions and set the default state, once a context is current.
+    void init(GLADloadproc load);
+    
+    /// @brief Create the EGL context and the offscreen framebuffer, once GLFW is initialized.
+    /// @throws std::runtime_error On failure, the handles created so far are left to release().
+    void initHeadless();
+    
+    /// @brief Destroy the window or the EGL context and terminate GLFW, whatever was created.
+    void release();
+    
+    /// @brief Framebuffer of a headless context.
+    struct Offscreen
+    {
+        gl::raii::Framebuffer fbo;
+        gl::raii::Renderbuffer color, depthStencil;
+    };
+    
+    std::unique_ptr<Offscreen> m_offscreen;
+    
+    /// @brief EGL handles of a headless context, not typed to not include EGL everywhere.
+    void *m_eglDisplay{nullptr};
+    void *m_eglContext{nullptr};
+    void *m_eglSurface{nullptr};
 };
-
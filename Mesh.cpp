@@ -1,4 +1,5 @@
 #include "Mesh.hpp"
+#include <utility/gl/registry.hpp>
 
 namespace obj
 {
@@ -11,6 +12,11 @@ namespace obj
     
     void Mesh::init()
     {
+        for(const Vertex& vertex : vertices)
+        {
+            bounds.extend(vertex.pos);
+        }
+        
         glBindVertexArray(vao);
     
         glBindBuffer(GL_ARRAY_BUFFER, vbo);
@@ -29,13 +35,28 @@ namespace obj
         gl::bufferData(GL_ELEMENT_ARRAY_BUFFER, indices, GL_STATIC_DRAW);
     
         glBindVertexArray(0);
+        
+        gl::registry::setBufferStorage(vbo, vertices.size() * sizeof(Vertex));
+        gl::registry::setBufferStorage(ebo, indices.size() * sizeof(indices[0]));
+        gl::registry::setLabel(gl::registry::Type::Buffer, vbo, "Mesh vertices");
+        gl::registry::setLabel(gl::registry::Type::Buffer, ebo, "Mesh indices");
     }
     
     void Mesh::draw(gl::Shader& shader) const
     {
-        glActiveTexture(GL_TEXTURE1);
-        gl::Texture::bind(&material.diffuseTexture);
-        glActiveTexture(GL_TEXTURE0);
+        // The atlas is bound once for all the meshes by the model
+        if(material.isAtlased())
+        {
+            shader.setUniform("u_AtlasTransform", material.atlasRegion.transform);
+            shader.setUniform("u_AtlasLayer", static_cast<float>(material.atlasRegion.layer));
+            shader.setUniform("u_AtlasMaxLod", material.atlasRegion.maxLod);
+        }
+        else if(material.textured)
+        {
+            glActiveTexture(GL_TEXTURE1);
+            gl::Texture::bind(&material.diffuseTexture);
+            glActiveTexture(GL_TEXTURE0);
+        }
         
         shader.setUniform("u_DiffuseColor", material.diffuseColor);
         
@@ -43,4 +64,76 @@ namespace obj
         glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, nullptr);
         glBindVertexArray(0);
     }
+    
+    void Mesh::drawOccluder(math::OcclusionBuffer& buffer, const glm::mat4& model) const
+    {
+        if(!vertices.empty())
+        {
+            buffer.addOccluder(model, &vertices[0].pos, vertices.size(), sizeof(Vertex),
+                               indices.data(), indices.size());
+        }
+    }
+    
+    void Mesh::buildBVH()
+    {
+        if(!vertices.empty())
+        {
+            bvh.build(&vertices[0].pos, vertices.size(), sizeof(Vertex), indices.data(), indices.size());
+        }
+    }
+    
+    std::optional<math::TriangleBVH::Hit> Mesh::raycast(const glm::vec3& origin, const glm::vec3& direction,
+                                                        float maxDistance) const
+    {
+        if(!bvh.empty())
+        {
+            return bvh.raycast(origin, direction, maxDistance);
+        }
+        
+        std::optional<math::TriangleBVH::Hit> closest;
+        for(std::size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            const auto hit = math::TriangleBVH::intersect(origin, direction, vertices[indices[i]].pos,
+                                                          vertices[indices[i + 1]].pos, vertices[indices[i + 2]].pos,
+                                                          maxDistance);
+            if(hit)
+            {
+                closest = hit;
+                closest->triangle = static_cast<std::uint32_t>(i / 3);
+                maxDistance = hit->distance;
+            }
+        }
+        
+        return closest;
+    }
+    
+    const math::TriangleBVH& Mesh::getBVH() const
+    {
+        return bvh;
+    }
+    
+    const Material& Mesh::getMaterial() const
+    {
+        return material;
+    }
+    
+    Material& Mesh::getMaterial()
+    {
+        return material;
+    }
+    
+    const math::AABB& Mesh::getBounds() const
+    {
+        return bounds;
+    }
+    
+    const Mesh::Vertices& Mesh::getVertices() const
+    {
+        return vertices;
+    }
+    
+    const Mesh::Indices& Mesh::getIndices() const
+    {
+        return indices;
+    }
 }
\ No newline at end of file
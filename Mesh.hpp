@@ -2,8 +2,13 @@
 
 #include <utility/gl/gl.hpp>
 #include <utility/gl/Shader.hpp>
+#include <utility/gl/TextureAtlas.hpp>
+#include <utility/math/AABB.hpp>
+#include <utility/math/OcclusionBuffer.hpp>
+#include <utility/math/TriangleBVH.hpp>
 #include <glm/vec3.hpp>
 #include <glm/vec2.hpp>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -27,6 +32,12 @@ namespace obj
     {
         gl::Texture diffuseTexture;
         glm::vec4 diffuseColor{1};
+        bool textured{false}; ///< If diffuseTexture is loaded, else only diffuseColor is used
+        
+        /// @brief Where the texture is in the atlas of the model, which replaces diffuseTexture, if packed.
+        gl::TextureAtlas::Region atlasRegion;
+        
+        bool isAtlased() const { return textured && atlasRegion.layer >= 0; }
     };
     
     class Mesh
@@ -39,12 +50,41 @@ namespace obj
         
         void draw(gl::Shader& shader) const;
         
+        /// @brief Add the triangles to the occluders of a buffer.
+        /// @param model Transform of the mesh to world coordinates.
+        void drawOccluder(math::OcclusionBuffer& buffer, const glm::mat4& model) const;
+        
+        const Material& getMaterial() const;
+        Material& getMaterial();
+        
+        /// @brief Bounds of the vertices, in the coordinates of the mesh.
+        const math::AABB& getBounds() const;
+        
+        /// @brief Build the tree of raycast(), pure CPU so it can run on the workers.
+        /// @remarks Optional: without it, raycast() tests every triangle.
+        void buildBVH();
+        
+        /// @brief Find the closest triangle hit by a ray, in the coordinates of the mesh.
+        /// @details See math::TriangleBVH::raycast(), the triangle of the hit indexes getIndices() from 3 * triangle.
+        std::optional<math::TriangleBVH::Hit> raycast(const glm::vec3& origin, const glm::vec3& direction,
+                                                      float maxDistance = std::numeric_limits<float>::max()) const;
+        
+        const math::TriangleBVH& getBVH() const;
+        
+        /// @brief The data uploaded to the buffers, kept for the CPU passes.
+        /// @{
+        const Vertices& getVertices() const;
+        const Indices& getIndices() const;
+        /// @}
+        
     private:
         void init();
         
         Vertices vertices;
         Indices indices;
         Material material;
+        math::AABB bounds;
+        math::TriangleBVH bvh;
         
         gl::raii::VertexArray vao;
         gl::raii::Buffer vbo, ebo;
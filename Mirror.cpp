@@ -0,0 +1,290 @@
+#include "Mirror.hpp"
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <cmath>
+#include <limits>
+
+glm::mat4 Mirror::model() const
+{
+    glm::mat4 mat{1};
+    mat = glm::translate(mat, pos);
+    mat = glm::scale(mat, glm::vec3{scale});
+    mat *= glm::mat4{glm::quat{glm::radians(rotation)}};
+    
+    return mat;
+}
+
+glm::vec3 Mirror::origin() const
+{
+    return model() * glm::vec4{glm::vec3{0}, 1};
+}
+
+glm::vec3 Mirror::n1() const
+{
+    return normalize(model() * glm::vec4{glm::vec3{1, 0, 0}, 0});
+}
+
+glm::vec3 Mirror::n2() const
+{
+    return normalize(model() * glm::vec4{glm::vec3{0, 1, 0}, 0});
+}
+
+glm::vec3 Mirror::normal() const
+{
+    return normalize(glm::cross(n1(), n2()));
+}
+
+glm::vec4 Mirror::plane() const
+{
+    const glm::vec3 n = normal();
+    return {n, -glm::dot(n, origin())};
+}
+
+bool Mirror::isFacing(const glm::vec3& eye) const
+{
+    return glm::dot(normal(), eye - origin()) > 0.0f;
+}
+
+std::optional<float> Mirror::raycast(const glm::vec3& origin, const glm::vec3& direction) const
+{
+    // Only from the front, so going against the normal
+    const glm::vec4 plane = this->plane();
+    const float speed = glm::dot(glm::vec3{plane}, direction);
+    if(!(speed < 0.0f))
+    {
+        return std::nullopt;
+    }
+    
+    const float distance = -(glm::dot(glm::vec3{plane}, origin) + plane.w) / speed;
+    if(distance < 0.0f)
+    {
+        return std::nullopt;
+    }
+    
+    // In the unit quad
+    const glm::vec3 local{glm::inverse(model()) * glm::vec4{origin + direction * distance, 1}};
+    if(std::abs(local.x) > 0.5f || std::abs(local.y) > 0.5f)
+    {
+        return std::nullopt;
+    }
+    
+    return distance;
+}
+
+math::Frustum Mirror::portal(const glm::vec3& eye) const
+{
+    math::Frustum frustum;
+    
+    if(!isFacing(eye))
+    {
+        return frustum;
+    }
+    
+    const glm::mat4 model = this->model();
+    const glm::vec3 corners[4] = {
+        model * glm::vec4{-.5, -.5, 0, 1},
+        model * glm::vec4{.5, -.5, 0, 1},
+        model * glm::vec4{.5, .5, 0, 1},
+        model * glm::vec4{-.5, .5, 0, 1}
+    };
+    const glm::vec3 center{model[3]};
+    
+    // The plane through the eye and each edge, its normal toward the center of the mirror
+    for(int i = 0; i < 4; ++i)
+    {
+        glm::vec3 normal = glm::cross(corners[i] - eye, corners[(i + 1) % 4] - eye);
+        const float length = glm::length(normal);
+        
+        // The eye almost in the plane of the mirror: keep the plane which accepts everything
+        if(!(length > 1e-6f))
+        {
+            continue;
+        }
+        
+        normal /= length;
+        if(glm::dot(normal, center - eye) < 0.0f)
+        {
+            normal = -normal;
+        }
+        
+        frustum.planes[i] = {normal, -glm::dot(normal, eye)};
+    }
+    
+    // The reflections are behind the mirror
+    frustum.planes[4] = -plane();
+    
+    return frustum;
+}
+
+std::optional<ScreenRect> Mirror::screenBounds(const glm::mat4& viewProj, glm::ivec2 viewport) const
+{
+    const glm::mat4 mvp{viewProj * model()};
+    
+    const glm::vec4 corners[4]{
+        mvp * glm::vec4{-.5, -.5, 0, 1},
+        mvp * glm::vec4{.5, -.5, 0, 1},
+        mvp * glm::vec4{.5, .5, 0, 1},
+        mvp * glm::vec4{-.5, .5, 0, 1}
+    };
+    
+    // Sutherland-Hodgman against the plane w = epsilon, to never divide by a null or negative w.
+    // Called every frame, so on the stack: a plane cuts at most one corner of the quad, which makes 5 of them
+    const float epsilon = 1e-5f;
+    glm::vec4 clipped[5];
+    std::size_t count = 0;
+    
+    for(std::size_t i = 0; i < 4; ++i)
+    {
+        const glm::vec4& a = corners[i];
+        const glm::vec4& b = corners[(i + 1) % 4];
+        const bool aInside = a.w > epsilon;
+        const bool bInside = b.w > epsilon;
+        
+        if(aInside)
+        {
+            clipped[count++] = a;
+        }
+        
+        if(aInside != bInside)
+        {
+            const float t = (epsilon - a.w) / (b.w - a.w);
+            clipped[count++] = glm::mix(a, b, t);
+        }
+    }
+    
+    if(count == 0)
+    {
+        return std::nullopt;
+    }
+    
+    glm::vec2 min{std::numeric_limits<float>::max()};
+    glm::vec2 max{std::numeric_limits<float>::lowest()};
+    
+    for(std::size_t i = 0; i < count; ++i)
+    {
+        const glm::vec4& corner = clipped[i];
+        const glm::vec2 ndc{glm::vec2{corner} / corner.w};
+        min = glm::min(min, ndc);
+        max = glm::max(max, ndc);
+    }
+    
+    min = glm::max(min, glm::vec2{-1});
+    max = glm::min(max, glm::vec2{1});
+    
+    if(min.x >= max.x || min.y >= max.y)
+    {
+        return std::nullopt;
+    }
+    
+    // NDC to window coordinates, rounded outward to not lose any pixel on the edges
+    const glm::ivec2 pos{glm::floor((min * 0.5f + 0.5f) * glm::vec2{viewport})};
+    const glm::ivec2 end{glm::ceil((max * 0.5f + 0.5f) * glm::vec2{viewport})};
+    
+    return ScreenRect{pos, end - pos};
+}
+
+glm::mat4 Mirror::getReflectionMatrixInMirrorCoords() const
+{
+    // Only build the model matrix once, n1(), n2() and origin() would each rebuild it
+    const glm::mat4 model = this->model();
+    const glm::vec3 n1{normalize(glm::vec3{model[0]})};
+    const glm::vec3 n2{normalize(glm::vec3{model[1]})};
+    const glm::vec3 mirrorPos{model[3]};
+
+    const glm::vec3 n3{normalize(glm::cross(n1, n2))};
+
+    // n1, n2 are orthogonal vectors of the mirror
+    // n3 is to complete the basis
+    // the vertices should be in trigonometric order to work
+    glm::mat4 reflectionMatrix{1};
+
+    // Let p be the point we mirror
+    // Compute p1 = p relative to the mirror [Translation in global coordinate system ~= premultiply]
+    reflectionMatrix = glm::translate(glm::mat4{1}, -mirrorPos) * reflectionMatrix;
+
+    // Compute p2 = same as p1 but in coordinate system {n1, n2, n3}
+    // The basis is orthonormal (rotation and uniform scale only), so the inverse is the transpose
+    reflectionMatrix = glm::transpose(glm::transition(n1, n2, n3)) * reflectionMatrix;
+
+    // Compute p3 = (p3.x, p3.y, -p3.z) to go into the mirror (z is orthogonal distance from mirror)
+    reflectionMatrix = glm::scale(glm::mat4{1}, {1, 1, -1}) * reflectionMatrix;
+
+    return reflectionMatrix;
+}
+
+glm::mat4 Mirror::getReflectionMatrix() const
+{
+    const glm::mat4 model = this->model();
+    const glm::vec3 n1{normalize(glm::vec3{model[0]})};
+    const glm::vec3 n2{normalize(glm::vec3{model[1]})};
+    const glm::vec3 mirrorPos{model[3]};
+    
+    const glm::vec3 n3{normalize(glm::cross(n1, n2))};
+    
+    // n1, n2 are orthogonal vectors of the mirror
+    // n3 is to complete the basis
+    // the vertices should be in trigonometric order to work
+    glm::mat4 reflectionMatrix{1};
+    
+    // Let p be the point we mirror
+    // Compute p1 = p relative to the mirror [Translation in global coordinate system ~= premultiply]
+    reflectionMatrix = glm::translate(glm::mat4{1}, -mirrorPos) * reflectionMatrix;
+    
+    // Compute p2 = same as p1 but in coordinate system {n1, n2, n3}
+    // The basis is orthonormal (rotation and uniform scale only), so the inverse is the transpose
+    reflectionMatrix = glm::transpose(glm::transition(n1, n2, n3)) * reflectionMatrix;
+    
+    // Compute p3 = (p3.x, p3.y, -p3.z) to go into the mirror (z is orthogonal distance from mirror)
+    reflectionMatrix = glm::scale(glm::mat4{1}, {1, 1, -1}) * reflectionMatrix;
+    
+    // Compute p4 = same as p3 but in canonical coordinate system (again relative to the mirror)
+    reflectionMatrix = glm::transition(n1, n2, n3) * reflectionMatrix;
+    
+    // Compute p5 = p4 from relative to the mirror to global space [Translation in global coordinate system]
+    reflectionMatrix = glm::translate(glm::mat4{1}, mirrorPos) * reflectionMatrix;
+    
+    return reflectionMatrix;
+}
+
+void Mirror::clearDepth(const Scene& scene, gl::ShaderVariants& shaders) const
+{
+    // Only writes the depth, so the cheapest variant
+    gl::Shader& shader = shaders.get(0);
+    
+    // Clear the depth buffer where the stencil buffer is 1
+    glStencilFunc(GL_EQUAL, 1, 0xff); // To set the reference to 1
+
+    Uniforms uni;
+    uni.send(shader);
+
+    // We can't glDisable(GL_DEPTH_TEST) because it will also disable writing to the depth buffer
+    // We don't change about the color we just want to clear the depth by writing to max depth that is 1
+    glDepthFunc(GL_ALWAYS);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    
+    scene.drawFarQuad();
+
+    glDepthFunc(GL_LESS);
+    glStencilFunc(GL_ALWAYS, 0, 0xff); // To set the reference to 1
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+void Mirror::drawReflection(const Scene& scene, gl::ShaderVariants& shaders, Uniforms uniforms,
+                            const math::OcclusionBuffer *occlusion) const
+{
+    // Draw only where the mirror was drawn == where stencil buffer equals 1
+    glStencilFunc(GL_EQUAL, 1, 0xff); // To set the reference to 1
+    
+    // Mix with the mirror base color
+    uniforms.opacity *= 0.9;
+    
+    uniforms.features |= FeatureMirrorClip;
+    uniforms.reflection = getReflectionMatrix();
+    uniforms.reflectionLocal = getReflectionMatrixInMirrorCoords();
+    
+    // Like getCameraPos() of lighting.glsl
+    const math::Frustum through = portal(glm::vec3{glm::inverse(uniforms.view)[3]});
+    scene.draw(shaders, uniforms, occlusion, &through);
+
+    glStencilFunc(GL_ALWAYS, 0, 0xff); // Reset
+}
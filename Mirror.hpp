@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Scene.hpp"
+#include <glm/glm.hpp>
+#include <optional>
+
+/// @brief Rectangle in window coordinates, in the same convention as glViewport() and glScissor().
+struct ScreenRect
+{
+    glm::ivec2 pos{0};
+    glm::ivec2 size{0};
+};
+
+/// @brief A planar mirror: a unit quad in the plane z = 0 of its model matrix, reflective on the side +z.
+struct Mirror
+{
+    glm::vec3 pos{0};
+    float scale{10.0f};
+    glm::vec3 rotation{0}; // In degrees
+    
+    glm::mat4 model() const;
+    
+    glm::vec3 origin() const;
+    
+    glm::vec3 n1() const;
+    
+    glm::vec3 n2() const;
+    
+    /// @brief Normal of the reflective side of the mirror, in world coordinates.
+    glm::vec3 normal() const;
+    
+    /// @brief Check if the reflective side of the mirror faces a point.
+    /// @details Seen from behind, nothing can be reflected so the reflection passes can be skipped on the CPU.
+    bool isFacing(const glm::vec3& eye) const;
+    
+    /// @brief Compute the rectangle of the window covered by the mirror.
+    /// @details The mirror quad is clipped against the near plane before the projection,
+    /// so the rectangle stays valid when the camera is close to or partially behind the mirror.
+    /// @param viewProj The projection matrix multiplied by the view matrix.
+    /// @param viewport The size of the viewport in pixels.
+    /// @returns Nothing if the mirror is out of the viewport.
+    std::optional<ScreenRect> screenBounds(const glm::mat4& viewProj, glm::ivec2 viewport) const;
+    
+    // transform any point into its reflection, in the mirror coordinate system
+    // more output z is negative more the reflection is far into the mirror
+    glm::mat4 getReflectionMatrixInMirrorCoords() const;
+    
+    glm::mat4 getReflectionMatrix() const;
+    
+    /// @brief Clear the depth where the mirror was drawn (stencil equal to 1), before drawing the reflection.
+    /// @details With the quad of the scene on the far plane, see Scene::drawFarQuad().
+    void clearDepth(const Scene& scene, gl::ShaderVariants& shaders) const;
+    
+    /// @brief Draw the reflected scene where the mirror was drawn (stencil equal to 1).
+    /// @details Only the instances whose reflection is seen through the mirror, see portal().
+    /// @param occlusion If set, rasterized through the reflection matrix, see Scene::draw().
+    void drawReflection(const Scene& scene, gl::ShaderVariants& shaders, Uniforms uniforms,
+                        const math::OcclusionBuffer *occlusion = nullptr) const;
+    
+    /// @brief The pyramid from the eye through the edges of the mirror, behind the mirror.
+    /// @details The reflections drawn are in it, so the culling of the reflection can ignore the instances whose
+    /// reflection is out of it, see Scene::cull(). Any point is in it if the mirror doesn't face the eye.
+    math::Frustum portal(const glm::vec3& eye) const;
+    
+    /// @brief Find where a ray hits the reflective side of the mirror, for picking.
+    /// @returns The distance along the ray, in lengths of its direction.
+    std::optional<float> raycast(const glm::vec3& origin, const glm::vec3& direction) const;
+    
+    /// @brief The plane of the mirror, as (normal, distance) like math::Frustum, see Scene::drawOccluders().
+    glm::vec4 plane() const;
+};
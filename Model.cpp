@@ -1,16 +1,21 @@
 #include "Model.hpp"
 #include <utility/conversion.hpp>
+#include <utility/ThreadPool.hpp>
+#include <utility/time/Trace.hpp>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 #include <glm/gtx/string_cast.hpp>
+#include <algorithm>
 #include <iostream>
 
 namespace obj
 {
-    Model::Model(const std::filesystem::path& path)
+    Model::Model(const std::filesystem::path& path, bool pickable)
         : directory(path.parent_path())
     {
+        trace::Scope scope{"Model::Model", "asset"};
+        
         Assimp::Importer importer;
         const aiScene *scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
         
@@ -19,28 +24,160 @@ namespace obj
             std::cerr << "Failed to load the model " << path << ": " << importer.GetErrorString() << std::endl;
         }
         
-        processNode(*scene->mRootNode, *scene);
+        processNode(*scene->mRootNode, *scene, TransformHierarchy::NoParent);
+        
+        // The textures are decoded and their mipmaps generated in parallel, only the uploads are left,
+        // spread over the next frames if there is a gl::TextureUploader. With several textures, they are packed
+        // into an atlas instead, which waits for their decoding, and is compressed like them once packed.
+        if(pendingTextures.size() > 1)
+        {
+            packTextures(path.filename().string());
+        }
+        
+        for(auto& [mesh, decoded] : pendingTextures)
+        {
+            meshes[mesh].getMaterial().diffuseTexture.load(std::move(decoded));
+        }
+        pendingTextures.clear();
+        
+        // The large meshes split their own build between the workers
+        if(pickable)
+        {
+            trace::Scope bvhScope{"Mesh::buildBVH", "asset"};
+            ThreadPool::global().parallelFor(0, meshes.size(), 1, [&](std::size_t first, std::size_t last) {
+                for(std::size_t i = first; i < last; ++i)
+                {
+                    meshes[i].buildBVH();
+                }
+            });
+        }
+        
+        // The imported hierarchy is static, computed once for all
+        transforms.update();
+        
+        for(std::size_t i = 0; i < meshes.size(); ++i)
+        {
+            bounds.extend(meshes[i].getBounds().transformed(transforms.getWorld(meshNodes[i])));
+        }
+    }
+    
+    void Model::draw(gl::Shader& shader, const glm::mat4& model) const
+    {
+        for(std::size_t i = 0; i < meshes.size(); ++i)
+        {
+            shader.setUniform("u_ModelMatrix", model * transforms.getWorld(meshNodes[i]));
+            meshes[i].draw(shader);
+        }
+    }
+    
+    void Model::draw(const std::function<gl::Shader&(const Material&)>& select, const glm::mat4& model) const
+    {
+        if(!atlas.empty())
+        {
+            atlas.bind();
+        }
+        
+        for(std::size_t i = 0; i < meshes.size(); ++i)
+        {
+            gl::Shader& shader = select(meshes[i].getMaterial());
+            shader.setUniform("u_ModelMatrix", model * transforms.getWorld(meshNodes[i]));
+            meshes[i].draw(shader);
+        }
     }
     
-    void Model::draw(gl::Shader& shader) const
+    void Model::drawOccluders(math::OcclusionBuffer& buffer, const glm::mat4& model) const
     {
-        for(const Mesh& mesh : meshes)
+        for(std::size_t i = 0; i < meshes.size(); ++i)
         {
-            mesh.draw(shader);
+            meshes[i].drawOccluder(buffer, model * transforms.getWorld(meshNodes[i]));
         }
     }
     
-    void Model::processNode(aiNode& node, const aiScene& scene)
+    const math::AABB& Model::getBounds() const
+    {
+        return bounds;
+    }
+    
+    const std::vector<Mesh>& Model::getMeshes() const
     {
+        return meshes;
+    }
+    
+    const glm::mat4& Model::getMeshTransform(std::size_t mesh) const
+    {
+        return transforms.getWorld(meshNodes[mesh]);
+    }
+    
+    void Model::packTextures(const std::string& label)
+    {
+        // The meshes sharing a file share its region
+        std::vector<gl::Texture::Decoded> files;
+        std::vector<std::size_t> fileOfMesh(meshes.size());
+        
+        for(auto& [mesh, decoding] : pendingTextures)
+        {
+            gl::Texture::Decoded decoded = decoding.get();
+            const auto it = std::find_if(files.begin(), files.end(), [&decoded](const gl::Texture::Decoded& file) {
+                return file.path == decoded.path;
+            });
+            
+            fileOfMesh[mesh] = static_cast<std::size_t>(it - files.begin());
+            if(it == files.end())
+            {
+                files.push_back(std::move(decoded));
+            }
+        }
+        
+        // The block compressed files have no RGBA levels, they are decoded again only if the atlas isn't cached
+        std::vector<gl::TextureAtlas::Source> sources;
+        for(const gl::Texture::Decoded& file : files)
+        {
+            gl::TextureAtlas::Source& source = sources.emplace_back();
+            source.path = file.path;
+            
+            if(!file.compressed.empty())
+            {
+                source.size = file.compressed.levels.front().size;
+            }
+            else if(!file.mipmaps.empty())
+            {
+                source.size = file.mipmaps.front().size;
+                source.image = &file.mipmaps.front();
+            }
+        }
+        
+        const std::vector<gl::TextureAtlas::Region> regions = atlas.pack(sources, label,
+                                                                         gl::Texture::getCompressionCacheDirectory());
+        
+        // The files not packed are loaded as before, by each mesh using them
+        for(const auto& [mesh, decoding] : pendingTextures)
+        {
+            Material& material = meshes[mesh].getMaterial();
+            material.atlasRegion = regions[fileOfMesh[mesh]];
+            
+            if(!material.isAtlased())
+            {
+                material.diffuseTexture.load(files[fileOfMesh[mesh]]);
+            }
+        }
+        pendingTextures.clear();
+    }
+    
+    void Model::processNode(aiNode& node, const aiScene& scene, int parent)
+    {
+        // Recursion is depth-first so the parent is always added before its children
+        const int index = transforms.add(convert_mat4<glm::mat4>(node.mTransformation), parent);
+        
         for(unsigned int i = 0; i < node.mNumMeshes; ++i)
         {
             aiMesh *mesh = scene.mMeshes[node.mMeshes[i]];
             meshes.push_back(processMesh(*mesh, scene));
+            meshNodes.push_back(index);
         }
         
         for(unsigned int i = 0; i < node.mNumChildren; ++i)
         {
-            processNode(*node.mChildren[i], scene);
+            processNode(*node.mChildren[i], scene, index);
         }
     }
     
@@ -88,7 +225,8 @@ namespace obj
             {
                 const std::filesystem::path texPath = directory / path.C_Str();
                 std::cout << "Loading texture " << texPath << std::endl;
-                material.diffuseTexture.load(texPath);
+                pendingTextures.emplace_back(meshes.size(), gl::Texture::decodeAsync(texPath, gl::ColorSpace::Srgb));
+                material.textured = true;
             }
             else
             {
@@ -115,11 +253,7 @@ namespace obj
                 material.diffuseColor = glm::vec4{1};
             }
         }
-        else
-        {
-            // White diffuse texture by default
-            material.diffuseTexture.load({1, 1}, glm::vec4{1});
-        }
+        // Else untextured and white by default
         
         return Mesh{vertices, indices, std::move(material)};
     }
@@ -1,7 +1,11 @@
 #pragma once
 
 #include "Mesh.hpp"
+#include "TransformHierarchy.hpp"
 #include <filesystem>
+#include <functional>
+#include <future>
+#include <utility>
 
 class aiNode;
 class aiScene;
@@ -12,15 +16,46 @@ namespace obj
     class Model
     {
     public:
-        Model(const std::filesystem::path& path);
+        /// @param pickable Build the triangle BVH of each mesh, for the ray casts, see Mesh::raycast().
+        Model(const std::filesystem::path& path, bool pickable = true);
         
-        void draw(gl::Shader& shader) const;
+        /// @brief Draw all the meshes, each one with its node transform.
+        /// @param model The model matrix of the whole model, u_ModelMatrix is set to model * node transform.
+        void draw(gl::Shader& shader, const glm::mat4& model) const;
+        
+        /// @brief Draw all the meshes, each one with a shader chosen for its material.
+        /// @param select Returns the shader to draw a material with, with all the uniforms set but u_ModelMatrix.
+        void draw(const std::function<gl::Shader&(const Material&)>& select, const glm::mat4& model) const;
+        
+        /// @brief Add all the meshes to the occluders of a buffer, each one with its node transform.
+        void drawOccluders(math::OcclusionBuffer& buffer, const glm::mat4& model) const;
+        
+        /// @brief Bounds of all the meshes with their node transform, in the coordinates of the model.
+        const math::AABB& getBounds() const;
+        
+        const std::vector<Mesh>& getMeshes() const;
+        
+        /// @brief The node transform of a mesh, in the coordinates of the model.
+        const glm::mat4& getMeshTransform(std::size_t mesh) const;
         
     private:
-        void processNode(aiNode& node, const aiScene& scene);
+        void processNode(aiNode& node, const aiScene& scene, int parent);
         Mesh processMesh(aiMesh& mesh, const aiScene& scene);
         
+        /// @brief Pack the textures decoded into the atlas, the ones which don't fit get their own texture.
+        void packTextures(const std::string& label);
+        
         std::vector<Mesh> meshes; ///< Children meshes.
+        std::vector<int> meshNodes; ///< For each mesh, its node in the transforms.
+        TransformHierarchy transforms; ///< The aiNode transforms, flattened.
+        math::AABB bounds;
         std::filesystem::path directory; ///< Where to load textures
+        
+        /// @brief The textures of the meshes, if there are several, bound once for all the meshes.
+        gl::TextureAtlas atlas;
+        
+        /// @brief The textures decoded by the workers while importing, with the index of their mesh.
+        /// @remarks Only used by the constructor, which uploads them once all the meshes are imported.
+        std::vector<std::pair<std::size_t, std::future<gl::Texture::Decoded>>> pendingTextures;
     };
 }
\ No newline at end of file
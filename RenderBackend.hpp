@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Scene.hpp"
+#include "Mirror.hpp"
+#include <utility/gl/Image.hpp>
+#include <utility/time/Profiler.hpp>
+
+/// @brief Something which renders the frames of a scene: the Renderer with OpenGL, or the SoftwareRenderer on the CPU.
+/// @details The same Scene, Mirror and Frame drive both, so the application, the benchmark and the offline renders
+/// can switch between them.
+class RenderBackend
+{
+public:
+    /// @brief What to draw and from where, for one frame.
+    struct Frame
+    {
+        Uniforms uniforms; ///< Camera matrices, light and time, uniforms.shadowCascades is set by render()
+        glm::vec3 eye{0}; ///< Position of the camera, in world coordinates
+        float zNear{0.1f};
+        float zFar{100.0f};
+        glm::ivec2 viewport{0};
+        bool shadows{true};
+        int shadowCascades{1};
+        bool reflectionOnly{false}; ///< Draw the scene through the reflection matrix, to debug the mirror
+        bool occlusionCulling{true}; ///< Skip the instances hidden by the occluders, in the scene and the reflection
+        Profiler *profiler{nullptr}; ///< Where to measure the passes, can be nullptr
+    };
+    
+    virtual ~RenderBackend() = default;
+    
+    /// @brief Render a frame, its target is cleared first.
+    virtual void render(const Scene& scene, const Mirror& mirror, Frame frame) = 0;
+    
+    /// @brief The color of the last frame rendered, over its viewport.
+    virtual gl::Image read() const = 0;
+};
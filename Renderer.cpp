@@ -0,0 +1,215 @@
+#include "Renderer.hpp"
+#include <algorithm>
+#include <optional>
+
+Renderer::Renderer(const std::filesystem::path& assets)
+    : m_shaders{assets / "base.vert", assets / "base.frag", shaderFeatureDefines}
+{
+    // The variants created during a frame, after the shadow map was sent to the others
+    m_shaders.setOnCreate([this](gl::Shader& shader) {
+        if(m_shadowMapRendered)
+        {
+            m_shadowMap.send(shader);
+        }
+    });
+    
+    // Submit all the shaders before using any, so the driver can compile them in parallel.
+    // The variants drawn every frame (0 clears the depth of the mirror), the others are compiled when first used
+    const unsigned int lit = FeatureDiffuse | FeatureSpecular | FeatureShadows;
+    m_shaders.prewarm({0, lit, lit | FeatureTextured, lit | FeatureMirrorClip, lit | FeatureMirrorClip | FeatureTextured,
+                       lit | FeatureAtlas, lit | FeatureMirrorClip | FeatureAtlas});
+    
+    m_shadowShader.submit(assets / "shadow.vert", assets / "shadow.frag");
+    
+    m_white.load1x1White();
+}
+
+void Renderer::render(const Scene& scene, const Mirror& mirror, Frame frame)
+{
+    // The uniforms of the passes, without shadows until the shadow map is rendered
+    Uniforms base = frame.uniforms;
+    base.shadowCascades = 0;
+    
+    if(frame.shadows)
+    {
+        Profiler::Scope scope{frame.profiler, "Shadow map"};
+        
+        m_shadowMap.setCascadeCount(frame.shadowCascades);
+        m_shadowMap.render(scene, m_shadowShader, base.lightDir, base.view, base.proj, frame.zNear, frame.zFar);
+        m_shaders.forEach([&](gl::Shader& shader) { m_shadowMap.send(shader); });
+        m_shadowMapRendered = true;
+        
+        base.shadowCascades = m_shadowMap.getCascadeCount();
+    }
+    
+    {
+        Profiler::Scope scope{frame.profiler, "Virtual texture feedback"};
+        updateVirtualTextures(scene, mirror, frame);
+    }
+    
+    m_viewport = frame.viewport;
+    glViewport(0, 0, frame.viewport.x, frame.viewport.y);
+    scene.resetGL();
+    scene.clear();
+    
+    // Use texture 0 as the "non-texture"
+    // Since we mostly multiply the texture, we use opaque white 1x1 as default
+    // So we can use any shader using textures without needing specific ones, and we can also use effects
+    glActiveTexture(GL_TEXTURE0);
+    gl::Texture::bind(&m_white);
+    
+    Uniforms uniforms = base;
+    
+    if(frame.reflectionOnly)
+    {
+        uniforms.model = mirror.getReflectionMatrix();
+    }
+    
+    const math::OcclusionBuffer *occlusion = nullptr;
+    
+    if(frame.occlusionCulling)
+    {
+        Profiler::Scope scope{frame.profiler, "Occlusion culling"};
+        scene.drawOccluders(m_occlusion, uniforms.proj * uniforms.view * uniforms.model);
+        occlusion = &m_occlusion;
+    }
+    
+    {
+        Profiler::Scope scope{frame.profiler, "Scene"};
+        scene.draw(m_shaders, uniforms, occlusion);
+    }
+    
+    Profiler::Scope mirrorScope{frame.profiler, "Mirror"};
+    
+    uniforms = base;
+    uniforms.model = mirror.model();
+    uniforms.ambient = 1.;
+    uniforms.diffuseColor = glm::vec4{1, 0, 1, 1};
+    
+    // Count the samples of the mirror which pass the depth test.
+    // The reflection passes are then conditionally rendered by the GPU, without the CPU waiting for the result:
+    // if the mirror is fully hidden, the depth clear and the whole reflected scene are skipped.
+    // The passes are also scissored to the rectangle covered by the mirror,
+    // so they only cost in proportion to the size of the mirror on the screen.
+    std::optional<ScreenRect> mirrorBounds;
+    
+    if(mirror.isFacing(frame.eye))
+    {
+        mirrorBounds = mirror.screenBounds(uniforms.proj * uniforms.view, frame.viewport);
+    }
+    
+    if(mirrorBounds)
+    {
+        glBeginQuery(GL_ANY_SAMPLES_PASSED, m_mirrorQuery);
+    }
+    
+    {
+        Profiler::Scope scope{frame.profiler, "Mirror stencil"};
+        scene.drawMirror(m_shaders, uniforms);
+    }
+    
+    if(mirrorBounds)
+    {
+        glEndQuery(GL_ANY_SAMPLES_PASSED);
+        glBeginConditionalRender(m_mirrorQuery, GL_QUERY_WAIT);
+        
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(mirrorBounds->pos.x, mirrorBounds->pos.y, mirrorBounds->size.x, mirrorBounds->size.y);
+        
+        {
+            Profiler::Scope scope{frame.profiler, "Mirror::clearDepth"};
+            mirror.clearDepth(scene, m_shaders);
+        }
+        
+        const math::OcclusionBuffer *reflectionOcclusion = nullptr;
+        
+        if(frame.occlusionCulling)
+        {
+            // The reflection is the scene seen through the reflection matrix, without what is behind the mirror
+            Profiler::Scope scope{frame.profiler, "Reflection occlusion culling"};
+            scene.drawOccluders(m_reflectionOcclusion, base.proj * base.view * mirror.getReflectionMatrix(),
+                                mirror.plane());
+            reflectionOcclusion = &m_reflectionOcclusion;
+        }
+        
+        {
+            Profiler::Scope scope{frame.profiler, "Mirror::drawReflection"};
+            mirror.drawReflection(scene, m_shaders, base, reflectionOcclusion);
+        }
+        
+        glDisable(GL_SCISSOR_TEST);
+        glEndConditionalRender();
+    }
+}
+
+void Renderer::updateVirtualTextures(const Scene& scene, const Mirror& mirror, const Frame& frame)
+{
+    std::vector<gl::VirtualTexture *> textures;
+    for(const Instance& instance : scene.instances)
+    {
+        if(instance.virtualTexture
+           && std::find(textures.begin(), textures.end(), instance.virtualTexture) == textures.end())
+        {
+            textures.push_back(instance.virtualTexture);
+        }
+    }
+    
+    if(textures.empty())
+    {
+        return;
+    }
+    
+    scene.resetGL();
+    m_feedback.begin(frame.viewport);
+    
+    // Only the pages matter, not the lighting
+    Uniforms uniforms = frame.uniforms;
+    uniforms.features = FeatureFeedback;
+    uniforms.shadowCascades = 0;
+    uniforms.virtualLodBias = m_feedback.getLodBias();
+    
+    if(frame.reflectionOnly)
+    {
+        uniforms.model = mirror.getReflectionMatrix();
+    }
+    
+    scene.draw(m_shaders, uniforms);
+    m_feedback.end();
+    
+    for(gl::VirtualTexture *texture : textures)
+    {
+        texture->update(m_feedback);
+    }
+}
+
+gl::Image Renderer::read() const
+{
+    gl::Image image;
+    image.size = m_viewport;
+    image.pixels.resize(static_cast<std::size_t>(m_viewport.x) * m_viewport.y * 4);
+    
+    // The rows of RGBA8 are always aligned on 4 bytes, the default GL_PACK_ALIGNMENT
+    glReadPixels(0, 0, m_viewport.x, m_viewport.y, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.data());
+    
+    return image;
+}
+
+gl::ShaderVariants& Renderer::getShaders()
+{
+    return m_shaders;
+}
+
+const ShadowMap& Renderer::getShadowMap() const
+{
+    return m_shadowMap;
+}
+
+const math::OcclusionBuffer& Renderer::getOcclusion() const
+{
+    return m_occlusion;
+}
+
+const math::OcclusionBuffer& Renderer::getReflectionOcclusion() const
+{
+    return m_reflectionOcclusion;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "RenderBackend.hpp"
+#include "ShadowMap.hpp"
+#include <utility/gl/ShaderVariants.hpp>
+#include <filesystem>
+
+/// @brief Render the frames of the scene: the shadow map, the virtual texture feedback, the scene, the mirror and its
+/// reflection.
+/// @details Shared by the application and the benchmark, so the benchmark measures the same passes.
+class Renderer : public RenderBackend
+{
+public:
+    /// @param assets Where the shaders are.
+    explicit Renderer(const std::filesystem::path& assets);
+    
+    /// @remarks The shader variants refer to the renderer.
+    Renderer(const Renderer&) = delete;
+    Renderer& operator=(const Renderer&) = delete;
+    
+    /// @brief Render a frame into the bound framebuffer, which is cleared first.
+    void render(const Scene& scene, const Mirror& mirror, Frame frame) override;
+    
+    /// @brief Read the color of the bound framebuffer, over the viewport of the last frame.
+    /// @remarks Waits for the GPU to finish the frame.
+    gl::Image read() const override;
+    
+    /// @brief The variants of the base shaders, to draw more on top of a frame.
+    gl::ShaderVariants& getShaders();
+    
+    const ShadowMap& getShadowMap() const;
+    
+    /// @brief The occlusion buffers of the last frame, of the scene and of the reflection.
+    /// @{
+    const math::OcclusionBuffer& getOcclusion() const;
+    const math::OcclusionBuffer& getReflectionOcclusion() const;
+    /// @}
+
+private:
+    gl::ShaderVariants m_shaders;
+    gl::Shader m_shadowShader;
+    ShadowMap m_shadowMap;
+    bool m_shadowMapRendered{false}; ///< Once it is, the variants created later get its uniforms
+    
+    /// @brief Draw the scene into the feedback, and stream the pages seen into the virtual textures of the instances.
+    /// @remarks Only the main view requests pages, the reflection uses the ones resident.
+    void updateVirtualTextures(const Scene& scene, const Mirror& mirror, const Frame& frame);
+    
+    gl::VirtualTextureFeedback m_feedback;
+    
+    /// @brief Bound on the unit 0 as the "non-texture".
+    gl::Texture m_white;
+    
+    /// @brief Occlusion query of the mirror surface, to skip the reflection when the mirror is hidden.
+    gl::raii::Query m_mirrorQuery;
+    
+    /// @brief Rasterized on the CPU before drawing the scene and the reflection, see Scene::drawOccluders().
+    math::OcclusionBuffer m_occlusion, m_reflectionOcclusion;
+    
+    glm::ivec2 m_viewport{0}; ///< Of the last frame, for read()
+};
@@ -1,38 +1,256 @@
 #include "Scene.hpp"
-#include <GLFW/glfw3.h>
+#include <utility/gl/registry.hpp>
 #include <glm/gtx/transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/matrix.hpp>
+
+namespace
+{
+    const obj::Vertex mirrorVertices[4]{
+        {{-.5, -.5, 0}, {0, 0}, {0, 0, 1}},
+        {{.5, -.5, 0}, {1, 0}, {0, 0, 1}},
+        {{.5, .5, 0}, {1, 1}, {0, 0, 1}},
+        {{-.5, .5, 0}, {0, 1}, {0, 0, 1}}
+    };
+    
+    // The max depth is 1
+    const obj::Vertex farVertices[4]{
+        {{-1, -1, 1}},
+        {{1, -1, 1}},
+        {{1, 1, 1}},
+        {{-1, 1, 1}}
+    };
+}
+
+Quad::Quad(const obj::Vertex (&vertices)[4], const std::string& label)
+{
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    gl::registry::setBufferStorage(vbo, sizeof(vertices));
+    gl::registry::setLabel(gl::registry::Type::Buffer, vbo, label);
+    gl::registry::setLabel(gl::registry::Type::VertexArray, vao, label);
+    
+    glEnableVertexAttribArray(obj::AttrVertex);
+    gl::vertexAttribPointer(obj::AttrVertex, 3, GL_FLOAT, &obj::Vertex::pos);
+    
+    glEnableVertexAttribArray(obj::AttrNormal);
+    gl::vertexAttribPointer(obj::AttrNormal, 3, GL_FLOAT, &obj::Vertex::nor);
+    
+    glEnableVertexAttribArray(obj::AttrTextCoords);
+    gl::vertexAttribPointer(obj::AttrTextCoords, 2, GL_FLOAT, &obj::Vertex::texCoords);
+    
+    glBindVertexArray(0);
+}
+
+void Quad::draw() const
+{
+    glBindVertexArray(vao);
+    glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+    glBindVertexArray(0);
+}
 
 Scene::Scene(std::filesystem::path assets)
-    : model{assets / "cube.obj"}
+    : model{assets / "cube.obj"},
+      m_mirrorQuad{mirrorVertices, "Mirror quad"},
+      m_farQuad{farVertices, "Far quad"}
+{
+    // Model on the floor, rotation is set by update()
+    m_rotatingNode = transforms.add();
+    instances.push_back({&model, m_rotatingNode, true});
+    
+    // Floor
+    glm::mat4 floor{1};
+    floor = glm::translate(floor, {0, -3, 0});
+    floor = glm::scale(floor, {10.0f, 0.1f, 10.0f});
+    m_floor = instances.size();
+    instances.push_back({&model, transforms.add(floor), false});
+    instances.back().occluder = true;
+    
+    transforms.update();
+    updateBVH();
+}
+
+void Scene::update(float time)
 {
+    transforms.setLocal(m_rotatingNode, glm::vec3{0}, glm::angleAxis(time, glm::normalize(glm::vec3{1, 1, 0})),
+                        glm::vec3{1});
+    transforms.update();
+    updateBVH();
 }
 
-void Scene::draw(gl::Shader& shader, Uniforms base) const
+void Scene::updateBVH()
 {
-    // Model on the floor
+    m_boxes.clear();
+    
+    for(const Instance& instance : instances)
     {
-        Uniforms uniforms = base;
-        const float angle = static_cast<float>(glfwGetTime());
-        uniforms.texture = 1;
-        uniforms.model = glm::rotate(uniforms.model, angle, {1, 1, 0});
-        uniforms.send(shader);
-        model.draw(shader);
+        m_boxes.push_back(getBounds(instance));
     }
     
-    // Floor
-    {
+    m_bvh.update(m_boxes);
+}
+
+void Scene::draw(gl::ShaderVariants& shaders, Uniforms base, const math::OcclusionBuffer *occlusion,
+                 const math::Frustum *portal) const
+{
+    base.texture = 1;
+    
+    cull(base, occlusion, portal, [&](const Instance& instance) {
         Uniforms uniforms = base;
-        uniforms.texture = 1;
-        uniforms.model = glm::translate(uniforms.model, {0, -3, 0});
-        uniforms.model = glm::scale(uniforms.model, {10.0f, 0.1f, 10.0f});
-        uniforms.send(shader);
-        model.draw(shader);
+        uniforms.model = base.model * transforms.getWorld(instance.node);
+        uniforms.virtualTexture = instance.virtualTexture;
+        drawModel(*instance.model, shaders, uniforms);
+    });
+}
+
+void Scene::cull(const Uniforms& uniforms, const math::OcclusionBuffer *occlusion, const math::Frustum *portal,
+                 const std::function<void(const Instance&)>& visit) const
+{
+    // The boxes are in world coordinates, the frustum is moved back to them through all the transforms of base.vert
+    const glm::mat4 reflection = (uniforms.features & FeatureMirrorClip) ? uniforms.reflection : glm::mat4{1};
+    const glm::mat4 model = reflection * uniforms.model;
+    const math::Frustum frustum{uniforms.proj * uniforms.view * model};
+    
+    // A plane p tests the transformed points: dot(p, model * x) = dot(transpose(model) * p, x)
+    math::Frustum local;
+    if(portal)
+    {
+        const glm::mat4 transposed = glm::transpose(model);
+        for(int i = 0; i < 6; ++i)
+        {
+            local.planes[i] = transposed * portal->planes[i];
+        }
     }
+    
+    // Hidden in the occlusion buffer is also conservative for a node: its box contains the boxes of its instances
+    m_bvh.query([&](const math::AABB& box) {
+        return frustum.intersects(box) && (!portal || local.intersects(box))
+               && (!occlusion || occlusion->isVisible(box));
+    }, [&](std::uint32_t index) {
+        visit(instances[index]);
+    });
+}
+
+void drawModel(const obj::Model& model, gl::ShaderVariants& shaders, const Uniforms& uniforms)
+{
+    const gl::Shader *current = nullptr;
+    
+    model.draw([&](const obj::Material& material) -> gl::Shader&
+    {
+        gl::Shader& shader = shaders.get(uniforms.getFeatures(material.textured, material.isAtlased()));
+        
+        // Consecutive meshes drawn with the same variant don't need the uniforms again
+        if(&shader != current)
+        {
+            uniforms.send(shader);
+            current = &shader;
+        }
+        
+        return shader;
+    }, uniforms.model);
+}
+
+void Scene::drawShadowCasters(gl::Shader& shader, Uniforms base, const math::Frustum& frustum, bool dynamic) const
+{
+    m_bvh.query([&](const math::AABB& box) { return frustum.intersects(box); }, [&](std::uint32_t index) {
+        const Instance& instance = instances[index];
+        if(instance.dynamic == dynamic)
+        {
+            Uniforms uniforms = base;
+            uniforms.model = base.model * transforms.getWorld(instance.node);
+            uniforms.send(shader);
+            instance.model->draw(shader, uniforms.model);
+        }
+    });
+}
+
+void Scene::drawOccluders(math::OcclusionBuffer& buffer, const glm::mat4& viewProj,
+                          const std::optional<glm::vec4>& plane) const
+{
+    buffer.clear(viewProj);
+    
+    // The occluders out of the view hide nothing
+    const math::Frustum frustum{viewProj};
+    
+    m_bvh.query([&](const math::AABB& box) { return frustum.intersects(box); }, [&](std::uint32_t index) {
+        const Instance& instance = instances[index];
+        if(!instance.occluder)
+        {
+            return;
+        }
+        
+        if(plane)
+        {
+            // Distance of the corner of the box the most behind the plane
+            const math::AABB& bounds = m_bvh.getBoxes()[index];
+            const glm::vec3 normal{*plane};
+            if(glm::dot(normal, bounds.center()) - glm::dot(glm::abs(normal), bounds.extent()) + plane->w < 0.0f)
+            {
+                return;
+            }
+        }
+        
+        instance.model->drawOccluders(buffer, transforms.getWorld(instance.node));
+    });
+    
+    buffer.rasterize();
+}
+
+std::optional<RayHit> Scene::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const
+{
+    std::optional<RayHit> closest;
+    
+    m_bvh.raycast(origin, direction, maxDistance, [&](std::uint32_t index, float distance) {
+        const Instance& instance = instances[index];
+        const glm::mat4& world = transforms.getWorld(instance.node);
+        const std::vector<obj::Mesh>& meshes = instance.model->getMeshes();
+        
+        for(std::size_t i = 0; i < meshes.size(); ++i)
+        {
+            // The distances along an affine transform of the ray are the same
+            const glm::mat4 toMesh = glm::inverse(world * instance.model->getMeshTransform(i));
+            const auto hit = meshes[i].raycast(toMesh * glm::vec4{origin, 1}, toMesh * glm::vec4{direction, 0},
+                                               distance);
+            
+            if(hit)
+            {
+                closest = RayHit{index, i, hit->triangle, hit->barycentrics, hit->distance,
+                                 origin + direction * hit->distance};
+                distance = hit->distance;
+            }
+        }
+        
+        return distance;
+    });
+    
+    return closest;
+}
+
+math::AABB Scene::getBounds(const Instance& instance) const
+{
+    return instance.model->getBounds().transformed(transforms.getWorld(instance.node));
+}
+
+Instance& Scene::getFloor()
+{
+    return instances[m_floor];
+}
+
+math::AABB Scene::getBounds() const
+{
+    return m_bvh.getBounds();
+}
+
+const math::BVH& Scene::getBVH() const
+{
+    return m_bvh;
 }
 
 void Scene::resetGL() const
 {
     glDisable(GL_CULL_FACE);
+    glDisable(GL_SCISSOR_TEST);
     
     glActiveTexture(GL_TEXTURE0);
     
@@ -55,8 +273,10 @@ void Scene::clear() const
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 }
 
-void Scene::drawMirror(gl::Shader& shader, Uniforms uniforms) const
+void Scene::drawMirror(gl::ShaderVariants& shaders, Uniforms uniforms) const
 {
+    gl::Shader& shader = shaders.get(uniforms.getFeatures(false));
+    
     // Where the mirror is drawn, the stencil buffer will contain 1
     // (If the current framebuffer has not stencil buffer, it will just not be written)
     
@@ -64,49 +284,15 @@ void Scene::drawMirror(gl::Shader& shader, Uniforms uniforms) const
     glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE); // Where the triangle is drawn, set 1 in stencil buffer
     
     uniforms.send(shader);
-    
-    gl::raii::VertexArray vao;
-    gl::raii::Buffer vbo;
-    
-    obj::Vertex vertices[4];
-    vertices[0].pos = {-.5, -.5, 0};
-    vertices[1].pos = {.5, -.5, 0};
-    vertices[2].pos = {.5, .5, 0};
-    vertices[3].pos = {-.5, .5, 0};
-    
-    vertices[0].texCoords = {0, 0};
-    vertices[1].texCoords = {1, 0};
-    vertices[2].texCoords = {1, 1};
-    vertices[3].texCoords = {0, 1};
-    
-    vertices[0].nor = {0, 0, 1};
-    vertices[1].nor = {0, 0, 1};
-    vertices[2].nor = {0, 0, 1};
-    vertices[3].nor = {0, 0, 1};
-    
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-    
-    glEnableVertexAttribArray(obj::AttrVertex);
-    gl::vertexAttribPointer(obj::AttrVertex, 3, GL_FLOAT, &obj::Vertex::pos);
-    
-    glEnableVertexAttribArray(obj::AttrNormal);
-    gl::vertexAttribPointer(obj::AttrNormal, 3, GL_FLOAT, &obj::Vertex::nor);
-    
-    glEnableVertexAttribArray(obj::AttrTextCoords);
-    gl::vertexAttribPointer(obj::AttrTextCoords, 2, GL_FLOAT, &obj::Vertex::texCoords);
-    
-    glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
-    glBindVertexArray(0);
+    m_mirrorQuad.draw();
     
     glStencilFunc(GL_ALWAYS, 0, 0xff); // To set the reference to 1
     glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP); // Where the triangle is drawn, set 1 in stencil buffer
 }
 
-Uniforms::Uniforms()
-    : time{static_cast<float>(glfwGetTime())}
+void Scene::drawFarQuad() const
 {
+    m_farQuad.draw();
 }
 
 void Uniforms::send(gl::Shader& shader) const
@@ -130,4 +316,43 @@ void Uniforms::send(gl::Shader& shader) const
     
     // Lighting
     shader.setUniform("u_LightDirection", lightDir);
+    shader.setUniform("u_ShadowCascadeCount", shadowCascades);
+    shader.setUniform("u_ShadowMap", shadowMap);
+    shader.setUniform("u_Atlas", atlas);
+    
+    if(virtualTexture)
+    {
+        virtualTexture->send(shader, virtualLodBias);
+    }
+    
+    if(features & FeatureMirrorClip)
+    {
+        shader.setUniform("u_ReflectionMatrix", reflection);
+        shader.setUniform("u_ReflectionMatrixLocal", reflectionLocal);
+    }
+}
+
+unsigned int Uniforms::getFeatures(bool textured, bool atlased) const
+{
+    unsigned int result = features;
+    
+    if(virtualTexture)
+    {
+        result |= FeatureVirtual;
+    }
+    else if(atlased)
+    {
+        result |= FeatureAtlas;
+    }
+    else if(textured)
+    {
+        result |= FeatureTextured;
+    }
+    
+    if(shadowCascades > 0)
+    {
+        result |= FeatureShadows;
+    }
+    
+    return result;
 }
\ No newline at end of file
@@ -1,7 +1,16 @@
 #pragma once
 
 #include "Model.hpp"
+#include "ShadowMap.hpp"
 #include <utility/gl/Shader.hpp>
+#include <utility/gl/ShaderVariants.hpp>
+#include <utility/gl/VirtualTexture.hpp>
+#include <utility/math/BVH.hpp>
+#include <utility/math/Frustum.hpp>
+#include <utility/math/OcclusionBuffer.hpp>
+#include <functional>
+#include <limits>
+#include <optional>
 
 // add a bit utilities functions...
 namespace glm
@@ -23,38 +32,191 @@ namespace glm
     }
 }
 
+/// @brief Features of the variants of base.vert and base.frag, see gl::ShaderVariants.
+enum ShaderFeature : unsigned int
+{
+    FeatureTextured = 1 << 0, ///< Sample the texture of the material
+    FeatureDiffuse = 1 << 1,
+    FeatureSpecular = 1 << 2,
+    FeatureShadows = 1 << 3, ///< Sample the shadow map
+    FeatureMirrorClip = 1 << 4, ///< Drawn in the mirror, so transformed by the reflection and clipped by the mirror
+    FeatureVirtual = 1 << 5, ///< Sample a gl::VirtualTexture instead of the texture of the material
+    FeatureFeedback = 1 << 6, ///< Write the pages of the virtual textures needed, see gl::VirtualTextureFeedback
+    FeatureAtlas = 1 << 7 ///< Sample the region of the material in the gl::TextureAtlas of its model
+};
+
+/// @brief The macro defined in the shaders for each ShaderFeature, in the order of the bits.
+inline const gl::Shader::Defines shaderFeatureDefines{
+    "TEXTURED", "DIFFUSE", "SPECULAR", "SHADOWS", "MIRROR_CLIP", "VIRTUAL_TEXTURE", "VIRTUAL_FEEDBACK",
+    "TEXTURE_ATLAS"
+};
+
 struct Uniforms
 {
-    Uniforms();
-    
     void send(gl::Shader& shader) const;
     
+    /// @brief The variant of the base shaders to draw with these uniforms.
+    /// @details The features, plus FeatureTextured if textured and FeatureShadows if there are shadow cascades.
+    /// FeatureVirtual replaces FeatureTextured if there is a virtual texture, else FeatureAtlas if the texture is in
+    /// the atlas of the model.
+    unsigned int getFeatures(bool textured, bool atlased = false) const;
+    
     glm::mat4 proj{1};
     glm::mat4 view{1};
     glm::mat4 model{1};
-    float time{0};
+    float time{0}; ///< Seconds, from the clock of the caller
     float ambient{0};
     float diffuse{1};
     float specularExponent{16.0f};
     unsigned int texture{0};
     glm::vec3 lightDir;
-  
+    
     float opacity{1};
     
     glm::vec4 diffuseColor{1};
+    
+    /// @brief Count of shadow cascades to sample, 0 to disable shadows.
+    /// @details The light matrices are sent by ShadowMap::send().
+    int shadowCascades{0};
+    
+    /// @brief Texture unit of the shadow map.
+    /// @remarks Always sent even without shadows: two samplers of different types can't use the same unit.
+    unsigned int shadowMap{ShadowMap::TextureUnit};
+    
+    /// @brief Texture unit of the atlases, always sent for the same reason.
+    unsigned int atlas{gl::TextureAtlas::TextureUnit};
+    
+    /// @brief The features of the lighting, the ones depending on the material and the shadows are added at draw.
+    unsigned int features{FeatureDiffuse | FeatureSpecular};
+    
+    /// @brief Replaces the texture of the materials, its textures and uniforms are sent with the others.
+    const gl::VirtualTexture *virtualTexture{nullptr};
+    
+    /// @brief See gl::VirtualTextureFeedback::getLodBias().
+    float virtualLodBias{0};
+    
+    /// @brief Only sent with FeatureMirrorClip.
+    /// @{
+    glm::mat4 reflection{1}; ///< Transform any point to its reflection
+    glm::mat4 reflectionLocal{1}; ///< Transform any point to its reflection, in the coordinates of the mirror
+    /// @}
+};
+
+/// @brief Draw a model with the variant of the base shaders matching each of its materials.
+/// @param uniforms uniforms.model is the model matrix of the whole model.
+void drawModel(const obj::Model& model, gl::ShaderVariants& shaders, const Uniforms& uniforms);
+
+/// @brief A model placed in the scene.
+struct Instance
+{
+    const obj::Model *model{nullptr};
+    int node{TransformHierarchy::NoParent}; ///< Node in the scene transforms
+    bool dynamic{false}; ///< If the instance moves, static instances are cached in the shadow map
+    gl::VirtualTexture *virtualTexture{nullptr}; ///< Replaces the textures of the model if set, not owned
+    bool occluder{false}; ///< Hides the others in the occlusion buffers: the large instances, with few triangles
 };
 
+/// @brief The closest triangle of the instances hit by a ray, see Scene::raycast().
+struct RayHit
+{
+    std::size_t instance{0}; ///< In Scene::instances
+    std::size_t mesh{0}; ///< In the meshes of the model of the instance
+    std::uint32_t triangle{0}; ///< Its indices start at 3 * triangle in the indices of the mesh
+    glm::vec2 barycentrics{0}; ///< The weights of the second and third vertices of the triangle
+    float distance{0}; ///< Along the ray, in lengths of its direction
+    glm::vec3 point{0}; ///< In world coordinates
+};
+
+/// @brief A quad of 4 vertices drawn as a triangle fan, uploaded once.
+struct Quad
+{
+    /// @param label Of the buffer, for the debuggers and the registry.
+    Quad(const obj::Vertex (&vertices)[4], const std::string& label);
+    
+    /// @brief Draw with the program in use.
+    void draw() const;
+    
+    gl::raii::VertexArray vao;
+    gl::raii::Buffer vbo;
+};
+
+/// @brief The instances, with a math::BVH over their bounds to only visit the ones in a frustum or on a ray.
+/// @remarks update() must be called after adding, removing or moving instances, the BVH is only refreshed there.
 class Scene
 {
 public:
     Scene(std::filesystem::path assets);
     
+    /// @brief Animate the scene, recompute the world matrices which changed and refit the BVH.
+    /// @param time The time of the animation in seconds.
+    void update(float time);
+    
     void resetGL() const;
     void clear() const;
     
-    void draw(gl::Shader& shader, Uniforms uniforms = {}) const;
-    void drawMirror(gl::Shader& shader, Uniforms uniforms) const;
+    /// @brief Draw the instances in the view.
+    /// @param uniforms uniforms.model is applied on top of the world matrix of each instance.
+    /// @param occlusion If set, only the instances visible in it are drawn, see drawOccluders().
+    /// @param portal If set, only the instances seen through it are drawn, see cull().
+    void draw(gl::ShaderVariants& shaders, Uniforms uniforms = {}, const math::OcclusionBuffer *occlusion = nullptr,
+              const math::Frustum *portal = nullptr) const;
+    
+    /// @brief Visit the instances which may be visible with uniforms, walking the BVH: the nodes out of the view, out
+    /// of the portal or hidden in the occlusion buffer are skipped with all their instances.
+    /// @param uniforms The view of draw(): the projection, the view, uniforms.model and, with FeatureMirrorClip, the
+    /// reflection.
+    /// @param portal If set, planes in world coordinates which the drawn geometry must intersect after all the
+    /// transforms, like the pyramid from the eye through the mirror, see Mirror::portal().
+    void cull(const Uniforms& uniforms, const math::OcclusionBuffer *occlusion, const math::Frustum *portal,
+              const std::function<void(const Instance&)>& visit) const;
+    void drawMirror(gl::ShaderVariants& shaders, Uniforms uniforms) const;
+    
+    /// @brief Draw a quad covering the viewport on the far plane, its vertices are in clip coordinates.
+    void drawFarQuad() const;
+    
+    /// @brief Draw only the static or only the dynamic instances which intersect the frustum of the light.
+    void drawShadowCasters(gl::Shader& shader, Uniforms uniforms, const math::Frustum& frustum, bool dynamic) const;
+    
+    /// @brief Clear the buffer, then rasterize the occluders into it.
+    /// @param viewProj The projection matrix multiplied by the view matrix, and by uniforms.model of draw().
+    /// @param plane If set, only the occluders fully on its positive side, as (normal, distance) like math::Frustum:
+    /// the ones clipped by the mirror must not hide its reflection.
+    void drawOccluders(math::OcclusionBuffer& buffer, const glm::mat4& viewProj,
+                       const std::optional<glm::vec4>& plane = std::nullopt) const;
+    
+    /// @brief Find the closest triangle hit by a ray, for picking.
+    /// @details The instances are visited through the BVH from the closest, the ray is moved to the coordinates of
+    /// each mesh, whose triangle BVH is cast against, see obj::Mesh::raycast().
+    /// @param origin, direction In world coordinates, the direction not necessarily normalized.
+    std::optional<RayHit> raycast(const glm::vec3& origin, const glm::vec3& direction,
+                                  float maxDistance = std::numeric_limits<float>::max()) const;
+    
+    /// @brief Bounds of an instance, in world coordinates.
+    math::AABB getBounds(const Instance& instance) const;
+    
+    /// @brief Bounds of all the instances, in world coordinates.
+    math::AABB getBounds() const;
+    
+    /// @brief The BVH over getBounds() of each instance, the indices are the ones of instances.
+    const math::BVH& getBVH() const;
+    
+    Instance& getFloor();
     
     obj::Model model;
+    TransformHierarchy transforms;
+    std::vector<Instance> instances;
+
+private:
+    /// @brief Refit the BVH to the bounds of the instances, or rebuild it, see math::BVH::update().
+    void updateBVH();
+    
+    math::BVH m_bvh;
+    std::vector<math::AABB> m_boxes; ///< The bounds of the instances, kept between the frames to not reallocate them
+    
+    Quad m_mirrorQuad; ///< The mirror in its own coordinates, see drawMirror()
+    Quad m_farQuad; ///< See drawFarQuad()
+    
+    int m_rotatingNode; ///< Node of the animated model on the floor
+    std::size_t m_floor; ///< Index of the floor in the instances
 };
 
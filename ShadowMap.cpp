@@ -0,0 +1,269 @@
+#include "ShadowMap.hpp"
+#include "Scene.hpp"
+#include <utility/math/Frustum.hpp>
+#include <utility/gl/registry.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <string>
+
+namespace
+{
+    /// @brief View matrix of the light, only a rotation so it only depends on the light direction.
+    glm::mat4 lightView(const glm::vec3& lightDir)
+    {
+        // Any up vector not parallel to the light
+        const glm::vec3 up = std::abs(lightDir.y) > 0.99f ? glm::vec3{0, 0, 1} : glm::vec3{0, 1, 0};
+        return glm::lookAt(glm::vec3{0}, lightDir, up);
+    }
+    
+    /// @brief Snap a value to a grid, rounding down.
+    float snapDown(float value, float step)
+    {
+        return std::floor(value / step) * step;
+    }
+    
+    float snapUp(float value, float step)
+    {
+        return std::ceil(value / step) * step;
+    }
+}
+
+ShadowMap::ShadowMap(int resolution, int cascades)
+    : m_resolution(resolution), m_cascadeCount(std::clamp(cascades, 1, MaxCascades))
+{
+    allocate();
+}
+
+void ShadowMap::allocate()
+{
+    for(GLuint texture : {m_staticDepth.id, m_depth.id})
+    {
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, m_resolution, m_resolution, m_cascadeCount, 0,
+                     GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        
+        gl::registry::setImageStorage(gl::registry::Type::Texture, texture, GL_DEPTH_COMPONENT24,
+                                      {m_resolution, m_resolution, m_cascadeCount});
+    }
+    
+    gl::registry::setLabel(gl::registry::Type::Texture, m_staticDepth, "Shadow map (static casters)");
+    gl::registry::setLabel(gl::registry::Type::Texture, m_depth, "Shadow map");
+    
+    // The sampled map compares in hardware (sampler2DArrayShadow), with bilinear filtering of the results
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_depth);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    
+    invalidate();
+}
+
+void ShadowMap::setCascadeCount(int cascades)
+{
+    cascades = std::clamp(cascades, 1, MaxCascades);
+    
+    if(cascades != m_cascadeCount)
+    {
+        m_cascadeCount = cascades;
+        allocate();
+    }
+}
+
+int ShadowMap::getCascadeCount() const
+{
+    return m_cascadeCount;
+}
+
+void ShadowMap::invalidate()
+{
+    for(Cascade& cascade : m_cascades)
+    {
+        cascade.cached = false;
+    }
+}
+
+int ShadowMap::getStaticRedrawCount() const
+{
+    return m_staticRedraws;
+}
+
+void ShadowMap::fit(const Scene& scene, const glm::vec3& lightDir, const glm::mat4& view, const glm::mat4& proj,
+                    float zNear, float zFar)
+{
+    const glm::mat4 lightViewMatrix = lightView(lightDir);
+    
+    // Bounds of the scene in light space, snapped outward to an unit grid
+    // so moving the dynamic casters a bit does not change the light matrices
+    const math::AABB sceneBounds = scene.getBounds().transformed(lightViewMatrix);
+    const glm::vec3 sceneMin = glm::floor(sceneBounds.min) - 1.0f;
+    const glm::vec3 sceneMax = glm::ceil(sceneBounds.max) + 1.0f;
+    
+    // The light looks toward -z: the casters nearest to the light have the biggest z
+    const float lightNear = -sceneMax.z;
+    const float lightFar = -sceneMin.z;
+    
+    glm::mat4 lightProjs[MaxCascades];
+    
+    if(m_cascadeCount == 1)
+    {
+        lightProjs[0] = glm::ortho(sceneMin.x, sceneMax.x, sceneMin.y, sceneMax.y, lightNear, lightFar);
+        m_cascades[0].splitFar = zFar;
+    }
+    else
+    {
+        const glm::mat4 invViewProj = glm::inverse(proj * view);
+        float splitNear = zNear;
+        
+        for(int i = 0; i < m_cascadeCount; ++i)
+        {
+            // Practical split scheme: blend of logarithmic and uniform splits
+            const float ratio = static_cast<float>(i + 1) / static_cast<float>(m_cascadeCount);
+            const float logSplit = zNear * std::pow(zFar / zNear, ratio);
+            const float uniformSplit = zNear + (zFar - zNear) * ratio;
+            const float splitFar = glm::mix(uniformSplit, logSplit, 0.75f);
+            
+            // Corners of the slice of the camera frustum, in world coordinates
+            glm::vec3 corners[8];
+            int count = 0;
+            
+            for(float distance : {splitNear, splitFar})
+            {
+                // View depth to NDC depth, with the projection matrix of the camera
+                const glm::vec4 clip = proj * glm::vec4{0, 0, -distance, 1};
+                const float ndcZ = clip.z / clip.w;
+                
+                for(float x : {-1.0f, 1.0f})
+                {
+                    for(float y : {-1.0f, 1.0f})
+                    {
+                        const glm::vec4 world = invViewProj * glm::vec4{x, y, ndcZ, 1};
+                        corners[count++] = glm::vec3{world} / world.w;
+                    }
+                }
+            }
+            
+            // Bounding sphere of the slice: its size does not change when the camera rotates
+            glm::vec3 center{0};
+            for(const glm::vec3& corner : corners)
+            {
+                center += corner / 8.0f;
+            }
+            
+            float radius = 0;
+            for(const glm::vec3& corner : corners)
+            {
+                radius = std::max(radius, glm::distance(center, corner));
+            }
+            radius = snapUp(radius, 1.0f / 16.0f);
+            
+            // Snap the center to the texels of the cascade, in light space
+            const float texel = 2.0f * radius / static_cast<float>(m_resolution);
+            glm::vec3 lightCenter{lightViewMatrix * glm::vec4{center, 1}};
+            lightCenter.x = snapDown(lightCenter.x, texel);
+            lightCenter.y = snapDown(lightCenter.y, texel);
+            
+            lightProjs[i] = glm::ortho(lightCenter.x - radius, lightCenter.x + radius,
+                                       lightCenter.y - radius, lightCenter.y + radius,
+                                       lightNear, lightFar);
+            
+            m_cascades[i].splitFar = splitFar;
+            splitNear = splitFar;
+        }
+    }
+    
+    for(int i = 0; i < m_cascadeCount; ++i)
+    {
+        const glm::mat4 lightMatrix = lightProjs[i] * lightViewMatrix;
+        
+        if(lightMatrix != m_cascades[i].lightMatrix)
+        {
+            m_cascades[i].lightMatrix = lightMatrix;
+            m_cascades[i].cached = false;
+        }
+    }
+}
+
+void ShadowMap::render(const Scene& scene, gl::Shader& shader, const glm::vec3& lightDir,
+                       const glm::mat4& view, const glm::mat4& proj, float zNear, float zFar)
+{
+    fit(scene, lightDir, view, proj, zNear, zFar);
+    
+    // Restored at the end, the current framebuffer is not always the window (offscreen contexts)
+    GLint framebuffer = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+    
+    glViewport(0, 0, m_resolution, m_resolution);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
+    glDepthMask(GL_TRUE);
+    
+    // Against shadow acne
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(2.0f, 4.0f);
+    
+    m_staticRedraws = 0;
+    
+    for(int i = 0; i < m_cascadeCount; ++i)
+    {
+        Cascade& cascade = m_cascades[i];
+        const math::Frustum frustum{cascade.lightMatrix};
+        
+        Uniforms uniforms;
+        uniforms.proj = cascade.lightMatrix;
+        uniforms.view = glm::mat4{1};
+        
+        // Depth only framebuffers, no color attachment
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, m_readFbo);
+        glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_staticDepth, 0, i);
+        glReadBuffer(GL_NONE);
+        
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_drawFbo);
+        glDrawBuffer(GL_NONE);
+        
+        if(!cascade.cached)
+        {
+            glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_staticDepth, 0, i);
+            assert(glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+            
+            glClear(GL_DEPTH_BUFFER_BIT);
+            scene.drawShadowCasters(shader, uniforms, frustum, false);
+            
+            cascade.cached = true;
+            m_staticRedraws++;
+        }
+        
+        // Start from the cached static casters, and add the dynamic ones on top
+        glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_depth, 0, i);
+        assert(glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+        
+        glBlitFramebuffer(0, 0, m_resolution, m_resolution, 0, 0, m_resolution, m_resolution,
+                          GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        
+        scene.drawShadowCasters(shader, uniforms, frustum, true);
+    }
+    
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+}
+
+void ShadowMap::send(gl::Shader& shader) const
+{
+    glActiveTexture(GL_TEXTURE0 + TextureUnit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_depth);
+    glActiveTexture(GL_TEXTURE0);
+    
+    for(int i = 0; i < m_cascadeCount; ++i)
+    {
+        const std::string index = "[" + std::to_string(i) + "]";
+        shader.setUniform("u_LightMatrix" + index, m_cascades[i].lightMatrix);
+        shader.setUniform("u_CascadeSplits" + index, m_cascades[i].splitFar);
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <utility/gl/gl.hpp>
+#include <utility/gl/Shader.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+class Scene;
+
+/// @brief Shadow map of a directional light, with cached static casters and optional cascades.
+/// @details
+/// Each cascade is a layer of a depth texture array. The static casters of a cascade are rendered once into
+/// a cached layer, which is only re-rendered when the light matrix of the cascade changes or when invalidate()
+/// is called. Each frame, the cached layer is copied into the sampled layer, and only the dynamic casters are
+/// rendered on top of it.
+/// The casters are culled against the frustum of the light of each cascade.
+///
+/// With one cascade, the map covers the whole scene.
+/// With several cascades, the view frustum of the camera is split along its depth and each slice has its own map,
+/// so the shadows near the camera have more resolution. The bounds of each cascade are snapped to its texels,
+/// so its matrix (and its static cache) stays the same as long as the camera does not move more than a texel.
+class ShadowMap
+{
+public:
+    /// @brief Texture unit where the shadow map is bound by send().
+    static constexpr int TextureUnit = 2;
+    
+    static constexpr int MaxCascades = 4;
+    
+    /// @param resolution Width and height of each cascade, in texels.
+    /// @param cascades Count of cascades, between 1 and MaxCascades.
+    explicit ShadowMap(int resolution = 2048, int cascades = 1);
+    
+    /// @brief Change the count of cascades, between 1 and MaxCascades.
+    /// @remarks Reallocates the maps and invalidates the cache.
+    void setCascadeCount(int cascades);
+    
+    int getCascadeCount() const;
+    
+    /// @brief Re-render the static casters on the next render().
+    /// @details To call when a static instance is added, removed or moved.
+    void invalidate();
+    
+    /// @brief Render the shadow map for this frame.
+    /// @param shader The shader to render depth only (shadow.vert / shadow.frag).
+    /// @param lightDir Direction of the light rays, in world coordinates.
+    /// @param view,proj Matrices of the camera, only used to fit the cascades.
+    /// @param zNear,zFar Planes of the camera projection, only used to split the cascades.
+    /// @remarks Changes the viewport, the caller has to set it again. The bound framebuffer is restored.
+    void render(const Scene& scene, gl::Shader& shader, const glm::vec3& lightDir,
+                const glm::mat4& view, const glm::mat4& proj, float zNear, float zFar);
+    
+    /// @brief Bind the shadow map on TextureUnit and send the matrices of the cascades to a shader.
+    /// @remarks Sampling is enabled by Uniforms::shadowCascades.
+    void send(gl::Shader& shader) const;
+    
+    /// @brief Count of cascades which rendered their static casters during the last render().
+    int getStaticRedrawCount() const;
+    
+private:
+    struct Cascade
+    {
+        glm::mat4 lightMatrix{1}; ///< Projection * view of the light
+        float splitFar{0}; ///< Distance from the camera where the cascade ends
+        bool cached{false}; ///< If the static layer is valid for lightMatrix
+    };
+    
+    /// @brief Allocate the depth texture arrays.
+    void allocate();
+    
+    /// @brief Compute the light matrix of each cascade.
+    void fit(const Scene& scene, const glm::vec3& lightDir, const glm::mat4& view, const glm::mat4& proj,
+             float zNear, float zFar);
+    
+    int m_resolution;
+    int m_cascadeCount;
+    int m_staticRedraws{0};
+    Cascade m_cascades[MaxCascades];
+    
+    gl::raii::Texture m_staticDepth; ///< Static casters only, one layer per cascade
+    gl::raii::Texture m_depth; ///< Static and dynamic casters, sampled by the shaders
+    gl::raii::Framebuffer m_readFbo, m_drawFbo;
+};
@@ -0,0 +1,167 @@
+#include "SoftwareRenderer.hpp"
+#include <utility/ThreadPool.hpp>
+#include <glm/matrix.hpp>
+
+void SoftwareRenderer::render(const Scene& scene, const Mirror& mirror, Frame frame)
+{
+    const Uniforms& base = frame.uniforms;
+    
+    m_rasterizer.resize(frame.viewport);
+    m_rasterizer.clear(glm::vec4{0});
+    
+    Uniforms uniforms = base;
+    
+    if(frame.reflectionOnly)
+    {
+        uniforms.model = mirror.getReflectionMatrix();
+    }
+    
+    const math::OcclusionBuffer *occlusion = nullptr;
+    
+    if(frame.occlusionCulling)
+    {
+        Profiler::Scope scope{frame.profiler, "Occlusion culling"};
+        scene.drawOccluders(m_occlusion, uniforms.proj * uniforms.view * uniforms.model);
+        occlusion = &m_occlusion;
+    }
+    
+    {
+        Profiler::Scope scope{frame.profiler, "Scene"};
+        drawScene(scene, uniforms, {}, occlusion);
+    }
+    
+    {
+        Profiler::Scope scope{frame.profiler, "Mirror"};
+        
+        uniforms = base;
+        uniforms.ambient = 1.;
+        
+        // Where the mirror is drawn, the stencil buffer will contain 1
+        raster::State state;
+        state.stencilRef = 1;
+        state.stencilReplace = true;
+        
+        const obj::Mesh::Vertices quad{
+            {{-.5, -.5, 0}, {0, 0}, {0, 0, 1}},
+            {{.5, -.5, 0}, {1, 0}, {0, 0, 1}},
+            {{.5, .5, 0}, {1, 1}, {0, 0, 1}},
+            {{-.5, .5, 0}, {0, 1}, {0, 0, 1}}
+        };
+        const obj::Mesh::Indices indices{0, 1, 2, 0, 2, 3};
+        drawMesh(quad, indices, mirror.model(), uniforms, state, glm::vec4{1, 0, 1, 1});
+        
+        // Seen from behind or out of the view, nothing is reflected. There is no scissor nor conditional render:
+        // the tiles out of the mirror are not touched by its quads, and the reflection fails the stencil test there.
+        if(mirror.isFacing(frame.eye) && mirror.screenBounds(base.proj * base.view, frame.viewport))
+        {
+            // Clear the depth where the stencil buffer is 1, like Mirror::clearDepth()
+            state = {};
+            state.depthFunc = raster::State::DepthFunc::Always;
+            state.colorWrite = false;
+            state.stencilFunc = raster::State::StencilFunc::Equal;
+            state.stencilRef = 1;
+            
+            std::vector<raster::Vertex> far(4);
+            far[0].clip = {-1, -1, 1, 1};
+            far[1].clip = {1, -1, 1, 1};
+            far[2].clip = {1, 1, 1, 1};
+            far[3].clip = {-1, 1, 1, 1};
+            m_rasterizer.draw(far, {0, 1, 2, 0, 2, 3}, state, {});
+            
+            const math::OcclusionBuffer *reflectionOcclusion = nullptr;
+            
+            if(frame.occlusionCulling)
+            {
+                Profiler::Scope scope{frame.profiler, "Reflection occlusion culling"};
+                scene.drawOccluders(m_reflectionOcclusion, base.proj * base.view * mirror.getReflectionMatrix(),
+                                    mirror.plane());
+                reflectionOcclusion = &m_reflectionOcclusion;
+            }
+            
+            // Like Mirror::drawReflection()
+            uniforms = base;
+            uniforms.opacity *= 0.9;
+            uniforms.features |= FeatureMirrorClip;
+            uniforms.reflection = mirror.getReflectionMatrix();
+            uniforms.reflectionLocal = mirror.getReflectionMatrixInMirrorCoords();
+            
+            state.depthFunc = raster::State::DepthFunc::Less;
+            state.colorWrite = true;
+            const math::Frustum portal = mirror.portal(frame.eye);
+            drawScene(scene, uniforms, state, reflectionOcclusion, &portal);
+        }
+    }
+    
+    Profiler::Scope scope{frame.profiler, "Rasterizer::flush"};
+    m_rasterizer.flush();
+}
+
+void SoftwareRenderer::drawScene(const Scene& scene, const Uniforms& uniforms, const raster::State& state,
+                                 const math::OcclusionBuffer *occlusion, const math::Frustum *portal)
+{
+    scene.cull(uniforms, occlusion, portal, [&](const Instance& instance) {
+        const glm::mat4 world = uniforms.model * scene.transforms.getWorld(instance.node);
+        const std::vector<obj::Mesh>& meshes = instance.model->getMeshes();
+        
+        for(std::size_t i = 0; i < meshes.size(); ++i)
+        {
+            drawMesh(meshes[i].getVertices(), meshes[i].getIndices(), world * instance.model->getMeshTransform(i),
+                     uniforms, state, meshes[i].getMaterial().diffuseColor);
+        }
+    });
+}
+
+void SoftwareRenderer::drawMesh(const obj::Mesh::Vertices& vertices, const obj::Mesh::Indices& indices,
+                                const glm::mat4& model, const Uniforms& uniforms, const raster::State& base,
+                                const glm::vec4& color)
+{
+    const bool reflected = uniforms.features & FeatureMirrorClip;
+    const glm::mat4 viewProj = uniforms.proj * uniforms.view * (reflected ? uniforms.reflection : glm::mat4{1});
+    const glm::mat3 normalMatrix{model};
+    
+    // The transform of the vertices of a large mesh is worth the workers
+    m_vertices.resize(vertices.size());
+    ThreadPool::global().parallelFor(0, vertices.size(), 4096, [&](std::size_t first, std::size_t last) {
+        for(std::size_t i = first; i < last; ++i)
+        {
+            const glm::vec4 pos = model * glm::vec4{vertices[i].pos, 1};
+            raster::Vertex& vertex = m_vertices[i];
+            
+            vertex.clip = viewProj * pos;
+            vertex.pos = pos;
+            vertex.nor = glm::normalize(normalMatrix * vertices[i].nor);
+            vertex.clipDistance = reflected ? -(uniforms.reflectionLocal * pos).z : 1.0f;
+        }
+    });
+    
+    raster::State state = base;
+    state.clipDistance = reflected;
+    
+    // Blending an opaque color only costs, the result is the same
+    state.blend = uniforms.opacity < 1.0f;
+    
+    raster::Shading shading;
+    shading.color = color;
+    shading.ambient = uniforms.ambient;
+    shading.diffuse = uniforms.diffuse;
+    shading.specularExponent = uniforms.specularExponent;
+    shading.opacity = uniforms.opacity;
+    shading.diffuseTerm = uniforms.features & FeatureDiffuse;
+    shading.specularTerm = uniforms.features & FeatureSpecular;
+    shading.lightDir = uniforms.lightDir;
+    
+    // Like getCameraPos() of lighting.glsl
+    shading.eye = glm::vec3{glm::inverse(uniforms.view)[3]};
+    
+    m_rasterizer.draw(m_vertices, indices, state, shading);
+}
+
+gl::Image SoftwareRenderer::read() const
+{
+    return m_rasterizer.read();
+}
+
+const raster::Rasterizer& SoftwareRenderer::getRasterizer() const
+{
+    return m_rasterizer;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "RenderBackend.hpp"
+#include <utility/raster/Rasterizer.hpp>
+#include <vector>
+
+/// @brief Render the frames of the scene on the CPU with raster::Rasterizer, for the servers without GPU.
+/// @details The same passes as the Renderer: the scene, the mirror into the stencil, the depth cleared behind it and
+/// the reflection, with the lighting of base.frag. Without the shadows nor the textures, only the colors of the
+/// materials.
+/// @remarks The models still need an OpenGL context to be loaded, a software one is enough since no frame is drawn
+/// with it.
+class SoftwareRenderer : public RenderBackend
+{
+public:
+    void render(const Scene& scene, const Mirror& mirror, Frame frame) override;
+    
+    gl::Image read() const override;
+    
+    const raster::Rasterizer& getRasterizer() const;
+
+private:
+    /// @brief Queue the instances in the view, like Scene::draw().
+    /// @param uniforms With FeatureMirrorClip, transformed by the reflection and clipped by the mirror.
+    void drawScene(const Scene& scene, const Uniforms& uniforms, const raster::State& state,
+                   const math::OcclusionBuffer *occlusion, const math::Frustum *portal = nullptr);
+    
+    /// @brief Transform the vertices like base.vert, and queue them.
+    /// @param model The world matrix of the vertices, uniforms.model is ignored.
+    void drawMesh(const obj::Mesh::Vertices& vertices, const obj::Mesh::Indices& indices, const glm::mat4& model,
+                  const Uniforms& uniforms, const raster::State& state, const glm::vec4& color);
+    
+    raster::Rasterizer m_rasterizer;
+    
+    /// @brief Transformed by drawMesh(), kept to not allocate them for each mesh.
+    std::vector<raster::Vertex> m_vertices;
+    
+    math::OcclusionBuffer m_occlusion, m_reflectionOcclusion;
+};
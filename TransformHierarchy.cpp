@@ -0,0 +1,96 @@
+#include "TransformHierarchy.hpp"
+#include <algorithm>
+#include <cassert>
+
+int TransformHierarchy::add(const glm::mat4& local, int parent)
+{
+    const int node = static_cast<int>(m_parents.size());
+    assert(parent == NoParent || (parent >= 0 && parent < node));
+    
+    m_parents.push_back(parent);
+    m_locals.push_back(local);
+    m_worlds.push_back(local);
+    m_dirty.push_back(1);
+    
+    m_firstDirty = std::min(m_firstDirty, static_cast<std::size_t>(node));
+    
+    return node;
+}
+
+void TransformHierarchy::setLocal(int node, const glm::mat4& local)
+{
+    m_locals[node] = local;
+    m_dirty[node] = 1;
+    
+    m_firstDirty = std::min(m_firstDirty, static_cast<std::size_t>(node));
+}
+
+void TransformHierarchy::setLocal(int node, const glm::vec3& translation, const glm::quat& rotation,
+                                  const glm::vec3& scale)
+{
+    const std::size_t index = m_componentNodes.size();
+    m_componentNodes.push_back(node);
+    m_components.resize(index + 1);
+    m_components.set(index, translation, rotation, scale);
+}
+
+const glm::mat4& TransformHierarchy::getLocal(int node) const
+{
+    return m_locals[node];
+}
+
+const glm::mat4& TransformHierarchy::getWorld(int node) const
+{
+    return m_worlds[node];
+}
+
+int TransformHierarchy::getParent(int node) const
+{
+    return m_parents[node];
+}
+
+std::size_t TransformHierarchy::size() const
+{
+    return m_parents.size();
+}
+
+void TransformHierarchy::update()
+{
+    if(!m_componentNodes.empty())
+    {
+        m_componentLocals.resize(m_componentNodes.size());
+        math::computeTransforms(m_components, glm::mat4{1}, {m_componentLocals.data()});
+        
+        // In the order of the calls, the last one wins if a node was set twice
+        for(std::size_t i = 0; i < m_componentNodes.size(); ++i)
+        {
+            setLocal(m_componentNodes[i], m_componentLocals[i]);
+        }
+        
+        m_componentNodes.clear();
+        m_components.resize(0);
+    }
+    
+    const std::size_t count = m_parents.size();
+    
+    // Parents are always before their children,
+    // so when we reach a node its parent is already up-to-date and its dirty flag already propagated
+    for(std::size_t i = m_firstDirty; i < count; ++i)
+    {
+        const int parent = m_parents[i];
+        
+        if(parent != NoParent && m_dirty[parent])
+        {
+            m_dirty[i] = 1;
+        }
+        
+        if(m_dirty[i])
+        {
+            m_worlds[i] = parent == NoParent ? m_locals[i] : m_worlds[parent] * m_locals[i];
+        }
+    }
+    
+    // Can't reset the flags in the first pass, the children still need to know if their parent changed
+    std::fill(m_dirty.begin() + static_cast<std::ptrdiff_t>(std::min(m_firstDirty, count)), m_dirty.end(), 0);
+    m_firstDirty = count;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <utility/math/TransformBatch.hpp>
+#include <glm/mat4x4.hpp>
+#include <cstddef>
+#include <vector>
+
+/// @brief Hierarchy of transforms, stored as flat arrays.
+/// @details
+/// Each node has a local matrix (relative to its parent) and a world matrix (relative to the root).
+/// Nodes are always stored parent-before-child: a node can only be added once its parent exists.
+/// Thanks to this order, the world matrices are recomputed in a single linear pass, without recursion.
+/// Changing a local matrix marks the node as dirty, and only the dirty nodes and their descendants are
+/// recomputed on the next update(). The pass also starts at the first dirty node, so the static nodes added
+/// before the animated ones are never touched.
+/// The animated nodes can be set from a translation, a rotation and a scale instead of a matrix: their local matrices
+/// are then computed all at once by update(), with the SIMD kernel of math::computeTransforms().
+/// Example:
+///     TransformHierarchy h;
+///     int root = h.add(glm::translate(glm::mat4{1}, {0, 1, 0}));
+///     int child = h.add(glm::scale(glm::mat4{1}, {2, 2, 2}), root);
+///     h.update();           // h.getWorld(child) == translate * scale
+///
+class TransformHierarchy
+{
+public:
+    /// @brief Parent index of the root nodes.
+    static constexpr int NoParent = -1;
+    
+    /// @brief Add a node at the end of the hierarchy.
+    /// @param parent The parent node. It must already be in the hierarchy, or NoParent for a root node.
+    /// @returns The index of the new node.
+    int add(const glm::mat4& local = glm::mat4{1}, int parent = NoParent);
+    
+    /// @brief Set the local matrix of a node and mark it as dirty.
+    void setLocal(int node, const glm::mat4& local);
+    
+    /// @brief Set the local matrix of a node to translate(translation) * rotate(rotation) * scale(scale).
+    /// @remarks The matrix is only computed by the next update(), with the other nodes set this way.
+    void setLocal(int node, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale);
+    
+    const glm::mat4& getLocal(int node) const;
+    
+    /// @brief Get the world matrix of a node.
+    /// @remarks Only up-to-date after update() if the node or one of its ancestors was changed.
+    const glm::mat4& getWorld(int node) const;
+    
+    int getParent(int node) const;
+    
+    /// @brief Count of nodes.
+    std::size_t size() const;
+    
+    /// @brief Recompute the world matrices of the dirty nodes and of all their descendants.
+    void update();
+    
+private:
+    std::vector<int> m_parents;
+    std::vector<glm::mat4> m_locals;
+    std::vector<glm::mat4> m_worlds;
+    
+    /// @brief One flag per node, not a std::vector<bool> to not pay for bit packing.
+    std::vector<unsigned char> m_dirty;
+    
+    /// @brief Index of the first dirty node, all nodes before are up-to-date.
+    std::size_t m_firstDirty{0};
+    
+    /// @name
+    /// @brief The nodes set from their components since the last update(), and their local matrices.
+    /// @remarks Kept between the updates to not allocate them each frame.
+    /// @{
+    math::TransformSoA m_components;
+    std::vector<int> m_componentNodes;
+    std::vector<glm::mat4> m_componentLocals;
+    /// @}
+};
@@ -1,11 +1,13 @@
 #include "Triangle.hpp"
 #include "Scene.hpp"
+#include <utility/gl/registry.hpp>
 
 Triangle::Triangle(const obj::Vertex vertices[3])
 {
     glBindVertexArray(vao);
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
     glBufferData(GL_ARRAY_BUFFER, sizeof(*vertices) * 3, vertices, GL_STATIC_DRAW);
+    gl::registry::setBufferStorage(vbo, sizeof(*vertices) * 3);
     
     glEnableVertexAttribArray(obj::AttrVertex);
     gl::vertexAttribPointer(obj::AttrVertex, 3, GL_FLOAT, &obj::Vertex::pos);
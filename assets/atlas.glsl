@@ -0,0 +1,22 @@
+// Sampling of a gl::TextureAtlas, included by lighting.glsl.
+// The region of the image in the layer repeats: the coordinates wrap inside the region, with the level of detail of
+// the unwrapped coordinates, so there is no seam where they wrap.
+
+#ifdef TEXTURE_ATLAS
+uniform sampler2DArray u_Atlas;
+uniform vec4 u_AtlasTransform; // Scale then offset of the region, in the coordinates of the layer
+uniform float u_AtlasLayer;
+uniform float u_AtlasMaxLod; // The coarser levels mix the neighbor regions
+
+vec4 sampleAtlas(vec2 uv)
+{
+    vec2 size = vec2(textureSize(u_Atlas, 0).xy) * u_AtlasTransform.xy;
+    vec2 dx = dFdx(uv) * size;
+    vec2 dy = dFdy(uv) * size;
+    float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-12));
+
+    vec2 coords = u_AtlasTransform.zw + fract(uv) * u_AtlasTransform.xy;
+
+    return textureLod(u_Atlas, vec3(coords, u_AtlasLayer), clamp(lod, 0.0, u_AtlasMaxLod));
+}
+#endif
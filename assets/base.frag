@@ -1,5 +1,10 @@
 #version 330 core
 
+// Features, defined depending on the variant:
+//  MIRROR_CLIP: drawn in a mirror, discard what is behind the mirror
+//  VIRTUAL_FEEDBACK: write the pages of the virtual texture needed instead of the color, see gl::VirtualTextureFeedback
+//  And the ones of lighting.glsl
+
 // Generic
 uniform float u_Time;
 
@@ -8,72 +13,38 @@ uniform mat4 u_ModelMatrix;
 uniform mat4 u_ViewMatrix;
 uniform mat4 u_ProjectionMatrix;
 
-// Material
-uniform sampler2D u_Texture; // Texture for ambiant AND diffuse color
-uniform float u_AmbientIntensity;
-uniform float u_DiffuseIntensity;
-uniform vec4 u_DiffuseColor;
-uniform float u_SpecularExponent;
-uniform vec4 u_SpecularColor;
-uniform float u_Opacity;
-
-// Lighting
-uniform vec3 u_LightDirection;
+#include "lighting.glsl"
 
 in FS {
+#ifdef MIRROR_CLIP
+    float reflectionDepth; // Depth into the mirror. If negative, the object comes from behind the mirror.
+#endif
     vec4 pos;
     vec3 nor;
     vec2 uv;
 } fs;
 
+#ifdef VIRTUAL_FEEDBACK
+out uvec4 out_Feedback;
+#else
 out vec4 out_Color;
-
-vec3 getCameraPos()
-{
-    // In view space, origin is position of the camera
-    vec4 origin = vec4(vec3(0), 1);
-
-    return vec3(inverse(u_ViewMatrix) * origin);
-}
-
-float getSpecularIntensity()
-{
-    vec3 eyes = normalize(fs.pos.xyz - getCameraPos());
-    vec3 r = reflect(u_LightDirection, fs.nor);
-
-    float specular = dot(r, -eyes);
-    if(specular < 0)
-    {
-        specular = 0;
-    }
-
-    specular = pow(specular, u_SpecularExponent);
-
-    return specular;
-}
-
+#endif
 
 void main()
 {
-    float ambiant = u_AmbientIntensity;
-    vec4 ambiantColor = texture(u_Texture, fs.uv) * u_DiffuseColor;
-
-    float diffuse = dot(-u_LightDirection, fs.nor);
-    if(diffuse < 0)
+#ifdef MIRROR_CLIP
+    // Discard if the object is behind the mirror (negative depth), before paying for the lighting
+    if(fs.reflectionDepth < 0.0)
     {
-        // The ray comes from back,
-        // We don't want to reduce the luminosity with a negative amount, just don't illuminate with diffuse
-        diffuse = 0;
+        discard;
     }
-
-    diffuse *= u_DiffuseIntensity;
-    vec4 diffuseColor = texture(u_Texture, fs.uv) * u_DiffuseColor;
-
-    float specular = getSpecularIntensity();
-
-    out_Color = (ambiant * ambiantColor
-                 + diffuse * diffuseColor
-                 + specular * u_SpecularColor);
-
-    out_Color.a = u_Opacity;
-}
\ No newline at end of file
+#endif
+
+#if defined(VIRTUAL_FEEDBACK) && defined(VIRTUAL_TEXTURE)
+    out_Feedback = getVirtualFeedback(fs.uv);
+#elif defined(VIRTUAL_FEEDBACK)
+    out_Feedback = uvec4(0);
+#else
+    out_Color = getLighting(fs.pos, fs.nor, fs.uv);
+#endif
+}
@@ -1,17 +1,26 @@
 #version 330 core
 
+// Features, defined depending on the variant:
+//  MIRROR_CLIP: drawn in a mirror, transformed by u_ReflectionMatrix
+
 uniform float u_Time;
 uniform mat4 u_ModelMatrix;
 uniform mat4 u_ViewMatrix;
 uniform mat4 u_ProjectionMatrix;
-uniform mat4 u_LightMatrix;
-uniform sampler2D u_ShadowMap;
+
+#ifdef MIRROR_CLIP
+uniform mat4 u_ReflectionMatrixLocal; // Transform any point on it's reflection, in mirror coord system
+uniform mat4 u_ReflectionMatrix;
+#endif
 
 layout (location = 0) in vec4 in_Pos;
 layout (location = 1) in vec3 in_Normal;
 layout (location = 2) in vec2 in_UV;
 
 out FS {
+#ifdef MIRROR_CLIP
+    float reflectionDepth; // Depth into the mirror. If negative, the object comes from behind the mirror.
+#endif
     vec4 pos;
     vec3 nor;
     vec2 uv;
@@ -25,9 +34,14 @@ void main()
     vec4 worldPos = in_Pos;
     worldPos = u_ModelMatrix * worldPos;
 
+#ifdef MIRROR_CLIP
+    gl_Position = u_ProjectionMatrix * u_ViewMatrix * u_ReflectionMatrix * worldPos;
+    fs.reflectionDepth = -(u_ReflectionMatrixLocal * worldPos).z;
+#else
     gl_Position = u_ProjectionMatrix * u_ViewMatrix * worldPos;
+#endif
 
     fs.pos = worldPos;
     fs.uv = in_UV;
     fs.nor = vec3(worldNor);
-}
\ No newline at end of file
+}
@@ -0,0 +1,142 @@
+// Lighting model shared by the fragment shaders, included by gl::Shader::preprocess().
+// The includer declares u_ViewMatrix.
+// Features, defined depending on the variant:
+//  TEXTURED: the diffuse color is multiplied by u_Texture, else only u_DiffuseColor is used
+//  VIRTUAL_TEXTURE: the diffuse color is multiplied by the virtual texture of virtual.glsl instead of u_Texture
+//  TEXTURE_ATLAS: the diffuse color is multiplied by the region of the atlas of atlas.glsl instead of u_Texture
+//  DIFFUSE, SPECULAR: the diffuse and specular terms, else only the ambient term is computed
+//  SHADOWS: the diffuse and specular terms are shadowed by u_ShadowMap
+
+// Material
+uniform sampler2D u_Texture; // Texture for ambiant AND diffuse color
+uniform float u_AmbientIntensity;
+uniform float u_DiffuseIntensity;
+uniform vec4 u_DiffuseColor;
+uniform float u_SpecularExponent;
+uniform vec4 u_SpecularColor;
+uniform float u_Opacity;
+
+#include "virtual.glsl"
+#include "atlas.glsl"
+
+// Lighting
+uniform vec3 u_LightDirection;
+
+// Shadows
+const int MAX_CASCADES = 4;
+uniform int u_ShadowCascadeCount; // 0 to disable shadows
+uniform mat4 u_LightMatrix[MAX_CASCADES]; // Projection * view of the light, for each cascade
+uniform float u_CascadeSplits[MAX_CASCADES]; // Distance from the camera where each cascade ends
+uniform sampler2DArrayShadow u_ShadowMap; // One layer per cascade
+
+vec3 getCameraPos()
+{
+    // In view space, origin is position of the camera
+    vec4 origin = vec4(vec3(0), 1);
+
+    return vec3(inverse(u_ViewMatrix) * origin);
+}
+
+float getSpecularIntensity(vec4 pos, vec3 nor)
+{
+    vec3 eyes = normalize(pos.xyz - getCameraPos());
+    vec3 r = reflect(u_LightDirection, nor);
+
+    float specular = dot(r, -eyes);
+    if(specular < 0)
+    {
+        specular = 0;
+    }
+
+    specular = pow(specular, u_SpecularExponent);
+
+    return specular;
+}
+
+// 1 if lit, 0 if in shadow
+float getShadow(vec4 pos)
+{
+#ifdef SHADOWS
+    if(u_ShadowCascadeCount == 0)
+    {
+        return 1.0;
+    }
+
+    // Use the first cascade which contains the fragment
+    float depth = -(u_ViewMatrix * pos).z;
+    int cascade = u_ShadowCascadeCount - 1;
+    for(int i = 0; i < u_ShadowCascadeCount; ++i)
+    {
+        if(depth < u_CascadeSplits[i])
+        {
+            cascade = i;
+            break;
+        }
+    }
+
+    vec4 lightPos = u_LightMatrix[cascade] * pos;
+    vec3 coords = lightPos.xyz / lightPos.w * 0.5 + 0.5;
+
+    if(coords.z > 1.0)
+    {
+        // Farther than the far plane of the light, nothing can cast a shadow
+        return 1.0;
+    }
+
+    // 3x3 PCF, each sample is also bilinearly filtered by the hardware comparison
+    vec2 texel = 1.0 / vec2(textureSize(u_ShadowMap, 0).xy);
+    float lit = 0.0;
+    for(int x = -1; x <= 1; ++x)
+    {
+        for(int y = -1; y <= 1; ++y)
+        {
+            lit += texture(u_ShadowMap, vec4(coords.xy + vec2(x, y) * texel, cascade, coords.z));
+        }
+    }
+
+    return lit / 9.0;
+#else
+    return 1.0;
+#endif
+}
+
+// Color of a point, in world coordinates, with its normal
+vec4 getLighting(vec4 pos, vec3 nor, vec2 uv)
+{
+#if defined(VIRTUAL_TEXTURE)
+    vec4 color = sampleVirtual(uv) * u_DiffuseColor;
+#elif defined(TEXTURE_ATLAS)
+    vec4 color = sampleAtlas(uv) * u_DiffuseColor;
+#elif defined(TEXTURED)
+    vec4 color = texture(u_Texture, uv) * u_DiffuseColor;
+#else
+    vec4 color = u_DiffuseColor;
+#endif
+
+    vec4 result = u_AmbientIntensity * color;
+
+    // Shadows only remove the light coming from the light direction
+#if defined(DIFFUSE) || defined(SPECULAR)
+    float shadow = getShadow(pos);
+#endif
+
+#ifdef DIFFUSE
+    float diffuse = dot(-u_LightDirection, nor);
+    if(diffuse < 0)
+    {
+        // The ray comes from back,
+        // We don't want to reduce the luminosity with a negative amount, just don't illuminate with diffuse
+        diffuse = 0;
+    }
+
+    result += diffuse * u_DiffuseIntensity * shadow * color;
+#endif
+
+#ifdef SPECULAR
+    result += getSpecularIntensity(pos, nor) * shadow * u_SpecularColor;
+#endif
+
+    result.a = u_Opacity;
+
+    return result;
+}
@@ -0,0 +1,62 @@
+// Sampling of a gl::VirtualTexture, included by lighting.glsl.
+// A texel of the level L of the indirection is a page of the level L: the physical page holding it, or holding its
+// closest resident parent, and the level of that page. The pages have a border, so the bilinear filtering of the
+// physical texture doesn't bleed between pages. No trilinear filtering: the level is chosen per fragment.
+
+#ifdef VIRTUAL_TEXTURE
+uniform sampler2D u_VirtualIndirection;
+uniform sampler2D u_VirtualPhysical;
+uniform vec2 u_VirtualSize; // Texels of the level 0
+uniform vec2 u_VirtualPhysicalSize; // Texels of the physical texture
+uniform int u_VirtualPageSize;
+uniform int u_VirtualBorder;
+uniform int u_VirtualLevels;
+uniform float u_VirtualLodBias; // Negative in the feedback pass, which has a lower resolution
+uniform int u_VirtualID;
+
+// Size of a level, in texels, as the mipmaps
+vec2 getVirtualLevelSize(int level)
+{
+    return max(floor(u_VirtualSize / float(1 << level)), vec2(1));
+}
+
+// Level needed by the fragment, from the derivatives as the hardware does
+int getVirtualLevel(vec2 uv)
+{
+    vec2 texel = uv * u_VirtualSize;
+    float rho = max(length(dFdx(texel)), length(dFdy(texel)));
+    float level = log2(max(rho, 1e-6)) + u_VirtualLodBias;
+
+    return clamp(int(floor(level)), 0, u_VirtualLevels - 1);
+}
+
+// Page of a level under uv, which repeats
+ivec2 getVirtualPage(vec2 uv, int level)
+{
+    return ivec2(floor(fract(uv) * getVirtualLevelSize(level) / float(u_VirtualPageSize)));
+}
+
+vec4 sampleVirtual(vec2 uv)
+{
+    int level = getVirtualLevel(uv);
+    vec4 entry = texelFetch(u_VirtualIndirection, getVirtualPage(uv, level), level);
+
+    // The page found may be a parent, of a coarser level
+    vec2 physicalPage = floor(entry.rg * 255.0 + 0.5);
+    int mapped = int(entry.b * 255.0 + 0.5);
+
+    vec2 texel = fract(uv) * getVirtualLevelSize(mapped);
+    vec2 inPage = mod(texel, float(u_VirtualPageSize));
+    vec2 physical = physicalPage * float(u_VirtualPageSize + 2 * u_VirtualBorder) + float(u_VirtualBorder) + inPage;
+
+    return textureLod(u_VirtualPhysical, physical / u_VirtualPhysicalSize, 0.0);
+}
+
+// Written by the feedback pass: the page needed, and which virtual texture
+uvec4 getVirtualFeedback(vec2 uv)
+{
+    int level = getVirtualLevel(uv);
+
+    return uvec4(uvec2(getVirtualPage(uv, level)), uint(level), uint(u_VirtualID));
+}
+#endif
@@ -0,0 +1,387 @@
+#include "Context.hpp"
+#include "Scene.hpp"
+#include "Mirror.hpp"
+#include "Renderer.hpp"
+#include "SoftwareRenderer.hpp"
+#include <utility/gl/stats.hpp>
+#include <utility/time/Profiler.hpp>
+#include <utility/time/Trace.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef GLAD_NO_DEBUG
+#error "The benchmark counts the calls through the GLAD debug loader, see OPENGL_OBJ_GL_MODE in CMakeLists.txt"
+#endif
+
+// Deterministic benchmark: replays a scripted camera and mirror path with a fixed simulated clock,
+// and prints the statistics of the frames as JSON, to compare commits and drivers.
+
+namespace
+{
+    struct Options
+    {
+        int frames{600};
+        int warmup{60};
+        glm::ivec2 size{1280, 720};
+        float dt{1.0f / 60.0f}; ///< Simulated time between two frames, in seconds
+        bool window{false}; ///< Render in a window instead of headless
+        bool shadows{true};
+        int cascades{1};
+        bool occlusionCulling{true};
+        bool software{false}; ///< Render with the SoftwareRenderer on the CPU instead of OpenGL
+        std::filesystem::path assets{std::filesystem::current_path() / "../assets"};
+        std::filesystem::path output; ///< Empty for stdout
+        std::filesystem::path trace; ///< Empty to not profile the scopes
+        std::filesystem::path image; ///< Where to write the last frame as PPM, empty to not write it
+    };
+    
+    void printUsage()
+    {
+        std::cerr << "Usage: OpenGL_OBJ_bench [options]\n"
+                     "  --frames N        Measured frames (600)\n"
+                     "  --warmup N        Frames rendered before measuring (60)\n"
+                     "  --size WxH        Size of the framebuffer (1280x720)\n"
+                     "  --dt SECONDS      Simulated time between frames (1/60)\n"
+                     "  --cascades N      Shadow cascades, 0 to disable shadows (1)\n"
+                     "  --no-occlusion    Disable the CPU occlusion culling\n"
+                     "  --backend gl|cpu  Render with OpenGL or with the CPU rasterizer (gl)\n"
+                     "  --window          Render in a window instead of headless\n"
+                     "  --assets PATH     Directory of the assets (../assets)\n"
+                     "  --output PATH     Where to write the JSON report (stdout)\n"
+                     "  --trace PATH      Profile the scopes and write a Chrome trace of the run\n"
+                     "  --image PATH      Write the last frame as a PPM image, for regression tests" << std::endl;
+    }
+    
+    bool parse(int argc, char **argv, Options& options)
+    {
+        for(int i = 1; i < argc; ++i)
+        {
+            const std::string arg{argv[i]};
+            const bool hasValue = i + 1 < argc;
+            
+            if(arg == "--window")
+            {
+                options.window = true;
+            }
+            else if(arg == "--frames" && hasValue)
+            {
+                options.frames = std::max(1, std::atoi(argv[++i]));
+            }
+            else if(arg == "--warmup" && hasValue)
+            {
+                options.warmup = std::max(0, std::atoi(argv[++i]));
+            }
+            else if(arg == "--size" && hasValue)
+            {
+                const std::string value{argv[++i]};
+                const std::size_t x = value.find('x');
+                if(x == std::string::npos)
+                {
+                    return false;
+                }
+                options.size = {std::atoi(value.substr(0, x).c_str()), std::atoi(value.substr(x + 1).c_str())};
+            }
+            else if(arg == "--dt" && hasValue)
+            {
+                options.dt = std::strtof(argv[++i], nullptr);
+            }
+            else if(arg == "--cascades" && hasValue)
+            {
+                options.cascades = std::clamp(std::atoi(argv[++i]), 0, ShadowMap::MaxCascades);
+                options.shadows = options.cascades > 0;
+            }
+            else if(arg == "--no-occlusion")
+            {
+                options.occlusionCulling = false;
+            }
+            else if(arg == "--backend" && hasValue)
+            {
+                const std::string value{argv[++i]};
+                if(value != "gl" && value != "cpu")
+                {
+                    return false;
+                }
+                options.software = value == "cpu";
+            }
+            else if(arg == "--assets" && hasValue)
+            {
+                options.assets = argv[++i];
+            }
+            else if(arg == "--output" && hasValue)
+            {
+                options.output = argv[++i];
+            }
+            else if(arg == "--trace" && hasValue)
+            {
+                options.trace = argv[++i];
+            }
+            else if(arg == "--image" && hasValue)
+            {
+                options.image = argv[++i];
+            }
+            else
+            {
+                return false;
+            }
+        }
+        
+        return options.size.x > 0 && options.size.y > 0 && options.dt > 0.0f;
+    }
+    
+    /// @brief The scripted path: the camera orbits around the scene while the mirror swings,
+    /// so the mirror is alternately seen from the front, seen from behind and out of the view.
+    RenderBackend::Frame script(float time, Mirror& mirror, glm::ivec2 size)
+    {
+        mirror.rotation.y = 60.0f * std::sin(0.25f * time);
+        
+        const float angle = 0.4f * time;
+        const float distance = 6.0f + 2.0f * std::sin(0.3f * time);
+        const glm::vec3 eye{distance * std::sin(angle), 1.5f + std::sin(0.5f * time), distance * std::cos(angle)};
+        
+        RenderBackend::Frame frame;
+        frame.eye = eye;
+        frame.viewport = size;
+        frame.uniforms.time = time;
+        frame.uniforms.lightDir = normalize(glm::vec3{-0.1, -1, -0.1});
+        frame.uniforms.view = glm::lookAt(eye, glm::vec3{0}, glm::vec3{0, 1, 0});
+        frame.uniforms.proj = glm::perspective(glm::radians(80.0f), static_cast<float>(size.x) / size.y,
+                                               frame.zNear, frame.zFar);
+        
+        return frame;
+    }
+    
+    /// @brief Nearest-rank percentile.
+    /// @param sorted The samples, in increasing order.
+    double percentile(const std::vector<double>& sorted, double p)
+    {
+        const auto rank = static_cast<std::size_t>(std::ceil(p / 100.0 * sorted.size()));
+        return sorted[std::clamp<std::size_t>(rank, 1, sorted.size()) - 1];
+    }
+    
+    void writeStats(std::ostream& out, const char *name, std::vector<double> samples)
+    {
+        std::sort(samples.begin(), samples.end());
+        
+        out << "  \"" << name << "\": {"
+            << "\"min\": " << samples.front()
+            << ", \"p50\": " << percentile(samples, 50)
+            << ", \"p95\": " << percentile(samples, 95)
+            << ", \"p99\": " << percentile(samples, 99)
+            << ", \"max\": " << samples.back() << "}";
+    }
+    
+    /// @brief Post-call callback of GLAD doing nothing.
+    void noCheck(const char *, void *, int, ...)
+    {
+    }
+    
+    std::string escape(const char *str)
+    {
+        std::string result;
+        
+        for(const char *c = str ? str : ""; *c; ++c)
+        {
+            if(*c == '"' || *c == '\\')
+            {
+                result += '\\';
+            }
+            result += *c;
+        }
+        
+        return result;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if(!parse(argc, argv, options))
+    {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+    
+    std::unique_ptr<Context> ctxt;
+    try
+    {
+        ctxt = options.window ? std::make_unique<Context>() : std::make_unique<Context>(Context::Headless{options.size});
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << "Failed to create the context: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    
+    // A window has its own size
+    options.size = ctxt->winSize;
+    
+#ifdef OPENGL_OBJ_GL_DEBUG
+    gl::enableDebugging();
+#else
+    // Measure the renderer, not the glGetError() of the GLAD debug loader after each call
+    glad_set_post_callback(noCheck);
+#endif
+    
+    Scene scene{options.assets};
+    Mirror mirror;
+    
+    // The models are loaded with OpenGL by both backends, the software one only draws on the CPU
+    std::unique_ptr<RenderBackend> renderer;
+    if(options.software)
+    {
+        renderer = std::make_unique<SoftwareRenderer>();
+    }
+    else
+    {
+        renderer = std::make_unique<Renderer>(options.assets);
+    }
+    
+    // The profiler adds queries and debug groups, so it only runs when tracing
+    const bool tracing = !options.trace.empty();
+    Profiler profiler;
+    trace::setEnabled(tracing);
+    trace::setThreadName("Main");
+    const Time traceStart = Time::now();
+    
+    // Frame i is measured in the query i % count, read count frames later to not stall the pipeline
+    std::array<gl::raii::Query, 4> gpuQueries;
+    
+    std::vector<double> cpuTimes, gpuTimes, drawCalls, stateChanges;
+    
+    const auto renderFrame = [&](int i, Profiler *frameProfiler) {
+        const float time = i * options.dt;
+        scene.update(time);
+        
+        RenderBackend::Frame frame = script(time, mirror, options.size);
+        frame.shadows = options.shadows;
+        frame.shadowCascades = std::max(options.cascades, 1);
+        frame.occlusionCulling = options.occlusionCulling;
+        frame.profiler = frameProfiler;
+        
+        ctxt->bindFramebuffer();
+        renderer->render(scene, mirror, frame);
+    };
+    
+    const int total = options.warmup + options.frames;
+    for(int i = 0; i < total + static_cast<int>(gpuQueries.size()); ++i)
+    {
+        // Result of the frame which used this query
+        const int previous = i - static_cast<int>(gpuQueries.size());
+        if(previous >= options.warmup)
+        {
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(gpuQueries[i % gpuQueries.size()], GL_QUERY_RESULT, &elapsed);
+            gpuTimes.push_back(elapsed / 1e6);
+        }
+        
+        if(i >= total)
+        {
+            continue;
+        }
+        
+        const auto start = std::chrono::steady_clock::now();
+        glBeginQuery(GL_TIME_ELAPSED, gpuQueries[i % gpuQueries.size()]);
+        if(tracing)
+        {
+            profiler.beginFrame();
+        }
+        
+        renderFrame(i, tracing ? &profiler : nullptr);
+        
+        if(tracing)
+        {
+            profiler.endFrame();
+        }
+        glEndQuery(GL_TIME_ELAPSED);
+        ctxt->swapBuffers();
+        const auto end = std::chrono::steady_clock::now();
+        
+        if(i >= options.warmup)
+        {
+            cpuTimes.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+        }
+    }
+    
+    // The calls are counted by a callback before each of them, so the measured frames are rendered again to count
+    // them, out of the timings and of the trace
+    trace::setEnabled(false);
+    gl::stats::enable();
+    
+    for(int i = options.warmup; i < total; ++i)
+    {
+        gl::stats::reset();
+        renderFrame(i, nullptr);
+        
+        const gl::stats::Counters counters = gl::stats::get();
+        drawCalls.push_back(counters.drawCalls);
+        stateChanges.push_back(counters.stateChanges);
+        ctxt->swapBuffers();
+    }
+    
+    gl::stats::disable();
+    trace::setEnabled(tracing);
+    
+    // Out of the measures. The headless framebuffer keeps the last frame, the back buffer of a window may not
+    if(!options.image.empty() && !renderer->read().writePPM(options.image))
+    {
+        return EXIT_FAILURE;
+    }
+    
+    if(tracing)
+    {
+        // The GPU results of the last frames are only read by the next frames
+        glFinish();
+        for(std::size_t j = 0; j < Profiler::Latency; ++j)
+        {
+            profiler.beginFrame();
+            profiler.endFrame();
+        }
+        
+        trace::writeChromeJson(options.trace, Time::now() - traceStart);
+    }
+    
+    std::ofstream file;
+    if(!options.output.empty())
+    {
+        file.open(options.output);
+        if(!file)
+        {
+            std::cerr << "Failed to open " << options.output << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    
+    std::ostream& out = options.output.empty() ? std::cout : file;
+    
+    out << "{\n"
+        << "  \"renderer\": \"" << escape(reinterpret_cast<const char *>(glGetString(GL_RENDERER))) << "\",\n"
+        << "  \"version\": \"" << escape(reinterpret_cast<const char *>(glGetString(GL_VERSION))) << "\",\n"
+        << "  \"headless\": " << (ctxt->isHeadless() ? "true" : "false") << ",\n"
+        << "  \"size\": [" << options.size.x << ", " << options.size.y << "],\n"
+        << "  \"frames\": " << options.frames << ",\n"
+        << "  \"warmup\": " << options.warmup << ",\n"
+        << "  \"dt\": " << options.dt << ",\n"
+        << "  \"shadow_cascades\": " << (options.shadows ? options.cascades : 0) << ",\n"
+        << "  \"backend\": \"" << (options.software ? "cpu" : "gl") << "\",\n"
+        << "  \"occlusion_culling\": " << (options.occlusionCulling ? "true" : "false") << ",\n";
+    
+    writeStats(out, "cpu_ms", cpuTimes);
+    out << ",\n";
+    writeStats(out, "gpu_ms", gpuTimes);
+    out << ",\n";
+    writeStats(out, "draw_calls", drawCalls);
+    out << ",\n";
+    writeStats(out, "state_changes", stateChanges);
+    out << "\n}" << std::endl;
+    
+    return EXIT_SUCCESS;
+}
@@ -1,14 +1,34 @@
 #include "Context.hpp"
 #include "Scene.hpp"
+#include "Mirror.hpp"
+#include "Renderer.hpp"
 #include "Triangle.hpp"
 #include <utility/gl/Shader.hpp>
+#include <utility/gl/stats.hpp>
+#include <utility/gl/registry.hpp>
+#include <utility/gl/TextureResidency.hpp>
+#include <utility/gl/TextureUploader.hpp>
+#include <utility/gl/Mipmaps.hpp>
+#include <utility/gl/PageFile.hpp>
+#include <utility/gl/VirtualTexture.hpp>
 #include <utility/time/Clock.hpp>
+#include <utility/time/Profiler.hpp>
+#include <utility/time/FPSCounter.hpp>
+#include <utility/time/Trace.hpp>
+#include <utility/math/TransformBatch.hpp>
 #include "Model.hpp"
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtx/quaternion.hpp>
 #include <glm/gtx/string_cast.hpp>
 #include <iostream>
+#include <cassert>
+#include <optional>
+#include <limits>
+#include <algorithm>
+#include <iterator>
+#include <cstdint>
+#include <chrono>
 
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
@@ -19,159 +39,16 @@
 #endif
 #include <GLFW/glfw3.h> // Will drag system OpenGL headers
 
-const int shadowTexIndex = 2;
-
-struct Mirror
-{
-    glm::vec3 pos{0};
-    float scale{10.0f};
-    glm::vec3 rotation{0}; // In degrees
-    
-    glm::mat4 model() const
-    {
-        glm::mat4 mat{1};
-        mat = glm::translate(mat, pos);
-        mat = glm::scale(mat, glm::vec3{scale});
-        mat *= glm::mat4{glm::quat{glm::radians(rotation)}};
-        
-        return mat;
-    }
-    
-    glm::vec3 origin() const
-    {
-        return model() * glm::vec4{glm::vec3{0}, 1};
-    }
-    
-    glm::vec3 n1() const
-    {
-        return normalize(model() * glm::vec4{glm::vec3{1, 0, 0}, 0});
-    }
-    
-    glm::vec3 n2() const
-    {
-        return normalize(model() * glm::vec4{glm::vec3{0, 1, 0}, 0});
-    }
-    
-    // transform any point into its reflection, in the mirror coordinate system
-    // more output z is negative more the reflection is far into the mirror
-    glm::mat4 getReflectionMatrixInMirrorCoords() const
-    {
-    
-        const auto n1 = this->n1();
-        const auto n2 = this->n2();
-        const auto mirrorPos = this->origin();
-    
-        const glm::vec3 n3{normalize(glm::cross(n1, n2))};
-    
-        // n1, n2 are orthogonal vectors of the mirror
-        // n3 is to complete the basis
-        // the vertices should be in trigonometric order to work
-        glm::mat4 reflectionMatrix{1};
-    
-        // Let p be the point we mirror
-        // Compute p1 = p relative to the mirror [Translation in global coordinate system ~= premultiply]
-        reflectionMatrix = glm::translate(glm::mat4{1}, -mirrorPos) * reflectionMatrix;
-    
-        // Compute p2 = same as p1 but in coordinate system {n1, n2, n3}
-        reflectionMatrix = glm::inverse(glm::transition(n1, n2, n3)) * reflectionMatrix;
-    
-        // Compute p3 = (p3.x, p3.y, -p3.z) to go into the mirror (z is orthogonal distance from mirror)
-        reflectionMatrix = glm::scale(glm::mat4{1}, {1, 1, -1}) * reflectionMatrix;
-    
-        return reflectionMatrix;
-    }
-    
-    glm::mat4 getReflectionMatrix() const
-    {
-        const auto n1 = this->n1();
-        const auto n2 = this->n2();
-        const auto mirrorPos = this->origin();
-        
-        const glm::vec3 n3{normalize(glm::cross(n1, n2))};
-        
-        // n1, n2 are orthogonal vectors of the mirror
-        // n3 is to complete the basis
-        // the vertices should be in trigonometric order to work
-        glm::mat4 reflectionMatrix{1};
-        
-        // Let p be the point we mirror
-        // Compute p1 = p relative to the mirror [Translation in global coordinate system ~= premultiply]
-        reflectionMatrix = glm::translate(glm::mat4{1}, -mirrorPos) * reflectionMatrix;
-        
-        // Compute p2 = same as p1 but in coordinate system {n1, n2, n3}
-        reflectionMatrix = glm::inverse(glm::transition(n1, n2, n3)) * reflectionMatrix;
-        
-        // Compute p3 = (p3.x, p3.y, -p3.z) to go into the mirror (z is orthogonal distance from mirror)
-        reflectionMatrix = glm::scale(glm::mat4{1}, {1, 1, -1}) * reflectionMatrix;
-        
-        // Compute p4 = same as p3 but in canonical coordinate system (again relative to the mirror)
-        reflectionMatrix = glm::transition(n1, n2, n3) * reflectionMatrix;
-        
-        // Compute p5 = p4 from relative to the mirror to global space [Translation in global coordinate system]
-        reflectionMatrix = glm::translate(glm::mat4{1}, mirrorPos) * reflectionMatrix;
-        
-        return reflectionMatrix;
-    }
-  
-    void clearDepth(gl::Shader& shader) const
-    {
-        // Clear the depth buffer where the stencil buffer is 1
-        glStencilFunc(GL_EQUAL, 1, 0xff); // To set the reference to 1
-    
-        Uniforms uni;
-        uni.send(shader);
-    
-        // We can't glDisable(GL_DEPTH_TEST) because it will also disable writing to the depth buffer
-        // We don't change about the color we just want to clear the depth by writing to max depth that is 1
-        glDepthFunc(GL_ALWAYS);
-        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-        
-        obj::Vertex vertices[4];
-        vertices[0].pos = {-1, -1, 1};
-        vertices[1].pos = {1, -1, 1};
-        vertices[2].pos = {1, 1, 1};
-        vertices[3].pos = {-1, 1, 1};
-    
-        gl::raii::VertexArray vao;
-        gl::raii::Buffer vbo;
-    
-        glBindVertexArray(vao);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-    
-        glEnableVertexAttribArray(obj::AttrVertex);
-        gl::vertexAttribPointer(obj::AttrVertex, 3, GL_FLOAT, &obj::Vertex::pos);
-    
-        glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
-        glBindVertexArray(0);
-    
-        glDepthFunc(GL_LESS);
-        glStencilFunc(GL_ALWAYS, 0, 0xff); // To set the reference to 1
-        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
-    }
-    
-    void drawReflection(Scene& scene, gl::Shader& shader, Uniforms uniforms) const
-    {
-        // Draw only where the mirror was drawn == where stencil buffer equals 1
-        glStencilFunc(GL_EQUAL, 1, 0xff); // To set the reference to 1
-        
-        // Mix with the mirror base color
-        uniforms.opacity *= 0.9;
-        
-        shader.setUniform("u_ReflectionMatrix", getReflectionMatrix());
-        shader.setUniform("u_ReflectionMatrixLocal", getReflectionMatrixInMirrorCoords());
-        scene.draw(shader, uniforms);
-    
-        glStencilFunc(GL_ALWAYS, 0, 0xff); // Reset
-    }
-    
-} mirror;
+Mirror mirror;
 
 struct GUI
 {
     bool showReflection{false};
     bool showAxis{true};
     bool showDemoWindow{false};
+    bool showShadows{true};
+    int shadowCascades{1};
+    bool occlusionCulling{true};
 } gui;
 
 struct Camera
@@ -179,14 +56,16 @@ struct Camera
     Scene *scene{nullptr};
     glm::quat quat{1, 0, 0, 0};
     float distance{4.0f};
-
+    float zNear{0.1f};
+    float zFar{100.0f};
+    
     glm::vec3 up() const
     {
         const glm::vec3 worldUp{0.0f, 1.0f, 0.0f};
         const glm::vec3 up{quat * worldUp};
         return up;
     }
- 
+    
     glm::vec3 eye() const
     {
         glm::vec3 eye{0};
@@ -205,15 +84,25 @@ struct Camera
         return glm::perspective(
                 glm::radians(80.0f),
                 static_cast<float>(viewport.x) / static_cast<float>(viewport.y),
-                0.1f,
-                100.0f);
+                zNear,
+                zFar);
     }
-    
+
 } camera;
 
 Context *ctxt;
+Renderer *renderer;
+gl::TextureResidency *residency;
+gl::TextureUploader *uploader;
+gl::VirtualTexture *floorTexture;
 
 Clock animClock;
+Profiler profiler;
+FPSCounter fpsCounter;
+
+/// @brief The OpenGL calls of the last frame, only with OPENGL_OBJ_GL_STATS.
+gl::stats::Counters glCalls;
+std::vector<gl::stats::EntryPoint> glEntryPoints;
 
 Uniforms getUniforms()
 {
@@ -224,6 +113,8 @@ Uniforms getUniforms()
     ret.proj = camera.proj(ctxt->winSize);
     ret.view = camera.view();
     
+    ret.time = static_cast<float>(glfwGetTime());
+    
     return ret;
 }
 
@@ -264,15 +155,92 @@ void pollEvents(GLFWwindow *win)
     }
 }
 
-void post_call_callback_debug(const char *name, void *funcptr, int len_args, ...)
+/// @brief Draw a scope of the profiler and its children as a tree, in the table of the profiler.
+void drawProfilerNode(const std::vector<Profiler::Result>& results, int index)
+{
+    const Profiler::Result& result = results[index];
+    
+    // Scopes begin in order, so the children are after their parent
+    bool leaf = true;
+    for(std::size_t i = index + 1; i < results.size() && leaf; ++i)
+    {
+        leaf = results[i].parent != index;
+    }
+    
+    ImGui::TableNextRow();
+    ImGui::TableNextColumn();
+    
+    int flags = ImGuiTreeNodeFlags_DefaultOpen | ImGuiTreeNodeFlags_SpanFullWidth;
+    if(leaf)
+    {
+        flags |= ImGuiTreeNodeFlags_Leaf;
+    }
+    
+    const bool open = ImGui::TreeNodeEx(&result, flags, "%s", result.name);
+    
+    ImGui::TableNextColumn();
+    ImGui::Text("%.3f", result.cpuMs);
+    ImGui::TableNextColumn();
+    ImGui::Text("%.3f", result.gpuMs);
+    
+    if(open)
+    {
+        for(std::size_t i = index + 1; i < results.size(); ++i)
+        {
+            if(results[i].parent == index)
+            {
+                drawProfilerNode(results, static_cast<int>(i));
+            }
+        }
+        
+        ImGui::TreePop();
+    }
+}
+
+/// @brief Show what is under the mouse: the triangle of the scene, or the mirror and the triangle reflected there.
+void drawPicking()
 {
-    GLenum error_code;
-    error_code = glad_glGetError();
+    // The ray through the cursor, from the near plane
+    const glm::vec2 mouse{ImGui::GetIO().MousePos.x, ImGui::GetIO().MousePos.y};
+    const glm::vec2 ndc{mouse.x / ctxt->winSize.x * 2.0f - 1.0f, 1.0f - mouse.y / ctxt->winSize.y * 2.0f};
+    const glm::mat4 inverse = glm::inverse(camera.proj(ctxt->winSize) * camera.view());
+    const glm::vec4 near = inverse * glm::vec4{ndc, -1, 1};
+    const glm::vec4 far = inverse * glm::vec4{ndc, 1, 1};
+    const glm::vec3 origin = glm::vec3{near} / near.w;
+    const glm::vec3 direction = glm::normalize(glm::vec3{far} / far.w - origin);
+    
+    const auto begin = std::chrono::steady_clock::now();
+    
+    std::optional<RayHit> hit = camera.scene->raycast(origin, direction);
+    std::optional<glm::vec3> mirrorPoint;
+    
+    // The mirror is drawn over what is behind it, the reflection is then cast from where it is hit
+    const std::optional<float> distance = mirror.raycast(origin, direction);
+    if(distance && (!hit || *distance < hit->distance))
+    {
+        mirrorPoint = origin + direction * *distance;
+        hit = camera.scene->raycast(*mirrorPoint, glm::mat3{mirror.getReflectionMatrix()} * direction);
+    }
+    
+    const auto end = std::chrono::steady_clock::now();
+    
+    ImGui::Text("Cast in %.1f us", std::chrono::duration<double, std::micro>(end - begin).count());
+    
+    if(mirrorPoint)
+    {
+        ImGui::InputFloat3("Mirror point", &mirrorPoint->x, "%.3f", ImGuiInputTextFlags_ReadOnly);
+    }
     
-    if (error_code != GL_NO_ERROR)
+    if(!hit)
     {
-        fprintf(stderr, "ERROR %d in %s\n", error_code, name);
+        ImGui::TextUnformatted(mirrorPoint ? "Nothing reflected" : "Nothing");
+        return;
     }
+    
+    ImGui::Text("%sInstance %zu, mesh %zu, triangle %u", mirrorPoint ? "Reflected: " : "", hit->instance, hit->mesh,
+                hit->triangle);
+    ImGui::Text("Barycentrics (%.3f, %.3f), distance %.3f", hit->barycentrics.x, hit->barycentrics.y, hit->distance);
+    ImGui::InputFloat3("Point", &hit->point.x, "%.3f", ImGuiInputTextFlags_ReadOnly);
 }
 
 void drawGUI()
@@ -292,7 +260,7 @@ void drawGUI()
         glm::vec3 n1{mirror.n1()}, n2{mirror.n2()};
         ImGui::InputFloat3("n1", &n1.x, "%.6f", ImGuiInputTextFlags_ReadOnly);
         ImGui::InputFloat3("n2", &n2.x, "%.6f", ImGuiInputTextFlags_ReadOnly);
-    
+        
         ImGui::Text("Reflection Matrix");
         if(ImGui::BeginTable("Reflection Matrix", 4))
         {
@@ -326,31 +294,213 @@ void drawGUI()
         ImGui::Checkbox("Show axis", &gui.showAxis);
     }
     
+    if(ImGui::CollapsingHeader("Textures"))
+    {
+        const gl::TextureResidency::Stats stats = residency->getStats();
+        
+        int budget = static_cast<int>(residency->getBudget() >> 20);
+        if(ImGui::SliderInt("Budget (MB)", &budget, 1, 2048))
+        {
+            residency->setBudget(static_cast<std::size_t>(budget) << 20);
+        }
+        
+        ImGui::Text("%zu textures: %.1f MB", stats.textures, stats.bytes / (1024.0 * 1024.0));
+        ImGui::Text("Reduced: %zu, evicted: %zu", stats.reduced, stats.evicted);
+        ImGui::Text("CPU cache: %.1f MB", stats.cacheBytes / (1024.0 * 1024.0));
+        
+        const gl::TextureUploader::Stats uploads = uploader->getStats();
+        
+        int uploadBudget = static_cast<int>(uploader->bytesPerFrame >> 20);
+        if(ImGui::SliderInt("Uploads per frame (MB)", &uploadBudget, 1, 256))
+        {
+            uploader->bytesPerFrame = static_cast<std::size_t>(uploadBudget) << 20;
+        }
+        
+        ImGui::Text("Decoding: %zu, copying: %zu, uploading: %zu", uploads.decoding, uploads.copying,
+                    uploads.uploading);
+        ImGui::Text("Uploaded: %zu textures, %.1f MB this frame", uploads.uploaded,
+                    uploads.uploadedBytes / (1024.0 * 1024.0));
+        ImGui::Text("Pixel buffers: %zu, %.1f MB", uploads.buffers, uploads.bufferBytes / (1024.0 * 1024.0));
+    }
+    
+    if(ImGui::CollapsingHeader("Virtual texture"))
+    {
+        const gl::VirtualTexture::Stats stats = floorTexture->getStats();
+        const gl::PageFile& file = floorTexture->getPageFile();
+        
+        ImGui::Text("%dx%d texels, %d levels of %dx%d pages", file.getSize().x, file.getSize().y, file.getLevels(),
+                    file.getPageSize(), file.getPageSize());
+        ImGui::Text("Resident pages: %zu / %zu", stats.resident, stats.capacity);
+        ImGui::Text("Visible: %zu, pending: %zu, uploaded: %zu", stats.visible, stats.pending, stats.uploaded);
+        ImGui::SliderInt("Uploads per frame", &floorTexture->maxUploadsPerFrame, 1, 64);
+    }
+    
+    if(ImGui::CollapsingHeader("Shadows"))
+    {
+        ImGui::Checkbox("Show shadows", &gui.showShadows);
+        ImGui::SliderInt("Cascades", &gui.shadowCascades, 1, ShadowMap::MaxCascades);
+        ImGui::Text("Static cascades redrawn this frame: %d", renderer->getShadowMap().getStaticRedrawCount());
+    }
+    
+    if(ImGui::CollapsingHeader("Occlusion culling"))
+    {
+        ImGui::Checkbox("Enabled", &gui.occlusionCulling);
+        ImGui::Text("Instruction set: %s", simd::toString(simd::detectLevel()));
+        
+        const math::OcclusionBuffer::Stats scene = renderer->getOcclusion().getStats();
+        const math::OcclusionBuffer::Stats reflection = renderer->getReflectionOcclusion().getStats();
+        ImGui::Text("Scene: %zu occluder triangles, %zu / %zu boxes occluded", scene.triangles, scene.occluded,
+                    scene.tested);
+        ImGui::Text("Reflection: %zu occluder triangles, %zu / %zu boxes occluded", reflection.triangles,
+                    reflection.occluded, reflection.tested);
+        
+        const math::BVH& bvh = camera.scene->getBVH();
+        ImGui::Text("BVH: %zu nodes, cost %.1f (%.1f when built), %zu rebuilds", bvh.getNodes().size(),
+                    bvh.getCost(), bvh.getBuiltCost(), bvh.getRebuildCount());
+    }
+    
+    if(ImGui::CollapsingHeader("Picking"))
+    {
+        drawPicking();
+    }
+    
     if(ImGui::CollapsingHeader("Camera", ImGuiTreeNodeFlags_DefaultOpen))
     {
         glm::vec3 eulerAngles = glm::degrees(glm::eulerAngles(camera.quat));
         ImGui::InputFloat3("Euler camera", &eulerAngles.x, "%.3f", ImGuiInputTextFlags_ReadOnly);
     }
     
+    if(ImGui::CollapsingHeader("Performance", ImGuiTreeNodeFlags_DefaultOpen))
+    {
+        const FPSCounter::Stats& stats = fpsCounter.getStats();
+        
+        ImGui::Text("%.0f FPS", fpsCounter.getFPS());
+        ImGui::Text("Frame time (ms): min %.2f  mean %.2f  max %.2f", stats.min, stats.mean, stats.max);
+        ImGui::Text("p50 %.2f  p95 %.2f  p99 %.2f", stats.p50, stats.p95, stats.p99);
+        ImGui::Text("Spikes (> %.1fx median): %u", fpsCounter.spikeFactor, fpsCounter.getSpikeCount());
+        
+        // Scaled on the slowest frame, but at least 2x the median so a steady frame time stays in the middle
+        char overlay[32];
+        std::snprintf(overlay, sizeof(overlay), "%.2f ms", stats.p50);
+        ImGui::PlotHistogram("##Frame times", fpsCounter.getHistory(), FPSCounter::HistorySize,
+                             static_cast<int>(fpsCounter.getHistoryOffset()), overlay,
+                             0.0f, std::max(stats.max, 2.0f * stats.p50), ImVec2{0, 80});
+    }
+    
     if(ImGui::CollapsingHeader("Debug"))
     {
         ImGui::Checkbox("Show demo window", &gui.showDemoWindow);
         if(gui.showDemoWindow) ImGui::ShowDemoWindow(&gui.showDemoWindow);
         
-        if (ImGui::CollapsingHeader("Textures"))
+        if(ImGui::CollapsingHeader("Profiler", ImGuiTreeNodeFlags_DefaultOpen))
+        {
+            const auto& results = profiler.getResults();
+            
+            // Results are a few frames late, to never wait for the GPU
+            if(!results.empty() && ImGui::BeginTable("Profiler", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+            {
+                ImGui::TableSetupColumn("Scope");
+                ImGui::TableSetupColumn("CPU (ms)");
+                ImGui::TableSetupColumn("GPU (ms)");
+                ImGui::TableHeadersRow();
+                
+                drawProfilerNode(results, 0);
+                
+                ImGui::EndTable();
+            }
+        }
+        
+        if(gl::stats::isEnabled() && ImGui::CollapsingHeader("OpenGL calls", ImGuiTreeNodeFlags_DefaultOpen))
+        {
+            ImGui::Text("%u calls: %u draws, %u binds, %u uploads, %u uniforms, %u other state changes",
+                        glCalls.calls, glCalls.drawCalls, glCalls.binds, glCalls.uploads, glCalls.uniforms,
+                        glCalls.stateChanges - glCalls.binds);
+            
+            std::vector<gl::stats::EntryPoint> entryPoints;
+            std::copy_if(glEntryPoints.begin(), glEntryPoints.end(), std::back_inserter(entryPoints),
+                         [](const gl::stats::EntryPoint& entryPoint) { return entryPoint.calls > 0; });
+            std::sort(entryPoints.begin(), entryPoints.end(), [](const auto& a, const auto& b) {
+                return a.calls > b.calls;
+            });
+            
+            if(ImGui::BeginTable("OpenGL calls", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+            {
+                ImGui::TableSetupColumn("Entry point");
+                ImGui::TableSetupColumn("Kind");
+                ImGui::TableSetupColumn("Calls");
+                ImGui::TableHeadersRow();
+                
+                for(const gl::stats::EntryPoint& entryPoint : entryPoints)
+                {
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    ImGui::TextUnformatted(entryPoint.name);
+                    ImGui::TableNextColumn();
+                    ImGui::TextUnformatted(gl::stats::getName(entryPoint.kind));
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%u", entryPoint.calls);
+                }
+                
+                ImGui::EndTable();
+            }
+        }
+        
+        if(ImGui::CollapsingHeader("GPU resources"))
         {
-            for (int i = 0; i < 64; ++i)
+            using gl::registry::Type;
+            
+            if(ImGui::BeginTable("GPU resources", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+            {
+                ImGui::TableSetupColumn("Type");
+                ImGui::TableSetupColumn("Count");
+                ImGui::TableSetupColumn("Memory (MB)");
+                ImGui::TableHeadersRow();
+                
+                for(Type type : {Type::Texture, Type::Renderbuffer, Type::Buffer, Type::Framebuffer, Type::VertexArray})
+                {
+                    const gl::registry::Totals& totals = gl::registry::getTotals(type);
+                    
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    ImGui::TextUnformatted(gl::registry::getName(type));
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%zu", totals.count);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.2f", totals.bytes / (1024.0 * 1024.0));
+                }
+                
+                ImGui::EndTable();
+            }
+            
+            if(ImGui::TreeNode("Textures"))
             {
-                if (glIsTexture(i))
+                // The largest first
+                std::vector<std::pair<GLuint, const gl::registry::Resource *>> textures;
+                for(const auto& [id, resource] : gl::registry::getResources(Type::Texture))
                 {
-                    int w, h;
-                    glBindTexture(GL_TEXTURE_2D, i);
-                    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &w);
-                    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &h);
+                    textures.emplace_back(id, &resource);
+                }
+                std::sort(textures.begin(), textures.end(), [](const auto& a, const auto& b) {
+                    return a.second->bytes > b.second->bytes;
+                });
                 
-                    ImGui::Text("Texture %d: %dx%d", i, w, h);
-                    ImGui::Image((ImTextureID) i, {100, 100});
+                for(const auto& [id, texture] : textures)
+                {
+                    ImGui::Text("%u %s: %dx%dx%d, %d levels, %.2f MB", id, texture->label.c_str(),
+                                texture->size.x, texture->size.y, texture->size.z, texture->levels,
+                                texture->bytes / (1024.0 * 1024.0));
+                    
+                    // Only the color textures are 2D, the depth ones are the layers of the shadow maps, and the
+                    // atlases are arrays even with a single layer
+                    const bool depth = texture->format == GL_DEPTH_COMPONENT || texture->format == GL_DEPTH_COMPONENT24;
+                    const bool atlas = texture->label.ends_with(" atlas");
+                    if(!depth && !atlas && texture->size.z == 1)
+                    {
+                        ImGui::Image((ImTextureID) (std::uintptr_t) id, {100, 100});
+                    }
                 }
+                
+                ImGui::TreePop();
             }
         }
     }
@@ -358,13 +508,19 @@ void drawGUI()
 
 int main()
 {
-    glad_set_post_callback(post_call_callback_debug);
+    // Always record, F12 dumps the last seconds
+    trace::setEnabled(true);
+    trace::setThreadName("Main");
     
     Context ctxt;
     ::ctxt = &ctxt;
     
     gl::enableDebugging();
     
+    // Check the SIMD kernels supported by this CPU against GLM and the scalar ones, only in debug builds
+    assert(math::validateTransformBatch());
+    assert(gl::validateMipmaps());
+    
     glfwSetErrorCallback([](int code, const char *description) {
         std::cerr << description << std::endl;
     });
@@ -376,6 +532,14 @@ int main()
             {
                 animClock.toggle();
             }
+            else if(key == GLFW_KEY_F12)
+            {
+                // Open it in chrome://tracing or https://ui.perfetto.dev
+                if(trace::writeChromeJson("trace.json"))
+                {
+                    std::cout << "Wrote the last 10 seconds to trace.json" << std::endl;
+                }
+            }
         }
     });
     
@@ -397,14 +561,51 @@ int main()
     
     const std::filesystem::path assets{std::filesystem::current_path() / "../assets"};
     
+    // Skip compiling and linking the shaders on the next launches
+    gl::Shader::setBinaryCacheDirectory(std::filesystem::current_path() / "shader_cache");
+    
+    // Encode the textures to BC7 or BC1/BC3 on the first launch only
+    gl::Texture::setCompressionCacheDirectory(std::filesystem::current_path() / "texture_cache");
+    
+    // Must exist before loading the textures it manages, and outlive them
+    gl::TextureResidency residency{256 << 20, 128 << 20};
+    gl::Texture::setResidency(&residency);
+    ::residency = &residency;
+    
+    // The textures of the models stream in over the first frames instead of stalling the loading
+    gl::TextureUploader uploader{16 << 20};
+    gl::Texture::setUploader(&uploader);
+    ::uploader = &uploader;
+    
+    // Declared after them, so destroyed before: the textures destroyed later don't reach them anymore
+    struct TextureManagersReset
+    {
+        ~TextureManagersReset()
+        {
+            gl::Texture::setUploader(nullptr);
+            gl::Texture::setResidency(nullptr);
+            ::uploader = nullptr;
+            ::residency = nullptr;
+        }
+    } textureManagersReset;
+    
     Scene scene{assets};
     camera.scene = &scene;
     
-    gl::Shader shader;
-    shader.load(assets / "base.vert", assets / "base.frag");
+    // Split into pages on the first launch only, or when the image changes
+    const std::filesystem::path floorPages = std::filesystem::current_path() / "texture_cache/UV.vt";
+    std::error_code error;
+    if(std::filesystem::last_write_time(floorPages, error) < std::filesystem::last_write_time(assets / "UV.png"))
+    {
+        gl::PageFile::build(assets / "UV.png", floorPages);
+    }
+    
+    gl::VirtualTexture floorTexture{floorPages};
+    scene.getFloor().virtualTexture = &floorTexture;
+    ::floorTexture = &floorTexture;
     
-    gl::Shader reflectionShader;
-    reflectionShader.load(assets / "reflection.vert", assets / "reflection.frag");
+    Renderer renderer{assets};
+    ::renderer = &renderer;
     
     gl::raii::Framebuffer mirrorFbo;
     gl::Texture texMirrorFbo;
@@ -421,60 +622,59 @@ int main()
     assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
     
-    gl::Texture dummy;
-    dummy.load1x1White();
+    // Loaded on the first frame showing it, and destroyed with the GL objects of main()
+    std::optional<obj::Model> axis;
     
-    // GL_TEXTURE1 for ambient color (general texture)
+    // The loading before isn't a frame, it would dominate the history
+    fpsCounter.start();
     
     while(!glfwWindowShouldClose(ctxt.window))
     {
         glfwPollEvents();
         pollEvents(ctxt.window);
-    
+        
         int display_w, display_h;
         glfwGetFramebufferSize(ctxt.window, &display_w, &display_h);
         
+        // The calls of the whole previous frame, including ImGui and the swap
+        glCalls = gl::stats::get();
+        glEntryPoints = gl::stats::getEntryPoints();
+        gl::stats::reset();
+        
+        profiler.beginFrame();
+        fpsCounter.onFrame();
+        
         // Start the Dear ImGui frame
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
         
-        glViewport(0, 0, display_w, display_h);
-        scene.resetGL();
-        scene.clear();
+        scene.update(static_cast<float>(glfwGetTime()));
         
-        // Use texture 0 as the "non-texture"
-        // Since we mostly multiply the texture, we use opaque white 1x1 as default
-        // So we can use any shader using textures without needing specific ones, and we can also use effects
-        glActiveTexture(GL_TEXTURE0);
-        gl::Texture::bind(&dummy);
+        Renderer::Frame frame;
+        frame.uniforms = getUniforms();
+        frame.eye = camera.eye();
+        frame.zNear = camera.zNear;
+        frame.zFar = camera.zFar;
+        frame.viewport = {display_w, display_h};
+        frame.shadows = gui.showShadows;
+        frame.shadowCascades = gui.shadowCascades;
+        frame.reflectionOnly = gui.showReflection;
+        frame.occlusionCulling = gui.occlusionCulling;
+        frame.profiler = &profiler;
+        renderer.render(scene, mirror, frame);
         
-        Uniforms uniforms = getUniforms();
-        
-        if(gui.showReflection)
         {
-            uniforms.model = mirror.getReflectionMatrix();
+            Profiler::Scope scope{&profiler, "GUI"};
+            drawGUI();
         }
         
-        scene.draw(shader, uniforms);
-        
-        uniforms = getUniforms();
-        uniforms.model = mirror.model();
-        uniforms.ambient = 1.;
-        uniforms.diffuseColor = glm::vec4{1, 0, 1, 1};
-        
-        scene.drawMirror(shader, uniforms);
-        
-        uniforms = getUniforms();
-        mirror.clearDepth(shader);
-        mirror.drawReflection(scene, reflectionShader, uniforms);
-    
-        drawGUI();
-        
         // Draw axis on top of everything with glClearDepth()
         // glDisableDepth() would work partially because the object itself will be not depth-tested so awkward rendering
         if(gui.showAxis)
         {
+            Profiler::Scope scope{&profiler, "Axis"};
+            
             struct
             {
                 glm::ivec2 pos;
@@ -484,36 +684,46 @@ int main()
             const glm::ivec2 margin{50};
             viewport.size = glm::ivec2{100};
             viewport.pos = ctxt.winSize - viewport.size - margin;
-    
+            
             glViewport(viewport.pos.x, viewport.pos.y, viewport.size.x, viewport.size.y);
             
             glEnable(GL_SCISSOR_TEST);
             glScissor(viewport.pos.x, viewport.pos.y, viewport.size.x, viewport.size.y);
-    
+            
             glClearColor(1, 1, 1, 1);
             glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
             glDisable(GL_SCISSOR_TEST);
-    
-    
-            uniforms = {};
             
-            static obj::Model axis{assets / "axis.obj"};
+            
+            Uniforms uniforms;
+            
+            if(!axis)
+            {
+                axis.emplace(assets / "axis.obj", false);
+            }
+            
             const float d = 1;
             
             uniforms.proj = glm::ortho(-d, d, -d, d, -d, d);
             uniforms.model *= glm::mat4{glm::inverse(camera.quat)};
             uniforms.ambient = 1;
-            uniforms.diffuse = 0;
+            uniforms.features = FeatureSpecular;
             uniforms.lightDir = glm::vec3{1, -1, 0};
-            uniforms.send(shader);
-            axis.draw(shader);
+            drawModel(*axis, renderer.getShaders(), uniforms);
         }
         
         // Rendering
-        ImGui::Render();
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        {
+            Profiler::Scope scope{&profiler, "ImGui"};
+            ImGui::Render();
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        }
+        
+        uploader.update();
+        residency.update();
         
-        glfwSwapBuffers(ctxt.window);
+        profiler.endFrame();
+        ctxt.swapBuffers();
     }
     
     // Cleanup
@@ -0,0 +1,153 @@
+#include "ThreadPool.hpp"
+#include <utility/time/Trace.hpp>
+#include <algorithm>
+#include <atomic>
+
+namespace
+{
+    /// @brief Names of the tracks of the workers, the trace keeps pointers to them.
+    const char *const WorkerNames[] = {
+        "Worker 1", "Worker 2", "Worker 3", "Worker 4", "Worker 5", "Worker 6", "Worker 7", "Worker 8",
+        "Worker 9", "Worker 10", "Worker 11", "Worker 12", "Worker 13", "Worker 14", "Worker 15", "Worker 16"
+    };
+    
+    /// @brief Progress of a parallelFor(), shared with the workers which may start after it returned.
+    struct Ranges
+    {
+        std::size_t begin, end, grain, count;
+        std::atomic<std::size_t> next{0};
+        std::atomic<std::size_t> remaining;
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+    
+    /// @brief Run the ranges not taken yet.
+    void runRanges(Ranges& ranges, const std::function<void(std::size_t, std::size_t)>& body)
+    {
+        for(std::size_t i = ranges.next++; i < ranges.count; i = ranges.next++)
+        {
+            const std::size_t first = ranges.begin + i * ranges.grain;
+            body(first, std::min(first + ranges.grain, ranges.end));
+            
+            if(--ranges.remaining == 0)
+            {
+                std::lock_guard lock{ranges.mutex};
+                ranges.done.notify_all();
+            }
+        }
+    }
+}
+
+ThreadPool::ThreadPool(unsigned threads)
+{
+    m_threads.reserve(threads);
+    for(unsigned i = 0; i < threads; ++i)
+    {
+        m_threads.emplace_back(&ThreadPool::work, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard lock{m_mutex};
+        m_stopping = true;
+    }
+    
+    m_condition.notify_all();
+    
+    for(std::thread& thread : m_threads)
+    {
+        thread.join();
+    }
+}
+
+void ThreadPool::parallelFor(std::size_t begin, std::size_t end, std::size_t grain,
+                             const std::function<void(std::size_t, std::size_t)>& body)
+{
+    if(begin >= end)
+    {
+        return;
+    }
+    
+    grain = std::max<std::size_t>(grain, 1);
+    
+    auto ranges = std::make_shared<Ranges>();
+    ranges->begin = begin;
+    ranges->end = end;
+    ranges->grain = grain;
+    ranges->count = (end - begin + grain - 1) / grain;
+    ranges->remaining = ranges->count;
+    
+    // A worker starting after all the ranges are taken returns without calling body, so it can be a reference
+    const std::size_t helpers = std::min<std::size_t>(m_threads.size(), ranges->count - 1);
+    for(std::size_t i = 0; i < helpers; ++i)
+    {
+        push([ranges, &body] { runRanges(*ranges, body); });
+    }
+    
+    runRanges(*ranges, body);
+    
+    // Wait for the ranges taken by the workers
+    std::unique_lock lock{ranges->mutex};
+    ranges->done.wait(lock, [&ranges] { return ranges->remaining == 0; });
+}
+
+unsigned ThreadPool::getThreadCount() const
+{
+    return static_cast<unsigned>(m_threads.size());
+}
+
+unsigned ThreadPool::getDefaultThreadCount()
+{
+    // hardware_concurrency() can be 0 if unknown
+    const unsigned hardware = std::thread::hardware_concurrency();
+    return std::clamp(hardware, 2u, static_cast<unsigned>(std::size(WorkerNames)) + 1) - 1;
+}
+
+ThreadPool& ThreadPool::global()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::push(std::function<void()> task)
+{
+    if(m_threads.empty())
+    {
+        task();
+        return;
+    }
+    
+    {
+        std::lock_guard lock{m_mutex};
+        m_tasks.push_back(std::move(task));
+    }
+    
+    m_condition.notify_one();
+}
+
+void ThreadPool::work(unsigned index)
+{
+    trace::setThreadName(index < std::size(WorkerNames) ? WorkerNames[index] : "Worker");
+    
+    while(true)
+    {
+        std::function<void()> task;
+        
+        {
+            std::unique_lock lock{m_mutex};
+            m_condition.wait(lock, [this] { return m_stopping || !m_tasks.empty(); });
+            
+            if(m_tasks.empty())
+            {
+                return;
+            }
+            
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        
+        task();
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/// @brief Worker threads running the CPU work which must not stall the render thread (decoding, mipmaps...).
+/// @details
+/// The tasks are run in the order they are submitted. A task may call parallelFor(): the calling thread takes its
+/// share of the ranges instead of waiting for the workers, so the pool can't deadlock on itself.
+///     std::future<Image> image = ThreadPool::global().submit([&path] { return Image::decode(path); });
+///     // Other work, then on the render thread:
+///     texture.load(image.get());
+class ThreadPool
+{
+public:
+    /// @param threads Count of workers, 0 to run everything on the calling threads.
+    explicit ThreadPool(unsigned threads = getDefaultThreadCount());
+    
+    /// @brief Finish the tasks submitted, then join the workers.
+    ~ThreadPool();
+    
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    
+    /// @brief Run a task on a worker.
+    /// @returns The result of the task, or its exception.
+    template<typename F>
+    std::future<std::invoke_result_t<F>> submit(F&& task)
+    {
+        auto packaged = std::make_shared<std::packaged_task<std::invoke_result_t<F>()>>(std::forward<F>(task));
+        std::future<std::invoke_result_t<F>> result = packaged->get_future();
+        
+        push([packaged] { (*packaged)(); });
+        
+        return result;
+    }
+    
+    /// @brief Call body(first, last) on ranges covering [begin, end), on the workers and the calling thread.
+    /// @param grain Size of the ranges, the last one can be smaller.
+    /// @remarks Returns when all the ranges are done. body must not throw.
+    void parallelFor(std::size_t begin, std::size_t end, std::size_t grain,
+                     const std::function<void(std::size_t, std::size_t)>& body);
+    
+    unsigned getThreadCount() const;
+    
+    /// @returns One less than the hardware threads, the render thread keeps its own core.
+    static unsigned getDefaultThreadCount();
+    
+    /// @brief The pool shared by the whole program, created on first use.
+    static ThreadPool& global();
+
+private:
+    void push(std::function<void()> task);
+    
+    void work(unsigned index);
+    
+    std::vector<std::thread> m_threads;
+    std::deque<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_stopping{false};
+};
@@ -19,5 +19,23 @@ T convert_vec2(const auto& in)
     ret.x = in.x;
     ret.y = in.y;
     
+    return ret;
+}
+
+/// @brief Convert a row-major 4x4 matrix (like aiMatrix4x4) into a column-major one (like glm::mat4).
+/// @details in[row][col] for the input, ret[col][row] for the output.
+template<typename T>
+T convert_mat4(const auto& in)
+{
+    T ret;
+    
+    for(int row = 0; row < 4; ++row)
+    {
+        for(int col = 0; col < 4; ++col)
+        {
+            ret[col][row] = in[row][col];
+        }
+    }
+    
     return ret;
 }
\ No newline at end of file
@@ -0,0 +1,540 @@
+#include "CompressedImage.hpp"
+#include "extensions.hpp"
+#include "registry.hpp"
+#include <utility/io.hpp>
+#include <utility/ThreadPool.hpp>
+#include <utility/time/Trace.hpp>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+namespace gl
+{
+    namespace
+    {
+        /// @brief Increment when the encoders or the mipmaps change, to encode the cached files again.
+        constexpr std::uint32_t EncoderVersion = 2;
+        
+        struct FileHeader
+        {
+            char magic[4]{'G', 'L', 'T', 'C'};
+            std::uint32_t version{EncoderVersion};
+            std::uint32_t format{0};
+            std::uint32_t levels{0};
+        };
+        
+        struct LevelHeader
+        {
+            std::int32_t width{0};
+            std::int32_t height{0};
+            std::uint32_t bytes{0};
+        };
+        
+        /// @brief The 4x4 RGBA pixels of a block.
+        using Block = std::array<std::array<int, 4>, 16>;
+        
+        /// @brief Read a block, repeating the last row and column of the images smaller than the block.
+        Block getBlock(const Image& image, int bx, int by)
+        {
+            Block block;
+            
+            for(int y = 0; y < 4; ++y)
+            {
+                const int iy = std::min(by * 4 + y, image.size.y - 1);
+                
+                for(int x = 0; x < 4; ++x)
+                {
+                    const int ix = std::min(bx * 4 + x, image.size.x - 1);
+                    const unsigned char *pixel = &image.pixels[(static_cast<std::size_t>(iy) * image.size.x + ix) * 4];
+                    
+                    for(int c = 0; c < 4; ++c)
+                    {
+                        block[y * 4 + x][c] = pixel[c];
+                    }
+                }
+            }
+            
+            return block;
+        }
+        
+        /// @brief Endpoints of the line fitting the colors of a block, on its first channels.
+        /// @details The bounding box of the colors, with its diagonal oriented along the correlation of the channels
+        /// with the channel of largest range, inset a bit because the extremes are rarely both reached.
+        void findEndpoints(const Block& block, int channels, std::array<int, 4>& e0, std::array<int, 4>& e1)
+        {
+            std::array<int, 4> low{255, 255, 255, 255}, high{0, 0, 0, 0};
+            std::array<float, 4> mean{};
+            
+            for(const auto& pixel : block)
+            {
+                for(int c = 0; c < channels; ++c)
+                {
+                    low[c] = std::min(low[c], pixel[c]);
+                    high[c] = std::max(high[c], pixel[c]);
+                    mean[c] += pixel[c] / 16.0f;
+                }
+            }
+            
+            int main = 0;
+            for(int c = 1; c < channels; ++c)
+            {
+                if(high[c] - low[c] > high[main] - low[main])
+                {
+                    main = c;
+                }
+            }
+            
+            for(int c = 0; c < channels; ++c)
+            {
+                float covariance = 0;
+                for(const auto& pixel : block)
+                {
+                    covariance += (pixel[c] - mean[c]) * (pixel[main] - mean[main]);
+                }
+                
+                const int inset = (high[c] - low[c]) / 16;
+                e0[c] = low[c] + inset;
+                e1[c] = high[c] - inset;
+                
+                if(covariance < 0)
+                {
+                    std::swap(e0[c], e1[c]);
+                }
+            }
+        }
+        
+        /// @returns The index of the palette entry closest to a pixel, on its first channels.
+        template<std::size_t N>
+        int findClosest(const std::array<int, 4>& pixel, const std::array<std::array<int, 4>, N>& palette, int channels)
+        {
+            int best = 0;
+            int bestError = INT32_MAX;
+            
+            for(std::size_t i = 0; i < N; ++i)
+            {
+                int error = 0;
+                for(int c = 0; c < channels; ++c)
+                {
+                    const int d = pixel[c] - palette[i][c];
+                    error += d * d;
+                }
+                
+                if(error < bestError)
+                {
+                    best = static_cast<int>(i);
+                    bestError = error;
+                }
+            }
+            
+            return best;
+        }
+        
+        std::uint16_t to565(const std::array<int, 4>& color)
+        {
+            return static_cast<std::uint16_t>(((color[0] * 31 + 127) / 255) << 11
+                                              | ((color[1] * 63 + 127) / 255) << 5
+                                              | ((color[2] * 31 + 127) / 255));
+        }
+        
+        std::array<int, 4> from565(std::uint16_t color)
+        {
+            const int r = color >> 11, g = (color >> 5) & 63, b = color & 31;
+            return {(r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2), 255};
+        }
+        
+        /// @brief The 8 bytes of a BC1 color block, always in 4 colors mode (as in BC3).
+        void encodeColor(const Block& block, unsigned char *out)
+        {
+            std::array<int, 4> e0, e1;
+            findEndpoints(block, 3, e0, e1);
+            
+            std::uint16_t c0 = to565(e0), c1 = to565(e1);
+            
+            // c0 > c1 selects the 4 colors mode
+            if(c0 < c1)
+            {
+                std::swap(c0, c1);
+            }
+            
+            const std::array<int, 4> p0 = from565(c0), p1 = from565(c1);
+            std::array<std::array<int, 4>, 4> palette{p0, p1, p0, p1};
+            for(int c = 0; c < 3; ++c)
+            {
+                palette[2][c] = (2 * p0[c] + p1[c]) / 3;
+                palette[3][c] = (p0[c] + 2 * p1[c]) / 3;
+            }
+            
+            std::uint32_t indices = 0;
+            if(c0 != c1)
+            {
+                for(int i = 0; i < 16; ++i)
+                {
+                    indices |= static_cast<std::uint32_t>(findClosest(block[i], palette, 3)) << (2 * i);
+                }
+            }
+            
+            out[0] = c0 & 0xff;
+            out[1] = c0 >> 8;
+            out[2] = c1 & 0xff;
+            out[3] = c1 >> 8;
+            for(int i = 0; i < 4; ++i)
+            {
+                out[4 + i] = (indices >> (8 * i)) & 0xff;
+            }
+        }
+        
+        /// @brief The 8 bytes of a BC3 alpha block, always in 8 values mode.
+        void encodeAlpha(const Block& block, unsigned char *out)
+        {
+            int a0 = 0, a1 = 255;
+            for(const auto& pixel : block)
+            {
+                a0 = std::max(a0, pixel[3]);
+                a1 = std::min(a1, pixel[3]);
+            }
+            
+            std::array<std::array<int, 4>, 8> palette{};
+            palette[0][0] = a0;
+            palette[1][0] = a1;
+            for(int i = 1; i < 7; ++i)
+            {
+                palette[i + 1][0] = ((7 - i) * a0 + i * a1) / 7;
+            }
+            
+            std::uint64_t indices = 0;
+            if(a0 != a1)
+            {
+                for(int i = 0; i < 16; ++i)
+                {
+                    const std::array<int, 4> alpha{block[i][3]};
+                    indices |= static_cast<std::uint64_t>(findClosest(alpha, palette, 1)) << (3 * i);
+                }
+            }
+            
+            out[0] = static_cast<unsigned char>(a0);
+            out[1] = static_cast<unsigned char>(a1);
+            for(int i = 0; i < 6; ++i)
+            {
+                out[2 + i] = (indices >> (8 * i)) & 0xff;
+            }
+        }
+        
+        /// @brief Writes the bits of a block, from the least significant bit of the first byte.
+        struct BitWriter
+        {
+            unsigned char *out;
+            int position{0};
+            
+            void write(std::uint32_t value, int bits)
+            {
+                for(int i = 0; i < bits; ++i, ++position)
+                {
+                    out[position / 8] |= ((value >> i) & 1) << (position % 8);
+                }
+            }
+        };
+        
+        /// @brief The 16 bytes of a BC7 block in mode 6: a single subset, RGBA 7.7.7.7 endpoints with a p-bit each,
+        /// and 4 bits indices.
+        void encodeBC7(const Block& block, unsigned char *out)
+        {
+            static constexpr int weights[16]{0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+            
+            std::array<int, 4> e0, e1;
+            findEndpoints(block, 4, e0, e1);
+            
+            // Quantize each endpoint to 7 bits per channel, and its shared lowest bit
+            std::array<std::array<int, 4>, 2> quantized;
+            std::array<int, 2> pbits;
+            std::array<std::array<int, 4>, 2> endpoints;
+            
+            for(int e = 0; e < 2; ++e)
+            {
+                const std::array<int, 4>& endpoint = e == 0 ? e0 : e1;
+                int bestError = INT32_MAX;
+                
+                for(int p = 0; p < 2; ++p)
+                {
+                    std::array<int, 4> q;
+                    int error = 0;
+                    
+                    for(int c = 0; c < 4; ++c)
+                    {
+                        q[c] = std::clamp((endpoint[c] - p + 1) / 2, 0, 127);
+                        const int d = (q[c] << 1 | p) - endpoint[c];
+                        error += d * d;
+                    }
+                    
+                    if(error < bestError)
+                    {
+                        bestError = error;
+                        quantized[e] = q;
+                        pbits[e] = p;
+                    }
+                }
+                
+                for(int c = 0; c < 4; ++c)
+                {
+                    endpoints[e][c] = quantized[e][c] << 1 | pbits[e];
+                }
+            }
+            
+            std::array<std::array<int, 4>, 16> palette;
+            for(int i = 0; i < 16; ++i)
+            {
+                for(int c = 0; c < 4; ++c)
+                {
+                    palette[i][c] = ((64 - weights[i]) * endpoints[0][c] + weights[i] * endpoints[1][c] + 32) >> 6;
+                }
+            }
+            
+            std::array<int, 16> indices;
+            for(int i = 0; i < 16; ++i)
+            {
+                indices[i] = findClosest(block[i], palette, 4);
+            }
+            
+            // The highest bit of the first index is implicitly 0: swap the endpoints if it's not
+            if(indices[0] & 8)
+            {
+                std::swap(quantized[0], quantized[1]);
+                std::swap(pbits[0], pbits[1]);
+                for(int& index : indices)
+                {
+                    index = 15 - index;
+                }
+            }
+            
+            std::memset(out, 0, 16);
+            BitWriter writer{out};
+            writer.write(1 << 6, 7);
+            
+            for(int c = 0; c < 4; ++c)
+            {
+                writer.write(quantized[0][c], 7);
+                writer.write(quantized[1][c], 7);
+            }
+            
+            writer.write(pbits[0], 1);
+            writer.write(pbits[1], 1);
+            
+            writer.write(indices[0], 3);
+            for(int i = 1; i < 16; ++i)
+            {
+                writer.write(indices[i], 4);
+            }
+        }
+        
+        CompressedImage::Level encodeLevel(const Image& image, GLenum format)
+        {
+            CompressedImage::Level level;
+            level.size = image.size;
+            level.data.resize(registry::getImageBytes(format, image.size));
+            
+            const int blocksX = (image.size.x + 3) / 4;
+            const int blocksY = (image.size.y + 3) / 4;
+            const std::size_t blockBytes = level.data.size() / (static_cast<std::size_t>(blocksX) * blocksY);
+            
+            // The blocks are independent, a row of blocks per range
+            ThreadPool::global().parallelFor(0, blocksY, 1, [&](std::size_t first, std::size_t last) {
+                for(int by = static_cast<int>(first); by < static_cast<int>(last); ++by)
+                {
+                    for(int bx = 0; bx < blocksX; ++bx)
+                    {
+                        const Block block = getBlock(image, bx, by);
+                        unsigned char *out = &level.data[(static_cast<std::size_t>(by) * blocksX + bx) * blockBytes];
+                        
+                        switch(format)
+                        {
+                            case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+                                encodeColor(block, out);
+                                break;
+                            
+                            case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+                                encodeAlpha(block, out);
+                                encodeColor(block, out + 8);
+                                break;
+                            
+                            case GL_COMPRESSED_RGBA_BPTC_UNORM:
+                                encodeBC7(block, out);
+                                break;
+                        }
+                    }
+                }
+            });
+            
+            return level;
+        }
+    }
+    
+    GLenum CompressedImage::chooseFormat(const Image& image)
+    {
+        bool opaque = true;
+        for(std::size_t i = 3; i < image.pixels.size() && opaque; i += 4)
+        {
+            opaque = image.pixels[i] == 255;
+        }
+        
+        // The mode 6 interpolates the alpha on the same line as the colors, BC3 encodes it apart
+        if(ext::ARB_texture_compression_bptc && (opaque || !ext::EXT_texture_compression_s3tc))
+        {
+            return GL_COMPRESSED_RGBA_BPTC_UNORM;
+        }
+        
+        if(ext::EXT_texture_compression_s3tc)
+        {
+            return opaque ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        }
+        
+        return 0;
+    }
+    
+    CompressedImage CompressedImage::encode(const MipChain& chain, GLenum format)
+    {
+        trace::Scope scope{"CompressedImage::encode", "asset"};
+        
+        CompressedImage result;
+        result.format = format;
+        
+        for(const Image& level : chain)
+        {
+            result.levels.push_back(encodeLevel(level, format));
+        }
+        
+        return result;
+    }
+    
+    CompressedImage CompressedImage::import(const std::filesystem::path& source,
+                                            const std::filesystem::path& cacheDirectory, ColorSpace colorSpace)
+    {
+        if(!ext::ARB_texture_compression_bptc && !ext::EXT_texture_compression_s3tc)
+        {
+            return {};
+        }
+        
+        // Encode again if the source, the formats supported or the filtering of the mipmaps change
+        std::error_code error;
+        const auto size = std::filesystem::file_size(source, error);
+        const auto time = std::filesystem::last_write_time(source, error).time_since_epoch().count();
+        if(error)
+        {
+            return {};
+        }
+        
+        std::ostringstream key;
+        key << std::filesystem::weakly_canonical(source).string() << '\n' << size << '\n' << time << '\n'
+            << ext::ARB_texture_compression_bptc << ext::EXT_texture_compression_s3tc;
+        
+        // Only the linear images extend the key, so the caches of the sRGB images stay valid
+        if(colorSpace == ColorSpace::Linear)
+        {
+            key << "\nlinear";
+        }
+        
+        std::ostringstream name;
+        name << std::hex << std::setw(16) << std::setfill('0') << io::hash(key.str()) << ".tex";
+        const std::filesystem::path cachePath = cacheDirectory / name.str();
+        
+        CompressedImage image = load(cachePath);
+        if(!image.empty())
+        {
+            return image;
+        }
+        
+        MipChain chain = generateMipmaps(Image::decode(source), colorSpace);
+        if(chain.empty())
+        {
+            return {};
+        }
+        
+        image = encode(chain, chooseFormat(chain[0]));
+        image.save(cachePath);
+        
+        return image;
+    }
+    
+    CompressedImage CompressedImage::load(const std::filesystem::path& path)
+    {
+        const std::vector<char> file = io::readBinary(path);
+        
+        FileHeader header;
+        if(file.size() < sizeof(header) || std::memcmp(file.data(), header.magic, sizeof(header.magic)) != 0)
+        {
+            return {};
+        }
+        
+        std::memcpy(&header, file.data(), sizeof(header));
+        if(header.version != EncoderVersion)
+        {
+            return {};
+        }
+        
+        CompressedImage image;
+        image.format = header.format;
+        
+        std::size_t offset = sizeof(header);
+        for(std::uint32_t i = 0; i < header.levels; ++i)
+        {
+            LevelHeader level;
+            if(offset + sizeof(level) > file.size())
+            {
+                return {};
+            }
+            
+            std::memcpy(&level, file.data() + offset, sizeof(level));
+            offset += sizeof(level);
+            
+            if(offset + level.bytes > file.size())
+            {
+                return {};
+            }
+            
+            image.levels.push_back({{level.width, level.height}, {file.begin() + offset, file.begin() + offset + level.bytes}});
+            offset += level.bytes;
+        }
+        
+        return image;
+    }
+    
+    bool CompressedImage::save(const std::filesystem::path& path) const
+    {
+        FileHeader header;
+        header.format = format;
+        header.levels = static_cast<std::uint32_t>(levels.size());
+        
+        std::vector<char> file(sizeof(header));
+        std::memcpy(file.data(), &header, sizeof(header));
+        
+        for(const Level& level : levels)
+        {
+            const LevelHeader levelHeader{level.size.x, level.size.y, static_cast<std::uint32_t>(level.data.size())};
+            
+            const std::size_t offset = file.size();
+            file.resize(offset + sizeof(levelHeader) + level.data.size());
+            std::memcpy(file.data() + offset, &levelHeader, sizeof(levelHeader));
+            std::memcpy(file.data() + offset + sizeof(levelHeader), level.data.data(), level.data.size());
+        }
+        
+        return io::writeBinary(path, file.data(), file.size());
+    }
+    
+    void CompressedImage::upload(int dropped) const
+    {
+        dropped = std::clamp(dropped, 0, static_cast<int>(levels.size()) - 1);
+        
+        for(std::size_t i = dropped; i < levels.size(); ++i)
+        {
+            const Level& level = levels[i];
+            glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(i - dropped), format, level.size.x, level.size.y, 0,
+                                   static_cast<GLsizei>(level.data.size()), level.data.data());
+        }
+    }
+    
+    bool CompressedImage::empty() const
+    {
+        return levels.empty();
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Image.hpp"
+#include "Mipmaps.hpp"
+#include "gl.hpp"
+#include <filesystem>
+#include <vector>
+
+namespace gl
+{
+    /// @brief A block compressed image with all its mipmap levels, encoded on the CPU.
+    /// @details
+    /// BC7 (mode 6 only) for the opaque images when the context supports BPTC, else BC1, and BC3 for the images with
+    /// alpha when the context supports S3TC: 4 to 8 times smaller than RGBA8 in memory, and as much less bandwidth.
+    /// The encoding is slow, so import() caches the result in a file and only encodes again if the source changed.
+    struct CompressedImage
+    {
+        struct Level
+        {
+            glm::ivec2 size{0};
+            std::vector<unsigned char> data;
+        };
+        
+        GLenum format{0}; ///< Internal format, 0 if empty
+        std::vector<Level> levels; ///< From the full resolution down to 1x1
+        
+        /// @brief The best compressed format supported by the context for this image.
+        /// @returns 0 if the context supports none.
+        static GLenum chooseFormat(const Image& image);
+        
+        /// @brief Encode an image and its mipmaps, see generateMipmaps().
+        /// @param format GL_COMPRESSED_RGB_S3TC_DXT1_EXT, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT or
+        /// GL_COMPRESSED_RGBA_BPTC_UNORM.
+        /// @remarks The blocks are encoded on the ThreadPool, no OpenGL call.
+        static CompressedImage encode(const MipChain& chain, GLenum format);
+        
+        /// @brief Load the compressed image of a file from the cache, or encode and cache it.
+        /// @param colorSpace Of the RGB values, to generate the mipmaps, see generateMipmaps().
+        /// @returns An empty image if the context supports no compressed format, or if the file can't be decoded.
+        /// @remarks Can be called from any thread once the extensions are loaded, no OpenGL call.
+        static CompressedImage import(const std::filesystem::path& source, const std::filesystem::path& cacheDirectory,
+                                      ColorSpace colorSpace = ColorSpace::Srgb);
+        
+        /// @brief Read a file written by save().
+        /// @returns An empty image if the file is missing or invalid, without logging.
+        static CompressedImage load(const std::filesystem::path& path);
+        
+        bool save(const std::filesystem::path& path) const;
+        
+        /// @brief Upload to the texture bound to GL_TEXTURE_2D, with all its mipmaps.
+        /// @param dropped Count of largest levels skipped, to upload at a lower resolution.
+        void upload(int dropped = 0) const;
+        
+        bool empty() const;
+    };
+}
@@ -0,0 +1,72 @@
+#include "Image.hpp"
+#include <fstream>
+#include <iostream>
+
+// Defines as static to avoid clashes in cases of others files also include stb_image
+#define STB_IMAGE_STATIC
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+namespace gl
+{
+    Image Image::decode(const std::filesystem::path& path)
+    {
+        // Set to the way OpenGL expect pixels, per thread since the images are decoded by the workers
+        stbi_set_flip_vertically_on_load_thread(true);
+        
+        int width, height, channels;
+        unsigned char *pixels = stbi_load(path.c_str(), &width, &height, &channels, 4);
+        
+        Image image;
+        
+        if(!pixels)
+        {
+            std::cerr << "Failed to load the texture from the path " << path << std::endl;
+            return image;
+        }
+        
+        image.size = {width, height};
+        image.pixels.assign(pixels, pixels + static_cast<std::size_t>(width) * height * 4);
+        stbi_image_free(pixels);
+        
+        return image;
+    }
+    
+    bool Image::writePPM(const std::filesystem::path& path) const
+    {
+        std::ofstream file{path, std::ios::binary};
+        if(!file)
+        {
+            std::cerr << "Failed to write the image to the path " << path << std::endl;
+            return false;
+        }
+        
+        file << "P6\n" << size.x << ' ' << size.y << "\n255\n";
+        
+        std::vector<char> row(static_cast<std::size_t>(size.x) * 3);
+        for(int y = size.y - 1; y >= 0; --y)
+        {
+            const unsigned char *source = &pixels[static_cast<std::size_t>(y) * size.x * 4];
+            for(int x = 0; x < size.x; ++x)
+            {
+                for(int c = 0; c < 3; ++c)
+                {
+                    row[static_cast<std::size_t>(x) * 3 + c] = static_cast<char>(source[x * 4 + c]);
+                }
+            }
+            file.write(row.data(), static_cast<std::streamsize>(row.size()));
+        }
+        
+        return static_cast<bool>(file);
+    }
+    
+    bool Image::empty() const
+    {
+        return pixels.empty();
+    }
+    
+    std::size_t Image::getBytes() const
+    {
+        return pixels.size();
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <glm/vec2.hpp>
+#include <filesystem>
+#include <vector>
+
+namespace gl
+{
+    /// @brief An image in memory, 8 bits RGBA, with the first row at the bottom like OpenGL.
+    /// @remarks Only CPU memory, so it can be decoded and processed on any thread.
+    struct Image
+    {
+        glm::ivec2 size{0};
+        std::vector<unsigned char> pixels;
+        
+        /// @brief Decode an image file.
+        /// @returns An empty image if it failed, and log to std::cerr.
+        static Image decode(const std::filesystem::path& path);
+        
+        /// @brief Write to a binary PPM file, without the alpha and with the first row at the top.
+        /// @returns false if it failed, and log to std::cerr.
+        bool writePPM(const std::filesystem::path& path) const;
+        
+        bool empty() const;
+        std::size_t getBytes() const;
+    };
+}
@@ -0,0 +1,301 @@
+#include "MipmapsKernel.hpp"
+#include "gl.hpp"
+#include <utility/ThreadPool.hpp>
+#include <utility/time/Trace.hpp>
+#include <glm/common.hpp>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+namespace gl
+{
+    namespace
+    {
+        /// @brief Entries of the table converting linear values to sRGB, enough to round the dark values right.
+        constexpr std::size_t EncodeEntries = 1 << 14;
+        
+        /// @brief Rows of the output level computed by a task, about 64k pixels.
+        std::size_t getGrain(int width)
+        {
+            return std::max<std::size_t>(1, (1 << 16) / width);
+        }
+        
+        float toLinear(float srgb)
+        {
+            return srgb <= 0.04045f ? srgb / 12.92f : std::pow((srgb + 0.055f) / 1.055f, 2.4f);
+        }
+        
+        float toSrgb(float linear)
+        {
+            return linear <= 0.0031308f ? linear * 12.92f : 1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f;
+        }
+        
+        /// @brief Linear value of each 8 bits value, the alpha and the linear data are already linear.
+        struct DecodeTable
+        {
+            std::array<float, 256> color, alpha;
+            
+            DecodeTable()
+            {
+                for(int i = 0; i < 256; ++i)
+                {
+                    color[i] = toLinear(i / 255.0f);
+                    alpha[i] = i / 255.0f;
+                }
+            }
+        };
+        
+        /// @brief 8 bits sRGB value of each linear value, quantized to EncodeEntries.
+        struct EncodeTable
+        {
+            std::array<unsigned char, EncodeEntries> color;
+            
+            EncodeTable()
+            {
+                for(std::size_t i = 0; i < EncodeEntries; ++i)
+                {
+                    color[i] = static_cast<unsigned char>(std::lround(toSrgb(i / (EncodeEntries - 1.0f)) * 255.0f));
+                }
+            }
+        };
+        
+        const DecodeTable& getDecodeTable()
+        {
+            static const DecodeTable table;
+            return table;
+        }
+        
+        const EncodeTable& getEncodeTable()
+        {
+            static const EncodeTable table;
+            return table;
+        }
+        
+        /// @brief Convert a row of pixels to linear RGBA.
+        void decodeRow(const unsigned char *pixels, float *out, int width, ColorSpace colorSpace)
+        {
+            const DecodeTable& table = getDecodeTable();
+            const std::array<float, 256>& color = colorSpace == ColorSpace::Srgb ? table.color : table.alpha;
+            
+            for(std::size_t i = 0; i < static_cast<std::size_t>(width) * 4; i += 4)
+            {
+                out[i] = color[pixels[i]];
+                out[i + 1] = color[pixels[i + 1]];
+                out[i + 2] = color[pixels[i + 2]];
+                out[i + 3] = table.alpha[pixels[i + 3]];
+            }
+        }
+        
+        /// @brief 8 bits value of a linear value, without conversion.
+        unsigned char encodeLinear(float linear)
+        {
+            return static_cast<unsigned char>(std::clamp(linear, 0.0f, 1.0f) * 255.0f + 0.5f);
+        }
+        
+        void encodeRow(const float *linear, unsigned char *out, int width, ColorSpace colorSpace)
+        {
+            const EncodeTable& table = getEncodeTable();
+            
+            const auto index = [](float v) {
+                return static_cast<std::size_t>(std::clamp(v, 0.0f, 1.0f) * (EncodeEntries - 1) + 0.5f);
+            };
+            
+            for(std::size_t i = 0; i < static_cast<std::size_t>(width) * 4; i += 4)
+            {
+                for(std::size_t c = 0; c < 3; ++c)
+                {
+                    out[i + c] = colorSpace == ColorSpace::Srgb ? table.color[index(linear[i + c])]
+                                                                : encodeLinear(linear[i + c]);
+                }
+                out[i + 3] = encodeLinear(linear[i + 3]);
+            }
+        }
+        
+        /// @brief Compute a row of the next level with the widest kernel, the remaining floats with the scalar one.
+        void downsampleRow(const float *row0, const float *row1, float *out, int width, int inWidth, simd::Level level)
+        {
+            const std::size_t count = static_cast<std::size_t>(width) * 4;
+            
+            // A size of 1 is not halved, the same pixel is read twice
+            if(inWidth == 1)
+            {
+                for(std::size_t i = 0; i < 4; ++i)
+                {
+                    out[i] = ((row0[i] + row0[i]) + (row1[i] + row1[i])) * 0.25f;
+                }
+                
+                return;
+            }
+            
+            std::size_t done = 0;
+            
+            if(level == simd::Level::AVX2)
+            {
+                const std::size_t end = count - count % 8;
+                if(downsampleRowAVX2(row0, row1, out, 0, end))
+                {
+                    done = end;
+                }
+            }
+            else if(level == simd::Level::SSE4)
+            {
+                if(downsampleRowSSE4(row0, row1, out, 0, count))
+                {
+                    done = count;
+                }
+            }
+            
+            detail::downsampleRow<simd::Float1>(row0, row1, out, done, count);
+        }
+        
+        /// @brief The linear values of a level, kept to compute the next one.
+        struct LinearLevel
+        {
+            glm::ivec2 size{0};
+            std::vector<float> values;
+            
+            const float *getRow(int y) const
+            {
+                return values.data() + static_cast<std::size_t>(y) * size.x * 4;
+            }
+        };
+    }
+    
+    MipChain generateMipmaps(Image image, ColorSpace colorSpace, simd::Level level)
+    {
+        trace::Scope scope{"generateMipmaps", "asset"};
+        
+        MipChain chain;
+        if(image.empty())
+        {
+            return chain;
+        }
+        
+        chain.push_back(std::move(image));
+        
+        LinearLevel previous;
+        
+        while(chain.back().size != glm::ivec2{1})
+        {
+            const Image& source = chain.back();
+            
+            LinearLevel next;
+            next.size = glm::max(source.size / 2, 1);
+            next.values.resize(static_cast<std::size_t>(next.size.x) * next.size.y * 4);
+            
+            Image result;
+            result.size = next.size;
+            result.pixels.resize(static_cast<std::size_t>(result.size.x) * result.size.y * 4);
+            
+            // The full resolution is only decoded row by row, its linear values would be 4 times larger than it
+            const bool decode = previous.values.empty();
+            
+            const auto computeRows = [&](std::size_t first, std::size_t last) {
+                std::vector<float> rows[2];
+                
+                for(std::size_t y = first; y < last; ++y)
+                {
+                    // A size of 1 is not halved, the same row is read twice
+                    const int y0 = std::min<int>(2 * y, source.size.y - 1);
+                    const int y1 = std::min<int>(2 * y + 1, source.size.y - 1);
+                    const float *row0, *row1;
+                    
+                    if(decode)
+                    {
+                        for(int i = 0; i < 2; ++i)
+                        {
+                            const int sy = i == 0 ? y0 : y1;
+                            rows[i].resize(static_cast<std::size_t>(source.size.x) * 4);
+                            decodeRow(&source.pixels[static_cast<std::size_t>(sy) * source.size.x * 4], rows[i].data(),
+                                      source.size.x, colorSpace);
+                        }
+                        
+                        row0 = rows[0].data();
+                        row1 = rows[1].data();
+                    }
+                    else
+                    {
+                        row0 = previous.getRow(y0);
+                        row1 = previous.getRow(y1);
+                    }
+                    
+                    float *out = next.values.data() + y * next.size.x * 4;
+                    downsampleRow(row0, row1, out, next.size.x, source.size.x, level);
+                    encodeRow(out, &result.pixels[y * result.size.x * 4], result.size.x, colorSpace);
+                }
+            };
+            
+            ThreadPool::global().parallelFor(0, next.size.y, getGrain(next.size.x), computeRows);
+            
+            previous = std::move(next);
+            chain.push_back(std::move(result));
+        }
+        
+        return chain;
+    }
+    
+    void uploadMipmaps(const MipChain& chain, int dropped)
+    {
+        // The level 0 of OpenGL is the first level uploaded
+        const int first = std::min<int>(dropped, static_cast<int>(chain.size()) - 1);
+        
+        // Fallback for an incomplete chain: only the first level, the driver generates the others
+        const bool complete = chain.back().size == glm::ivec2{1};
+        const int last = complete ? static_cast<int>(chain.size()) - 1 : first;
+        
+        for(int i = first; i <= last; ++i)
+        {
+            const Image& image = chain[i];
+            glTexImage2D(GL_TEXTURE_2D, i - first, GL_RGBA, image.size.x, image.size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                         image.pixels.data());
+        }
+        
+        if(!complete)
+        {
+            glGenerateMipmap(GL_TEXTURE_2D);
+        }
+    }
+    
+    bool validateMipmaps()
+    {
+        std::mt19937 rng{42};
+        std::uniform_int_distribution<int> value{0, 255};
+        
+        // Odd sizes, to check the kernels tails and the clamping
+        Image image;
+        image.size = {67, 45};
+        image.pixels.resize(static_cast<std::size_t>(image.size.x) * image.size.y * 4);
+        for(unsigned char& pixel : image.pixels)
+        {
+            pixel = static_cast<unsigned char>(value(rng));
+        }
+        
+        const MipChain expected = generateMipmaps(image, ColorSpace::Srgb, simd::Level::Scalar);
+        bool success = true;
+        
+        for(simd::Level level : {simd::Level::SSE4, simd::Level::AVX2})
+        {
+            if(level > simd::detectLevel())
+            {
+                continue;
+            }
+            
+            const MipChain chain = generateMipmaps(image, ColorSpace::Srgb, level);
+            
+            for(std::size_t i = 0; i < chain.size(); ++i)
+            {
+                if(chain[i].size != expected[i].size || chain[i].pixels != expected[i].pixels)
+                {
+                    std::cerr << "Mipmaps mismatch with the scalar kernel (" << simd::toString(level)
+                              << ", level " << i << ")" << std::endl;
+                    success = false;
+                    break;
+                }
+            }
+        }
+        
+        return success;
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Image.hpp"
+#include <utility/math/simd.hpp>
+#include <vector>
+
+namespace gl
+{
+    /// @brief An image with its mipmap levels, from the full resolution down to 1x1.
+    using MipChain = std::vector<Image>;
+    
+    /// @brief How the RGB values of an image are encoded, which decides how its mipmaps are filtered.
+    enum class ColorSpace
+    {
+        Srgb, ///< Colors, as the diffuse textures
+        Linear ///< Data, as the normal, specular or roughness maps
+    };
+    
+    /// @brief Generate all the mipmap levels of an image on the CPU, to upload them at once with uploadMipmaps().
+    /// @details
+    /// Each level averages 2x2 pixels of the previous one (box filter), with the rows split over the ThreadPool.
+    /// The sRGB colors are averaged in linear space, else the minified textures get darker and lose contrast, as with
+    /// glGenerateMipmap() on GL_RGBA8. The alpha is linear. The levels are computed from the linear values of the
+    /// previous level, not from its 8 bits pixels, so the rounding errors don't add up.
+    /// A size of 1 is not halved, and the last row or column of an odd size is skipped, like OpenGL.
+    /// @param colorSpace Of the RGB values. The linear data is averaged as is, with the plain box filter.
+    /// @param level The instruction set to use. Defaults to the best one supported by the CPU.
+    /// @remarks Can be called from any thread, no OpenGL call.
+    MipChain generateMipmaps(Image image, ColorSpace colorSpace = ColorSpace::Srgb,
+                             simd::Level level = simd::detectLevel());
+    
+    /// @brief Upload a chain to the texture bound to GL_TEXTURE_2D.
+    /// @param dropped Count of largest levels skipped, to upload at a lower resolution.
+    /// @remarks If the chain doesn't go down to 1x1, only its first level is uploaded and glGenerateMipmap() is the
+    /// fallback for the others.
+    void uploadMipmaps(const MipChain& chain, int dropped = 0);
+    
+    /// @brief Check each kernel supported by the CPU against the scalar one, on a random image with odd sizes.
+    /// @returns true if all the levels are equal. Mismatches are logged to std::cerr.
+    bool validateMipmaps();
+    
+    /// @name
+    /// @brief Kernels for each instruction set, compute the floats [begin, end) of a row of the next level.
+    /// @param row0,row1 The two rows of the previous level averaged, in linear RGBA.
+    /// @remarks Only call them if the CPU supports the instruction set, end - begin must be a multiple of the lane
+    /// count and the previous level at least 2 pixels wide.
+    /// @returns false if the kernel was not compiled with the instruction set enabled, nothing is computed.
+    /// @{
+    bool downsampleRowSSE4(const float *row0, const float *row1, float *out, std::size_t begin, std::size_t end);
+    bool downsampleRowAVX2(const float *row0, const float *row1, float *out, std::size_t begin, std::size_t end);
+    /// @}
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Mipmaps.hpp"
+
+namespace gl
+{
+    namespace detail
+    {
+        /// @brief Sum of the pixels 2x and 2x + 1 of a row, for the floats [i, i + Lanes) of the halved row.
+        /// @details The pixels are RGBA, so one Float4 is one pixel of the halved row.
+        template<typename V>
+        V sumPairs(const float *row, std::size_t i)
+        {
+            const std::size_t first = (i / 4) * 8 + i % 4;
+            return V::load(row + first) + V::load(row + first + 4);
+        }
+
+#if defined(__AVX2__) && defined(__FMA__)
+        /// @brief Two pixels of the halved row: the pairs are in the halves of two vectors, so they are swapped.
+        template<>
+        inline simd::Float8 sumPairs<simd::Float8>(const float *row, std::size_t i)
+        {
+            const __m256 a = _mm256_loadu_ps(row + 2 * i);
+            const __m256 b = _mm256_loadu_ps(row + 2 * i + 8);
+            
+            // [pixel 0, pixel 2] + [pixel 1, pixel 3]
+            return {_mm256_add_ps(_mm256_permute2f128_ps(a, b, 0x20), _mm256_permute2f128_ps(a, b, 0x31))};
+        }
+#endif
+
+        /// @brief Downsample kernel, written once for any wrapper of simd.hpp.
+        /// @details The previous level must be at least 2 pixels wide, end - begin a multiple of V::Lanes.
+        /// The same operations in the same order for every wrapper, so all of them give the same floats.
+        template<typename V>
+        void downsampleRow(const float *row0, const float *row1, float *out, std::size_t begin, std::size_t end)
+        {
+            const V quarter = V::set1(0.25f);
+            
+            for(std::size_t i = begin; i < end; i += V::Lanes)
+            {
+                ((sumPairs<V>(row0, i) + sumPairs<V>(row1, i)) * quarter).store(out + i);
+            }
+        }
+    }
+}
@@ -0,0 +1,17 @@
+#include "MipmapsKernel.hpp"
+
+// Compiled with -mavx2 -mfma, only called when the CPU supports it.
+// Only the Float8 kernel is instantiated here, see TransformBatch_sse4.cpp.
+
+namespace gl
+{
+    bool downsampleRowAVX2(const float *row0, const float *row1, float *out, std::size_t begin, std::size_t end)
+    {
+#if defined(__AVX2__) && defined(__FMA__)
+        detail::downsampleRow<simd::Float8>(row0, row1, out, begin, end);
+        return true;
+#else
+        return false;
+#endif
+    }
+}
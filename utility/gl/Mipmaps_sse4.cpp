@@ -0,0 +1,17 @@
+#include "MipmapsKernel.hpp"
+
+// Compiled with -msse4.1, only called when the CPU supports it.
+// Only the Float4 kernel is instantiated here, see TransformBatch_sse4.cpp.
+
+namespace gl
+{
+    bool downsampleRowSSE4(const float *row0, const float *row1, float *out, std::size_t begin, std::size_t end)
+    {
+#if defined(__SSE4_1__)
+        detail::downsampleRow<simd::Float4>(row0, row1, out, begin, end);
+        return true;
+#else
+        return false;
+#endif
+    }
+}
@@ -0,0 +1,218 @@
+#include "PageFile.hpp"
+#include "Mipmaps.hpp"
+#include <utility/time/Trace.hpp>
+#include <glm/common.hpp>
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <iostream>
+
+namespace gl
+{
+    namespace
+    {
+        constexpr std::uint32_t Version = 1;
+        
+        struct FileHeader
+        {
+            char magic[4]{'G', 'L', 'V', 'T'};
+            std::uint32_t version{Version};
+            std::int32_t width{0};
+            std::int32_t height{0};
+            std::int32_t pageSize{0};
+            std::int32_t border{0};
+            std::int32_t levels{0};
+            std::int32_t pagesX{0};
+            std::int32_t pagesY{0};
+        };
+        
+        /// @brief Copy a page with its border from a level, wrapping around the level.
+        void copyPage(const Image& level, glm::ivec2 page, int pageSize, int border, unsigned char *out)
+        {
+            const int stride = pageSize + 2 * border;
+            
+            for(int y = 0; y < stride; ++y)
+            {
+                const int sy = ((page.y * pageSize - border + y) % level.size.y + level.size.y) % level.size.y;
+                
+                for(int x = 0; x < stride; ++x)
+                {
+                    const int sx = ((page.x * pageSize - border + x) % level.size.x + level.size.x) % level.size.x;
+                    std::memcpy(out + (static_cast<std::size_t>(y) * stride + x) * 4,
+                                &level.pixels[(static_cast<std::size_t>(sy) * level.size.x + sx) * 4], 4);
+                }
+            }
+        }
+    }
+    
+    bool PageFile::build(const std::filesystem::path& source, const std::filesystem::path& path, int pageSize,
+                         int border)
+    {
+        trace::Scope scope{"PageFile::build", "asset"};
+        
+        const MipChain chain = generateMipmaps(Image::decode(source));
+        if(chain.empty())
+        {
+            return false;
+        }
+        
+        FileHeader header;
+        header.width = chain[0].size.x;
+        header.height = chain[0].size.y;
+        header.pageSize = pageSize;
+        header.border = border;
+        
+        const auto pageCount = [pageSize](int texels) {
+            return static_cast<std::int32_t>(std::bit_ceil(static_cast<unsigned>((texels + pageSize - 1) / pageSize)));
+        };
+        
+        header.pagesX = pageCount(header.width);
+        header.pagesY = pageCount(header.height);
+        header.levels = std::bit_width(static_cast<unsigned>(std::max(header.pagesX, header.pagesY)));
+        
+        const int stride = pageSize + 2 * border;
+        std::vector<unsigned char> texels(static_cast<std::size_t>(stride) * stride * 4);
+        
+        std::error_code error;
+        std::filesystem::create_directories(path.parent_path(), error);
+        
+        // Written to a temporary file first, as io::writeBinary(), but streamed: the file can be larger than memory
+        std::filesystem::path tmp{path};
+        tmp += ".tmp";
+        
+        {
+            std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+            ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            
+            for(int level = 0; level < header.levels; ++level)
+            {
+                // The chain always has more levels than the pages: a page is larger than a texel
+                const Image& image = chain[std::min<std::size_t>(level, chain.size() - 1)];
+                const glm::ivec2 pages = glm::max(glm::ivec2{header.pagesX >> level, header.pagesY >> level}, 1);
+                
+                for(int y = 0; y < pages.y; ++y)
+                {
+                    for(int x = 0; x < pages.x; ++x)
+                    {
+                        copyPage(image, {x, y}, pageSize, border, texels.data());
+                        ofs.write(reinterpret_cast<const char *>(texels.data()),
+                                  static_cast<std::streamsize>(texels.size()));
+                    }
+                }
+            }
+            
+            if(!ofs)
+            {
+                std::cerr << "Failed to write the file " << tmp << std::endl;
+                return false;
+            }
+        }
+        
+        std::filesystem::rename(tmp, path, error);
+        if(error)
+        {
+            std::cerr << "Failed to rename " << tmp << " to " << path << ": " << error.message() << std::endl;
+            return false;
+        }
+        
+        return true;
+    }
+    
+    bool PageFile::open(const std::filesystem::path& path)
+    {
+        std::lock_guard lock{m_mutex};
+        
+        m_file = std::ifstream{path, std::ios::binary};
+        
+        FileHeader header;
+        FileHeader expected;
+        if(!m_file.read(reinterpret_cast<char *>(&header), sizeof(header))
+           || std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 || header.version != Version
+           || header.pageSize <= 0 || header.border < 0 || header.levels <= 0)
+        {
+            m_file.close();
+            m_levels = 0;
+            return false;
+        }
+        
+        m_size = {header.width, header.height};
+        m_pageSize = header.pageSize;
+        m_border = header.border;
+        m_levels = header.levels;
+        m_pages = {header.pagesX, header.pagesY};
+        
+        return true;
+    }
+    
+    bool PageFile::isOpen() const
+    {
+        return m_levels > 0;
+    }
+    
+    bool PageFile::readPage(Page page, std::vector<unsigned char>& texels) const
+    {
+        texels.resize(getPageBytes());
+        
+        std::lock_guard lock{m_mutex};
+        
+        m_file.seekg(static_cast<std::streamoff>(getOffset(page)));
+        if(!m_file.read(reinterpret_cast<char *>(texels.data()), static_cast<std::streamsize>(texels.size())))
+        {
+            std::cerr << "Failed to read the page (" << page.pos.x << ", " << page.pos.y << ") of the level "
+                      << page.level << std::endl;
+            m_file.clear();
+            return false;
+        }
+        
+        return true;
+    }
+    
+    glm::ivec2 PageFile::getSize() const
+    {
+        return m_size;
+    }
+    
+    int PageFile::getPageSize() const
+    {
+        return m_pageSize;
+    }
+    
+    int PageFile::getBorder() const
+    {
+        return m_border;
+    }
+    
+    int PageFile::getLevels() const
+    {
+        return m_levels;
+    }
+    
+    int PageFile::getStride() const
+    {
+        return m_pageSize + 2 * m_border;
+    }
+    
+    glm::ivec2 PageFile::getPageCount(int level) const
+    {
+        return glm::max(glm::ivec2{m_pages.x >> level, m_pages.y >> level}, 1);
+    }
+    
+    std::size_t PageFile::getPageBytes() const
+    {
+        return static_cast<std::size_t>(getStride()) * getStride() * 4;
+    }
+    
+    std::uint64_t PageFile::getOffset(Page page) const
+    {
+        std::uint64_t pages = 0;
+        for(int level = 0; level < page.level; ++level)
+        {
+            const glm::ivec2 count = getPageCount(level);
+            pages += static_cast<std::uint64_t>(count.x) * count.y;
+        }
+        
+        pages += static_cast<std::uint64_t>(page.pos.y) * getPageCount(page.level).x + page.pos.x;
+        
+        return sizeof(FileHeader) + pages * getPageBytes();
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <glm/vec2.hpp>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+namespace gl
+{
+    /// @brief A texture split into square pages, for each of its mipmap levels, stored in a file to be streamed.
+    /// @details
+    /// A page is pageSize x pageSize texels, plus a border of texels of the neighbor pages on each side, so the
+    /// bilinear filtering of a page sampled alone matches the full texture. The borders wrap around the texture, which
+    /// repeats. The count of pages of the level 0 is rounded up to a power of two on each axis, so each level has half
+    /// the pages of the previous one, down to a single page: a level is never partially covered by its parent.
+    /// The pages are RGBA8, in the order of the levels then of the rows, so the offset of a page is computed.
+    /// @remarks Only CPU memory and file reads, readPage() can be called from any thread.
+    class PageFile
+    {
+    public:
+        struct Page
+        {
+            int level{0};
+            glm::ivec2 pos{0}; ///< In pages of its level
+        };
+        
+        /// @brief Split an image file into a page file.
+        /// @details The whole image and its mipmaps are in memory while building, it's meant to be done offline or
+        /// cached. The levels are the ones of generateMipmaps(), gamma-correct.
+        /// @returns false and log to std::cerr if the image can't be decoded or the file written.
+        static bool build(const std::filesystem::path& source, const std::filesystem::path& path, int pageSize = 128,
+                          int border = 4);
+        
+        /// @brief Open a file written by build(), only its header is read.
+        /// @returns false if the file is missing or invalid, without logging.
+        bool open(const std::filesystem::path& path);
+        
+        bool isOpen() const;
+        
+        /// @brief Read the texels of a page, with its border: getStride() x getStride() RGBA8 texels.
+        /// @returns false and log to std::cerr if the read fails.
+        bool readPage(Page page, std::vector<unsigned char>& texels) const;
+        
+        /// @brief Size of the level 0 of the texture, in texels.
+        glm::ivec2 getSize() const;
+        
+        int getPageSize() const;
+        int getBorder() const;
+        int getLevels() const;
+        
+        /// @brief Size of a page with its borders, in texels.
+        int getStride() const;
+        
+        /// @brief Count of pages of a level on each axis.
+        glm::ivec2 getPageCount(int level) const;
+        
+        /// @brief Memory of a page with its borders, in bytes.
+        std::size_t getPageBytes() const;
+    
+    private:
+        std::uint64_t getOffset(Page page) const;
+        
+        glm::ivec2 m_size{0};
+        int m_pageSize{0};
+        int m_border{0};
+        int m_levels{0};
+        glm::ivec2 m_pages{0}; ///< Count of pages of the level 0
+        
+        /// @brief The reads of the workers seek in the same stream.
+        mutable std::ifstream m_file;
+        mutable std::mutex m_mutex;
+    };
+}
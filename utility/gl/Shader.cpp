@@ -1,32 +1,271 @@
 #include "Shader.hpp"
+#include "extensions.hpp"
 #include <utility/io.hpp>
 #include <vector>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <regex>
 #include <glm/gtc/type_ptr.hpp>
 
 namespace gl
 {
+    namespace
+    {
+        /// @brief Header of a cached program binary file, followed by the binary itself.
+        struct BinaryHeader
+        {
+            char magic[4]{'G', 'L', 'P', 'B'};
+            std::uint32_t format{0}; ///< Binary format returned by glGetProgramBinary()
+        };
+        
+        std::string getString(GLenum name)
+        {
+            const auto *str = reinterpret_cast<const char *>(glGetString(name));
+            return str ? str : "";
+        }
+        
+        /// @brief Append a file to out, recursively replacing the #include directives by the included files.
+        /// @param included The files already included, this file is added to it.
+        void preprocessFile(const std::filesystem::path& file, const Shader::Defines& defines,
+                            std::vector<std::filesystem::path>& included, std::ostringstream& out)
+        {
+            static const std::regex includeRegex(R"re(^\s*#\s*include\s+"([^"]+)".*)re");
+            static const std::regex versionRegex(R"(^\s*#\s*version\b.*)");
+            
+            // In GLSL 330, the line following "#line n" is the line n + 1
+            const std::size_t index = included.size();
+            included.push_back(std::filesystem::weakly_canonical(file));
+            if(index > 0)
+            {
+                out << "#line 0 " << index << '\n';
+            }
+            
+            std::istringstream in{io::readAll(file)};
+            std::string line;
+            for(int number = 1; std::getline(in, line); ++number)
+            {
+                std::smatch match;
+                if(std::regex_match(line, match, includeRegex))
+                {
+                    const std::filesystem::path child = file.parent_path() / match[1].str();
+                    
+                    if(std::find(included.begin(), included.end(), std::filesystem::weakly_canonical(child))
+                       == included.end())
+                    {
+                        if(std::filesystem::is_regular_file(child))
+                        {
+                            preprocessFile(child, {}, included, out);
+                        }
+                        else
+                        {
+                            std::cerr << file.string() << ":" << number << ": can't include " << child << std::endl;
+                        }
+                    }
+                    
+                    out << "#line " << number << ' ' << index << '\n';
+                    continue;
+                }
+                
+                out << line << '\n';
+                
+                // The #version must be the first directive, so the macros are defined just after it
+                if(!defines.empty() && std::regex_match(line, versionRegex))
+                {
+                    for(const std::string& define : defines)
+                    {
+                        out << "#define " << define << '\n';
+                    }
+                    
+                    out << "#line " << number << ' ' << index << '\n';
+                }
+            }
+        }
+    }
+    
+    std::filesystem::path Shader::s_binaryCacheDirectory;
+    
     void Shader::load(const std::string& vertexSrc, const std::string& fragmentSrc)
     {
-        gl::raii::Shader vert(GL_VERTEX_SHADER);
-        gl::raii::Shader frag(GL_FRAGMENT_SHADER);
+        submit(vertexSrc, fragmentSrc);
+        finish();
+    }
+    
+    void Shader::submit(const std::string& vertexSrc, const std::string& fragmentSrc)
+    {
+        const std::filesystem::path cachePath = getBinaryCachePath(vertexSrc, fragmentSrc);
+        
+        if(!cachePath.empty())
+        {
+            if(loadBinary(cachePath))
+            {
+                m_pending.reset();
+                return;
+            }
+            
+            // Must be set before linking to be able to get the binary after
+            ext::programParameteri(m_program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+        
+        // The shaders are kept until finish(), to get their log if the link fails
+        m_pending = std::make_unique<Pending>();
+        m_pending->cachePath = cachePath;
         
-        gl::compileShader(vert, vertexSrc);
-        gl::compileShader(frag, fragmentSrc);
-        gl::linkShadersToProgram(m_program, vert, frag);
+        gl::compileShader(m_pending->vert, vertexSrc, false);
+        gl::compileShader(m_pending->frag, fragmentSrc, false);
+        gl::linkShadersToProgram(m_program, m_pending->vert, m_pending->frag, false);
+    }
+    
+    void Shader::submit(const std::filesystem::path& vert, const std::filesystem::path& frag, const Defines& defines)
+    {
+        submit(preprocess(vert, defines), preprocess(frag, defines));
+    }
+    
+    std::string Shader::preprocess(const std::filesystem::path& path, const Defines& defines)
+    {
+        std::vector<std::filesystem::path> included;
+        std::ostringstream out;
+        
+        preprocessFile(path, defines, included, out);
+        
+        return out.str();
+    }
+    
+    bool Shader::isReady() const
+    {
+        if(!m_pending || !ext::KHR_parallel_shader_compile)
+        {
+            return true;
+        }
+        
+        int completed;
+        glGetProgramiv(m_program, GL_COMPLETION_STATUS_KHR, &completed);
+        
+        return completed;
+    }
+    
+    void Shader::finish() const
+    {
+        if(!m_pending)
+        {
+            return;
+        }
+        
+        // Only look at the shaders if the link failed, the link status is enough in the common case
+        if(gl::checkLinkStatus(m_program))
+        {
+            if(!m_pending->cachePath.empty())
+            {
+                saveBinary(m_pending->cachePath);
+            }
+        }
+        else
+        {
+            gl::checkCompileStatus(m_pending->vert);
+            gl::checkCompileStatus(m_pending->frag);
+        }
         
-        // At the end of the scope the GL::Shader will be deleted,
+        // At this point the GL::Shader will be deleted,
         // it's fine because they are no more necessary
+        m_pending.reset();
     }
     
-    void Shader::load(const std::filesystem::path& vert, const std::filesystem::path& frag)
+    void Shader::setBinaryCacheDirectory(const std::filesystem::path& directory)
     {
-        load(io::readAll(vert), io::readAll(frag));
+        s_binaryCacheDirectory = directory;
+    }
+    
+    std::filesystem::path Shader::getBinaryCachePath(const std::string& vertexSrc, const std::string& fragmentSrc)
+    {
+        if(s_binaryCacheDirectory.empty() || !ext::ARB_get_program_binary)
+        {
+            return {};
+        }
+        
+        // Some drivers support the extension but no format at all
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        if(formats == 0)
+        {
+            return {};
+        }
+        
+        // The driver strings don't change while running
+        static const std::string driver{
+            getString(GL_VENDOR) + '\n' + getString(GL_RENDERER) + '\n' + getString(GL_VERSION)
+        };
+        
+        // Chain the hashes, with separators so moving text from a source to another changes the key
+        std::uint64_t key = io::hash(driver);
+        key = io::hash(vertexSrc + '\0', key);
+        key = io::hash(fragmentSrc + '\0', key);
+        
+        std::ostringstream name;
+        name << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+        
+        return s_binaryCacheDirectory / name.str();
+    }
+    
+    bool Shader::loadBinary(const std::filesystem::path& path)
+    {
+        const std::vector<char> file = io::readBinary(path);
+        
+        BinaryHeader header;
+        if(file.size() <= sizeof(header) || std::memcmp(file.data(), header.magic, sizeof(header.magic)) != 0)
+        {
+            return false;
+        }
+        
+        std::memcpy(&header, file.data(), sizeof(header));
+        
+        ext::programBinary(m_program, header.format, file.data() + sizeof(header),
+                           static_cast<GLsizei>(file.size() - sizeof(header)));
+        
+        // The driver can reject a binary at any time (for example after an update keeping the same version string),
+        // in this case the program is just not linked and we compile it from the sources
+        int status;
+        glGetProgramiv(m_program, GL_LINK_STATUS, &status);
+        
+        return status;
+    }
+    
+    void Shader::saveBinary(const std::filesystem::path& path) const
+    {
+        int status;
+        glGetProgramiv(m_program, GL_LINK_STATUS, &status);
+        
+        int length = 0;
+        glGetProgramiv(m_program, GL_PROGRAM_BINARY_LENGTH, &length);
+        
+        if(!status || length <= 0)
+        {
+            return;
+        }
+        
+        std::vector<char> file(sizeof(BinaryHeader) + length);
+        
+        BinaryHeader header;
+        GLenum format = 0;
+        ext::getProgramBinary(m_program, length, nullptr, &format, file.data() + sizeof(header));
+        header.format = format;
+        std::memcpy(file.data(), &header, sizeof(header));
+        
+        io::writeBinary(path, file.data(), file.size());
+    }
+    
+    void Shader::load(const std::filesystem::path& vert, const std::filesystem::path& frag, const Defines& defines)
+    {
+        load(preprocess(vert, defines), preprocess(frag, defines));
     }
     
     void Shader::bind(const Shader *shader)
     {
         if (shader)
         {
+            shader->finish();
             glUseProgram(shader->m_program);
         } else
         {
@@ -68,4 +307,10 @@ namespace gl
         Shader::bind(this);
         glUniform3fv(glGetUniformLocation(m_program, name.c_str()), 1, glm::value_ptr(value));
     }
-}
\ No newline at end of file
+    
+    void Shader::setUniform(const std::string& name, const glm::vec2& value)
+    {
+        Shader::bind(this);
+        glUniform2fv(glGetUniformLocation(m_program, name.c_str()), 1, glm::value_ptr(value));
+    }
+}
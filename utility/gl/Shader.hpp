@@ -4,6 +4,8 @@
 #include "Texture.hpp"
 #include <glm/glm.hpp>
 #include <string>
+#include <memory>
+#include <vector>
 #include <filesystem>
 
 namespace gl
@@ -12,13 +14,49 @@ namespace gl
     class Shader
     {
     public:
+        /// @brief Macros to define in a shader, each one as "NAME" or "NAME VALUE".
+        using Defines = std::vector<std::string>;
         
         /// @brief Try to load a shader.
         /// @param vertex,fragment The source code for each shader.
         /// @throws If there was an error.
         void load(const std::string& vertexSrc, const std::string& fragmentSrc);
         
-        void load(const std::filesystem::path& vert, const std::filesystem::path& frag);
+        /// @brief Load a shader from files, see preprocess().
+        void load(const std::filesystem::path& vert, const std::filesystem::path& frag, const Defines& defines = {});
+        
+        /// @brief Start to compile and link the shader, without waiting for the driver.
+        /// @details
+        /// Querying the status of a shader forces the driver to finish its compilation, so the status is only checked
+        /// when the shader is first used (bind() or setUniform()). Submit all the shaders first, then use them:
+        /// the driver can compile all of them in parallel (with KHR_parallel_shader_compile).
+        ///     a.submit(...);
+        ///     b.submit(...);      // Compiles while a is still compiling
+        ///     a.setUniform(...);  // Waits only for a
+        void submit(const std::string& vertexSrc, const std::string& fragmentSrc);
+        
+        void submit(const std::filesystem::path& vert, const std::filesystem::path& frag, const Defines& defines = {});
+        
+        /// @brief Read the source of a shader, resolving its #include "file" and adding the macros.
+        /// @details
+        /// An included path is relative to the including file, and a file is only included once (as with
+        /// #pragma once), so included files need no guard. The macros are defined right after the #version line.
+        /// #line directives keep the line numbers of the compilation errors right: the source string number is 0
+        /// for the file itself, then the order of inclusion of the included files.
+        /// @remarks Log to std::cerr the files which can't be read.
+        static std::string preprocess(const std::filesystem::path& path, const Defines& defines = {});
+        
+        /// @brief Check if the shader can be used without waiting for the driver.
+        /// @remarks Always true without KHR_parallel_shader_compile, because it's impossible to know.
+        bool isReady() const;
+        
+        /// @brief Set the directory where the linked programs are cached, as binaries of the driver.
+        /// @details A cached binary is keyed by a hash of the sources and of the GL_VENDOR, GL_RENDERER and
+        /// GL_VERSION strings, so another driver never reuses it. If the driver still rejects a cached binary,
+        /// the program is silently compiled from the sources and cached again.
+        /// @param directory Empty to disable the cache, which is the default.
+        /// @remarks Needs OpenGL 4.1 or ARB_get_program_binary, else the cache is ignored.
+        static void setBinaryCacheDirectory(const std::filesystem::path& directory);
         
         /// @brief Bind the shader.
         /// @param shader Pass nullptr to unbind.
@@ -32,6 +70,7 @@ namespace gl
         
         void setUniform(const std::string& name, const glm::vec4& value);
         void setUniform(const std::string& name, const glm::vec3& value);
+        void setUniform(const std::string& name, const glm::vec2& value);
     
         void setUniform(const std::string& name, int value);
         void setUniform(const std::string& name, unsigned int value);
@@ -40,6 +79,31 @@ namespace gl
         /// @}
     
     private:
+        /// @returns Where the binary of a program with these sources is cached, empty if the cache is disabled.
+        static std::filesystem::path getBinaryCachePath(const std::string& vertexSrc, const std::string& fragmentSrc);
+        
+        /// @returns true if the program is linked from the cached binary.
+        bool loadBinary(const std::filesystem::path& path);
+        
+        void saveBinary(const std::filesystem::path& path) const;
+        
+        /// @brief Wait for the submitted compilation, log the errors and cache the binary.
+        /// @remarks Do nothing if there is no compilation pending.
+        void finish() const;
+        
+        /// @brief A compilation submitted but not checked yet.
+        struct Pending
+        {
+            gl::raii::Shader vert{GL_VERTEX_SHADER};
+            gl::raii::Shader frag{GL_FRAGMENT_SHADER};
+            std::filesystem::path cachePath; ///< Where to cache the binary once linked, empty for no cache
+        };
+        
         gl::raii::Program m_program;
+        
+        /// @brief Mutable because it can be finished when binding a const shader.
+        mutable std::unique_ptr<Pending> m_pending;
+        
+        static std::filesystem::path s_binaryCacheDirectory;
     };
 }
\ No newline at end of file
@@ -0,0 +1,57 @@
+#include "ShaderVariants.hpp"
+#include <cassert>
+
+namespace gl
+{
+    ShaderVariants::ShaderVariants(std::filesystem::path vert, std::filesystem::path frag, Shader::Defines features)
+        : m_vert{std::move(vert)}, m_frag{std::move(frag)}, m_features{std::move(features)}
+    {
+        assert(m_features.size() <= sizeof(unsigned int) * 8);
+    }
+    
+    Shader& ShaderVariants::get(unsigned int features)
+    {
+        std::unique_ptr<Shader>& shader = m_variants[features];
+        
+        if(!shader)
+        {
+            Shader::Defines defines;
+            for(std::size_t i = 0; i < m_features.size(); ++i)
+            {
+                if(features & (1u << i))
+                {
+                    defines.push_back(m_features[i]);
+                }
+            }
+            
+            // Only submitted, the status is checked when the variant is first bound
+            shader = std::make_unique<Shader>();
+            shader->submit(m_vert, m_frag, defines);
+            
+            if(m_onCreate)
+            {
+                m_onCreate(*shader);
+            }
+        }
+        
+        return *shader;
+    }
+    
+    void ShaderVariants::prewarm(std::initializer_list<unsigned int> variants)
+    {
+        for(unsigned int features : variants)
+        {
+            get(features);
+        }
+    }
+    
+    void ShaderVariants::setOnCreate(std::function<void(Shader&)> f)
+    {
+        m_onCreate = std::move(f);
+    }
+    
+    std::size_t ShaderVariants::size() const
+    {
+        return m_variants.size();
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Shader.hpp"
+#include <functional>
+#include <unordered_map>
+#include <initializer_list>
+
+namespace gl
+{
+    /// @brief Variants of a shader, each one compiled with its own set of features.
+    /// @details
+    /// A feature is a bit of a mask and a macro defined in the sources when the bit is set, so a variant only
+    /// contains the code of its features instead of branching on uniforms:
+    ///     ShaderVariants shaders{"base.vert", "base.frag", {"TEXTURED", "SPECULAR"}};
+    ///     shaders.get(0b10); // Compiled with #define SPECULAR
+    /// The variants are compiled on first use and then cached, in memory and in the binary cache of Shader.
+    class ShaderVariants
+    {
+    public:
+        /// @param features The macro defined for each bit of the features, features[i] is for the bit 1 << i.
+        ShaderVariants(std::filesystem::path vert, std::filesystem::path frag, Shader::Defines features);
+        
+        /// @brief Get the variant with these features, compiling it if it's the first use.
+        Shader& get(unsigned int features);
+        
+        /// @brief Submit the compilation of variants which will be used, without waiting for it.
+        /// @details Avoids a hitch the first time a variant is drawn, and lets the driver compile them in parallel.
+        void prewarm(std::initializer_list<unsigned int> variants);
+        
+        /// @brief Call f(Shader&) on each variant already compiled, to set the uniforms shared by all of them.
+        template<typename F>
+        void forEach(F&& f)
+        {
+            for(auto& [features, shader] : m_variants)
+            {
+                f(*shader);
+            }
+        }
+        
+        /// @brief Set f(Shader&), called on each variant when it is created, so the variants created after a forEach()
+        /// also get the uniforms shared by all of them.
+        void setOnCreate(std::function<void(Shader&)> f);
+        
+        /// @brief Count of variants already compiled.
+        std::size_t size() const;
+        
+    private:
+        std::filesystem::path m_vert, m_frag;
+        Shader::Defines m_features;
+        std::function<void(Shader&)> m_onCreate;
+        
+        /// @brief Pointers, so the references returned by get() stay valid.
+        std::unordered_map<unsigned int, std::unique_ptr<Shader>> m_variants;
+    };
+}
@@ -1,45 +1,155 @@
 #include "Texture.hpp"
+#include "registry.hpp"
+#include "TextureResidency.hpp"
+#include "TextureUploader.hpp"
+#include <utility/ThreadPool.hpp>
+#include <utility/time/Trace.hpp>
+#include <glm/common.hpp>
+#include <algorithm>
 #include <iostream>
 
-// Defines as static to avoid clashes in cases of others files also include stb_image
-#define STB_IMAGE_STATIC
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
-
 namespace gl
 {
+    TextureResidency *Texture::s_residency{nullptr};
+    TextureUploader *Texture::s_uploader{nullptr};
+    std::filesystem::path Texture::s_compressionCacheDirectory;
+    
+    Texture::~Texture()
+    {
+        if(s_uploader && m_texture.id)
+        {
+            s_uploader->cancel(m_texture);
+        }
+        
+        if(s_residency && m_texture.id)
+        {
+            s_residency->remove(m_texture);
+        }
+    }
+    
     void Texture::load1x1White()
     {
         static const GLubyte pixels[] = {
                 0xff, 0xff, 0xff, 0xff // RGBA Opaque white 1x1
         };
         
+        // A 1x1 texture is its own chain, no mipmap to generate
         Texture::bind(this);
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        
+        registry::setImageStorage(registry::Type::Texture, m_texture, GL_RGBA, {1, 1, 1});
+        registry::setLabel(registry::Type::Texture, m_texture, "White");
     }
     
-    void Texture::load(const std::filesystem::path& path)
+    Texture::Decoded Texture::decode(const std::filesystem::path& path, ColorSpace colorSpace)
     {
-        // Set to the way OpenGL expect pixels
-        stbi_set_flip_vertically_on_load(true);
+        trace::Scope scope{"Texture::decode", "asset"};
+        
+        Decoded decoded;
+        decoded.path = path;
+        decoded.colorSpace = colorSpace;
+        
+        if(!s_compressionCacheDirectory.empty())
+        {
+            decoded.compressed = CompressedImage::import(path, s_compressionCacheDirectory, colorSpace);
+            
+            if(!decoded.compressed.empty())
+            {
+                return decoded;
+            }
+        }
+        
+        decoded.mipmaps = generateMipmaps(Image::decode(path), colorSpace);
         
-        int width, height, channels;
-        unsigned char *pixels = stbi_load(path.c_str(), &width, &height, &channels, 4);
+        return decoded;
+    }
+    
+    std::future<Texture::Decoded> Texture::decodeAsync(const std::filesystem::path& path, ColorSpace colorSpace)
+    {
+        return ThreadPool::global().submit([path, colorSpace] { return decode(path, colorSpace); });
+    }
+    
+    void Texture::load(const std::filesystem::path& path, ColorSpace colorSpace)
+    {
+        load(decode(path, colorSpace));
+    }
+    
+    void Texture::load(Decoded decoded)
+    {
+        trace::Scope scope{"Texture::load", "asset"};
         
-        if(!pixels)
+        if(!decoded.compressed.empty())
         {
-            std::cerr << "Failed to load the texture from the path " << path << std::endl;
+            load(decoded.compressed);
+        }
+        else if(!decoded.mipmaps.empty())
+        {
+            load(decoded.mipmaps);
         }
         else
         {
-            Texture::bind(this);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
-            glGenerateMipmap(GL_TEXTURE_2D);
+            return;
         }
         
-        free(pixels);
-        pixels = nullptr;
+        track(m_texture, std::move(decoded));
+    }
+    
+    void Texture::load(std::future<Decoded> decoded)
+    {
+        if(s_uploader)
+        {
+            s_uploader->load(m_texture, std::move(decoded));
+        }
+        else
+        {
+            load(decoded.get());
+        }
+    }
+    
+    void Texture::track(GLuint texture, Decoded decoded)
+    {
+        registry::setLabel(registry::Type::Texture, texture, decoded.path.filename().string());
+        
+        if(!s_residency)
+        {
+            return;
+        }
+        
+        if(!decoded.compressed.empty())
+        {
+            s_residency->add(texture, decoded.path, decoded.compressed, decoded.colorSpace);
+        }
+        else
+        {
+            s_residency->add(texture, decoded.path, std::move(decoded.mipmaps), decoded.colorSpace);
+        }
+    }
+    
+    void Texture::load(const Image& image)
+    {
+        glBindTexture(GL_TEXTURE_2D, m_texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.size.x, image.size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                     image.pixels.data());
+        glGenerateMipmap(GL_TEXTURE_2D);
+        
+        registry::setImageStorage(registry::Type::Texture, m_texture, GL_RGBA, {image.size, 1}, 0);
+    }
+    
+    void Texture::load(const MipChain& chain)
+    {
+        glBindTexture(GL_TEXTURE_2D, m_texture);
+        uploadMipmaps(chain);
+        
+        registry::setImageStorage(registry::Type::Texture, m_texture, GL_RGBA, {chain[0].size, 1}, 0);
+    }
+    
+    void Texture::load(const CompressedImage& image)
+    {
+        glBindTexture(GL_TEXTURE_2D, m_texture);
+        image.upload();
+        
+        registry::setImageStorage(registry::Type::Texture, m_texture, image.format, {image.levels[0].size, 1}, 0);
     }
     
     void Texture::load(glm::ivec2 size, glm::vec4 color)
@@ -48,6 +158,8 @@ namespace gl
         
         Texture::bind(this);
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size.x, size.y, 0, GL_RGBA, GL_FLOAT, pixels.data());
+        
+        registry::setImageStorage(registry::Type::Texture, m_texture, GL_RGBA, {size, 1});
     }
     
     void Texture::load(glm::ivec2 size, GLint internalFormat)
@@ -58,12 +170,19 @@ namespace gl
         // format should be the same as internalFormat, since there is no data but sometimes it will not work,
         // For example using internalFormat=GL_DEPTH_COMPONENT and format=GL_RGBA will not work.
         glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, size.x, size.y, 0, internalFormat, GL_UNSIGNED_BYTE, nullptr);
+        
+        registry::setImageStorage(registry::Type::Texture, m_texture, internalFormat, {size, 1});
     }
     
     void Texture::bind(const Texture *texture)
     {
         if (texture)
         {
+            if(s_residency)
+            {
+                s_residency->use(texture->m_texture);
+            }
+            
             glBindTexture(GL_TEXTURE_2D, texture->m_texture);
         }
         else
@@ -72,6 +191,36 @@ namespace gl
         }
     }
     
+    void Texture::setResidency(TextureResidency *residency)
+    {
+        s_residency = residency;
+    }
+    
+    TextureResidency *Texture::getResidency()
+    {
+        return s_residency;
+    }
+    
+    void Texture::setUploader(TextureUploader *uploader)
+    {
+        s_uploader = uploader;
+    }
+    
+    TextureUploader *Texture::getUploader()
+    {
+        return s_uploader;
+    }
+    
+    void Texture::setCompressionCacheDirectory(const std::filesystem::path& directory)
+    {
+        s_compressionCacheDirectory = directory;
+    }
+    
+    const std::filesystem::path& Texture::getCompressionCacheDirectory()
+    {
+        return s_compressionCacheDirectory;
+    }
+    
     unsigned int Texture::getID() const
     {
         return m_texture.id;
@@ -1,22 +1,74 @@
 #pragma once
 
 #include "gl.hpp"
+#include "Image.hpp"
+#include "Mipmaps.hpp"
+#include "CompressedImage.hpp"
 #include <glm/vec2.hpp>
 #include <glm/vec4.hpp>
 #include <filesystem>
+#include <future>
 
 namespace gl
 {
+    class TextureResidency;
+    class TextureUploader;
+    
     class Texture
     {
     public:
         Texture() = default;
+        ~Texture();
+        
+        Texture(Texture&&) = default;
+        Texture& operator=(Texture&&) = default;
+        
+        /// @brief An image file decoded with its mipmaps, ready to be uploaded by load().
+        struct Decoded
+        {
+            std::filesystem::path path;
+            CompressedImage compressed; ///< If block compressed, see setCompressionCacheDirectory()
+            MipChain mipmaps; ///< Else the RGBA8 levels, empty if the file can't be decoded
+            ColorSpace colorSpace{ColorSpace::Srgb}; ///< Of the RGB values, to generate the levels again
+        };
         
         /// @brief Set the texture as 1x1 opaque white
         void load1x1White();
         
-        /// @brief Load from an image file on the disk.
-        void load(const std::filesystem::path& path);
+        /// @brief Decode an image file and generate its mipmaps, or read them from the compression cache.
+        /// @details Block compressed if a compression cache directory is set and the context supports it,
+        /// see setCompressionCacheDirectory(), else in RGBA8 with the mipmaps of generateMipmaps().
+        /// @param colorSpace Of the material slot: sRGB for the colors, linear for the data.
+        /// @remarks Can be called from any thread, no OpenGL call.
+        static Decoded decode(const std::filesystem::path& path, ColorSpace colorSpace = ColorSpace::Srgb);
+        
+        /// @brief decode() on the ThreadPool, so the render thread only uploads the levels.
+        ///     std::future<gl::Texture::Decoded> decoded = gl::Texture::decodeAsync(path);
+        ///     // Other work, then:
+        ///     texture.load(decoded.get());
+        static std::future<Decoded> decodeAsync(const std::filesystem::path& path,
+                                                ColorSpace colorSpace = ColorSpace::Srgb);
+        
+        /// @brief Load from an image file on the disk, with mipmaps: decode() then load() on the calling thread.
+        void load(const std::filesystem::path& path, ColorSpace colorSpace = ColorSpace::Srgb);
+        
+        /// @brief Upload a decoded file with all its levels.
+        /// @remarks Managed by the residency manager if there is one, see setResidency().
+        void load(Decoded decoded);
+        
+        /// @brief Upload a file being decoded, see decodeAsync().
+        /// @details Through the uploader if there is one, over the next frames, see setUploader(). Else waits for the
+        /// decoding and uploads now.
+        void load(std::future<Decoded> decoded);
+        
+        /// @brief Load from an image in memory, with the mipmaps generated by the driver.
+        /// @remarks Prefer the chain of generateMipmaps(), which is gamma-correct and doesn't stall the driver.
+        void load(const Image& image);
+        
+        /// @brief Load from an image in memory with its mipmaps, see uploadMipmaps().
+        void load(const MipChain& chain);
+        
+        void load(const CompressedImage& image);
         
         /// @brief Load as texture of this size with an undefined color
         /// @param internalFormat This function is also the only way to pass a custom argument to the internal
@@ -26,8 +78,27 @@ namespace gl
         /// @brief Load as texture of this size with an uniform color
         void load(glm::ivec2 size, glm::vec4 color);
         
+        /// @remarks Mark the texture as used in this frame for the residency manager.
         static void bind(const Texture *texture);
         
+        /// @brief Set the manager of the textures loaded from files, nullptr for none (the default).
+        /// @remarks The manager must outlive the textures.
+        static void setResidency(TextureResidency *residency);
+        
+        static TextureResidency *getResidency();
+        
+        /// @brief Set the uploader of the textures loaded asynchronously, nullptr for none (the default).
+        /// @remarks The uploader must outlive the textures.
+        static void setUploader(TextureUploader *uploader);
+        
+        static TextureUploader *getUploader();
+        
+        /// @brief Set the directory where the block compressed textures are cached, see CompressedImage::import().
+        /// @param directory Empty to load the textures uncompressed, which is the default.
+        static void setCompressionCacheDirectory(const std::filesystem::path& directory);
+        
+        static const std::filesystem::path& getCompressionCacheDirectory();
+        
         /// @brief Get the size of the texture in pixel.
         glm::vec2 getSize() const;
         
@@ -44,6 +115,15 @@ namespace gl
         void setFilter(Filter filter);
     
     private:
+        friend class TextureUploader;
+        
+        /// @brief Label a texture loaded from a file, and give it to the residency manager.
+        static void track(GLuint texture, Decoded decoded);
+        
         gl::raii::Texture m_texture;
+        
+        static TextureResidency *s_residency;
+        static TextureUploader *s_uploader;
+        static std::filesystem::path s_compressionCacheDirectory;
     };
 }
\ No newline at end of file
@@ -0,0 +1,433 @@
+#include "TextureAtlas.hpp"
+#include "extensions.hpp"
+#include "registry.hpp"
+#include <utility/io.hpp>
+#include <utility/time/Trace.hpp>
+#include <glm/common.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+namespace gl
+{
+    namespace
+    {
+        /// @brief Copy an image into a layer at origin, with a guard band of its opposite edges around it.
+        void copyWrapped(const Image& image, glm::ivec2 origin, int guard, Image& layer)
+        {
+            for(int y = -guard; y < image.size.y + guard; ++y)
+            {
+                const int sy = (y % image.size.y + image.size.y) % image.size.y;
+                
+                for(int x = -guard; x < image.size.x + guard; ++x)
+                {
+                    const int sx = (x % image.size.x + image.size.x) % image.size.x;
+                    const std::size_t target = static_cast<std::size_t>(origin.y + y) * layer.size.x + origin.x + x;
+                    std::memcpy(&layer.pixels[target * 4],
+                                &image.pixels[(static_cast<std::size_t>(sy) * image.size.x + sx) * 4], 4);
+                }
+            }
+        }
+        
+        /// @brief The file of a cached layer.
+        std::filesystem::path getLayerPath(const std::filesystem::path& cachePath, int layer)
+        {
+            return cachePath.string() + "-" + std::to_string(layer) + ".tex";
+        }
+        
+        /// @brief Where the compressed layers of the sources are cached, without the suffix of each layer.
+        /// @returns An empty path if a source file can't be found, the layers are then not cached.
+        std::filesystem::path getCachePath(const std::vector<TextureAtlas::Source>& sources, glm::ivec2 size,
+                                           int layers, const std::filesystem::path& cacheDirectory)
+        {
+            // As CompressedImage::import(): encode again if a source, the layout or the formats supported change
+            std::ostringstream key;
+            key << size.x << 'x' << size.y << 'x' << layers << '\n' << ext::ARB_texture_compression_bptc
+                << ext::EXT_texture_compression_s3tc;
+            
+            for(const TextureAtlas::Source& source : sources)
+            {
+                std::error_code error;
+                const auto bytes = std::filesystem::file_size(source.path, error);
+                const auto time = std::filesystem::last_write_time(source.path, error).time_since_epoch().count();
+                if(error)
+                {
+                    return {};
+                }
+                
+                key << '\n' << std::filesystem::weakly_canonical(source.path).string() << '\n' << bytes << '\n' << time;
+            }
+            
+            std::ostringstream name;
+            name << std::hex << std::setw(16) << std::setfill('0') << io::hash(key.str());
+            return cacheDirectory / name.str();
+        }
+        
+        /// @returns The cached layers, or none if one is missing or they don't match.
+        std::vector<CompressedImage> loadLayers(const std::filesystem::path& cachePath, int layers)
+        {
+            std::vector<CompressedImage> images;
+            
+            for(int layer = 0; layer < layers; ++layer)
+            {
+                images.push_back(CompressedImage::load(getLayerPath(cachePath, layer)));
+                
+                const CompressedImage& image = images.back();
+                if(image.empty() || image.format != images.front().format
+                   || image.levels.size() != images.front().levels.size())
+                {
+                    return {};
+                }
+            }
+            
+            return images;
+        }
+        
+        /// @brief Encode the layers in a common format, and cache them.
+        /// @returns No layer if the context supports no compressed format.
+        std::vector<CompressedImage> encodeLayers(const std::vector<MipChain>& chains,
+                                                  const std::filesystem::path& cachePath)
+        {
+            // The format of the layers with alpha if they differ, see CompressedImage::chooseFormat()
+            GLenum format = 0;
+            for(const MipChain& chain : chains)
+            {
+                const GLenum layerFormat = CompressedImage::chooseFormat(chain[0]);
+                if(format == 0 || layerFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+                {
+                    format = layerFormat;
+                }
+            }
+            
+            if(format == 0)
+            {
+                return {};
+            }
+            
+            std::vector<CompressedImage> images;
+            for(std::size_t layer = 0; layer < chains.size(); ++layer)
+            {
+                images.push_back(CompressedImage::encode(chains[layer], format));
+                images.back().save(getLayerPath(cachePath, static_cast<int>(layer)));
+            }
+            
+            return images;
+        }
+    }
+    
+    void TextureAtlas::layout(const std::vector<Source>& sources, std::vector<Region>& regions,
+                              std::vector<glm::ivec2>& origins)
+    {
+        // The files which failed to decode have no size, they are left out
+        const auto empty = [](const Source& source) {
+            return source.size.x <= 0 || source.size.y <= 0;
+        };
+        
+        const auto first = std::find_if_not(sources.begin(), sources.end(), empty);
+        const bool uniform = std::all_of(sources.begin(), sources.end(), [&](const Source& source) {
+            return empty(source) || source.size == first->size;
+        });
+        
+        m_size = glm::ivec2{0};
+        m_layers = 0;
+        
+        if(first == sources.end())
+        {
+            return;
+        }
+        
+        if(uniform)
+        {
+            // The images of the size of a layer repeat with the wrapping of the texture, with all their mipmaps
+            m_size = first->size;
+            for(std::size_t i = 0; i < sources.size(); ++i)
+            {
+                if(!empty(sources[i]))
+                {
+                    regions[i].layer = m_layers++;
+                }
+            }
+        }
+        else
+        {
+            layoutShelves(sources, regions, origins);
+        }
+    }
+    
+    void TextureAtlas::layoutShelves(const std::vector<Source>& sources, std::vector<Region>& regions,
+                                     std::vector<glm::ivec2>& origins)
+    {
+        // The cells and the layers are multiples of the guard band, so the levels sampled keep the images on whole
+        // texels and the coordinates of the regions stay exact
+        const auto cellSize = [](glm::ivec2 size) {
+            return (size + 3 * GuardBand - 1) / GuardBand * GuardBand;
+        };
+        
+        GLint maxTextureSize = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+        const int maxSize = maxTextureSize / GuardBand * GuardBand;
+        
+        // The tallest cells first, so each shelf wastes little height
+        std::vector<std::size_t> order;
+        double area = 0.0;
+        int widest = 0;
+        
+        for(std::size_t i = 0; i < sources.size(); ++i)
+        {
+            const glm::ivec2 cell = cellSize(sources[i].size);
+            if(sources[i].size.x <= 0 || sources[i].size.y <= 0 || cell.x > maxSize || cell.y > maxSize)
+            {
+                continue;
+            }
+            
+            order.push_back(i);
+            area += static_cast<double>(cell.x) * cell.y;
+            widest = std::max(widest, cell.x);
+        }
+        
+        if(order.empty())
+        {
+            return;
+        }
+        
+        std::stable_sort(order.begin(), order.end(), [&sources](std::size_t a, std::size_t b) {
+            return sources[a].size.y > sources[b].size.y;
+        });
+        
+        // About square if everything fits in one layer, which is then cut to the height of its shelves
+        const int side = static_cast<int>(std::ceil(std::sqrt(area) / GuardBand)) * GuardBand;
+        m_size = glm::ivec2{std::min(std::max(side, widest), maxSize), maxSize};
+        
+        glm::ivec2 shelf{0}; // Corner of the next cell in the current shelf
+        int shelfHeight = 0;
+        int layerCount = 1;
+        int usedHeight = 0;
+        
+        for(std::size_t i : order)
+        {
+            const glm::ivec2 cell = cellSize(sources[i].size);
+            
+            if(shelf.x + cell.x > m_size.x)
+            {
+                shelf = {0, shelf.y + shelfHeight};
+                shelfHeight = 0;
+            }
+            
+            if(shelf.y + cell.y > m_size.y)
+            {
+                shelf = glm::ivec2{0};
+                shelfHeight = 0;
+                ++layerCount;
+            }
+            
+            origins[i] = shelf + GuardBand;
+            regions[i].layer = layerCount - 1;
+            shelf.x += cell.x;
+            shelfHeight = std::max(shelfHeight, cell.y);
+            usedHeight = std::max(usedHeight, shelf.y + shelfHeight);
+        }
+        
+        if(layerCount == 1)
+        {
+            m_size.y = usedHeight;
+        }
+        
+        m_layers = layerCount;
+        
+        // The levels where the guard band is still a texel wide
+        const float maxLod = std::log2(static_cast<float>(GuardBand));
+        
+        for(std::size_t i : order)
+        {
+            const glm::vec2 scale = glm::vec2{sources[i].size} / glm::vec2{m_size};
+            const glm::vec2 offset = glm::vec2{origins[i]} / glm::vec2{m_size};
+            regions[i].transform = glm::vec4{scale.x, scale.y, offset.x, offset.y};
+            regions[i].maxLod = maxLod;
+        }
+    }
+    
+    bool TextureAtlas::fill(const std::vector<Source>& sources, const std::vector<glm::ivec2>& origins,
+                            std::vector<Region>& regions, std::vector<Image>& layers) const
+    {
+        layers.resize(m_layers);
+        for(Image& layer : layers)
+        {
+            layer.size = m_size;
+            layer.pixels.resize(static_cast<std::size_t>(m_size.x) * m_size.y * 4);
+        }
+        
+        bool success = true;
+        
+        for(std::size_t i = 0; i < sources.size(); ++i)
+        {
+            if(regions[i].layer < 0)
+            {
+                continue;
+            }
+            
+            Image decoded;
+            const Image *image = sources[i].image;
+            if(!image)
+            {
+                decoded = Image::decode(sources[i].path);
+                image = &decoded;
+            }
+            
+            if(image->size != sources[i].size)
+            {
+                regions[i] = {};
+                success = false;
+                continue;
+            }
+            
+            // The uniform layers have no guard band, the wrapping of the texture repeats them
+            const bool uniform = image->size == m_size;
+            copyWrapped(*image, origins[i], uniform ? 0 : GuardBand, layers[regions[i].layer]);
+        }
+        
+        return success;
+    }
+    
+    std::vector<TextureAtlas::Region> TextureAtlas::pack(const std::vector<Source>& sources, const std::string& label,
+                                                        const std::filesystem::path& cacheDirectory)
+    {
+        trace::Scope scope{"TextureAtlas::pack", "asset"};
+        
+        std::vector<Region> regions(sources.size());
+        std::vector<glm::ivec2> origins(sources.size(), glm::ivec2{0});
+        layout(sources, regions, origins);
+        
+        if(m_layers == 0)
+        {
+            return regions;
+        }
+        
+        std::filesystem::path cachePath;
+        if(!cacheDirectory.empty() && (ext::ARB_texture_compression_bptc || ext::EXT_texture_compression_s3tc))
+        {
+            cachePath = getCachePath(sources, m_size, m_layers, cacheDirectory);
+        }
+        
+        // The cached layers need neither the images nor the encoding
+        std::vector<CompressedImage> compressed;
+        if(!cachePath.empty())
+        {
+            compressed = loadLayers(cachePath, m_layers);
+        }
+        
+        std::vector<MipChain> chains;
+        if(compressed.empty())
+        {
+            std::vector<Image> layers;
+            
+            // A layer missing an image is not cached, the next launch tries to decode it again
+            if(!fill(sources, origins, regions, layers))
+            {
+                cachePath.clear();
+            }
+            
+            for(Image& layer : layers)
+            {
+                chains.push_back(generateMipmaps(std::move(layer)));
+            }
+            
+            if(!cachePath.empty())
+            {
+                compressed = encodeLayers(chains, cachePath);
+            }
+        }
+        
+        GLint previous = 0;
+        glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &previous);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, m_texture);
+        
+        if(!compressed.empty())
+        {
+            upload(compressed);
+        }
+        else
+        {
+            upload(chains);
+        }
+        
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, previous);
+        
+        const GLenum format = compressed.empty() ? GL_RGBA8 : compressed.front().format;
+        registry::setImageStorage(registry::Type::Texture, m_texture, format, {m_size, m_layers}, 0);
+        registry::setLabel(registry::Type::Texture, m_texture, label + " atlas");
+        
+        return regions;
+    }
+    
+    void TextureAtlas::upload(const std::vector<MipChain>& layers) const
+    {
+        // As uploadMipmaps(): if the chain doesn't go down to 1x1, the driver generates the levels
+        const bool complete = layers[0].back().size == glm::ivec2{1};
+        const int levels = complete ? static_cast<int>(layers[0].size()) : 1;
+        
+        for(int level = 0; level < levels; ++level)
+        {
+            const glm::ivec2 size = layers[0][level].size;
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, size.x, size.y, m_layers, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                         nullptr);
+            
+            for(int layer = 0; layer < m_layers; ++layer)
+            {
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, size.x, size.y, 1, GL_RGBA, GL_UNSIGNED_BYTE,
+                                layers[layer][level].pixels.data());
+            }
+        }
+        
+        if(!complete)
+        {
+            glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        }
+    }
+    
+    void TextureAtlas::upload(const std::vector<CompressedImage>& layers) const
+    {
+        // The blocks of a level are specified for all the layers at once, one layer after the other
+        std::vector<unsigned char> data;
+        
+        for(std::size_t level = 0; level < layers[0].levels.size(); ++level)
+        {
+            data.clear();
+            for(const CompressedImage& layer : layers)
+            {
+                data.insert(data.end(), layer.levels[level].data.begin(), layer.levels[level].data.end());
+            }
+            
+            const glm::ivec2 size = layers[0].levels[level].size;
+            glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, static_cast<GLint>(level), layers[0].format, size.x, size.y,
+                                   m_layers, 0, static_cast<GLsizei>(data.size()), data.data());
+        }
+    }
+    
+    void TextureAtlas::bind() const
+    {
+        glActiveTexture(GL_TEXTURE0 + TextureUnit);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, m_texture);
+        glActiveTexture(GL_TEXTURE0);
+    }
+    
+    bool TextureAtlas::empty() const
+    {
+        return m_layers == 0;
+    }
+    
+    int TextureAtlas::getLayerCount() const
+    {
+        return m_layers;
+    }
+    
+    glm::ivec2 TextureAtlas::getSize() const
+    {
+        return m_size;
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "gl.hpp"
+#include "Image.hpp"
+#include "Mipmaps.hpp"
+#include "CompressedImage.hpp"
+#include <glm/vec4.hpp>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace gl
+{
+    /// @brief Images packed into the layers of a GL_TEXTURE_2D_ARRAY, so the meshes using them share a single bind.
+    /// @details
+    /// If all the images have the same size, each gets a layer of that size: they repeat with the wrapping of the
+    /// texture and have all their mipmaps. Else they are packed in cells on shelves, the tallest first, across as few
+    /// layers as possible: the layers are sized from the cells, about square and cut to the height of their shelves
+    /// when they all fit in one, else of GL_MAX_TEXTURE_SIZE. Each cell has a guard band of GuardBand texels on each
+    /// side, filled with the opposite edges of the image, so the bilinear filtering repeats the image without bleeding
+    /// into its neighbors. The levels coarser than the guard band would mix the cells, so they are not sampled for
+    /// the packed images.
+    /// With a cache directory, the layers are block compressed once packed, like CompressedImage::import(), and cached
+    /// there: the next launches load them without decoding nor packing the images, only their sizes are needed.
+    /// The sampling is in assets/atlas.glsl.
+    ///     const std::vector<gl::TextureAtlas::Region> regions = atlas.pack(sources, "Model", cacheDirectory);
+    ///     atlas.bind();
+    ///     // For each mesh, send the region of its image
+    class TextureAtlas
+    {
+    public:
+        /// @brief Texture unit of the array, bound by bind().
+        static constexpr int TextureUnit = 5;
+        
+        /// @brief Texels around each packed image.
+        static constexpr int GuardBand = 8;
+        
+        /// @brief Where an image is in the atlas.
+        struct Region
+        {
+            int layer{-1}; ///< -1 if the image is not in the atlas
+            glm::vec4 transform{1, 1, 0, 0}; ///< Scale then offset, from the coordinates of the image to the layer
+            float maxLod{1000.0f}; ///< Coarsest level without the neighbor cells
+        };
+        
+        /// @brief An image file to pack.
+        struct Source
+        {
+            std::filesystem::path path; ///< Decoded if image is null and the layers are not cached
+            glm::ivec2 size{0};
+            const Image *image{nullptr}; ///< Already decoded, at full resolution
+        };
+        
+        /// @brief Pack the images into a new texture array, with their mipmaps.
+        /// @param label Of the texture, for the debuggers and the registry.
+        /// @param cacheDirectory Where to cache the block compressed layers. If empty, or if the context supports no
+        /// compressed format, the layers are RGBA8.
+        /// @returns The region of each image. The images which don't fit in a layer with their guard band, or which
+        /// can't be decoded, are not packed (layer -1), they need their own texture.
+        /// @remarks The mipmaps of the layers are generated on the CPU, see generateMipmaps().
+        std::vector<Region> pack(const std::vector<Source>& sources, const std::string& label,
+                                 const std::filesystem::path& cacheDirectory = {});
+        
+        /// @brief Bind the array on its unit.
+        void bind() const;
+        
+        /// @brief If nothing is packed.
+        bool empty() const;
+        
+        int getLayerCount() const;
+        
+        /// @brief Size of a layer, in texels.
+        glm::ivec2 getSize() const;
+    
+    private:
+        /// @brief Place the images in the layers, and set the size and the count of the layers.
+        /// @param origins Set to the corner of each image in its layer.
+        void layout(const std::vector<Source>& sources, std::vector<Region>& regions, std::vector<glm::ivec2>& origins);
+        
+        /// @brief Place images of different sizes on shelves, see layout().
+        void layoutShelves(const std::vector<Source>& sources, std::vector<Region>& regions,
+                           std::vector<glm::ivec2>& origins);
+        
+        /// @brief Copy the images into their layers, decoding the ones not decoded yet.
+        /// @returns false if an image can't be decoded, its region is then reset.
+        bool fill(const std::vector<Source>& sources, const std::vector<glm::ivec2>& origins,
+                  std::vector<Region>& regions, std::vector<Image>& layers) const;
+        
+        /// @name
+        /// @brief Specify the levels of the array bound, from the layers with their mipmaps.
+        /// @{
+        void upload(const std::vector<MipChain>& layers) const;
+        void upload(const std::vector<CompressedImage>& layers) const;
+        /// @}
+        
+        raii::Texture m_texture;
+        glm::ivec2 m_size{0};
+        int m_layers{0};
+    };
+}
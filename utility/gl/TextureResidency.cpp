@@ -0,0 +1,398 @@
+#include "TextureResidency.hpp"
+#include "registry.hpp"
+#include "CompressedImage.hpp"
+#include <utility/time/Trace.hpp>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+namespace gl
+{
+    TextureResidency::TextureResidency(std::size_t budget, std::size_t cacheBudget)
+        : m_budget{budget}, m_cacheBudget{cacheBudget}
+    {
+    }
+    
+    void TextureResidency::setBudget(std::size_t budget)
+    {
+        m_budget = budget;
+    }
+    
+    std::size_t TextureResidency::getBudget() const
+    {
+        return m_budget;
+    }
+    
+    void TextureResidency::add(GLuint texture, const std::filesystem::path& source, MipChain chain,
+                               ColorSpace colorSpace)
+    {
+        remove(texture);
+        
+        Entry entry;
+        entry.source = source;
+        entry.colorSpace = colorSpace;
+        entry.size = chain[0].size;
+        entry.lastUsed = m_frame;
+        entry.levels = registry::getMipmapLevels({entry.size, 1});
+        entry.bytes = getBytes(entry, 0, false);
+        
+        m_bytes += entry.bytes;
+        m_entries.emplace(texture, std::move(entry));
+        
+        cache(texture, std::move(chain));
+    }
+    
+    void TextureResidency::add(GLuint texture, const std::filesystem::path& source, const CompressedImage& image,
+                               ColorSpace colorSpace)
+    {
+        remove(texture);
+        
+        Entry entry;
+        entry.source = source;
+        entry.colorSpace = colorSpace;
+        entry.size = image.levels[0].size;
+        entry.format = image.format;
+        entry.lastUsed = m_frame;
+        entry.levels = registry::getMipmapLevels({entry.size, 1});
+        entry.bytes = getBytes(entry, 0, false);
+        
+        m_bytes += entry.bytes;
+        m_entries.emplace(texture, std::move(entry));
+    }
+    
+    void TextureResidency::remove(GLuint texture)
+    {
+        auto it = m_entries.find(texture);
+        if(it != m_entries.end())
+        {
+            m_bytes -= it->second.bytes;
+            m_entries.erase(it);
+        }
+        
+        auto cached = m_cache.find(texture);
+        if(cached != m_cache.end())
+        {
+            m_cacheBytes -= getBytes(cached->second.chain);
+            m_cache.erase(cached);
+        }
+    }
+    
+    void TextureResidency::use(GLuint texture)
+    {
+        auto it = m_entries.find(texture);
+        if(it != m_entries.end())
+        {
+            it->second.lastUsed = m_frame;
+        }
+    }
+    
+    void TextureResidency::update()
+    {
+        // Memory which can be freed by evicting the textures not used in this frame
+        std::size_t freeable = 0;
+        std::vector<GLuint> restores;
+        
+        for(const auto& [texture, entry] : m_entries)
+        {
+            if(entry.lastUsed != m_frame)
+            {
+                freeable += entry.bytes - getBytes(entry, 0, true);
+            }
+            else if(entry.dropped > 0 || entry.evicted)
+            {
+                restores.push_back(texture);
+            }
+        }
+        
+        // The smallest first, they are the fastest to restore
+        std::sort(restores.begin(), restores.end(), [this](GLuint a, GLuint b) {
+            return getBytes(m_entries[a], 0, false) < getBytes(m_entries[b], 0, false);
+        });
+        
+        const std::size_t available = m_budget + freeable;
+        int restored = 0;
+        
+        for(GLuint texture : restores)
+        {
+            if(restored >= maxRestoresPerFrame)
+            {
+                break;
+            }
+            
+            Entry& entry = m_entries[texture];
+            const int current = entry.evicted ? getMaxDropped(entry) + 1 : entry.dropped;
+            
+            // The best resolution fitting in the budget, once the unused textures are evicted
+            for(int dropped = 0; dropped < current; ++dropped)
+            {
+                if(m_bytes - entry.bytes + getBytes(entry, dropped, false) <= available)
+                {
+                    upload(texture, entry, dropped, false);
+                    restored++;
+                    break;
+                }
+            }
+        }
+        
+        enforceBudget();
+        
+        m_frame++;
+    }
+    
+    void TextureResidency::enforceBudget()
+    {
+        if(m_bytes <= m_budget)
+        {
+            return;
+        }
+        
+        // Least recently used first, then the largest first
+        std::vector<GLuint> order;
+        order.reserve(m_entries.size());
+        for(const auto& [texture, entry] : m_entries)
+        {
+            order.push_back(texture);
+        }
+        
+        std::sort(order.begin(), order.end(), [this](GLuint a, GLuint b) {
+            const Entry& lhs = m_entries[a];
+            const Entry& rhs = m_entries[b];
+            return lhs.lastUsed != rhs.lastUsed ? lhs.lastUsed < rhs.lastUsed : lhs.bytes > rhs.bytes;
+        });
+        
+        for(GLuint texture : order)
+        {
+            if(m_bytes <= m_budget)
+            {
+                break;
+            }
+            
+            Entry& entry = m_entries[texture];
+            if(entry.evicted)
+            {
+                continue;
+            }
+            
+            // The least levels dropped freeing enough memory
+            const std::size_t excess = m_bytes - m_budget;
+            const int maxDropped = getMaxDropped(entry);
+            
+            int dropped = entry.dropped;
+            while(dropped < maxDropped && entry.bytes - getBytes(entry, dropped, false) < excess)
+            {
+                dropped++;
+            }
+            
+            const bool enough = entry.bytes - getBytes(entry, dropped, false) >= excess;
+            const bool used = entry.lastUsed == m_frame;
+            
+            if(!enough && !used)
+            {
+                upload(texture, entry, maxDropped, true);
+            }
+            else if(dropped != entry.dropped)
+            {
+                upload(texture, entry, dropped, false);
+            }
+        }
+    }
+    
+    TextureResidency::Stats TextureResidency::getStats() const
+    {
+        Stats stats;
+        stats.textures = m_entries.size();
+        stats.bytes = m_bytes;
+        stats.cacheBytes = m_cacheBytes;
+        
+        for(const auto& [texture, entry] : m_entries)
+        {
+            if(entry.evicted)
+            {
+                stats.evicted++;
+            }
+            else if(entry.dropped > 0)
+            {
+                stats.reduced++;
+            }
+        }
+        
+        return stats;
+    }
+    
+    std::size_t TextureResidency::getBytes(const Entry& entry, int dropped, bool evicted)
+    {
+        if(evicted)
+        {
+            return getBytes(entry.format, {1, 1});
+        }
+        
+        return getBytes(entry.format, glm::max(glm::ivec2{entry.size.x >> dropped, entry.size.y >> dropped}, 1));
+    }
+    
+    std::size_t TextureResidency::getBytes(GLenum format, glm::ivec2 size)
+    {
+        std::size_t bytes = 0;
+        for(;; size = glm::max(size / 2, 1))
+        {
+            bytes += registry::getImageBytes(format, size);
+            
+            if(size == glm::ivec2{1})
+            {
+                return bytes;
+            }
+        }
+    }
+    
+    int TextureResidency::getMaxDropped(const Entry& entry)
+    {
+        int dropped = 0;
+        
+        while((std::max(entry.size.x, entry.size.y) >> (dropped + 1)) >= MinSize)
+        {
+            dropped++;
+        }
+        
+        return dropped;
+    }
+    
+    void TextureResidency::upload(GLuint texture, Entry& entry, int dropped, bool evicted)
+    {
+        trace::Scope scope{"TextureResidency::upload", "asset"};
+        
+        // Not Texture::bind(), which would mark the texture as used
+        GLint previous = 0;
+        glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        
+        // Not clamped while uploading, glGenerateMipmap() of an incomplete chain fills all the levels
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 1000);
+        
+        const bool compressed = entry.format != GL_RGBA;
+        const glm::ivec2 size = compressed ? uploadCompressed(dropped, evicted, entry)
+                                           : uploadImage(texture, dropped, evicted, entry);
+        
+        // Both chains go down to 1x1, the levels past it keep their previous storage until they are released
+        const int levels = size == glm::ivec2{0} ? entry.levels : registry::getMipmapLevels({size, 1});
+        for(int level = levels; level < entry.levels; ++level)
+        {
+            glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        }
+        
+        // The released levels are empty, the texture would be incomplete if it sampled them
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        
+        glBindTexture(GL_TEXTURE_2D, previous);
+        
+        if(size == glm::ivec2{0})
+        {
+            return;
+        }
+        
+        registry::setImageStorage(registry::Type::Texture, texture, entry.format, {size, 1}, 0);
+        
+        // What is allocated now: the chain from the size uploaded, which may differ from the requested one
+        const std::size_t bytes = getBytes(entry.format, size);
+        m_bytes = m_bytes - entry.bytes + bytes;
+        entry.bytes = bytes;
+        entry.dropped = dropped;
+        entry.evicted = evicted;
+        entry.levels = levels;
+    }
+    
+    glm::ivec2 TextureResidency::uploadImage(GLuint texture, int dropped, bool evicted, const Entry& entry)
+    {
+        MipChain decoded;
+        const MipChain *chain = nullptr;
+        
+        auto cached = m_cache.find(texture);
+        if(cached != m_cache.end())
+        {
+            cached->second.lastUsed = m_frame;
+            chain = &cached->second.chain;
+        }
+        else
+        {
+            decoded = generateMipmaps(Image::decode(entry.source), entry.colorSpace);
+            if(decoded.empty())
+            {
+                return glm::ivec2{0};
+            }
+            
+            chain = &decoded;
+        }
+        
+        // Evicted textures keep only their average color, the last level
+        const int level = evicted ? static_cast<int>(chain->size()) - 1 : std::min<int>(dropped, chain->size() - 1);
+        uploadMipmaps(*chain, level);
+        
+        const glm::ivec2 size = (*chain)[level].size;
+        
+        if(!decoded.empty())
+        {
+            cache(texture, std::move(decoded));
+        }
+        
+        return size;
+    }
+    
+    glm::ivec2 TextureResidency::uploadCompressed(int dropped, bool evicted, const Entry& entry)
+    {
+        const CompressedImage image = CompressedImage::import(entry.source, Texture::getCompressionCacheDirectory(),
+                                                              entry.colorSpace);
+        if(image.empty())
+        {
+            return glm::ivec2{0};
+        }
+        
+        // The last level is 1x1, the average color
+        const int level = evicted ? static_cast<int>(image.levels.size()) - 1 : dropped;
+        image.upload(level);
+        
+        return image.levels[std::min<std::size_t>(level, image.levels.size() - 1)].size;
+    }
+    
+    void TextureResidency::cache(GLuint texture, MipChain chain)
+    {
+        const std::size_t bytes = getBytes(chain);
+        if(bytes > m_cacheBudget)
+        {
+            return;
+        }
+        
+        auto previous = m_cache.find(texture);
+        if(previous != m_cache.end())
+        {
+            m_cacheBytes -= getBytes(previous->second.chain);
+        }
+        
+        m_cacheBytes += bytes;
+        m_cache[texture] = {std::move(chain), m_frame};
+        
+        // Evict the least recently used chains, except the new one
+        while(m_cacheBytes > m_cacheBudget)
+        {
+            auto oldest = m_cache.end();
+            for(auto it = m_cache.begin(); it != m_cache.end(); ++it)
+            {
+                if(it->first != texture && (oldest == m_cache.end() || it->second.lastUsed < oldest->second.lastUsed))
+                {
+                    oldest = it;
+                }
+            }
+            
+            m_cacheBytes -= getBytes(oldest->second.chain);
+            m_cache.erase(oldest);
+        }
+    }
+    
+    std::size_t TextureResidency::getBytes(const MipChain& chain)
+    {
+        std::size_t bytes = 0;
+        for(const Image& image : chain)
+        {
+            bytes += image.getBytes();
+        }
+        
+        return bytes;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "Texture.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <unordered_map>
+
+namespace gl
+{
+    /// @brief Keep the textures loaded from files in a memory budget, reducing the ones not used recently.
+    /// @details
+    /// Each frame, the textures bound are marked as used (Texture::bind()). At the end of the frame, update():
+    /// - Restores the textures used this frame which were reduced, at the best resolution fitting in the budget.
+    /// - If the budget is exceeded, reduces the least recently used textures: first by dropping their largest
+    ///   mipmap levels, down to MinSize, then by evicting them (replaced by a 1x1 texture of their average color).
+    /// The textures used this frame are only reduced down to MinSize, never evicted.
+    /// The images are restored from a CPU cache of the mipmaps, with its own budget, else decoded again.
+    /// The block compressed textures are restored from their cached file instead, which has all their levels.
+    ///     gl::TextureResidency residency{256 << 20};
+    ///     gl::Texture::setResidency(&residency);
+    ///     // Load the textures, then each frame:
+    ///     residency.update();
+    /// @remarks The textures keep their OpenGL name, only their storage changes.
+    class TextureResidency
+    {
+    public:
+        /// @brief Width or height of the smallest reduced texture, before evicting it.
+        static constexpr int MinSize = 32;
+        
+        struct Stats
+        {
+            std::size_t textures{0};
+            std::size_t reduced{0}; ///< Without their full resolution, but not evicted
+            std::size_t evicted{0};
+            std::size_t bytes{0}; ///< Estimated memory of the managed textures, with their mipmaps
+            std::size_t cacheBytes{0}; ///< Memory of the CPU cache
+        };
+        
+        /// @param budget Memory of the managed textures, in bytes.
+        /// @param cacheBudget Memory of the mipmaps kept on the CPU, 0 to always decode the files again.
+        explicit TextureResidency(std::size_t budget, std::size_t cacheBudget = 0);
+        
+        void setBudget(std::size_t budget);
+        std::size_t getBudget() const;
+        
+        /// @brief Count of textures restored per update() at most, to spread the decoding over the frames.
+        int maxRestoresPerFrame{2};
+        
+        /// @brief Manage a texture, loaded at full resolution.
+        /// @param chain The decoded file with its mipmaps, cached if it fits in the cache.
+        /// @param colorSpace Of the file, to generate the mipmaps again when it is decoded again.
+        void add(GLuint texture, const std::filesystem::path& source, MipChain chain,
+                 ColorSpace colorSpace = ColorSpace::Srgb);
+        
+        /// @brief Manage a block compressed texture, loaded at full resolution.
+        void add(GLuint texture, const std::filesystem::path& source, const CompressedImage& image,
+                 ColorSpace colorSpace = ColorSpace::Srgb);
+        
+        void remove(GLuint texture);
+        
+        /// @brief Mark a texture as used in this frame.
+        /// @remarks Ignored if the texture is not managed.
+        void use(GLuint texture);
+        
+        /// @brief End the frame: restore the textures used, then enforce the budget.
+        void update();
+        
+        Stats getStats() const;
+        
+    private:
+        struct Entry
+        {
+            std::filesystem::path source;
+            glm::ivec2 size{0}; ///< Full resolution
+            GLenum format{GL_RGBA}; ///< GL_RGBA, or the block compressed format
+            ColorSpace colorSpace{ColorSpace::Srgb};
+            int dropped{0}; ///< Count of largest mipmap levels not resident
+            int levels{1}; ///< Specified in the texture object, the ones past a smaller chain are released
+            bool evicted{false};
+            std::uint64_t lastUsed{0};
+            std::size_t bytes{0};
+        };
+        
+        /// @returns Memory of a texture at this resolution, with its mipmaps.
+        static std::size_t getBytes(const Entry& entry, int dropped, bool evicted);
+        
+        /// @returns Memory of a chain from this size down to 1x1.
+        static std::size_t getBytes(GLenum format, glm::ivec2 size);
+        
+        /// @returns The most levels which can be dropped before reaching MinSize.
+        static int getMaxDropped(const Entry& entry);
+        
+        /// @brief Upload the texture at a new resolution.
+        void upload(GLuint texture, Entry& entry, int dropped, bool evicted);
+        
+        /// @brief Upload an RGBA texture, from the cached mipmaps or the source.
+        /// @returns The size uploaded, 0 if the source can't be decoded.
+        glm::ivec2 uploadImage(GLuint texture, int dropped, bool evicted, const Entry& entry);
+        
+        /// @brief Upload a block compressed texture, from its cached file.
+        /// @returns The size uploaded, 0 if the file can't be read.
+        glm::ivec2 uploadCompressed(int dropped, bool evicted, const Entry& entry);
+        
+        /// @brief Reduce the least recently used textures until the budget is respected, if possible.
+        void enforceBudget();
+        
+        void cache(GLuint texture, MipChain chain);
+        
+        static std::size_t getBytes(const MipChain& chain);
+        
+        std::unordered_map<GLuint, Entry> m_entries;
+        std::uint64_t m_frame{1};
+        std::size_t m_budget;
+        std::size_t m_bytes{0};
+        
+        struct CachedChain
+        {
+            MipChain chain;
+            std::uint64_t lastUsed{0};
+        };
+        
+        std::unordered_map<GLuint, CachedChain> m_cache;
+        std::size_t m_cacheBudget;
+        std::size_t m_cacheBytes{0};
+    };
+}
@@ -0,0 +1,504 @@
+#include "TextureUploader.hpp"
+#include "registry.hpp"
+#include <utility/ThreadPool.hpp>
+#include <utility/time/Trace.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+namespace gl
+{
+    namespace
+    {
+        /// @brief Levels uploaded: all of them, or only the first of an incomplete chain, see uploadMipmaps().
+        int getLevelCount(const Texture::Decoded& decoded)
+        {
+            if(!decoded.compressed.empty())
+            {
+                return static_cast<int>(decoded.compressed.levels.size());
+            }
+            
+            return decoded.mipmaps.back().size == glm::ivec2{1} ? static_cast<int>(decoded.mipmaps.size()) : 1;
+        }
+        
+        glm::ivec2 getLevelSize(const Texture::Decoded& decoded, int level)
+        {
+            return decoded.compressed.empty() ? decoded.mipmaps[level].size : decoded.compressed.levels[level].size;
+        }
+        
+        const std::vector<unsigned char>& getLevelData(const Texture::Decoded& decoded, int level)
+        {
+            return decoded.compressed.empty() ? decoded.mipmaps[level].pixels : decoded.compressed.levels[level].data;
+        }
+        
+        /// @brief Rows of a level, in blocks of 4 rows for the compressed formats.
+        int getRowCount(const Texture::Decoded& decoded, int level)
+        {
+            const int height = getLevelSize(decoded, level).y;
+            return decoded.compressed.empty() ? height : (height + 3) / 4;
+        }
+    }
+    
+    TextureUploader::TextureUploader(std::size_t bytesPerFrame)
+        : bytesPerFrame{bytesPerFrame}, maxStagingBytes{4 * bytesPerFrame}
+    {
+    }
+    
+    TextureUploader::~TextureUploader()
+    {
+        for(Job& job : m_jobs)
+        {
+            release(job);
+        }
+    }
+    
+    void TextureUploader::load(GLuint texture, std::future<Texture::Decoded> decoded)
+    {
+        cancel(texture);
+        
+        Job& job = m_jobs.emplace_back();
+        job.texture = texture;
+        job.decoding = std::move(decoded);
+    }
+    
+    void TextureUploader::cancel(GLuint texture)
+    {
+        auto it = std::find_if(m_jobs.begin(), m_jobs.end(), [texture](const Job& job) {
+            return job.texture == texture;
+        });
+        
+        if(it != m_jobs.end())
+        {
+            // The uploads already issued may still read the buffer
+            if(it->uploading)
+            {
+                it->buffer->fence.set();
+            }
+            
+            release(*it);
+            m_jobs.erase(it);
+        }
+    }
+    
+    void TextureUploader::update()
+    {
+        trace::Scope scope{"TextureUploader::update", "asset"};
+        
+        m_uploadedBytes = 0;
+        
+        // In the order of the loads, so a texture is not starved by the ones loaded after it
+        bool staging = true;
+        for(auto it = m_jobs.begin(); it != m_jobs.end();)
+        {
+            Job& job = *it;
+            
+            if(job.decoding.valid())
+            {
+                if(job.decoding.wait_for(std::chrono::seconds{0}) != std::future_status::ready)
+                {
+                    ++it;
+                    continue;
+                }
+                
+                job.decoded = job.decoding.get();
+                
+                // Failed to decode, already logged
+                if(job.decoded.compressed.empty() && job.decoded.mipmaps.empty())
+                {
+                    it = m_jobs.erase(it);
+                    continue;
+                }
+                
+                job.offsets.clear();
+                job.bytes = 0;
+                for(int level = 0; level < getLevelCount(job.decoded); ++level)
+                {
+                    job.offsets.push_back(job.bytes);
+                    job.bytes += getLevelData(job.decoded, level).size();
+                }
+            }
+            
+            if(!job.buffer)
+            {
+                // A texture larger than the staging memory still goes alone
+                const std::size_t stagingBytes = getStagingBytes();
+                staging = staging && (stagingBytes == 0 || stagingBytes + job.bytes <= maxStagingBytes);
+                
+                if(!staging)
+                {
+                    ++it;
+                    continue;
+                }
+                
+                start(job);
+                
+                if(!job.buffer)
+                {
+                    it = m_jobs.erase(it);
+                    continue;
+                }
+            }
+            
+            if(!job.uploading)
+            {
+                if(job.copying.wait_for(std::chrono::seconds{0}) != std::future_status::ready)
+                {
+                    ++it;
+                    continue;
+                }
+                
+                job.copying.get();
+                allocate(job);
+            }
+            
+            if(m_uploadedBytes >= bytesPerFrame)
+            {
+                ++it;
+                continue;
+            }
+            
+            m_uploadedBytes += upload(job, bytesPerFrame - m_uploadedBytes);
+            
+            if(job.level < 0)
+            {
+                complete(job);
+                it = m_jobs.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        
+        trim();
+    }
+    
+    void TextureUploader::finish()
+    {
+        trace::Scope scope{"TextureUploader::finish", "asset"};
+        
+        const std::size_t budget = bytesPerFrame;
+        const std::size_t staging = maxStagingBytes;
+        bytesPerFrame = std::numeric_limits<std::size_t>::max();
+        maxStagingBytes = std::numeric_limits<std::size_t>::max();
+        
+        while(!m_jobs.empty())
+        {
+            for(Job& job : m_jobs)
+            {
+                if(job.decoding.valid())
+                {
+                    job.decoding.wait();
+                }
+                else if(job.copying.valid())
+                {
+                    job.copying.wait();
+                }
+            }
+            
+            update();
+        }
+        
+        bytesPerFrame = budget;
+        maxStagingBytes = staging;
+    }
+    
+    bool TextureUploader::isIdle() const
+    {
+        return m_jobs.empty();
+    }
+    
+    TextureUploader::Stats TextureUploader::getStats() const
+    {
+        Stats stats;
+        
+        for(const Job& job : m_jobs)
+        {
+            if(job.uploading)
+            {
+                stats.uploading++;
+            }
+            else if(job.buffer)
+            {
+                stats.copying++;
+            }
+            else
+            {
+                stats.decoding++;
+            }
+        }
+        
+        for(const Buffer& buffer : m_buffers)
+        {
+            stats.buffers++;
+            stats.bufferBytes += buffer.capacity;
+        }
+        
+        stats.uploadedBytes = m_uploadedBytes;
+        stats.uploaded = m_uploaded;
+        
+        return stats;
+    }
+    
+    void TextureUploader::start(Job& job)
+    {
+        Buffer& buffer = acquire(job.bytes);
+        
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.pbo);
+        void *mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, static_cast<GLsizeiptr>(job.bytes),
+                                        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        
+        if(!mapped)
+        {
+            std::cerr << "Failed to map a pixel buffer of " << job.bytes << " bytes for "
+                      << job.decoded.path.filename() << std::endl;
+            buffer.used = false;
+            return;
+        }
+        
+        job.buffer = &buffer;
+        
+        // The decoded levels are kept for the residency cache, so they are copied rather than decoded in place.
+        // The job is in a list, it doesn't move, and is only erased once the copy is done
+        auto *data = static_cast<unsigned char *>(mapped);
+        job.copying = ThreadPool::global().submit([&job, data] {
+            trace::Scope scope{"TextureUploader::copy", "asset"};
+            
+            for(int level = 0; level < static_cast<int>(job.offsets.size()); ++level)
+            {
+                const std::vector<unsigned char>& levelData = getLevelData(job.decoded, level);
+                std::memcpy(data + job.offsets[level], levelData.data(), levelData.size());
+            }
+        });
+    }
+    
+    void TextureUploader::allocate(Job& job)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, job.buffer->pbo);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        
+        GLint previous = 0;
+        glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous);
+        glBindTexture(GL_TEXTURE_2D, job.texture);
+        
+        // Without a pixel buffer bound, so nullptr is no data
+        const int levels = static_cast<int>(job.offsets.size());
+        const CompressedImage& compressed = job.decoded.compressed;
+        for(int level = 0; level < levels; ++level)
+        {
+            const glm::ivec2 size = getLevelSize(job.decoded, level);
+            
+            if(compressed.empty())
+            {
+                glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, size.x, size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            }
+            else
+            {
+                glCompressedTexImage2D(GL_TEXTURE_2D, level, compressed.format, size.x, size.y, 0,
+                                       static_cast<GLsizei>(compressed.levels[level].data.size()), nullptr);
+            }
+        }
+        
+        // Only the levels uploaded are sampled, the smallest is uploaded first
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, levels - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        glBindTexture(GL_TEXTURE_2D, previous);
+        
+        const GLenum format = compressed.empty() ? GL_RGBA : compressed.format;
+        registry::setImageStorage(registry::Type::Texture, job.texture, format, {getLevelSize(job.decoded, 0), 1}, 0);
+        
+        job.uploading = true;
+        job.level = levels - 1;
+        job.row = 0;
+    }
+    
+    std::size_t TextureUploader::upload(Job& job, std::size_t budget)
+    {
+        GLint previous = 0;
+        glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous);
+        glBindTexture(GL_TEXTURE_2D, job.texture);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, job.buffer->pbo);
+        
+        const CompressedImage& compressed = job.decoded.compressed;
+        std::size_t uploaded = 0;
+        
+        while(job.level >= 0)
+        {
+            const glm::ivec2 size = getLevelSize(job.decoded, job.level);
+            const int rows = getRowCount(job.decoded, job.level);
+            const std::size_t rowBytes = getLevelData(job.decoded, job.level).size() / rows;
+            
+            // At least a row, else the largest band fitting in what is left of the budget
+            const std::size_t fitting = (budget - uploaded) / rowBytes;
+            if(fitting == 0 && uploaded > 0)
+            {
+                break;
+            }
+            
+            const int count = static_cast<int>(std::clamp<std::size_t>(fitting, 1, rows - job.row));
+            const auto *offset = reinterpret_cast<const void *>(job.offsets[job.level] + job.row * rowBytes);
+            
+            if(compressed.empty())
+            {
+                glTexSubImage2D(GL_TEXTURE_2D, job.level, 0, job.row, size.x, count, GL_RGBA, GL_UNSIGNED_BYTE, offset);
+            }
+            else
+            {
+                // The blocks of the last row may be partially outside of the level
+                const int y = 4 * job.row;
+                glCompressedTexSubImage2D(GL_TEXTURE_2D, job.level, 0, y, size.x, std::min(4 * count, size.y - y),
+                                          compressed.format, static_cast<GLsizei>(count * rowBytes), offset);
+            }
+            
+            uploaded += count * rowBytes;
+            job.row += count;
+            
+            if(job.row == rows)
+            {
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, job.level);
+                job.level--;
+                job.row = 0;
+            }
+        }
+        
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glBindTexture(GL_TEXTURE_2D, previous);
+        
+        return uploaded;
+    }
+    
+    void TextureUploader::complete(Job& job)
+    {
+        GLint previous = 0;
+        glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous);
+        glBindTexture(GL_TEXTURE_2D, job.texture);
+        
+        // Back to the default, as the textures loaded directly
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 1000);
+        
+        // Only the first level of an incomplete chain was uploaded
+        if(job.decoded.compressed.empty() && job.decoded.mipmaps.back().size != glm::ivec2{1})
+        {
+            glGenerateMipmap(GL_TEXTURE_2D);
+        }
+        
+        glBindTexture(GL_TEXTURE_2D, previous);
+        
+        job.buffer->fence.set();
+        release(job);
+        
+        Texture::track(job.texture, std::move(job.decoded));
+        m_uploaded++;
+    }
+    
+    void TextureUploader::release(Job& job)
+    {
+        if(!job.buffer)
+        {
+            return;
+        }
+        
+        if(!job.uploading)
+        {
+            // The worker writes into the mapping until then
+            if(job.copying.valid())
+            {
+                job.copying.wait();
+            }
+            
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, job.buffer->pbo);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        
+        job.buffer->used = false;
+        job.buffer = nullptr;
+    }
+    
+    TextureUploader::Buffer& TextureUploader::acquire(std::size_t bytes)
+    {
+        // The smallest buffer large enough, among the ones the GPU is done with
+        Buffer *best = nullptr;
+        Buffer *free = nullptr;
+        for(Buffer& buffer : m_buffers)
+        {
+            if(buffer.used || (buffer.fence.id && !buffer.fence.isSignaled()))
+            {
+                continue;
+            }
+            
+            free = &buffer;
+            if(buffer.capacity >= bytes && (!best || buffer.capacity < best->capacity))
+            {
+                best = &buffer;
+            }
+        }
+        
+        if(!best)
+        {
+            // Reallocate a free buffer too small, else add one
+            best = free ? free : &m_buffers.emplace_back();
+            
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, best->pbo);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, static_cast<GLsizeiptr>(bytes), nullptr, GL_STREAM_DRAW);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            
+            best->capacity = bytes;
+            registry::setBufferStorage(best->pbo, bytes);
+            registry::setLabel(registry::Type::Buffer, best->pbo, "Texture upload");
+        }
+        
+        best->fence.reset();
+        best->used = true;
+        
+        return *best;
+    }
+    
+    void TextureUploader::trim()
+    {
+        std::size_t bytes = 0;
+        for(const Buffer& buffer : m_buffers)
+        {
+            bytes += buffer.capacity;
+        }
+        
+        // The largest first, the driver keeps the storage until the GPU is done with it
+        while(bytes > maxStagingBytes)
+        {
+            auto largest = m_buffers.end();
+            for(auto it = m_buffers.begin(); it != m_buffers.end(); ++it)
+            {
+                if(!it->used && (largest == m_buffers.end() || it->capacity > largest->capacity))
+                {
+                    largest = it;
+                }
+            }
+            
+            if(largest == m_buffers.end())
+            {
+                break;
+            }
+            
+            bytes -= largest->capacity;
+            m_buffers.erase(largest);
+        }
+    }
+    
+    std::size_t TextureUploader::getStagingBytes() const
+    {
+        std::size_t bytes = 0;
+        for(const Job& job : m_jobs)
+        {
+            if(job.buffer)
+            {
+                bytes += job.bytes;
+            }
+        }
+        
+        return bytes;
+    }
+}
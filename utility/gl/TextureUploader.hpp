@@ -0,0 +1,131 @@
+#pragma once
+
+#include "Texture.hpp"
+#include <cstddef>
+#include <future>
+#include <list>
+#include <vector>
+
+namespace gl
+{
+    /// @brief Upload the decoded textures through pixel buffers, a bounded amount of bytes per frame.
+    /// @details
+    /// glTexImage2D() from client memory copies the pixels before returning, which stalls the render thread for
+    /// large images. Instead, each texture goes through:
+    /// - The decoding, on the ThreadPool (Texture::decodeAsync()).
+    /// - A pixel buffer (GL_PIXEL_UNPACK_BUFFER) mapped by the render thread, then filled by a worker.
+    /// - The uploads from the buffer by update(), up to bytesPerFrame per frame, in bands of rows, the smallest levels
+    ///   first: the base level of the texture follows the levels done, so it sharpens while it streams in.
+    /// - A fence after the last upload: the buffer is reused once the GPU has read it.
+    ///     gl::TextureUploader uploader{16 << 20};
+    ///     gl::Texture::setUploader(&uploader);
+    ///     texture.load(gl::Texture::decodeAsync(path));
+    ///     // Then each frame:
+    ///     uploader.update();
+    /// @remarks Only from the thread of the context. The textures are referred to by their OpenGL name, so they can
+    /// be moved while uploading, and cancel() their upload when deleted.
+    class TextureUploader
+    {
+    public:
+        struct Stats
+        {
+            std::size_t decoding{0}; ///< Textures waiting for their decoding, or for staging memory
+            std::size_t copying{0}; ///< Textures being written into their buffer
+            std::size_t uploading{0}; ///< Textures with levels left to upload
+            std::size_t buffers{0};
+            std::size_t bufferBytes{0}; ///< Memory of the pixel buffers, used or not
+            std::size_t uploadedBytes{0}; ///< Uploaded by the last update()
+            std::size_t uploaded{0}; ///< Textures completed since the creation
+        };
+        
+        /// @param bytesPerFrame See bytesPerFrame.
+        explicit TextureUploader(std::size_t bytesPerFrame = 16 << 20);
+        
+        /// @brief Wait for the workers writing into the buffers, the uploads left are dropped.
+        ~TextureUploader();
+        
+        TextureUploader(const TextureUploader&) = delete;
+        TextureUploader& operator=(const TextureUploader&) = delete;
+        
+        /// @brief Bytes uploaded per update() at most, at least a band of rows is uploaded per frame.
+        std::size_t bytesPerFrame;
+        
+        /// @brief Bytes of the buffers being filled or uploaded at most, at least a texture is in progress.
+        /// @details Bounds the memory of the buffers, 4 times bytesPerFrame by default.
+        std::size_t maxStagingBytes;
+        
+        /// @brief Queue a texture being decoded, its storage is replaced once the upload starts.
+        void load(GLuint texture, std::future<Texture::Decoded> decoded);
+        
+        /// @brief Drop the upload of a texture, if any. Called when the texture is deleted.
+        void cancel(GLuint texture);
+        
+        /// @brief Start the uploads of the textures decoded, continue the ones started, and recycle the buffers.
+        /// @remarks Call it once per frame.
+        void update();
+        
+        /// @brief Wait for all the textures queued, and upload them now, whatever the budget.
+        void finish();
+        
+        bool isIdle() const;
+        
+        Stats getStats() const;
+    
+    private:
+        struct Buffer
+        {
+            raii::Buffer pbo;
+            std::size_t capacity{0};
+            raii::Sync fence; ///< Set after the last upload reading the buffer
+            bool used{false};
+        };
+        
+        struct Job
+        {
+            GLuint texture{0};
+            std::future<Texture::Decoded> decoding;
+            Texture::Decoded decoded;
+            
+            /// @brief Offset of each level in the buffer, only the levels uploaded.
+            std::vector<std::size_t> offsets;
+            std::size_t bytes{0};
+            
+            Buffer *buffer{nullptr}; ///< Once mapped
+            std::future<void> copying; ///< Writing the levels into the mapped buffer
+            bool uploading{false}; ///< Unmapped, the storage of the texture allocated
+            
+            int level{0}; ///< Next level to upload, from the last one
+            int row{0}; ///< Next row of the level, in blocks for the compressed formats
+        };
+        
+        /// @brief Map a buffer for a decoded texture, and fill it on the ThreadPool.
+        void start(Job& job);
+        
+        /// @brief Allocate the storage of the texture, once its buffer is filled.
+        void allocate(Job& job);
+        
+        /// @brief Upload bands of rows of the levels left, up to budget bytes.
+        /// @returns The bytes uploaded.
+        std::size_t upload(Job& job, std::size_t budget);
+        
+        /// @brief Complete the texture, track it, and release its buffer.
+        void complete(Job& job);
+        
+        /// @brief Unmap and release the buffer of a job, after its copy.
+        void release(Job& job);
+        
+        /// @returns A free buffer of at least bytes, allocated if needed.
+        Buffer& acquire(std::size_t bytes);
+        
+        /// @brief Delete the free buffers above maxStagingBytes.
+        void trim();
+        
+        std::size_t getStagingBytes() const;
+        
+        std::list<Job> m_jobs; ///< In the order they were loaded
+        std::list<Buffer> m_buffers;
+        
+        std::size_t m_uploadedBytes{0};
+        std::size_t m_uploaded{0};
+    };
+}
@@ -0,0 +1,483 @@
+#include "VirtualTexture.hpp"
+#include "registry.hpp"
+#include <utility/ThreadPool.hpp>
+#include <utility/time/Trace.hpp>
+#include <glm/common.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <unordered_set>
+
+namespace gl
+{
+    VirtualTextureFeedback::VirtualTextureFeedback(int downscale)
+        : m_downscale{std::max(downscale, 1)}
+    {
+        registry::setLabel(registry::Type::Framebuffer, m_fbo, "Virtual texture feedback");
+        registry::setLabel(registry::Type::Renderbuffer, m_color, "Virtual texture feedback");
+        registry::setLabel(registry::Type::Renderbuffer, m_depth, "Virtual texture feedback depth");
+    }
+    
+    void VirtualTextureFeedback::begin(glm::ivec2 viewport)
+    {
+        // Restored by end(), the current framebuffer is not always the window (offscreen contexts)
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_previousFramebuffer);
+        
+        const glm::ivec2 size = glm::max(viewport / m_downscale, 1);
+        
+        glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+        
+        if(size != m_size)
+        {
+            m_size = size;
+            
+            glBindRenderbuffer(GL_RENDERBUFFER, m_color);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA16UI, size.x, size.y);
+            glBindRenderbuffer(GL_RENDERBUFFER, m_depth);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size.x, size.y);
+            glBindRenderbuffer(GL_RENDERBUFFER, 0);
+            
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_color);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depth);
+            
+            registry::setImageStorage(registry::Type::Renderbuffer, m_color, GL_RGBA16UI, {size, 1});
+            registry::setImageStorage(registry::Type::Renderbuffer, m_depth, GL_DEPTH_COMPONENT24, {size, 1});
+        }
+        
+        glViewport(0, 0, size.x, size.y);
+        
+        // 0 is no virtual texture
+        const GLuint none[4] = {0, 0, 0, 0};
+        const GLfloat far = 1.0f;
+        glClearBufferuiv(GL_COLOR, 0, none);
+        glClearBufferfv(GL_DEPTH, 0, &far);
+    }
+    
+    void VirtualTextureFeedback::end()
+    {
+        Readback& readback = m_readbacks[m_next];
+        m_next = (m_next + 1) % m_readbacks.size();
+        
+        const std::size_t bytes = static_cast<std::size_t>(m_size.x) * m_size.y * sizeof(m_pixels[0]);
+        
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+        if(readback.size != m_size)
+        {
+            glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(bytes), nullptr, GL_STREAM_READ);
+            registry::setBufferStorage(readback.pbo, bytes);
+            registry::setLabel(registry::Type::Buffer, readback.pbo, "Virtual texture feedback readback");
+            readback.size = m_size;
+        }
+        
+        // Only queued: the copy is done by the GPU after the pass, into the buffer
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, m_fbo);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        glReadPixels(0, 0, m_size.x, m_size.y, GL_RGBA_INTEGER, GL_UNSIGNED_SHORT, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        readback.fence.set();
+        
+        glBindFramebuffer(GL_FRAMEBUFFER, m_previousFramebuffer);
+        
+        collect();
+    }
+    
+    void VirtualTextureFeedback::collect()
+    {
+        // From the oldest to the newest, so the newest finished is kept
+        for(std::size_t i = 0; i < m_readbacks.size(); ++i)
+        {
+            Readback& readback = m_readbacks[(m_next + i) % m_readbacks.size()];
+            if(!readback.fence.isSignaled())
+            {
+                continue;
+            }
+            
+            m_pixels.resize(static_cast<std::size_t>(readback.size.x) * readback.size.y);
+            const std::size_t bytes = m_pixels.size() * sizeof(m_pixels[0]);
+            
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+            if(const void *data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(bytes),
+                                                   GL_MAP_READ_BIT))
+            {
+                std::memcpy(m_pixels.data(), data, bytes);
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            
+            readback.fence.reset();
+        }
+    }
+    
+    const std::vector<std::array<std::uint16_t, 4>>& VirtualTextureFeedback::getPixels() const
+    {
+        return m_pixels;
+    }
+    
+    float VirtualTextureFeedback::getLodBias() const
+    {
+        return -std::log2(static_cast<float>(m_downscale));
+    }
+    
+    std::uint16_t VirtualTexture::s_nextID{1};
+    
+    VirtualTexture::VirtualTexture(const std::filesystem::path& path, int physicalPages)
+        : m_physicalPages{std::clamp(physicalPages, 1, 256)}, m_id{s_nextID++}
+    {
+        GLint previous = 0;
+        glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous);
+        
+        const std::string label = path.filename().string();
+        
+        if(!m_file.open(path))
+        {
+            std::cerr << "Failed to open the virtual texture " << path << std::endl;
+            
+            // A single white page of a texel, see send()
+            const GLubyte white[] = {0xff, 0xff, 0xff, 0xff};
+            for(GLuint texture : {m_indirection.id, m_physical.id})
+            {
+                glBindTexture(GL_TEXTURE_2D, texture);
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+                registry::setImageStorage(registry::Type::Texture, texture, GL_RGBA8, {1, 1, 1});
+            }
+            
+            glBindTexture(GL_TEXTURE_2D, previous);
+            return;
+        }
+        
+        const int stride = m_file.getStride();
+        const int levels = m_file.getLevels();
+        
+        glBindTexture(GL_TEXTURE_2D, m_physical);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, m_physicalPages * stride, m_physicalPages * stride, 0, GL_RGBA,
+                     GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        registry::setImageStorage(registry::Type::Texture, m_physical, GL_RGBA8,
+                                  {m_physicalPages * stride, m_physicalPages * stride, 1});
+        registry::setLabel(registry::Type::Texture, m_physical, label + " pages");
+        
+        // Only read with texelFetch(), the filters are for the completeness
+        glBindTexture(GL_TEXTURE_2D, m_indirection);
+        m_entries.resize(levels);
+        for(int level = 0; level < levels; ++level)
+        {
+            const glm::ivec2 count = m_file.getPageCount(level);
+            m_entries[level].resize(static_cast<std::size_t>(count.x) * count.y * 4);
+            glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, count.x, count.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        registry::setImageStorage(registry::Type::Texture, m_indirection, GL_RGBA8, {m_file.getPageCount(0), 1}, 0);
+        registry::setLabel(registry::Type::Texture, m_indirection, label + " indirection");
+        
+        glBindTexture(GL_TEXTURE_2D, previous);
+        
+        m_slots.resize(static_cast<std::size_t>(m_physicalPages) * m_physicalPages);
+        
+        // The page of the last level is the fallback of all the others, it's never replaced
+        const Key root = getKey({levels - 1, {0, 0}});
+        std::vector<unsigned char> texels;
+        if(m_file.readPage(getPage(root), texels))
+        {
+            upload(0, root, texels);
+            m_slots[0].lastUsed = std::numeric_limits<std::uint64_t>::max();
+        }
+        
+        updateIndirection();
+    }
+    
+    VirtualTexture::~VirtualTexture()
+    {
+        // The reads use the file
+        for(auto& [key, texels] : m_pending)
+        {
+            texels.wait();
+        }
+    }
+    
+    void VirtualTexture::update(const VirtualTextureFeedback& feedback)
+    {
+        if(!m_file.isOpen())
+        {
+            return;
+        }
+        
+        trace::Scope scope{"VirtualTexture::update", "asset"};
+        
+        request(feedback);
+        uploadPending();
+        
+        if(m_dirty)
+        {
+            updateIndirection();
+        }
+        
+        m_frame++;
+    }
+    
+    void VirtualTexture::request(const VirtualTextureFeedback& feedback)
+    {
+        const int levels = m_file.getLevels();
+        
+        std::unordered_set<Key> visible;
+        std::unordered_set<Key> touched;
+        std::vector<Key> missing;
+        
+        for(const std::array<std::uint16_t, 4>& pixel : feedback.getPixels())
+        {
+            const PageFile::Page page{pixel[2], {pixel[0], pixel[1]}};
+            
+            // The feedback of the other virtual textures, and the pixels without any
+            if(pixel[3] != m_id || page.level >= levels || page.pos.x >= m_file.getPageCount(page.level).x
+               || page.pos.y >= m_file.getPageCount(page.level).y || !visible.insert(getKey(page)).second)
+            {
+                continue;
+            }
+            
+            // The page and its parents: the parents are the fallback until the page is resident
+            for(Key key = getKey(page); touched.insert(key).second; key = getParent(key))
+            {
+                if(auto resident = m_resident.find(key); resident != m_resident.end())
+                {
+                    Slot& slot = m_slots[resident->second];
+                    slot.lastUsed = std::max(slot.lastUsed, m_frame);
+                }
+                else if(!m_pending.count(key))
+                {
+                    missing.push_back(key);
+                }
+                
+                if(getPage(key).level == levels - 1)
+                {
+                    break;
+                }
+            }
+        }
+        
+        m_visible = visible.size();
+        
+        // The coarsest first: they cover more of the screen, and the finer ones fall back to them
+        std::sort(missing.begin(), missing.end(), [](Key a, Key b) {
+            return getPage(a).level > getPage(b).level;
+        });
+        
+        // Don't queue more than what can be uploaded soon, the feedback may change before
+        const std::size_t maxPending = 2 * static_cast<std::size_t>(std::max(maxUploadsPerFrame, 1));
+        int reads = 0;
+        
+        for(Key key : missing)
+        {
+            if(reads >= maxReadsPerFrame || m_pending.size() >= maxPending)
+            {
+                break;
+            }
+            
+            m_pending.emplace(key, ThreadPool::global().submit([this, key] {
+                std::vector<unsigned char> texels;
+                if(!m_file.readPage(getPage(key), texels))
+                {
+                    texels.clear();
+                }
+                
+                return texels;
+            }));
+            
+            reads++;
+        }
+    }
+    
+    void VirtualTexture::uploadPending()
+    {
+        int uploads = 0;
+        
+        for(auto it = m_pending.begin(); it != m_pending.end() && uploads < maxUploadsPerFrame;)
+        {
+            if(it->second.wait_for(std::chrono::seconds{0}) != std::future_status::ready)
+            {
+                ++it;
+                continue;
+            }
+            
+            const int slot = findSlot();
+            if(slot < 0)
+            {
+                // All the pages are visible, the physical texture is too small for the view
+                break;
+            }
+            
+            const std::vector<unsigned char> texels = it->second.get();
+            if(!texels.empty())
+            {
+                upload(slot, it->first, texels);
+                uploads++;
+            }
+            
+            it = m_pending.erase(it);
+        }
+    }
+    
+    int VirtualTexture::findSlot() const
+    {
+        int best = -1;
+        
+        for(int i = 0; i < static_cast<int>(m_slots.size()); ++i)
+        {
+            const Slot& slot = m_slots[i];
+            if(!slot.used)
+            {
+                return i;
+            }
+            
+            if(slot.lastUsed < m_frame && (best < 0 || slot.lastUsed < m_slots[best].lastUsed))
+            {
+                best = i;
+            }
+        }
+        
+        return best;
+    }
+    
+    void VirtualTexture::upload(int slot, Key key, const std::vector<unsigned char>& texels)
+    {
+        Slot& target = m_slots[slot];
+        if(target.used)
+        {
+            m_resident.erase(target.key);
+        }
+        
+        target.key = key;
+        target.used = true;
+        target.lastUsed = m_frame;
+        m_resident[key] = slot;
+        
+        const int stride = m_file.getStride();
+        
+        GLint previous = 0;
+        glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous);
+        glBindTexture(GL_TEXTURE_2D, m_physical);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, (slot % m_physicalPages) * stride, (slot / m_physicalPages) * stride, stride,
+                        stride, GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+        glBindTexture(GL_TEXTURE_2D, previous);
+        
+        m_uploaded++;
+        m_dirty = true;
+    }
+    
+    void VirtualTexture::updateIndirection()
+    {
+        GLint previous = 0;
+        glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous);
+        glBindTexture(GL_TEXTURE_2D, m_indirection);
+        
+        // From the coarsest level, so the parents are done before their children
+        for(int level = m_file.getLevels() - 1; level >= 0; --level)
+        {
+            const glm::ivec2 count = m_file.getPageCount(level);
+            const glm::ivec2 parentCount = m_file.getPageCount(level + 1);
+            std::vector<unsigned char>& entries = m_entries[level];
+            
+            for(int y = 0; y < count.y; ++y)
+            {
+                for(int x = 0; x < count.x; ++x)
+                {
+                    unsigned char *entry = &entries[(static_cast<std::size_t>(y) * count.x + x) * 4];
+                    
+                    if(auto resident = m_resident.find(getKey({level, {x, y}})); resident != m_resident.end())
+                    {
+                        entry[0] = static_cast<unsigned char>(resident->second % m_physicalPages);
+                        entry[1] = static_cast<unsigned char>(resident->second / m_physicalPages);
+                        entry[2] = static_cast<unsigned char>(level);
+                        entry[3] = 255;
+                    }
+                    else if(level + 1 < m_file.getLevels())
+                    {
+                        const std::size_t parent = (static_cast<std::size_t>(y / 2) * parentCount.x + x / 2) * 4;
+                        std::memcpy(entry, &m_entries[level + 1][parent], 4);
+                    }
+                    else
+                    {
+                        // The root could not be read, point to the slot 0 anyway
+                        std::memset(entry, 0, 4);
+                    }
+                }
+            }
+            
+            glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, count.x, count.y, GL_RGBA, GL_UNSIGNED_BYTE, entries.data());
+        }
+        
+        glBindTexture(GL_TEXTURE_2D, previous);
+        m_dirty = false;
+    }
+    
+    void VirtualTexture::send(Shader& shader, float lodBias) const
+    {
+        glActiveTexture(GL_TEXTURE0 + IndirectionUnit);
+        glBindTexture(GL_TEXTURE_2D, m_indirection);
+        glActiveTexture(GL_TEXTURE0 + PhysicalUnit);
+        glBindTexture(GL_TEXTURE_2D, m_physical);
+        glActiveTexture(GL_TEXTURE0);
+        
+        // Without file, a single level of a single page of a texel
+        const bool open = m_file.isOpen();
+        const int pageSize = open ? m_file.getPageSize() : 1;
+        const int physicalSize = open ? m_physicalPages * m_file.getStride() : 1;
+        
+        shader.setUniform("u_VirtualIndirection", IndirectionUnit);
+        shader.setUniform("u_VirtualPhysical", PhysicalUnit);
+        shader.setUniform("u_VirtualSize", open ? glm::vec2{m_file.getSize()} : glm::vec2{1});
+        shader.setUniform("u_VirtualPhysicalSize", glm::vec2{static_cast<float>(physicalSize)});
+        shader.setUniform("u_VirtualPageSize", pageSize);
+        shader.setUniform("u_VirtualBorder", open ? m_file.getBorder() : 0);
+        shader.setUniform("u_VirtualLevels", open ? m_file.getLevels() : 1);
+        shader.setUniform("u_VirtualLodBias", lodBias);
+        shader.setUniform("u_VirtualID", static_cast<int>(m_id));
+    }
+    
+    std::uint16_t VirtualTexture::getID() const
+    {
+        return m_id;
+    }
+    
+    const PageFile& VirtualTexture::getPageFile() const
+    {
+        return m_file;
+    }
+    
+    VirtualTexture::Stats VirtualTexture::getStats() const
+    {
+        Stats stats;
+        stats.resident = m_resident.size();
+        stats.capacity = m_slots.size();
+        stats.visible = m_visible;
+        stats.pending = m_pending.size();
+        stats.uploaded = m_uploaded;
+        
+        return stats;
+    }
+    
+    VirtualTexture::Key VirtualTexture::getKey(PageFile::Page page)
+    {
+        return static_cast<Key>(page.level) << 48 | static_cast<Key>(page.pos.y) << 24 | static_cast<Key>(page.pos.x);
+    }
+    
+    PageFile::Page VirtualTexture::getPage(Key key)
+    {
+        constexpr Key mask = (Key{1} << 24) - 1;
+        return {static_cast<int>(key >> 48), {static_cast<int>(key & mask), static_cast<int>(key >> 24 & mask)}};
+    }
+    
+    VirtualTexture::Key VirtualTexture::getParent(Key key)
+    {
+        const PageFile::Page page = getPage(key);
+        return getKey({page.level + 1, page.pos / 2});
+    }
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include "gl.hpp"
+#include "PageFile.hpp"
+#include "Shader.hpp"
+#include <glm/vec2.hpp>
+#include <array>
+#include <cstdint>
+#include <future>
+#include <unordered_map>
+#include <vector>
+
+namespace gl
+{
+    /// @brief Which pages of the virtual textures are visible, rendered by a low resolution pass.
+    /// @details
+    /// The scene is drawn with the VIRTUAL_FEEDBACK variant of base.frag into a RGBA16UI framebuffer: each pixel is the
+    /// page sampled there (x, y, level) and the ID of its virtual texture, 0 where there is none. The pixels are read
+    /// back through pixel buffers and fences, so the CPU never waits for the GPU: the feedback is a few frames old.
+    ///     feedback.begin(viewport);
+    ///     // Draw the scene with FeatureFeedback and the LOD bias of getLodBias()
+    ///     feedback.end();
+    ///     virtualTexture.update(feedback);
+    class VirtualTextureFeedback
+    {
+    public:
+        /// @param downscale The size of the framebuffer is the viewport divided by it.
+        explicit VirtualTextureFeedback(int downscale = 8);
+        
+        /// @brief Bind the framebuffer of the pass, resized to the viewport, and clear it.
+        void begin(glm::ivec2 viewport);
+        
+        /// @brief Start to read back the pass, then restore the framebuffer bound before begin().
+        /// @remarks The viewport is not restored.
+        void end();
+        
+        /// @brief The last feedback read back: x, y, level and ID for each pixel.
+        const std::vector<std::array<std::uint16_t, 4>>& getPixels() const;
+        
+        /// @brief Added to the level sampled in the pass, since its derivatives are downscale times larger.
+        float getLodBias() const;
+    
+    private:
+        /// @brief Copy the oldest readback finished by the GPU, if any.
+        void collect();
+        
+        int m_downscale;
+        glm::ivec2 m_size{0};
+        GLint m_previousFramebuffer{0};
+        
+        raii::Framebuffer m_fbo;
+        raii::Renderbuffer m_color, m_depth;
+        
+        struct Readback
+        {
+            raii::Buffer pbo;
+            raii::Sync fence; ///< Empty if there is nothing to read
+            glm::ivec2 size{0};
+        };
+        
+        std::array<Readback, 3> m_readbacks;
+        std::size_t m_next{0}; ///< The readback written by end()
+        
+        std::vector<std::array<std::uint16_t, 4>> m_pixels;
+    };
+    
+    /// @brief A texture larger than memory: only the pages visible on the screen are resident.
+    /// @details
+    /// The pages of a PageFile are streamed into a physical texture, a cache of pages in a grid. An indirection texture,
+    /// with a texel per page and a mipmap per level, tells where each page is in the physical texture. A page which is
+    /// not resident points to its closest resident parent, so the texture is blurry until the page is loaded, never
+    /// missing: the page of the last level is always resident. See assets/virtual.glsl for the sampling.
+    /// Each frame, update() reads the pages requested by the feedback pass from the file on the ThreadPool, uploads the
+    /// pages read, replacing the least recently used ones, then updates the indirection texture.
+    /// The memory is the physical texture, whatever the size of the virtual texture.
+    class VirtualTexture
+    {
+    public:
+        /// @brief Texture units of the indirection and physical textures, bound by send().
+        static constexpr int IndirectionUnit = 3;
+        static constexpr int PhysicalUnit = 4;
+        
+        struct Stats
+        {
+            std::size_t resident{0}; ///< Pages in the physical texture
+            std::size_t capacity{0}; ///< Pages which fit in the physical texture
+            std::size_t visible{0}; ///< Pages seen by the last feedback
+            std::size_t pending{0}; ///< Pages being read from the file
+            std::size_t uploaded{0}; ///< Pages uploaded since the creation
+        };
+        
+        /// @param path A file written by PageFile::build().
+        /// @param physicalPages The physical texture is a grid of physicalPages x physicalPages pages.
+        /// @remarks Log to std::cerr if the file can't be opened, the texture is then white.
+        explicit VirtualTexture(const std::filesystem::path& path, int physicalPages = 16);
+        
+        /// @brief Wait for the pages being read.
+        ~VirtualTexture();
+        
+        VirtualTexture(const VirtualTexture&) = delete;
+        VirtualTexture& operator=(const VirtualTexture&) = delete;
+        
+        /// @brief Count of pages read from the file per update(), at most.
+        int maxReadsPerFrame{16};
+        
+        /// @brief Count of pages uploaded per update(), at most, to bound the hitch.
+        int maxUploadsPerFrame{8};
+        
+        /// @brief Request the pages seen by the feedback, upload the pages read, and update the indirection.
+        void update(const VirtualTextureFeedback& feedback);
+        
+        /// @brief Bind the textures on their units and send the uniforms of assets/virtual.glsl.
+        /// @param lodBias See VirtualTextureFeedback::getLodBias(), 0 outside of the feedback pass.
+        void send(Shader& shader, float lodBias = 0.0f) const;
+        
+        /// @brief Written in the feedback, from 1 since 0 is no virtual texture.
+        std::uint16_t getID() const;
+        
+        const PageFile& getPageFile() const;
+        
+        Stats getStats() const;
+    
+    private:
+        /// @brief Page of the file packed into an integer: level, y, x.
+        using Key = std::uint64_t;
+        
+        static Key getKey(PageFile::Page page);
+        static PageFile::Page getPage(Key key);
+        
+        /// @brief The parent page, in the next level.
+        static Key getParent(Key key);
+        
+        /// @brief A place for a page in the physical texture.
+        struct Slot
+        {
+            Key key{0};
+            bool used{false}; ///< Holds a page
+            std::uint64_t lastUsed{0};
+        };
+        
+        /// @brief Read the pages requested by the feedback, the coarsest first.
+        void request(const VirtualTextureFeedback& feedback);
+        
+        /// @brief Upload the pages read, up to maxUploadsPerFrame.
+        void uploadPending();
+        
+        /// @returns The slot to replace, the free or least recently used one, -1 if all of them are used this frame.
+        int findSlot() const;
+        
+        void upload(int slot, Key key, const std::vector<unsigned char>& texels);
+        
+        /// @brief Point each page to itself if resident, else to the entry of its parent.
+        void updateIndirection();
+        
+        PageFile m_file;
+        int m_physicalPages;
+        std::uint16_t m_id;
+        
+        raii::Texture m_indirection, m_physical;
+        
+        std::vector<Slot> m_slots;
+        std::unordered_map<Key, int> m_resident; ///< The slot of each resident page
+        std::unordered_map<Key, std::future<std::vector<unsigned char>>> m_pending;
+        
+        /// @brief RGBA8 texels of each level of the indirection: physical page x, y, level of the page, 255.
+        std::vector<std::vector<unsigned char>> m_entries;
+        bool m_dirty{false};
+        
+        std::uint64_t m_frame{1};
+        std::size_t m_visible{0};
+        std::size_t m_uploaded{0};
+        
+        static std::uint16_t s_nextID;
+    };
+}
@@ -0,0 +1,99 @@
+#include "extensions.hpp"
+#include <cstring>
+
+namespace gl
+{
+    namespace ext
+    {
+        bool ARB_get_program_binary{false};
+        void (APIENTRYP getProgramBinary)(GLuint, GLsizei, GLsizei *, GLenum *, void *){nullptr};
+        void (APIENTRYP programBinary)(GLuint, GLenum, const void *, GLsizei){nullptr};
+        void (APIENTRYP programParameteri)(GLuint, GLenum, GLint){nullptr};
+        
+        bool KHR_parallel_shader_compile{false};
+        void (APIENTRYP maxShaderCompilerThreads)(GLuint){nullptr};
+        
+        bool KHR_debug{false};
+        void (APIENTRYP pushDebugGroup)(GLenum, GLuint, GLsizei, const GLchar *){nullptr};
+        void (APIENTRYP popDebugGroup)(){nullptr};
+        void (APIENTRYP debugMessageCallback)(GLDEBUGPROC, const void *){nullptr};
+        void (APIENTRYP debugMessageControl)(GLenum, GLenum, GLenum, GLsizei, const GLuint *, GLboolean){nullptr};
+        
+        bool EXT_texture_compression_s3tc{false};
+        bool ARB_texture_compression_bptc{false};
+        
+        namespace
+        {
+            /// @brief Load a function into a pointer of any type.
+            template<typename Function>
+            bool loadFunction(GLADloadproc loader, Function& function, const char *name)
+            {
+                function = reinterpret_cast<Function>(loader(name));
+                return function != nullptr;
+            }
+        }
+        
+        bool isSupported(const char *name)
+        {
+            GLint count = 0;
+            glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+            
+            for(GLint i = 0; i < count; ++i)
+            {
+                const char *extension = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i));
+                
+                if(extension && std::strcmp(extension, name) == 0)
+                {
+                    return true;
+                }
+            }
+            
+            return false;
+        }
+        
+        bool isVersion(int major, int minor)
+        {
+            return GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor);
+        }
+        
+        void load(GLADloadproc loader)
+        {
+            if(isVersion(4, 1) || isSupported("GL_ARB_get_program_binary"))
+            {
+                ARB_get_program_binary = loadFunction(loader, getProgramBinary, "glGetProgramBinary")
+                                && loadFunction(loader, programBinary, "glProgramBinary")
+                                && loadFunction(loader, programParameteri, "glProgramParameteri");
+            }
+            
+            // Same enums and function for both, only the suffix of the function changes
+            if(isSupported("GL_KHR_parallel_shader_compile"))
+            {
+                KHR_parallel_shader_compile = loadFunction(loader, maxShaderCompilerThreads,
+                                                           "glMaxShaderCompilerThreadsKHR");
+            }
+            else if(isSupported("GL_ARB_parallel_shader_compile"))
+            {
+                KHR_parallel_shader_compile = loadFunction(loader, maxShaderCompilerThreads,
+                                                           "glMaxShaderCompilerThreadsARB");
+            }
+            
+            if(KHR_parallel_shader_compile)
+            {
+                // Let the driver choose how many threads it uses
+                maxShaderCompilerThreads(0xFFFFFFFF);
+            }
+            
+            // The functions have no suffix in desktop OpenGL, even from the extension
+            if(isVersion(4, 3) || isSupported("GL_KHR_debug"))
+            {
+                KHR_debug = loadFunction(loader, pushDebugGroup, "glPushDebugGroup")
+                         && loadFunction(loader, popDebugGroup, "glPopDebugGroup")
+                         && loadFunction(loader, debugMessageCallback, "glDebugMessageCallback")
+                         && loadFunction(loader, debugMessageControl, "glDebugMessageControl");
+            }
+            
+            EXT_texture_compression_s3tc = isSupported("GL_EXT_texture_compression_s3tc");
+            ARB_texture_compression_bptc = isVersion(4, 2) || isSupported("GL_ARB_texture_compression_bptc");
+        }
+    }
+}
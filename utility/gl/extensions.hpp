@@ -0,0 +1,94 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// Enums of the extensions used, not in the GLAD 4.0 core header
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#   define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#   define GL_PROGRAM_BINARY_LENGTH 0x8741
+#   define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#   define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+#ifndef GL_DEBUG_SOURCE_APPLICATION
+#   define GL_DEBUG_SOURCE_APPLICATION 0x824A
+#   define GL_DEBUG_OUTPUT 0x92E0
+#   define GL_DEBUG_OUTPUT_SYNCHRONOUS 0x8242
+#   define GL_DEBUG_TYPE_ERROR 0x824C
+#   define GL_DEBUG_TYPE_PUSH_GROUP 0x8269
+#   define GL_DEBUG_TYPE_POP_GROUP 0x826A
+#   define GL_DEBUG_SEVERITY_HIGH 0x9146
+#   define GL_DEBUG_SEVERITY_MEDIUM 0x9147
+#   define GL_DEBUG_SEVERITY_LOW 0x9148
+#   define GL_DEBUG_SEVERITY_NOTIFICATION 0x826B
+#   define GL_CONTEXT_FLAG_DEBUG_BIT 0x00000002
+#endif
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#   define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#   define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#   define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+
+/// @brief OpenGL utilities
+namespace gl
+{
+    /// @brief Entry points of the extensions, or of core functions newer than the GLAD 4.0 core profile.
+    /// @details Loaded by load() once the context is current, after gladLoadGLLoader().
+    /// Each feature has a flag, its functions are nullptr if the flag is false.
+    namespace ext
+    {
+        /// @brief Load the extensions supported by the current context.
+        /// @param loader The same loader than gladLoadGLLoader().
+        void load(GLADloadproc loader);
+        
+        /// @brief Check if the context supports an extension, like "GL_KHR_debug".
+        bool isSupported(const char *name);
+        
+        /// @brief Check if the version of the context is at least major.minor.
+        bool isVersion(int major, int minor);
+        
+        /// @name
+        /// @brief ARB_get_program_binary, core since 4.1
+        /// @{
+        extern bool ARB_get_program_binary;
+        extern void (APIENTRYP getProgramBinary)(GLuint program, GLsizei bufSize, GLsizei *length,
+                                                 GLenum *binaryFormat, void *binary);
+        extern void (APIENTRYP programBinary)(GLuint program, GLenum binaryFormat, const void *binary,
+                                              GLsizei length);
+        extern void (APIENTRYP programParameteri)(GLuint program, GLenum pname, GLint value);
+        /// @}
+        
+        /// @name
+        /// @brief KHR_parallel_shader_compile (or ARB_parallel_shader_compile)
+        /// @details Once enabled, the driver compiles on its own threads and the GL_COMPLETION_STATUS_KHR
+        /// of a shader or a program can be queried without waiting for the compilation.
+        /// @{
+        extern bool KHR_parallel_shader_compile;
+        extern void (APIENTRYP maxShaderCompilerThreads)(GLuint count);
+        /// @}
+        
+        /// @name
+        /// @brief KHR_debug, core since 4.3
+        /// @{
+        extern bool KHR_debug;
+        extern void (APIENTRYP pushDebugGroup)(GLenum source, GLuint id, GLsizei length, const GLchar *message);
+        extern void (APIENTRYP popDebugGroup)();
+        extern void (APIENTRYP debugMessageCallback)(GLDEBUGPROC callback, const void *userParam);
+        extern void (APIENTRYP debugMessageControl)(GLenum source, GLenum type, GLenum severity, GLsizei count,
+                                                    const GLuint *ids, GLboolean enabled);
+        /// @}
+        
+        /// @brief EXT_texture_compression_s3tc: BC1 (DXT1) to BC3 (DXT5), no function.
+        extern bool EXT_texture_compression_s3tc;
+        
+        /// @brief ARB_texture_compression_bptc, core since 4.2: BC6H and BC7, no function.
+        extern bool ARB_texture_compression_bptc;
+    }
+}
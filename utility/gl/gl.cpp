@@ -1,4 +1,7 @@
 #include "gl.hpp"
+#include "extensions.hpp"
+#include "stats.hpp"
+#include "registry.hpp"
 #include <utility/unused.hpp>
 #include <cassert>
 #include <iostream>
@@ -6,6 +9,39 @@
 
 namespace gl
 {
+    namespace
+    {
+        /// @brief Post-call callback of GLAD doing nothing, instead of the default calling glGetError().
+        [[maybe_unused]] void ignoreCall(const char *, void *, int, ...)
+        {
+        }
+        
+#ifdef OPENGL_OBJ_GL_DEBUG
+        const char *getSeverityName(GLenum severity)
+        {
+            switch(severity)
+            {
+                case GL_DEBUG_SEVERITY_HIGH: return "high";
+                case GL_DEBUG_SEVERITY_MEDIUM: return "medium";
+                case GL_DEBUG_SEVERITY_LOW: return "low";
+                default: return "notification";
+            }
+        }
+        
+        /// @remarks Can be called from a thread of the driver, unless the output is synchronous.
+        void APIENTRY onDebugMessage(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
+                                     const GLchar *message, const void *userParam)
+        {
+            UNUSED(source);
+            UNUSED(length);
+            UNUSED(userParam);
+            
+            std::cerr << "OpenGL " << (type == GL_DEBUG_TYPE_ERROR ? "error" : "message")
+                      << " " << id << " (" << getSeverityName(severity) << "): " << message << std::endl;
+        }
+#endif
+    }
+    
     namespace raii
     {
         Shader::Shader(GLenum type)
@@ -41,52 +77,105 @@ namespace gl
         Buffer::Buffer()
         {
             glGenBuffers(1, &id);
+            registry::add(registry::Type::Buffer, id);
         }
     
         Buffer::~Buffer()
         {
+            registry::remove(registry::Type::Buffer, id);
             glDeleteBuffers(1, &id);
         }
     
         VertexArray::VertexArray()
         {
             glGenVertexArrays(1, &id);
+            registry::add(registry::Type::VertexArray, id);
         }
     
         VertexArray::~VertexArray()
         {
+            registry::remove(registry::Type::VertexArray, id);
             glDeleteVertexArrays(1, &id);
         }
     
         Texture::Texture()
         {
             glGenTextures(1, &id);
+            registry::add(registry::Type::Texture, id);
         }
     
         Texture::~Texture()
         {
+            registry::remove(registry::Type::Texture, id);
             glDeleteTextures(1, &id);
         }
     
         Framebuffer::Framebuffer()
         {
             glGenFramebuffers(1, &id);
+            registry::add(registry::Type::Framebuffer, id);
         }
     
         Framebuffer::~Framebuffer()
         {
+            registry::remove(registry::Type::Framebuffer, id);
             glDeleteFramebuffers(1, &id);
         }
     
         Renderbuffer::Renderbuffer()
         {
             glGenRenderbuffers(1, &id);
+            registry::add(registry::Type::Renderbuffer, id);
         }
     
         Renderbuffer::~Renderbuffer()
         {
+            registry::remove(registry::Type::Renderbuffer, id);
             glDeleteRenderbuffers(1, &id);
         }
+    
+        Query::Query()
+        {
+            glGenQueries(1, &id);
+        }
+    
+        Query::~Query()
+        {
+            glDeleteQueries(1, &id);
+        }
+    
+        Sync::~Sync()
+        {
+            reset();
+        }
+    
+        void Sync::set()
+        {
+            reset();
+            id = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+    
+        bool Sync::isSignaled() const
+        {
+            if(!id)
+            {
+                return false;
+            }
+            
+            GLint status = GL_UNSIGNALED;
+            glGetSynciv(id, GL_SYNC_STATUS, sizeof(status), nullptr, &status);
+            
+            return status == GL_SIGNALED;
+        }
+    
+        void Sync::reset()
+        {
+            if(id)
+            {
+                glDeleteSync(id);
+                id = nullptr;
+            }
+        }
     }
     
     std::string getProgramInfoLog(unsigned int programID)
@@ -111,13 +200,34 @@ namespace gl
         return std::string{log.begin(), log.end()};
     }
     
-    void compileShader(unsigned int shaderID, const std::string& source)
+    void compileShader(unsigned int shaderID, const std::string& source, bool wait)
     {
         const char* c_source = source.c_str();
         glShaderSource(shaderID, 1, &c_source, nullptr); // The source is not compiled, just copied into the shader object at this time
         
         glCompileShader(shaderID);
         
+        if(wait)
+        {
+            checkCompileStatus(shaderID);
+        }
+    }
+    
+    void linkShadersToProgram(unsigned int programID, unsigned int fragmentShaderID, unsigned int vertexShaderID,
+                              bool wait)
+    {
+        glAttachShader(programID, vertexShaderID);
+        glAttachShader(programID, fragmentShaderID);
+        glLinkProgram(programID);
+        
+        if(wait)
+        {
+            checkLinkStatus(programID);
+        }
+    }
+    
+    bool checkCompileStatus(unsigned int shaderID)
+    {
         int status;
         glGetShaderiv(shaderID, GL_COMPILE_STATUS, &status);
         
@@ -125,23 +235,56 @@ namespace gl
         {
             std::cerr << "Failed to compile the shader: " << getShaderInfoLog(shaderID) << std::endl;
         }
+        
+        return status;
     }
     
-    void linkShadersToProgram(unsigned int programID, unsigned int fragmentShaderID, unsigned int vertexShaderID)
+    bool checkLinkStatus(unsigned int programID)
     {
-        glAttachShader(programID, vertexShaderID);
-        glAttachShader(programID, fragmentShaderID);
-        glLinkProgram(programID);
-        
         int success;
         glGetProgramiv(programID, GL_LINK_STATUS, &success);
         if (!success)
         {
             std::cerr << "Failed to link the program: " << getProgramInfoLog(programID) << std::endl;
         }
+        
+        return success;
     }
     
-    void enableDebugging(bool throwOnError)
+    void enableDebugging(bool synchronous)
     {
+#if defined(OPENGL_OBJ_GL_STATS)
+        UNUSED(synchronous);
+        
+        glad_set_post_callback(ignoreCall);
+        stats::enable();
+#elif defined(OPENGL_OBJ_GL_DEBUG)
+        if(!ext::KHR_debug)
+        {
+            std::cerr << "KHR_debug is not supported, checking glGetError() after each OpenGL call" << std::endl;
+            return;
+        }
+        
+        GLint flags = 0;
+        glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
+        if(!(flags & GL_CONTEXT_FLAG_DEBUG_BIT))
+        {
+            std::cerr << "Not a debug context, the driver may not report all the errors" << std::endl;
+        }
+        
+        glad_set_post_callback(ignoreCall);
+        
+        glEnable(GL_DEBUG_OUTPUT);
+        if(synchronous)
+        {
+            glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+        }
+        
+        // The notifications are too verbose (every buffer allocation, every debug group...)
+        ext::debugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, nullptr, GL_FALSE);
+        ext::debugMessageCallback(onDebugMessage, nullptr);
+#else
+        UNUSED(synchronous);
+#endif
     }
 }
\ No newline at end of file
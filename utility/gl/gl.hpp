@@ -9,6 +9,7 @@
 /// @brief OpenGL utilities
 namespace gl
 {
+    /// @remarks Buffer, Texture, Framebuffer, Renderbuffer and VertexArray add themselves to gl::registry.
     namespace raii
     {
         /// @brief Generic OpenGL object RAII
@@ -121,6 +122,32 @@ namespace gl
             Renderbuffer(Renderbuffer&&) = default;
             Renderbuffer& operator=(Renderbuffer&&) = default;
         };
+        
+        struct Query : GLObject<>
+        {
+            Query();
+            ~Query() override;
+            Query(Query&&) = default;
+            Query& operator=(Query&&) = default;
+        };
+        
+        /// @brief A fence, empty until set().
+        struct Sync : GLObject<GLsync, nullptr>
+        {
+            Sync() = default;
+            ~Sync() override;
+            Sync(Sync&&) = default;
+            Sync& operator=(Sync&&) = default;
+            
+            /// @brief Replace the fence by a new one, signaled once the commands submitted until now are done.
+            void set();
+            
+            /// @returns true if the fence is signaled, without waiting. False if empty.
+            bool isSignaled() const;
+            
+            /// @brief Delete the fence.
+            void reset();
+        };
     }
     
     /// @brief Simpler glBufferData() for C++
@@ -150,12 +177,32 @@ namespace gl
     std::string getProgramInfoLog(unsigned int programID);
     
     /// @brief Compiles a string into a shader
-    void compileShader(unsigned int shaderID, const std::string& source);
+    /// @param wait If false, the status is not checked: querying it forces the driver to finish the compilation now.
+    /// Check it later with checkCompileStatus().
+    void compileShader(unsigned int shaderID, const std::string& source, bool wait = true);
     
     /// @brief Links compiled shaders to a program
-    void linkShadersToProgram(unsigned int programID, unsigned int fragmentShaderID, unsigned int vertexShaderID);
+    /// @param wait If false, the status is not checked. Check it later with checkLinkStatus().
+    void linkShadersToProgram(unsigned int programID, unsigned int fragmentShaderID, unsigned int vertexShaderID,
+                              bool wait = true);
+    
+    /// @brief Wait for the compilation of a shader to finish and log the error if it failed.
+    /// @returns true on success.
+    bool checkCompileStatus(unsigned int shaderID);
     
+    /// @brief Wait for the link of a program to finish and log the error if it failed.
+    /// @returns true on success.
+    bool checkLinkStatus(unsigned int programID);
     
-    void enableDebugging(bool throwOnError = false);
+    /// @brief Check the OpenGL calls depending on the mode chosen at compile time (OPENGL_OBJ_GL_MODE in CMake).
+    /// @details
+    /// - OPENGL_OBJ_GL_DEBUG: log the errors and warnings of the KHR_debug message callback, which the driver calls
+    ///   itself instead of polling glGetError() after each call. Without KHR_debug, GLAD still polls glGetError().
+    /// - OPENGL_OBJ_GL_STATS: count the calls with gl::stats, without checking the errors.
+    /// - Else nothing, GLAD should be compiled with GLAD_NO_DEBUG so the calls have no callback at all.
+    /// @param synchronous Report the messages during the faulty call, so a breakpoint in the callback shows where it
+    /// comes from. Slower.
+    /// @remarks The context must be current.
+    void enableDebugging(bool synchronous = false);
 };
 
@@ -0,0 +1,250 @@
+#include "registry.hpp"
+#include "extensions.hpp"
+#include <algorithm>
+#include <array>
+#include <cassert>
+
+namespace gl::registry
+{
+    namespace
+    {
+        struct Registry
+        {
+            std::unordered_map<GLuint, Resource> resources;
+            Totals totals;
+        };
+        
+        std::array<Registry, TypeCount> registries;
+        
+        Registry& get(Type type)
+        {
+            return registries[static_cast<std::size_t>(type)];
+        }
+        
+        /// @brief Replace the size of a resource in the totals.
+        void setBytes(Type type, Resource& resource, std::size_t bytes)
+        {
+            Totals& totals = get(type).totals;
+            totals.bytes = totals.bytes - resource.bytes + bytes;
+            resource.bytes = bytes;
+        }
+    }
+    
+    void add(Type type, GLuint id)
+    {
+        if(id == 0)
+        {
+            return;
+        }
+        
+        Registry& registry = get(type);
+        
+        const bool inserted = registry.resources.emplace(id, Resource{}).second;
+        assert(inserted && "The resource is already registered");
+        
+        if(inserted)
+        {
+            registry.totals.count++;
+        }
+    }
+    
+    void remove(Type type, GLuint id)
+    {
+        Registry& registry = get(type);
+        
+        auto it = registry.resources.find(id);
+        if(it == registry.resources.end())
+        {
+            return;
+        }
+        
+        registry.totals.count--;
+        registry.totals.bytes -= it->second.bytes;
+        registry.resources.erase(it);
+    }
+    
+    void setLabel(Type type, GLuint id, std::string label)
+    {
+        auto& resources = get(type).resources;
+        
+        auto it = resources.find(id);
+        if(it != resources.end())
+        {
+            it->second.label = std::move(label);
+        }
+    }
+    
+    void setBufferStorage(GLuint id, std::size_t bytes)
+    {
+        auto& resources = get(Type::Buffer).resources;
+        
+        auto it = resources.find(id);
+        if(it != resources.end())
+        {
+            setBytes(Type::Buffer, it->second, bytes);
+        }
+    }
+    
+    void setImageStorage(Type type, GLuint id, GLenum internalFormat, glm::ivec3 size, int levels)
+    {
+        assert(type == Type::Texture || type == Type::Renderbuffer);
+        
+        auto& resources = get(type).resources;
+        
+        auto it = resources.find(id);
+        if(it == resources.end())
+        {
+            return;
+        }
+        
+        if(levels <= 0)
+        {
+            levels = getMipmapLevels(size);
+        }
+        
+        // The layers of an array are not reduced by the mipmaps, unlike the depth of a 3D texture
+        std::size_t bytes = 0;
+        for(int level = 0; level < levels; ++level)
+        {
+            bytes += getImageBytes(internalFormat, {std::max(size.x >> level, 1), std::max(size.y >> level, 1)}) * size.z;
+        }
+        
+        Resource& resource = it->second;
+        resource.size = size;
+        resource.format = internalFormat;
+        resource.levels = levels;
+        setBytes(type, resource, bytes);
+    }
+    
+    const Resource *find(Type type, GLuint id)
+    {
+        const auto& resources = get(type).resources;
+        
+        auto it = resources.find(id);
+        return it == resources.end() ? nullptr : &it->second;
+    }
+    
+    const std::unordered_map<GLuint, Resource>& getResources(Type type)
+    {
+        return get(type).resources;
+    }
+    
+    const Totals& getTotals(Type type)
+    {
+        return get(type).totals;
+    }
+    
+    const char *getName(Type type)
+    {
+        switch(type)
+        {
+            case Type::Buffer: return "Buffers";
+            case Type::Texture: return "Textures";
+            case Type::Framebuffer: return "Framebuffers";
+            case Type::Renderbuffer: return "Renderbuffers";
+            case Type::VertexArray: return "Vertex arrays";
+        }
+        
+        return "";
+    }
+    
+    std::size_t getBytesPerPixel(GLenum internalFormat)
+    {
+        switch(internalFormat)
+        {
+            case GL_RED:
+            case GL_R8:
+            case GL_R8UI:
+            case GL_R8I:
+            case GL_STENCIL_INDEX8:
+                return 1;
+            
+            case GL_RG:
+            case GL_RG8:
+            case GL_RG8UI:
+            case GL_RG8I:
+            case GL_R16F:
+            case GL_R16UI:
+            case GL_R16I:
+            case GL_DEPTH_COMPONENT16:
+                return 2;
+            
+            // The drivers pad the 24 bits formats to 32 bits
+            case GL_RGB:
+            case GL_RGB8:
+            case GL_SRGB8:
+            case GL_RGBA:
+            case GL_RGBA8:
+            case GL_SRGB8_ALPHA8:
+            case GL_RGBA8UI:
+            case GL_RGBA8I:
+            case GL_RG16F:
+            case GL_RG16UI:
+            case GL_RG16I:
+            case GL_R32F:
+            case GL_R32UI:
+            case GL_R32I:
+            case GL_R11F_G11F_B10F:
+            case GL_DEPTH_COMPONENT:
+            case GL_DEPTH_COMPONENT24:
+            case GL_DEPTH_COMPONENT32F:
+            case GL_DEPTH_STENCIL:
+            case GL_DEPTH24_STENCIL8:
+                return 4;
+            
+            case GL_RGB16F:
+            case GL_RGBA16F:
+            case GL_RGBA16UI:
+            case GL_RGBA16I:
+            case GL_RG32F:
+            case GL_RG32UI:
+            case GL_RG32I:
+            case GL_DEPTH32F_STENCIL8:
+                return 8;
+            
+            case GL_RGBA32F:
+            case GL_RGBA32UI:
+            case GL_RGBA32I:
+                return 16;
+            
+            case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+            case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+            case GL_COMPRESSED_RGBA_BPTC_UNORM:
+                return 0;
+            
+            default:
+                assert(false && "Unknown internal format, add it to getBytesPerPixel()");
+                return 4;
+        }
+    }
+    
+    std::size_t getImageBytes(GLenum internalFormat, glm::ivec2 size)
+    {
+        const std::size_t blocks = static_cast<std::size_t>((size.x + 3) / 4) * ((size.y + 3) / 4);
+        
+        switch(internalFormat)
+        {
+            case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+                return blocks * 8;
+            
+            case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+            case GL_COMPRESSED_RGBA_BPTC_UNORM:
+                return blocks * 16;
+            
+            default:
+                return static_cast<std::size_t>(size.x) * size.y * getBytesPerPixel(internalFormat);
+        }
+    }
+    
+    int getMipmapLevels(glm::ivec3 size)
+    {
+        int levels = 1;
+        
+        for(int extent = std::max(size.x, size.y); extent > 1; extent >>= 1)
+        {
+            levels++;
+        }
+        
+        return levels;
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/vec3.hpp>
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+
+namespace gl
+{
+    /// @brief Live OpenGL resources, with their estimated memory, to inspect them without querying the driver.
+    /// @details
+    /// The gl::raii wrappers add and remove themselves, the code allocating the storage describes it:
+    ///     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, ...);
+    ///     registry::setImageStorage(registry::Type::Texture, texture, GL_RGBA8, {w, h, 1});
+    /// The sizes are estimations from the formats, the driver may pad or compress.
+    /// @remarks Not thread-safe, only from the thread of the context.
+    namespace registry
+    {
+        enum class Type
+        {
+            Buffer,
+            Texture,
+            Framebuffer,
+            Renderbuffer,
+            VertexArray
+        };
+        
+        constexpr std::size_t TypeCount = 5;
+        
+        struct Resource
+        {
+            std::string label;
+            glm::ivec3 size{0}; ///< Width, height and layers of an image, 0 if it has no storage
+            GLenum format{0}; ///< Internal format of an image
+            int levels{1}; ///< Mipmap levels of an image
+            std::size_t bytes{0};
+        };
+        
+        /// @brief Sum of the resources of a type.
+        struct Totals
+        {
+            std::size_t count{0};
+            std::size_t bytes{0};
+        };
+        
+        /// @name
+        /// @brief Called by the gl::raii wrappers.
+        /// @remarks The id 0 is ignored, it's a moved-from wrapper.
+        /// @{
+        void add(Type type, GLuint id);
+        void remove(Type type, GLuint id);
+        /// @}
+        
+        void setLabel(Type type, GLuint id, std::string label);
+        
+        void setBufferStorage(GLuint id, std::size_t bytes);
+        
+        /// @param levels 0 for the full mipmap chain.
+        void setImageStorage(Type type, GLuint id, GLenum internalFormat, glm::ivec3 size, int levels = 1);
+        
+        /// @returns nullptr if the resource is not registered.
+        const Resource *find(Type type, GLuint id);
+        
+        /// @brief The live resources of a type, by id.
+        const std::unordered_map<GLuint, Resource>& getResources(Type type);
+        
+        const Totals& getTotals(Type type);
+        
+        const char *getName(Type type);
+        
+        /// @brief Estimated size of a pixel in the memory of the GPU.
+        /// @remarks 0 for the block compressed formats. Asserts on the unknown formats, counted as 4 bytes.
+        std::size_t getBytesPerPixel(GLenum internalFormat);
+        
+        /// @brief Estimated size of a 2D image (or of a layer) in the memory of the GPU, without mipmaps.
+        /// @details The block compressed formats are counted by blocks of 4x4 pixels.
+        std::size_t getImageBytes(GLenum internalFormat, glm::ivec2 size);
+        
+        /// @brief Count of levels of a full mipmap chain, down to 1x1.
+        int getMipmapLevels(glm::ivec3 size);
+    }
+}
@@ -0,0 +1,150 @@
+#include "stats.hpp"
+#include <unordered_map>
+#include <string_view>
+#include <iostream>
+
+namespace gl::stats
+{
+    namespace
+    {
+        Counters counters;
+        std::vector<EntryPoint> entryPoints;
+        bool enabled{false};
+        
+        bool startsWithAny(std::string_view name, std::initializer_list<std::string_view> prefixes)
+        {
+            for(std::string_view prefix : prefixes)
+            {
+                if(name.starts_with(prefix))
+                {
+                    return true;
+                }
+            }
+            
+            return false;
+        }
+        
+        Kind classify(std::string_view name)
+        {
+            if(name.starts_with("glDraw"))
+            {
+                return Kind::Draw;
+            }
+            
+            if(name.starts_with("glUniform"))
+            {
+                return Kind::Uniform;
+            }
+            
+            if(startsWithAny(name, {"glBind", "glUseProgram"}))
+            {
+                return Kind::Bind;
+            }
+            
+            if(startsWithAny(name, {"glTexImage", "glTexSubImage", "glCompressedTex", "glBufferData", "glBufferSubData"}))
+            {
+                return Kind::Upload;
+            }
+            
+            if(startsWithAny(name, {
+                "glEnable", "glDisable", "glActiveTexture",
+                "glBlend", "glDepthFunc", "glDepthMask", "glStencil", "glColorMask", "glCullFace", "glFrontFace",
+                "glPolygonOffset", "glViewport", "glScissor", "glClearColor", "glClearDepth", "glPixelStore"
+            }))
+            {
+                return Kind::State;
+            }
+            
+            return Kind::Other;
+        }
+        
+        void count(const char *name, void *, int, ...)
+        {
+            // GLAD passes the same literal for each entry point, so the entry points are cached by address
+            static std::unordered_map<const char *, std::size_t> indices;
+            
+            auto it = indices.find(name);
+            if(it == indices.end())
+            {
+                it = indices.emplace(name, entryPoints.size()).first;
+                entryPoints.push_back({name, classify(name), 0});
+            }
+            
+            EntryPoint& entryPoint = entryPoints[it->second];
+            entryPoint.calls++;
+            counters.calls++;
+            
+            switch(entryPoint.kind)
+            {
+                case Kind::Draw: counters.drawCalls++; break;
+                case Kind::Bind: counters.binds++; counters.stateChanges++; break;
+                case Kind::State: counters.stateChanges++; break;
+                case Kind::Upload: counters.uploads++; break;
+                case Kind::Uniform: counters.uniforms++; break;
+                case Kind::Other: break;
+            }
+        }
+        
+        void ignore(const char *, void *, int, ...)
+        {
+        }
+    }
+    
+    void enable()
+    {
+#ifdef GLAD_NO_DEBUG
+        std::cerr << "The OpenGL calls can't be counted, GLAD is compiled without its callbacks" << std::endl;
+#else
+        glad_set_pre_callback(count);
+        enabled = true;
+#endif
+    }
+    
+    void disable()
+    {
+#ifndef GLAD_NO_DEBUG
+        glad_set_pre_callback(ignore);
+#endif
+        enabled = false;
+    }
+    
+    bool isEnabled()
+    {
+        return enabled;
+    }
+    
+    const Counters& get()
+    {
+        return counters;
+    }
+    
+    const std::vector<EntryPoint>& getEntryPoints()
+    {
+        return entryPoints;
+    }
+    
+    const char *getName(Kind kind)
+    {
+        switch(kind)
+        {
+            case Kind::Draw: return "Draw";
+            case Kind::Bind: return "Bind";
+            case Kind::State: return "State";
+            case Kind::Upload: return "Upload";
+            case Kind::Uniform: return "Uniform";
+            case Kind::Other: break;
+        }
+        
+        return "Other";
+    }
+    
+    void reset()
+    {
+        counters = {};
+        
+        for(EntryPoint& entryPoint : entryPoints)
+        {
+            entryPoint.calls = 0;
+        }
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <vector>
+
+namespace gl
+{
+    /// @brief Count the OpenGL calls going through GLAD, to compare the cost of frames independently of the timings.
+    /// @remarks Uses the pre-call callback of the GLAD debug loader, so only counts after enable(), and never when
+    /// compiled with GLAD_NO_DEBUG.
+    namespace stats
+    {
+        /// @brief What an entry point does, guessed from its name.
+        enum class Kind
+        {
+            Other,
+            Draw, ///< glDraw*
+            Bind, ///< glBind* and glUseProgram
+            State, ///< glEnable/glDisable and fixed function state
+            Upload, ///< glTexImage*, glTexSubImage*, glCompressedTex*, glBufferData and glBufferSubData
+            Uniform ///< glUniform*
+        };
+        
+        /// @brief Counts of calls since the last reset().
+        struct Counters
+        {
+            unsigned int calls{0}; ///< All the calls, including the queries
+            unsigned int drawCalls{0}; ///< glDraw*
+            unsigned int binds{0}; ///< Kind::Bind
+            unsigned int stateChanges{0}; ///< Binds and other state, Kind::Bind and Kind::State
+            unsigned int uploads{0}; ///< Kind::Upload
+            unsigned int uniforms{0}; ///< glUniform*
+        };
+        
+        /// @brief Calls of a single entry point since the last reset().
+        struct EntryPoint
+        {
+            const char *name;
+            Kind kind;
+            unsigned int calls;
+        };
+        
+        /// @brief Start counting, by setting the pre-call callback of GLAD.
+        void enable();
+        
+        /// @brief Stop counting, the counters are kept. The pre-call callback of GLAD does nothing after.
+        void disable();
+        
+        bool isEnabled();
+        
+        const Counters& get();
+        
+        /// @brief All the entry points called since enable(), in the order of their first call.
+        /// @remarks An entry point not called since the last reset() is kept, with 0 calls.
+        const std::vector<EntryPoint>& getEntryPoints();
+        
+        const char *getName(Kind kind);
+        
+        /// @brief Set all the counters to 0, for example at the beginning of a frame.
+        void reset();
+    }
+}
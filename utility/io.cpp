@@ -1,9 +1,28 @@
 #include "io.hpp"
+#include <atomic>
 #include <iostream>
 #include <fstream>
+#include <random>
+#include <sstream>
 
 namespace io
 {
+    namespace
+    {
+        /// @brief A suffix unique to each call, so the concurrent writers of a file don't share a temporary file.
+        /// @details Random for each process, so the other instances of the program don't collide either, then a
+        /// counter for the threads of this one.
+        std::string getTemporarySuffix()
+        {
+            static const std::uint64_t process = std::uint64_t{std::random_device{}()} << 32 | std::random_device{}();
+            static std::atomic<std::uint64_t> counter{0};
+            
+            std::ostringstream suffix;
+            suffix << '.' << std::hex << process << '.' << counter++ << ".tmp";
+            return suffix.str();
+        }
+    }
+    
     std::string readAll(const std::filesystem::path& path)
     {
         if(!std::filesystem::is_regular_file(path))
@@ -18,4 +37,61 @@ namespace io
         
         return str;
     }
+    
+    std::vector<char> readBinary(const std::filesystem::path& path)
+    {
+        std::ifstream ifs(path, std::ios::binary);
+        if(!ifs)
+        {
+            return {};
+        }
+        
+        return std::vector<char>((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    }
+    
+    bool writeBinary(const std::filesystem::path& path, const void *data, std::size_t size)
+    {
+        std::error_code error;
+        std::filesystem::create_directories(path.parent_path(), error);
+        
+        std::filesystem::path tmp{path};
+        tmp += getTemporarySuffix();
+        
+        {
+            std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+            ofs.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+            
+            if(!ofs)
+            {
+                std::cerr << "Failed to write the file " << tmp << std::endl;
+                ofs.close();
+                std::filesystem::remove(tmp, error);
+                return false;
+            }
+        }
+        
+        // The last writer wins, each rename replaces the whole file
+        std::filesystem::rename(tmp, path, error);
+        if(error)
+        {
+            std::cerr << "Failed to rename " << tmp << " to " << path << ": " << error.message() << std::endl;
+            std::filesystem::remove(tmp, error);
+            return false;
+        }
+        
+        return true;
+    }
+    
+    std::uint64_t hash(std::string_view data, std::uint64_t seed)
+    {
+        std::uint64_t h = seed;
+        
+        for(unsigned char c : data)
+        {
+            h ^= c;
+            h *= 1099511628211ull;
+        }
+        
+        return h;
+    }
 }
\ No newline at end of file
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <string_view>
+#include <vector>
 #include <filesystem>
 
 namespace io
@@ -8,5 +11,19 @@ namespace io
     /// @brief Read all the content of a file into a string.
     /// @remarks Returns an empty string and log to std::err if there is an error.
     std::string readAll(const std::filesystem::path& path);
+    
+    /// @brief Read all the content of a binary file.
+    /// @remarks Returns an empty vector if the file can't be read, without logging: a missing file may be expected.
+    std::vector<char> readBinary(const std::filesystem::path& path);
+    
+    /// @brief Write a binary file, creating the parent directories if needed.
+    /// @details Written to a temporary file first then renamed, so a concurrent reader never sees a partial file.
+    /// Each call has its own temporary file, so concurrent writers of the same file don't mix their content.
+    /// @returns false and log to std::err if there is an error.
+    bool writeBinary(const std::filesystem::path& path, const void *data, std::size_t size);
+    
+    /// @brief FNV-1a hash, not cryptographic but good enough as a cache key.
+    /// @param seed The hash of the previous data, to chain the hashes.
+    std::uint64_t hash(std::string_view data, std::uint64_t seed = 14695981039346656037ull);
 }
 
@@ -0,0 +1,59 @@
+#include "AABB.hpp"
+#include <glm/glm.hpp>
+
+namespace math
+{
+    bool AABB::isEmpty() const
+    {
+        return min.x > max.x || min.y > max.y || min.z > max.z;
+    }
+    
+    void AABB::extend(const glm::vec3& point)
+    {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+    
+    void AABB::extend(const AABB& box)
+    {
+        min = glm::min(min, box.min);
+        max = glm::max(max, box.max);
+    }
+    
+    glm::vec3 AABB::center() const
+    {
+        return (min + max) * 0.5f;
+    }
+    
+    glm::vec3 AABB::extent() const
+    {
+        return (max - min) * 0.5f;
+    }
+    
+    AABB AABB::transformed(const glm::mat4& matrix) const
+    {
+        if(isEmpty())
+        {
+            return {};
+        }
+        
+        // Start from the translation, then each matrix element adds its smallest and biggest contribution
+        AABB ret;
+        ret.min = glm::vec3{matrix[3]};
+        ret.max = ret.min;
+        
+        for(int col = 0; col < 3; ++col)
+        {
+            for(int row = 0; row < 3; ++row)
+            {
+                const float a = matrix[col][row] * min[col];
+                const float b = matrix[col][row] * max[col];
+                
+                ret.min[row] += glm::min(a, b);
+                ret.max[row] += glm::max(a, b);
+            }
+        }
+        
+        return ret;
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+#include <limits>
+
+namespace math
+{
+    /// @brief Axis-aligned bounding box.
+    /// @details Empty by default: min is +infinity and max is -infinity, so extending it with any point
+    /// gives a box containing only this point.
+    struct AABB
+    {
+        glm::vec3 min{std::numeric_limits<float>::max()};
+        glm::vec3 max{std::numeric_limits<float>::lowest()};
+        
+        bool isEmpty() const;
+        
+        /// @brief Grow the box to contain a point.
+        void extend(const glm::vec3& point);
+        
+        /// @brief Grow the box to contain another box.
+        void extend(const AABB& box);
+        
+        glm::vec3 center() const;
+        
+        /// @brief Half of the size of the box.
+        glm::vec3 extent() const;
+        
+        /// @brief Get the smallest box containing this box transformed by a matrix.
+        /// @details Cheaper than transforming the 8 corners (Arvo's method).
+        AABB transformed(const glm::mat4& matrix) const;
+    };
+}
@@ -0,0 +1,400 @@
+#include "BVH.hpp"
+#include <utility/ThreadPool.hpp>
+#include <glm/common.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace math
+{
+    namespace
+    {
+        /// @brief Count of boxes from which the binning of a range is split between the workers.
+        constexpr std::uint32_t ParallelBinning = 1 << 14;
+        
+        /// @brief Count of boxes from which the two halves of a range are built in parallel.
+        constexpr std::uint32_t ParallelBuild = 1 << 12;
+        
+        /// @brief Half of the surface area, 0 for an empty box.
+        float area(const AABB& box)
+        {
+            // AABB::isEmpty(), inlined in the sweeps of split()
+            if(box.min.x > box.max.x || box.min.y > box.max.y || box.min.z > box.max.z)
+            {
+                return 0.0f;
+            }
+            
+            const glm::vec3 size = box.max - box.min;
+            return size.x * size.y + size.y * size.z + size.z * size.x;
+        }
+        
+        /// @brief AABB::extend(), inlined in the loops over the boxes and the bins.
+        void grow(AABB& box, const AABB& other)
+        {
+            box.min = glm::min(box.min, other.min);
+            box.max = glm::max(box.max, other.max);
+        }
+        
+        struct Bins
+        {
+            AABB bounds[3][BVH::BinCount];
+            std::uint32_t counts[3][BVH::BinCount]{};
+        };
+    }
+    
+    void BVH::build(std::vector<AABB> boxes)
+    {
+        m_boxes = std::move(boxes);
+        m_nodes.clear();
+        m_references.resize(m_boxes.size());
+        
+        for(std::size_t i = 0; i < m_boxes.size(); ++i)
+        {
+            m_references[i] = {m_boxes[i], static_cast<std::uint32_t>(i)};
+        }
+        
+        if(!m_boxes.empty())
+        {
+            m_nodes.reserve(m_boxes.size() / 2 + 1);
+            buildNode(0, static_cast<std::uint32_t>(m_boxes.size()), 0, m_nodes);
+        }
+        
+        m_indices.resize(m_references.size());
+        for(std::size_t i = 0; i < m_references.size(); ++i)
+        {
+            m_indices[i] = m_references[i].index;
+        }
+        
+        m_builtCost = getCost();
+    }
+    
+    bool BVH::update(const std::vector<AABB>& boxes)
+    {
+        if(boxes.size() != m_boxes.size() || m_nodes.empty())
+        {
+            build(boxes);
+            return true;
+        }
+        
+        std::copy(boxes.begin(), boxes.end(), m_boxes.begin());
+        refit();
+        
+        if(getCost() > m_builtCost * RebuildRatio)
+        {
+            ++m_rebuilds;
+            build(std::move(m_boxes));
+            return true;
+        }
+        
+        return false;
+    }
+    
+    void BVH::buildNode(std::uint32_t first, std::uint32_t last, int depth, std::vector<Node>& nodes)
+    {
+        const auto index = static_cast<std::uint32_t>(nodes.size());
+        nodes.emplace_back();
+        
+        AABB bounds, centers;
+        for(std::uint32_t i = first; i < last; ++i)
+        {
+            const AABB& box = m_references[i].box;
+            const glm::vec3 center = (box.min + box.max) * 0.5f;
+            grow(bounds, box);
+            centers.min = glm::min(centers.min, center);
+            centers.max = glm::max(centers.max, center);
+        }
+        
+        const std::uint32_t count = last - first;
+        std::uint32_t middle = first;
+        
+        if(count > MaxLeafSize)
+        {
+            if(depth < MaxDepth - 32)
+            {
+                middle = split(first, last, centers);
+            }
+            
+            // All the centers in the same bin, or too deep: two halves of the same count on the longest axis
+            if(middle == first)
+            {
+                const glm::vec3 extent = centers.max - centers.min;
+                const int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+                
+                middle = first + count / 2;
+                std::nth_element(m_references.begin() + first, m_references.begin() + middle,
+                                 m_references.begin() + last, [&](const Reference& a, const Reference& b) {
+                                     return a.box.min[axis] + a.box.max[axis] < b.box.min[axis] + b.box.max[axis];
+                                 });
+            }
+        }
+        
+        if(middle == first)
+        {
+            nodes[index] = {bounds.min, first, bounds.max, count};
+            return;
+        }
+        
+        std::uint32_t second = 0;
+        
+        if(count >= ParallelBuild)
+        {
+            // The second half is built into its own array, then appended with its children moved by its offset
+            std::vector<Node> nodes2;
+            ThreadPool::global().parallelFor(0, 2, 1, [&](std::size_t begin, std::size_t end) {
+                for(std::size_t half = begin; half < end; ++half)
+                {
+                    if(half == 0)
+                    {
+                        buildNode(first, middle, depth + 1, nodes);
+                    }
+                    else
+                    {
+                        buildNode(middle, last, depth + 1, nodes2);
+                    }
+                }
+            });
+            
+            second = static_cast<std::uint32_t>(nodes.size());
+            for(Node& node : nodes2)
+            {
+                if(!node.isLeaf())
+                {
+                    node.offset += second;
+                }
+            }
+            nodes.insert(nodes.end(), nodes2.begin(), nodes2.end());
+        }
+        else
+        {
+            buildNode(first, middle, depth + 1, nodes);
+            second = static_cast<std::uint32_t>(nodes.size());
+            buildNode(middle, last, depth + 1, nodes);
+        }
+        
+        nodes[index] = {bounds.min, second, bounds.max, 0};
+    }
+    
+    std::uint32_t BVH::split(std::uint32_t first, std::uint32_t last, const AABB& centers)
+    {
+        const glm::vec3 extent = centers.max - centers.min;
+        glm::vec3 scale{0};
+        for(int axis = 0; axis < 3; ++axis)
+        {
+            scale[axis] = extent[axis] > 0.0f ? BinCount / extent[axis] : 0.0f;
+        }
+        
+        const auto bin = [&](const AABB& box, int axis) {
+            const float center = (box.min[axis] + box.max[axis]) * 0.5f;
+            const int b = static_cast<int>((center - centers.min[axis]) * scale[axis]);
+            return b < BinCount ? b : BinCount - 1;
+        };
+        
+        const auto accumulate = [&](Bins& bins, std::uint32_t from, std::uint32_t to) {
+            for(std::uint32_t i = from; i < to; ++i)
+            {
+                const AABB& box = m_references[i].box;
+                for(int axis = 0; axis < 3; ++axis)
+                {
+                    const int b = bin(box, axis);
+                    ++bins.counts[axis][b];
+                    grow(bins.bounds[axis][b], box);
+                }
+            }
+        };
+        
+        Bins bins;
+        const std::uint32_t count = last - first;
+        
+        if(count >= ParallelBinning)
+        {
+            // Each range into its own bins, then merged
+            const std::uint32_t grain = ParallelBinning / 4;
+            std::vector<Bins> partial((count + grain - 1) / grain);
+            
+            ThreadPool::global().parallelFor(first, last, grain, [&](std::size_t from, std::size_t to) {
+                accumulate(partial[(from - first) / grain], static_cast<std::uint32_t>(from),
+                           static_cast<std::uint32_t>(to));
+            });
+            
+            for(const Bins& range : partial)
+            {
+                for(int axis = 0; axis < 3; ++axis)
+                {
+                    for(int b = 0; b < BinCount; ++b)
+                    {
+                        bins.counts[axis][b] += range.counts[axis][b];
+                        grow(bins.bounds[axis][b], range.bounds[axis][b]);
+                    }
+                }
+            }
+        }
+        else
+        {
+            accumulate(bins, first, last);
+        }
+        
+        // Cost of a split before each bin: the areas of the two halves weighted by their counts
+        float bestCost = std::numeric_limits<float>::max();
+        int bestAxis = -1;
+        int bestBin = 0;
+        
+        for(int axis = 0; axis < 3; ++axis)
+        {
+            if(scale[axis] == 0.0f)
+            {
+                continue;
+            }
+            
+            float rightArea[BinCount];
+            std::uint32_t rightCount[BinCount];
+            AABB box;
+            std::uint32_t n = 0;
+            
+            for(int b = BinCount - 1; b > 0; --b)
+            {
+                grow(box, bins.bounds[axis][b]);
+                n += bins.counts[axis][b];
+                rightArea[b] = area(box);
+                rightCount[b] = n;
+            }
+            
+            box = {};
+            n = 0;
+            
+            for(int b = 0; b + 1 < BinCount; ++b)
+            {
+                grow(box, bins.bounds[axis][b]);
+                n += bins.counts[axis][b];
+                
+                if(n == 0 || rightCount[b + 1] == 0)
+                {
+                    continue;
+                }
+                
+                const float cost = area(box) * n + rightArea[b + 1] * rightCount[b + 1];
+                if(cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = b + 1;
+                }
+            }
+        }
+        
+        if(bestAxis < 0)
+        {
+            return first;
+        }
+        
+        const auto middle = std::partition(m_references.begin() + first, m_references.begin() + last,
+                                           [&](const Reference& reference) {
+                                               return bin(reference.box, bestAxis) < bestBin;
+                                           });
+        return static_cast<std::uint32_t>(middle - m_references.begin());
+    }
+    
+    void BVH::refit()
+    {
+        for(std::size_t i = m_nodes.size(); i-- > 0;)
+        {
+            Node& node = m_nodes[i];
+            AABB bounds;
+            
+            if(node.isLeaf())
+            {
+                for(std::uint32_t j = node.offset; j < node.offset + node.count; ++j)
+                {
+                    grow(bounds, m_boxes[m_indices[j]]);
+                }
+            }
+            else
+            {
+                grow(bounds, AABB{m_nodes[i + 1].min, m_nodes[i + 1].max});
+                grow(bounds, AABB{m_nodes[node.offset].min, m_nodes[node.offset].max});
+            }
+            
+            node.min = bounds.min;
+            node.max = bounds.max;
+        }
+    }
+    
+    float BVH::intersect(const glm::vec3& min, const glm::vec3& max, const glm::vec3& origin,
+                         const glm::vec3& inverse, float maxDistance)
+    {
+        if(min.x > max.x || min.y > max.y || min.z > max.z)
+        {
+            return std::numeric_limits<float>::infinity();
+        }
+        
+        // Slabs: the distances to the planes of the box on each axis
+        const glm::vec3 t0 = (min - origin) * inverse;
+        const glm::vec3 t1 = (max - origin) * inverse;
+        const glm::vec3 near = glm::min(t0, t1);
+        const glm::vec3 far = glm::max(t0, t1);
+        
+        const float entry = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+        const float exit = std::min(std::min(far.x, far.y), std::min(far.z, maxDistance));
+        
+        return entry <= exit ? entry : std::numeric_limits<float>::infinity();
+    }
+    
+    glm::vec3 BVH::inverseDirection(const glm::vec3& direction)
+    {
+        glm::vec3 inverse;
+        for(int axis = 0; axis < 3; ++axis)
+        {
+            const float d = direction[axis];
+            inverse[axis] = 1.0f / (std::abs(d) > 1e-30f ? d : std::copysign(1e-30f, d));
+        }
+        
+        return inverse;
+    }
+    
+    AABB BVH::getBounds() const
+    {
+        return m_nodes.empty() ? AABB{} : AABB{m_nodes[0].min, m_nodes[0].max};
+    }
+    
+    float BVH::getCost() const
+    {
+        const float root = area(getBounds());
+        if(root <= 0.0f)
+        {
+            return 0.0f;
+        }
+        
+        // Probability of a ray hitting a node: the ratio of its area to the area of the root
+        float cost = 0.0f;
+        for(const Node& node : m_nodes)
+        {
+            const float nodeArea = area(AABB{node.min, node.max});
+            cost += node.isLeaf() ? nodeArea * node.count : nodeArea;
+        }
+        
+        return cost / root;
+    }
+    
+    float BVH::getBuiltCost() const
+    {
+        return m_builtCost;
+    }
+    
+    std::size_t BVH::getRebuildCount() const
+    {
+        return m_rebuilds;
+    }
+    
+    const std::vector<BVH::Node>& BVH::getNodes() const
+    {
+        return m_nodes;
+    }
+    
+    const std::vector<std::uint32_t>& BVH::getIndices() const
+    {
+        return m_indices;
+    }
+    
+    const std::vector<AABB>& BVH::getBoxes() const
+    {
+        return m_boxes;
+    }
+}
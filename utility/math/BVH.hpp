@@ -0,0 +1,254 @@
+#pragma once
+
+#include "AABB.hpp"
+#include <glm/vec3.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace math
+{
+    /// @brief Bounding volume hierarchy over boxes, to cull and cast rays against many objects without testing each.
+    /// @details
+    /// Built top-down with the surface area heuristic, evaluated on BinCount bins of the centers on each axis. The
+    /// binning of the large ranges and the two halves of the large splits run in parallel on the ThreadPool.
+    /// The nodes are stored depth first in one array of 32 bytes nodes: the first child of a node is the next node,
+    /// so the traversals mostly walk forward in memory.
+    /// When the boxes move, update() refits the nodes in a single backward pass. The refitted boxes overlap more and
+    /// more, so the tree is rebuilt once its cost grew by RebuildRatio since it was built.
+    ///     bvh.build(boxes);
+    ///     bvh.query([&](const AABB& box) { return frustum.intersects(box); },
+    ///               [&](std::uint32_t index) { draw(objects[index]); });
+    /// @remarks Pure CPU.
+    class BVH
+    {
+    public:
+        struct Node
+        {
+            glm::vec3 min;
+            std::uint32_t offset; ///< Of a leaf: its first index in getIndices(). Else: its second child.
+            glm::vec3 max;
+            std::uint32_t count; ///< Of a leaf: count of its indices. 0 for the others, whose first child is next.
+            
+            bool isLeaf() const { return count > 0; }
+        };
+        
+        /// @brief The ranges of at most this size are leaves.
+        static constexpr std::uint32_t MaxLeafSize = 4;
+        
+        static constexpr int BinCount = 16;
+        
+        /// @brief Bound of the depth of the tree, so the stacks of the traversals can't overflow: deeper than
+        /// MaxDepth - 32, the ranges are split in two halves of the same count instead of by the heuristic.
+        static constexpr int MaxDepth = 64;
+        
+        /// @brief Growth of getCost() after which update() rebuilds instead of refitting.
+        static constexpr float RebuildRatio = 1.5f;
+        
+        /// @brief Build the tree over boxes, the indices of the queries are their indices.
+        void build(std::vector<AABB> boxes);
+        
+        /// @brief Move the boxes: refit the tree, or rebuild it if it degraded or the count of boxes changed.
+        /// @details The boxes are copied into the storage of the tree, which is reused when their count is the same.
+        /// @returns true if the tree was rebuilt.
+        bool update(const std::vector<AABB>& boxes);
+        
+        /// @brief Call visit(index) for each box passing test(box), skipping the nodes which fail test(bounds).
+        /// @param test Must be conservative: true for a node if it may be true for one of its boxes.
+        template<typename Test, typename Visit>
+        void query(Test&& test, Visit&& visit) const;
+        
+        /// @brief Find the closest hit of a ray, visiting the boxes in the order they are entered.
+        /// @param hit hit(index, maxDistance) returns the distance of the hit of the ray on the object of the box, or
+        /// any value over maxDistance if it misses or is farther.
+        /// @returns The distance of the closest hit, maxDistance if nothing was hit (clamped to the largest float).
+        template<typename Hit>
+        float raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Hit&& hit) const;
+        
+        /// @brief Distance where a ray enters a box, 0 if it starts inside.
+        /// @param inverse 1 / direction, see inverseDirection().
+        /// @returns Infinity if it misses the box or enters it beyond maxDistance.
+        static float intersect(const glm::vec3& min, const glm::vec3& max, const glm::vec3& origin,
+                               const glm::vec3& inverse, float maxDistance);
+        
+        /// @brief 1 / direction, with the null components replaced by a tiny value to never compute 0 * infinity.
+        static glm::vec3 inverseDirection(const glm::vec3& direction);
+        
+        /// @brief Bounds of all the boxes.
+        AABB getBounds() const;
+        
+        /// @brief The surface area heuristic of the tree: the expected count of nodes and boxes tested by a ray.
+        float getCost() const;
+        
+        /// @brief getCost() of the tree when it was last built.
+        float getBuiltCost() const;
+        
+        /// @brief Count of rebuilds by update() because the tree degraded.
+        std::size_t getRebuildCount() const;
+        
+        const std::vector<Node>& getNodes() const;
+        const std::vector<std::uint32_t>& getIndices() const;
+        const std::vector<AABB>& getBoxes() const;
+    
+    private:
+        /// @brief Build the node of the range [first, last) of m_references, and its descendants, at the end of nodes.
+        void buildNode(std::uint32_t first, std::uint32_t last, int depth, std::vector<Node>& nodes);
+        
+        /// @brief Partition a range at the best split of the heuristic.
+        /// @returns The index of the first of the second half, or first if no split is better than the others.
+        std::uint32_t split(std::uint32_t first, std::uint32_t last, const AABB& centers);
+        
+        /// @brief Recompute the bounds of the nodes from the boxes, the children are after their parent.
+        void refit();
+        
+        /// @brief A box with its index, while building: the ranges are partitioned by moving them, not their indices,
+        /// so the bins of a range read contiguous memory.
+        struct Reference
+        {
+            AABB box;
+            std::uint32_t index;
+        };
+        
+        std::vector<Node> m_nodes;
+        std::vector<std::uint32_t> m_indices; ///< Of the boxes, the leaves are ranges of it
+        std::vector<AABB> m_boxes;
+        std::vector<Reference> m_references;
+        
+        float m_builtCost{0};
+        std::size_t m_rebuilds{0};
+    };
+    
+    template<typename Test, typename Visit>
+    void BVH::query(Test&& test, Visit&& visit) const
+    {
+        if(m_nodes.empty())
+        {
+            return;
+        }
+        
+        // At most a second child is waiting for each level
+        std::uint32_t stack[MaxDepth + 1];
+        int size = 0;
+        stack[size++] = 0;
+        
+        while(size > 0)
+        {
+            const Node& node = m_nodes[stack[--size]];
+            
+            if(!test(AABB{node.min, node.max}))
+            {
+                continue;
+            }
+            
+            if(node.isLeaf())
+            {
+                for(std::uint32_t i = node.offset; i < node.offset + node.count; ++i)
+                {
+                    const std::uint32_t index = m_indices[i];
+                    
+                    // A leaf of a single box already passed
+                    if(node.count == 1 || test(m_boxes[index]))
+                    {
+                        visit(index);
+                    }
+                }
+                continue;
+            }
+            
+            stack[size++] = node.offset;
+            stack[size++] = static_cast<std::uint32_t>(&node - m_nodes.data()) + 1;
+        }
+    }
+    
+    template<typename Hit>
+    float BVH::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Hit&& hit) const
+    {
+        if(m_nodes.empty())
+        {
+            return maxDistance;
+        }
+        
+        // The misses are at infinity, always farther
+        if(!(maxDistance < std::numeric_limits<float>::max()))
+        {
+            maxDistance = std::numeric_limits<float>::max();
+        }
+        
+        const glm::vec3 inverse = inverseDirection(direction);
+        
+        if(intersect(m_nodes[0].min, m_nodes[0].max, origin, inverse, maxDistance) > maxDistance)
+        {
+            return maxDistance;
+        }
+        
+        // The nodes waiting, with the distance where the ray enters them
+        struct Entry
+        {
+            std::uint32_t node;
+            float distance;
+        };
+        
+        Entry stack[MaxDepth + 1];
+        int size = 0;
+        stack[size++] = {0, 0.0f};
+        
+        while(size > 0)
+        {
+            const Entry entry = stack[--size];
+            
+            // A closer hit was found since it was pushed
+            if(entry.distance > maxDistance)
+            {
+                continue;
+            }
+            
+            const Node& node = m_nodes[entry.node];
+            
+            if(node.isLeaf())
+            {
+                for(std::uint32_t i = node.offset; i < node.offset + node.count; ++i)
+                {
+                    const std::uint32_t index = m_indices[i];
+                    const AABB& box = m_boxes[index];
+                    
+                    if(intersect(box.min, box.max, origin, inverse, maxDistance) <= maxDistance)
+                    {
+                        const float distance = hit(index, maxDistance);
+                        if(distance < maxDistance)
+                        {
+                            maxDistance = distance;
+                        }
+                    }
+                }
+                continue;
+            }
+            
+            // The closest child is popped first, its hits may then skip the other one
+            Entry first{entry.node + 1, 0.0f};
+            Entry second{node.offset, 0.0f};
+            first.distance = intersect(m_nodes[first.node].min, m_nodes[first.node].max, origin, inverse, maxDistance);
+            second.distance = intersect(m_nodes[second.node].min, m_nodes[second.node].max, origin, inverse,
+                                        maxDistance);
+            
+            if(second.distance < first.distance)
+            {
+                const Entry closest = second;
+                second = first;
+                first = closest;
+            }
+            
+            if(second.distance <= maxDistance)
+            {
+                stack[size++] = second;
+            }
+            
+            if(first.distance <= maxDistance)
+            {
+                stack[size++] = first;
+            }
+        }
+        
+        return maxDistance;
+    }
+}
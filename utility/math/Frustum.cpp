@@ -0,0 +1,61 @@
+#include "Frustum.hpp"
+#include <glm/glm.hpp>
+
+namespace math
+{
+    Frustum::Frustum()
+    {
+        // Planes which accept any point
+        for(glm::vec4& plane : planes)
+        {
+            plane = glm::vec4{0, 0, 0, 1};
+        }
+    }
+    
+    Frustum::Frustum(const glm::mat4& m)
+    {
+        // Rows of the matrix, GLM is column major
+        const glm::vec4 row0{m[0][0], m[1][0], m[2][0], m[3][0]};
+        const glm::vec4 row1{m[0][1], m[1][1], m[2][1], m[3][1]};
+        const glm::vec4 row2{m[0][2], m[1][2], m[2][2], m[3][2]};
+        const glm::vec4 row3{m[0][3], m[1][3], m[2][3], m[3][3]};
+        
+        // A point p is inside if -w <= x <= w, -w <= y <= w and -w <= z <= w in clip space
+        planes[0] = row3 + row0;
+        planes[1] = row3 - row0;
+        planes[2] = row3 + row1;
+        planes[3] = row3 - row1;
+        planes[4] = row3 + row2;
+        planes[5] = row3 - row2;
+        
+        for(glm::vec4& plane : planes)
+        {
+            plane /= glm::length(glm::vec3{plane});
+        }
+    }
+    
+    bool Frustum::intersects(const AABB& box) const
+    {
+        if(box.isEmpty())
+        {
+            return false;
+        }
+        
+        for(const glm::vec4& plane : planes)
+        {
+            // Corner of the box the most inside the plane, if even this one is outside the whole box is outside
+            const glm::vec3 positive{
+                plane.x >= 0 ? box.max.x : box.min.x,
+                plane.y >= 0 ? box.max.y : box.min.y,
+                plane.z >= 0 ? box.max.z : box.min.z
+            };
+            
+            if(glm::dot(glm::vec3{plane}, positive) + plane.w < 0)
+            {
+                return false;
+            }
+        }
+        
+        return true;
+    }
+}
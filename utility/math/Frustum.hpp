@@ -0,0 +1,29 @@
+#pragma once
+
+#include "AABB.hpp"
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+namespace math
+{
+    /// @brief The 6 planes of a view frustum, for culling.
+    class Frustum
+    {
+    public:
+        /// @brief Frustum which contains everything.
+        Frustum();
+        
+        /// @brief Extract the planes from a matrix (Gribb-Hartmann method).
+        /// @param viewProj The projection matrix multiplied by the view matrix. The planes are in world coordinates.
+        /// Use proj * view * model to get them in the coordinates of the model instead.
+        explicit Frustum(const glm::mat4& viewProj);
+        
+        /// @brief Check if a box is at least partially inside the frustum.
+        /// @remarks Conservative: a box near a corner of the frustum may be reported as visible when it is not.
+        bool intersects(const AABB& box) const;
+        
+        /// @brief Planes as (normal, distance), the normal points inside the frustum.
+        /// Order: left, right, bottom, top, near, far.
+        glm::vec4 planes[6];
+    };
+}
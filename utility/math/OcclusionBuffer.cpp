@@ -0,0 +1,280 @@
+#include "OcclusionBufferKernel.hpp"
+#include <utility/ThreadPool.hpp>
+#include <glm/common.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace math
+{
+    namespace
+    {
+        /// @brief In pixels.
+        constexpr float EdgeBias = 1.0f / 64.0f;
+    }
+    
+    OcclusionBuffer::OcclusionBuffer(glm::ivec2 size)
+        : m_size{(size + TileSize - 1) / TileSize * TileSize},
+          m_tiles{m_size / TileSize},
+          m_depth(static_cast<std::size_t>(m_size.x) * m_size.y, 1.0f),
+          m_bins(static_cast<std::size_t>(m_tiles.x) * m_tiles.y)
+    {
+    }
+    
+    void OcclusionBuffer::clear(const glm::mat4& viewProj)
+    {
+        m_viewProj = viewProj;
+        std::fill(m_depth.begin(), m_depth.end(), 1.0f);
+        
+        // The bins keep their memory from a frame to the next
+        m_triangles.clear();
+        for(std::vector<std::uint32_t>& bin : m_bins)
+        {
+            bin.clear();
+        }
+        
+        m_rasterized = 0;
+        m_tested = 0;
+        m_occluded = 0;
+    }
+    
+    void OcclusionBuffer::addOccluder(const glm::mat4& model, const glm::vec3 *positions, std::size_t vertexCount,
+                                      std::size_t stride, const unsigned int *indices, std::size_t indexCount)
+    {
+        const glm::mat4 mvp = m_viewProj * model;
+        const auto *bytes = reinterpret_cast<const unsigned char *>(positions);
+        
+        m_vertices.resize(vertexCount);
+        for(std::size_t i = 0; i < vertexCount; ++i)
+        {
+            m_vertices[i] = mvp * glm::vec4{*reinterpret_cast<const glm::vec3 *>(bytes + i * stride), 1};
+        }
+        
+        for(std::size_t i = 0; i + 2 < indexCount; i += 3)
+        {
+            const glm::vec4 triangle[3] = {m_vertices[indices[i]], m_vertices[indices[i + 1]],
+                                           m_vertices[indices[i + 2]]};
+            
+            // Out of the same side of the frustum
+            bool outside = false;
+            for(int axis = 0; axis < 3 && !outside; ++axis)
+            {
+                outside = (triangle[0][axis] > triangle[0].w && triangle[1][axis] > triangle[1].w
+                           && triangle[2][axis] > triangle[2].w)
+                          || (axis < 2 && triangle[0][axis] < -triangle[0].w && triangle[1][axis] < -triangle[1].w
+                              && triangle[2][axis] < -triangle[2].w);
+            }
+            
+            if(outside)
+            {
+                continue;
+            }
+            
+            // Sutherland-Hodgman against the near plane z = -w, like Mirror::screenBounds(): what is in front of it is
+            // not drawn, so it must not hide anything
+            glm::vec4 clipped[4];
+            int count = 0;
+            
+            for(int j = 0; j < 3; ++j)
+            {
+                const glm::vec4& a = triangle[j];
+                const glm::vec4& b = triangle[(j + 1) % 3];
+                const float da = a.z + a.w;
+                const float db = b.z + b.w;
+                
+                if(da >= 0.0f)
+                {
+                    clipped[count++] = a;
+                }
+                
+                if((da >= 0.0f) != (db >= 0.0f))
+                {
+                    clipped[count++] = glm::mix(a, b, da / (da - db));
+                }
+            }
+            
+            for(int j = 2; j < count; ++j)
+            {
+                addTriangle(clipped[0], clipped[j - 1], clipped[j]);
+            }
+        }
+    }
+    
+    void OcclusionBuffer::addTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c)
+    {
+        // To pixels, and the depth to [0, 1] like the depth buffer of OpenGL
+        glm::vec3 p[3];
+        const glm::vec4 *clip[3] = {&a, &b, &c};
+        for(int i = 0; i < 3; ++i)
+        {
+            const glm::vec3 ndc = glm::vec3{*clip[i]} / clip[i]->w;
+            p[i] = {(glm::vec2{ndc} * 0.5f + 0.5f) * glm::vec2{m_size}, ndc.z * 0.5f + 0.5f};
+        }
+        
+        float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[2].x - p[0].x) * (p[1].y - p[0].y);
+        if(std::abs(area) < 1e-6f)
+        {
+            return;
+        }
+        
+        // Both sides are rasterized, in counter-clockwise order so the edge functions are positive inside
+        if(area < 0.0f)
+        {
+            std::swap(p[1], p[2]);
+            area = -area;
+        }
+        
+        // The pixels whose center is in the bounds
+        const glm::vec2 min = glm::min(glm::vec2{p[0]}, glm::min(glm::vec2{p[1]}, glm::vec2{p[2]}));
+        const glm::vec2 max = glm::max(glm::vec2{p[0]}, glm::max(glm::vec2{p[1]}, glm::vec2{p[2]}));
+        
+        Triangle triangle;
+        triangle.min = glm::max(glm::ivec2{glm::ceil(min - 0.5f)}, glm::ivec2{0});
+        triangle.max = glm::min(glm::ivec2{glm::floor(max - 0.5f)}, m_size - 1);
+        
+        if(triangle.min.x > triangle.max.x || triangle.min.y > triangle.max.y)
+        {
+            return;
+        }
+        
+        for(int i = 0; i < 3; ++i)
+        {
+            const glm::vec3& from = p[i];
+            const glm::vec3& to = p[(i + 1) % 3];
+            
+            triangle.edges[i][0] = from.y - to.y;
+            triangle.edges[i][1] = to.x - from.x;
+            triangle.edges[i][2] = -(triangle.edges[i][0] * from.x + triangle.edges[i][1] * from.y);
+            
+            // Pushed out by a fraction of a pixel: a center on the edge shared by two triangles can be rounded out of
+            // both of them, which would leave holes in the occluders
+            triangle.edges[i][2] += EdgeBias * std::hypot(triangle.edges[i][0], triangle.edges[i][1]);
+        }
+        
+        const glm::vec3 d1 = p[1] - p[0];
+        const glm::vec3 d2 = p[2] - p[0];
+        triangle.depth[0] = (d1.z * d2.y - d2.z * d1.y) / area;
+        triangle.depth[1] = (d2.z * d1.x - d1.z * d2.x) / area;
+        triangle.depth[2] = p[0].z - triangle.depth[0] * p[0].x - triangle.depth[1] * p[0].y;
+        
+        const auto index = static_cast<std::uint32_t>(m_triangles.size());
+        m_triangles.push_back(triangle);
+        
+        for(int y = triangle.min.y / TileSize; y <= triangle.max.y / TileSize; ++y)
+        {
+            for(int x = triangle.min.x / TileSize; x <= triangle.max.x / TileSize; ++x)
+            {
+                m_bins[static_cast<std::size_t>(y) * m_tiles.x + x].push_back(index);
+            }
+        }
+    }
+    
+    void OcclusionBuffer::rasterize(simd::Level level)
+    {
+        m_rasterized = m_triangles.size();
+        
+        // The tiles don't share any pixel, so each one is a task
+        ThreadPool::global().parallelFor(0, m_bins.size(), 1, [&](std::size_t first, std::size_t last) {
+            for(std::size_t i = first; i < last; ++i)
+            {
+                const std::vector<std::uint32_t>& bin = m_bins[i];
+                if(bin.empty())
+                {
+                    continue;
+                }
+                
+                const glm::ivec2 origin = glm::ivec2{static_cast<int>(i) % m_tiles.x, static_cast<int>(i) / m_tiles.x}
+                                          * TileSize;
+                const Tile tile{origin, origin + TileSize};
+                
+                const Triangle *triangles = m_triangles.data();
+                bool done = false;
+                if(level == simd::Level::AVX2)
+                {
+                    done = rasterizeTileAVX2(triangles, bin.data(), bin.size(), tile, m_depth.data(), m_size.x);
+                }
+                else if(level == simd::Level::SSE4)
+                {
+                    done = rasterizeTileSSE4(triangles, bin.data(), bin.size(), tile, m_depth.data(), m_size.x);
+                }
+                
+                if(!done)
+                {
+                    detail::rasterizeTile<simd::Float1>(triangles, bin.data(), bin.size(), tile, m_depth.data(),
+                                                        m_size.x);
+                }
+            }
+        });
+    }
+    
+    bool OcclusionBuffer::isVisible(const AABB& box) const
+    {
+        ++m_tested;
+        
+        glm::vec2 min{std::numeric_limits<float>::max()};
+        glm::vec2 max{std::numeric_limits<float>::lowest()};
+        float closest = std::numeric_limits<float>::max();
+        
+        for(int i = 0; i < 8; ++i)
+        {
+            const glm::vec3 corner{i & 1 ? box.max.x : box.min.x, i & 2 ? box.max.y : box.min.y,
+                                   i & 4 ? box.max.z : box.min.z};
+            const glm::vec4 clip = m_viewProj * glm::vec4{corner, 1};
+            
+            // Crosses the near plane, the camera may be in the box
+            if(clip.z + clip.w <= 0.0f)
+            {
+                return true;
+            }
+            
+            const glm::vec3 ndc = glm::vec3{clip} / clip.w;
+            min = glm::min(min, glm::vec2{ndc});
+            max = glm::max(max, glm::vec2{ndc});
+            closest = std::min(closest, ndc.z);
+        }
+        
+        if(max.x < -1.0f || max.y < -1.0f || min.x > 1.0f || min.y > 1.0f)
+        {
+            ++m_occluded;
+            return false;
+        }
+        
+        // The pixels touched by the rectangle, and their neighbors
+        const glm::ivec2 first = glm::max(glm::ivec2{glm::floor((min * 0.5f + 0.5f) * glm::vec2{m_size})} - 1,
+                                          glm::ivec2{0});
+        const glm::ivec2 last = glm::min(glm::ivec2{glm::floor((max * 0.5f + 0.5f) * glm::vec2{m_size})} + 1,
+                                         m_size - 1);
+        const float depth = closest * 0.5f + 0.5f;
+        
+        for(int y = first.y; y <= last.y; ++y)
+        {
+            const float *row = &m_depth[static_cast<std::size_t>(y) * m_size.x];
+            
+            for(int x = first.x; x <= last.x; ++x)
+            {
+                if(row[x] >= depth)
+                {
+                    return true;
+                }
+            }
+        }
+        
+        ++m_occluded;
+        return false;
+    }
+    
+    glm::ivec2 OcclusionBuffer::getSize() const
+    {
+        return m_size;
+    }
+    
+    const std::vector<float>& OcclusionBuffer::getDepth() const
+    {
+        return m_depth;
+    }
+    
+    OcclusionBuffer::Stats OcclusionBuffer::getStats() const
+    {
+        return {m_rasterized, m_tested, m_occluded};
+    }
+}
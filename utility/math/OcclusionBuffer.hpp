@@ -0,0 +1,112 @@
+#pragma once
+
+#include "AABB.hpp"
+#include "simd.hpp"
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace math
+{
+    /// @brief A low resolution depth buffer rasterized on the CPU, to skip the objects hidden behind the occluders.
+    /// @details
+    /// The occluders are a few large meshes (walls, floors). Their triangles are clipped by the near plane, projected,
+    /// then binned into tiles of TileSize x TileSize pixels. rasterize() fills the tiles in parallel on the ThreadPool,
+    /// with the SIMD kernel of the CPU: each lane is a pixel of a row, the closest depth is kept.
+    /// Then the bounds of the other objects are tested against the buffer before drawing them.
+    ///     buffer.clear(proj * view);
+    ///     buffer.addOccluder(model, &vertices[0].pos, vertices.size(), sizeof(Vertex),
+    ///                        indices.data(), indices.size());
+    ///     buffer.rasterize();
+    ///     if(buffer.isVisible(bounds)) // Draw
+    /// @remarks Pure CPU, no OpenGL call.
+    class OcclusionBuffer
+    {
+    public:
+        /// @brief Pixels of the side of a tile, a multiple of the widest SIMD lanes.
+        static constexpr int TileSize = 32;
+        
+        struct Stats
+        {
+            std::size_t triangles{0}; ///< Triangles of the occluders rasterized, after the clipping
+            std::size_t tested{0}; ///< Calls to isVisible() since the last clear(), of instances or nodes of a BVH
+            std::size_t occluded{0}; ///< Of the ones tested
+        };
+        
+        /// @param size In pixels, rounded up to a multiple of TileSize.
+        explicit OcclusionBuffer(glm::ivec2 size = {256, 128});
+        
+        /// @brief Reset the depth to the far plane and drop the occluders, to rasterize a new view.
+        /// @param viewProj The projection matrix multiplied by the view matrix.
+        void clear(const glm::mat4& viewProj);
+        
+        /// @brief Clip, project and bin the triangles of a mesh.
+        /// @param model Transform of the positions to world coordinates.
+        /// @param positions The position of the first vertex, the next ones are stride bytes further.
+        void addOccluder(const glm::mat4& model, const glm::vec3 *positions, std::size_t vertexCount,
+                         std::size_t stride, const unsigned int *indices, std::size_t indexCount);
+        
+        /// @brief Rasterize the triangles added since clear() into the depth buffer.
+        /// @param level The instruction set to use. Defaults to the best one supported by the CPU.
+        void rasterize(simd::Level level = simd::detectLevel());
+        
+        /// @brief Check if a box may be seen, in front of the depth of the rasterized occluders.
+        /// @details Conservative: the box is visible if it crosses the near plane, and its rectangle on the screen is
+        /// grown by a pixel since the occluders only cover the centers of the pixels.
+        /// @param box In world coordinates.
+        /// @returns false if the box is hidden by the occluders or out of the view.
+        bool isVisible(const AABB& box) const;
+        
+        glm::ivec2 getSize() const;
+        
+        /// @brief The depth of each pixel, the first row at the bottom like OpenGL: 0 near, 1 far.
+        const std::vector<float>& getDepth() const;
+        
+        Stats getStats() const;
+        
+        /// @brief A triangle in pixels, ready to be rasterized.
+        struct Triangle
+        {
+            float edges[3][3]; ///< a, b, c of each edge function a * x + b * y + c, positive inside
+            float depth[3]; ///< a, b, c of the plane of the depth
+            glm::ivec2 min, max; ///< Pixels covered, inclusive
+        };
+        
+        /// @brief Pixels of a tile, [min, max).
+        struct Tile
+        {
+            glm::ivec2 min, max;
+        };
+    
+    private:
+        /// @brief Project a triangle in clip coordinates, already clipped by the near plane, and bin it.
+        void addTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c);
+        
+        glm::ivec2 m_size;
+        glm::ivec2 m_tiles; ///< Count of tiles on each axis
+        glm::mat4 m_viewProj{1};
+        
+        std::vector<float> m_depth;
+        std::vector<Triangle> m_triangles;
+        std::vector<std::vector<std::uint32_t>> m_bins; ///< Triangles overlapping each tile
+        std::vector<glm::vec4> m_vertices; ///< Clip space vertices of the last occluder, kept to not allocate each call
+        
+        std::size_t m_rasterized{0};
+        mutable std::size_t m_tested{0};
+        mutable std::size_t m_occluded{0};
+    };
+    
+    /// @name
+    /// @brief Kernels for each instruction set, keep the closest depth of the triangles in the pixels of a tile.
+    /// @param width Of the depth buffer, in pixels.
+    /// @remarks Only call them if the CPU supports the instruction set.
+    /// @returns false if the kernel was not compiled with the instruction set enabled, nothing is computed.
+    /// @{
+    bool rasterizeTileSSE4(const OcclusionBuffer::Triangle *triangles, const std::uint32_t *indices, std::size_t count,
+                           OcclusionBuffer::Tile tile, float *depth, int width);
+    bool rasterizeTileAVX2(const OcclusionBuffer::Triangle *triangles, const std::uint32_t *indices, std::size_t count,
+                           OcclusionBuffer::Tile tile, float *depth, int width);
+    /// @}
+}
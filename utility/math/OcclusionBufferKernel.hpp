@@ -0,0 +1,69 @@
+#pragma once
+
+#include "OcclusionBuffer.hpp"
+
+namespace math
+{
+    namespace detail
+    {
+        /// @brief Rasterization of a tile, written once for any wrapper of simd.hpp.
+        /// @details The edge functions and the depth are evaluated at the center of V::Lanes pixels of a row at once.
+        /// The width of the tile must be a multiple of V::Lanes.
+        template<typename V>
+        void rasterizeTile(const OcclusionBuffer::Triangle *triangles, const std::uint32_t *indices, std::size_t count,
+                           OcclusionBuffer::Tile tile, float *depth, int width)
+        {
+            float centers[V::Lanes];
+            for(std::size_t lane = 0; lane < V::Lanes; ++lane)
+            {
+                centers[lane] = static_cast<float>(lane) + 0.5f;
+            }
+            const V offsets = V::load(centers);
+            const int lanes = static_cast<int>(V::Lanes);
+            
+            for(std::size_t i = 0; i < count; ++i)
+            {
+                const OcclusionBuffer::Triangle& triangle = triangles[indices[i]];
+                
+                // The lanes start on a multiple of the lanes from the tile, the pixels out of the triangle fail the
+                // edges. No std::min() nor std::max(): their copy compiled here could be kept by the linker.
+                const int firstX = triangle.min.x > tile.min.x ? triangle.min.x : tile.min.x;
+                const int beginX = tile.min.x + (firstX - tile.min.x) / lanes * lanes;
+                const int endX = triangle.max.x + 1 < tile.max.x ? triangle.max.x + 1 : tile.max.x;
+                const int beginY = triangle.min.y > tile.min.y ? triangle.min.y : tile.min.y;
+                const int endY = triangle.max.y + 1 < tile.max.y ? triangle.max.y + 1 : tile.max.y;
+                
+                V a[3], b[3], c[3];
+                for(int edge = 0; edge < 3; ++edge)
+                {
+                    a[edge] = V::set1(triangle.edges[edge][0]);
+                    b[edge] = V::set1(triangle.edges[edge][1]);
+                    c[edge] = V::set1(triangle.edges[edge][2]);
+                }
+                const V za = V::set1(triangle.depth[0]);
+                const V zb = V::set1(triangle.depth[1]);
+                const V zc = V::set1(triangle.depth[2]);
+                
+                for(int y = beginY; y < endY; ++y)
+                {
+                    const V fy = V::set1(static_cast<float>(y) + 0.5f);
+                    const V row[3] = {fmadd(b[0], fy, c[0]), fmadd(b[1], fy, c[1]), fmadd(b[2], fy, c[2])};
+                    const V rowZ = fmadd(zb, fy, zc);
+                    float *line = depth + static_cast<std::size_t>(y) * width;
+                    
+                    for(int x = beginX; x < endX; x += lanes)
+                    {
+                        const V fx = V::set1(static_cast<float>(x)) + offsets;
+                        
+                        // Negative out of any edge
+                        const V inside = min(fmadd(a[0], fx, row[0]), min(fmadd(a[1], fx, row[1]),
+                                                                          fmadd(a[2], fx, row[2])));
+                        const V z = fmadd(za, fx, rowZ);
+                        const V current = V::load(line + x);
+                        selectNegative(inside, current, min(current, z)).store(line + x);
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,19 @@
+#include "OcclusionBufferKernel.hpp"
+
+// Compiled with -mavx2 -mfma, only called when the CPU supports it.
+// Only the Float8 kernel is instantiated here, never code shared with the other translation units,
+// otherwise the linker could keep a copy with instructions unsupported by the CPU.
+
+namespace math
+{
+    bool rasterizeTileAVX2(const OcclusionBuffer::Triangle *triangles, const std::uint32_t *indices, std::size_t count,
+                           OcclusionBuffer::Tile tile, float *depth, int width)
+    {
+#if defined(__AVX2__) && defined(__FMA__)
+        detail::rasterizeTile<simd::Float8>(triangles, indices, count, tile, depth, width);
+        return true;
+#else
+        return false;
+#endif
+    }
+}
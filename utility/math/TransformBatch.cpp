@@ -0,0 +1,168 @@
+#include "TransformBatchKernel.hpp"
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+namespace math
+{
+    std::size_t TransformSoA::size() const
+    {
+        return tx.size();
+    }
+    
+    void TransformSoA::resize(std::size_t count)
+    {
+        for(std::vector<float> *v : {&tx, &ty, &tz, &qx, &qy, &qz})
+        {
+            v->resize(count, 0.0f);
+        }
+        
+        for(std::vector<float> *v : {&qw, &sx, &sy, &sz})
+        {
+            v->resize(count, 1.0f);
+        }
+    }
+    
+    void TransformSoA::set(std::size_t i, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale)
+    {
+        tx[i] = translation.x;
+        ty[i] = translation.y;
+        tz[i] = translation.z;
+        
+        qx[i] = rotation.x;
+        qy[i] = rotation.y;
+        qz[i] = rotation.z;
+        qw[i] = rotation.w;
+        
+        sx[i] = scale.x;
+        sy[i] = scale.y;
+        sz[i] = scale.z;
+    }
+    
+    void computeTransforms(const TransformSoA& in, const glm::mat4& viewProj, const TransformBatchOutput& out,
+                           simd::Level level)
+    {
+        const std::size_t count = in.size();
+        
+        TransformBatchArrays arrays{};
+        const std::vector<float> *components[10] = {&in.tx, &in.ty, &in.tz, &in.qx, &in.qy, &in.qz, &in.qw,
+                                                     &in.sx, &in.sy, &in.sz};
+        for(int c = 0; c < 10; ++c)
+        {
+            arrays.transforms[c] = components[c]->data();
+        }
+        arrays.viewProj = glm::value_ptr(viewProj);
+        arrays.world = out.world ? glm::value_ptr(*out.world) : nullptr;
+        arrays.normal = out.normal ? glm::value_ptr(*out.normal) : nullptr;
+        arrays.worldViewProj = out.worldViewProj ? glm::value_ptr(*out.worldViewProj) : nullptr;
+        
+        std::size_t done = 0; // Objects already processed by a SIMD kernel
+        
+        // Process as many objects as possible with the widest kernel, the remaining ones are done with the scalar one
+        if(level == simd::Level::AVX2)
+        {
+            const std::size_t end = count - count % 8;
+            if(computeTransformsAVX2(arrays, 0, end))
+            {
+                done = end;
+            }
+        }
+        else if(level == simd::Level::SSE4)
+        {
+            const std::size_t end = count - count % 4;
+            if(computeTransformsSSE4(arrays, 0, end))
+            {
+                done = end;
+            }
+        }
+        
+        detail::computeTransforms<simd::Float1>(arrays, done, count);
+    }
+    
+    namespace
+    {
+        template<typename Matrix>
+        bool equals(const Matrix& a, const Matrix& b, float epsilon)
+        {
+            for(int col = 0; col < Matrix::length(); ++col)
+            {
+                for(int row = 0; row < Matrix::col_type::length(); ++row)
+                {
+                    // Relative for big values (the projection can produce them), absolute near zero
+                    const float tolerance = epsilon * std::max(1.0f, std::abs(b[col][row]));
+                    
+                    if(std::abs(a[col][row] - b[col][row]) > tolerance)
+                    {
+                        return false;
+                    }
+                }
+            }
+            
+            return true;
+        }
+    }
+    
+    bool validateTransformBatch(std::size_t count, float epsilon)
+    {
+        std::mt19937 rng{42};
+        std::uniform_real_distribution<float> position{-100.0f, 100.0f};
+        std::uniform_real_distribution<float> unit{-1.0f, 1.0f};
+        std::uniform_real_distribution<float> scale{0.1f, 10.0f};
+        
+        TransformSoA in;
+        in.resize(count);
+        
+        std::vector<glm::mat4> expectedWorld(count), expectedWorldViewProj(count);
+        std::vector<glm::mat3> expectedNormal(count);
+        
+        const glm::mat4 viewProj{
+            glm::perspective(glm::radians(80.0f), 16.0f / 9.0f, 0.1f, 100.0f)
+            * glm::lookAt(glm::vec3{3, 4, 5}, glm::vec3{0}, glm::vec3{0, 1, 0})
+        };
+        
+        for(std::size_t i = 0; i < count; ++i)
+        {
+            const glm::vec3 t{position(rng), position(rng), position(rng)};
+            const glm::quat q{glm::normalize(glm::quat{unit(rng), unit(rng), unit(rng), unit(rng)})};
+            const glm::vec3 s{scale(rng), scale(rng), scale(rng)};
+            in.set(i, t, q, s);
+            
+            expectedWorld[i] = glm::translate(glm::mat4{1}, t) * glm::mat4_cast(q) * glm::scale(glm::mat4{1}, s);
+            expectedNormal[i] = glm::inverseTranspose(glm::mat3{expectedWorld[i]});
+            expectedWorldViewProj[i] = viewProj * expectedWorld[i];
+        }
+        
+        bool success = true;
+        
+        for(simd::Level level : {simd::Level::Scalar, simd::Level::SSE4, simd::Level::AVX2})
+        {
+            if(level > simd::detectLevel())
+            {
+                continue;
+            }
+            
+            std::vector<glm::mat4> world(count), worldViewProj(count);
+            std::vector<glm::mat3> normal(count);
+            computeTransforms(in, viewProj, {world.data(), normal.data(), worldViewProj.data()}, level);
+            
+            for(std::size_t i = 0; i < count; ++i)
+            {
+                if(!equals(world[i], expectedWorld[i], epsilon)
+                   || !equals(normal[i], expectedNormal[i], epsilon)
+                   || !equals(worldViewProj[i], expectedWorldViewProj[i], epsilon))
+                {
+                    std::cerr << "Transform batch mismatch with GLM (" << simd::toString(level)
+                              << ", object " << i << ")" << std::endl;
+                    success = false;
+                    break;
+                }
+            }
+        }
+        
+        return success;
+    }
+}
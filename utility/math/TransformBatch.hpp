@@ -0,0 +1,69 @@
+#pragma once
+
+#include "simd.hpp"
+#include <glm/mat3x3.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <cstddef>
+#include <vector>
+
+namespace math
+{
+    /// @brief Transforms of many objects, stored as structure-of-arrays.
+    /// @details Each transform is translate(t) * rotate(q) * scale(s), like Mirror::model().
+    /// Each component has its own array, so a SIMD kernel can load the same component of several objects at once.
+    struct TransformSoA
+    {
+        std::vector<float> tx, ty, tz; ///< Translation
+        std::vector<float> qx, qy, qz, qw; ///< Rotation, as an unit quaternion
+        std::vector<float> sx, sy, sz; ///< Scale
+        
+        std::size_t size() const;
+        
+        /// @brief Resize all the arrays, new transforms are identity.
+        void resize(std::size_t count);
+        
+        void set(std::size_t i, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale);
+    };
+    
+    /// @brief Where to write the matrices computed by computeTransforms().
+    /// @details Each array must have at least the size of the input. Leave an array to nullptr to not compute it.
+    struct TransformBatchOutput
+    {
+        glm::mat4 *world{nullptr}; ///< Model matrices
+        glm::mat3 *normal{nullptr}; ///< Inverse transpose of the model matrices, to transform normals
+        glm::mat4 *worldViewProj{nullptr}; ///< viewProj * world
+    };
+    
+    /// @brief The arrays of a batch as raw pointers, for the kernels of each instruction set.
+    /// @details The matrices are column-major, contiguous like the GLM ones.
+    struct TransformBatchArrays
+    {
+        const float *transforms[10]; ///< tx, ty, tz, qx, qy, qz, qw, sx, sy, sz
+        const float *viewProj;
+        float *world; ///< 16 floats per object, nullptr to not compute it
+        float *normal; ///< 9 floats per object, nullptr to not compute it
+        float *worldViewProj; ///< 16 floats per object, nullptr to not compute it
+    };
+    
+    /// @brief Compute the world, normal and world-view-projection matrices of all the transforms.
+    /// @param viewProj Projection matrix multiplied by the view matrix, only used for out.worldViewProj.
+    /// @param level The instruction set to use. Defaults to the best one supported by the CPU.
+    void computeTransforms(const TransformSoA& in, const glm::mat4& viewProj, const TransformBatchOutput& out,
+                           simd::Level level = simd::detectLevel());
+    
+    /// @brief Check each kernel supported by the CPU against the same matrices computed with GLM.
+    /// @details Random transforms are generated with a fixed seed, so the check is reproducible.
+    /// @returns true if all the matrices are equal up to epsilon. Mismatches are logged to std::cerr.
+    bool validateTransformBatch(std::size_t count = 1000, float epsilon = 1e-4f);
+    
+    /// @name
+    /// @brief Kernels for each instruction set, process [begin, end).
+    /// @remarks Only call them if the CPU supports the instruction set, end - begin must be a multiple of the lane count.
+    /// @returns false if the kernel was not compiled with the instruction set enabled, nothing is computed.
+    /// @{
+    bool computeTransformsSSE4(const TransformBatchArrays& arrays, std::size_t begin, std::size_t end);
+    bool computeTransformsAVX2(const TransformBatchArrays& arrays, std::size_t begin, std::size_t end);
+    /// @}
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "TransformBatch.hpp"
+
+namespace math
+{
+    namespace detail
+    {
+        /// @brief Write one element of the matrix of each lane.
+        /// @param out The column-major matrices of size x size floats.
+        template<typename V>
+        void scatter(const V& value, float *out, int size, std::size_t first, int col, int row)
+        {
+            float lanes[V::Lanes];
+            value.store(lanes);
+            
+            for(std::size_t lane = 0; lane < V::Lanes; ++lane)
+            {
+                out[(first + lane) * size * size + col * size + row] = lanes[lane];
+            }
+        }
+        
+        /// @brief Batch transform kernel, written once for any wrapper of simd.hpp.
+        /// @details Each lane is a different object. end - begin must be a multiple of V::Lanes.
+        /// Only raw pointers are indexed: an accessor of GLM or of the standard library compiled here could be the copy
+        /// kept by the linker.
+        template<typename V>
+        void computeTransforms(const TransformBatchArrays& arrays, std::size_t begin, std::size_t end)
+        {
+            const float *const *in = arrays.transforms;
+            const float *viewProj = arrays.viewProj;
+            const V one = V::set1(1.0f);
+            const V two = V::set1(2.0f);
+            
+            for(std::size_t i = begin; i < end; i += V::Lanes)
+            {
+                const V qx = V::load(in[3] + i);
+                const V qy = V::load(in[4] + i);
+                const V qz = V::load(in[5] + i);
+                const V qw = V::load(in[6] + i);
+                
+                const V t[3] = {V::load(in[0] + i), V::load(in[1] + i), V::load(in[2] + i)};
+                const V s[3] = {V::load(in[7] + i), V::load(in[8] + i), V::load(in[9] + i)};
+                
+                // Rotation matrix of the quaternion, same formula as glm::mat3_cast(), r[col][row]
+                const V xx = qx * qx, yy = qy * qy, zz = qz * qz;
+                const V xy = qx * qy, xz = qx * qz, yz = qy * qz;
+                const V wx = qw * qx, wy = qw * qy, wz = qw * qz;
+                
+                const V r[3][3] = {
+                    {one - two * (yy + zz), two * (xy + wz), two * (xz - wy)},
+                    {two * (xy - wz), one - two * (xx + zz), two * (yz + wx)},
+                    {two * (xz + wy), two * (yz - wx), one - two * (xx + yy)}
+                };
+                
+                // world = translate * rotate * scale: each rotation column is scaled, the translation is the last column
+                V world[4][3];
+                for(int col = 0; col < 3; ++col)
+                {
+                    for(int row = 0; row < 3; ++row)
+                    {
+                        world[col][row] = r[col][row] * s[col];
+                    }
+                }
+                
+                for(int row = 0; row < 3; ++row)
+                {
+                    world[3][row] = t[row];
+                }
+                
+                if(arrays.world)
+                {
+                    const V zero = V::set1(0.0f);
+                    
+                    for(int col = 0; col < 4; ++col)
+                    {
+                        for(int row = 0; row < 3; ++row)
+                        {
+                            scatter(world[col][row], arrays.world, 4, i, col, row);
+                        }
+                        
+                        scatter(col == 3 ? one : zero, arrays.world, 4, i, col, 3);
+                    }
+                }
+                
+                if(arrays.normal)
+                {
+                    // inverse(transpose(R * S)) = R * inverse(S): no need of a generic inverse
+                    for(int col = 0; col < 3; ++col)
+                    {
+                        for(int row = 0; row < 3; ++row)
+                        {
+                            scatter(r[col][row] / s[col], arrays.normal, 3, i, col, row);
+                        }
+                    }
+                }
+                
+                if(arrays.worldViewProj)
+                {
+                    // The last row of the world matrix is (0, 0, 0, 1), so it is only a 3x4 matrix product
+                    for(int col = 0; col < 4; ++col)
+                    {
+                        for(int row = 0; row < 4; ++row)
+                        {
+                            V sum = col == 3 ? V::set1(viewProj[12 + row]) : V::set1(0.0f);
+                            
+                            for(int k = 0; k < 3; ++k)
+                            {
+                                sum = fmadd(V::set1(viewProj[k * 4 + row]), world[col][k], sum);
+                            }
+                            
+                            scatter(sum, arrays.worldViewProj, 4, i, col, row);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
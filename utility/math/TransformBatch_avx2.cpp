@@ -0,0 +1,18 @@
+#include "TransformBatchKernel.hpp"
+
+// Compiled with -mavx2 -mfma, only called when the CPU supports it.
+// Only the Float8 kernel is instantiated here, never code shared with the other translation units,
+// otherwise the linker could keep a copy with instructions unsupported by the CPU.
+
+namespace math
+{
+    bool computeTransformsAVX2(const TransformBatchArrays& arrays, std::size_t begin, std::size_t end)
+    {
+#if defined(__AVX2__) && defined(__FMA__)
+        detail::computeTransforms<simd::Float8>(arrays, begin, end);
+        return true;
+#else
+        return false;
+#endif
+    }
+}
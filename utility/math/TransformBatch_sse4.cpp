@@ -0,0 +1,18 @@
+#include "TransformBatchKernel.hpp"
+
+// Compiled with -msse4.1, only called when the CPU supports it.
+// Only the Float4 kernel is instantiated here, never code shared with the other translation units,
+// otherwise the linker could keep a copy with instructions unsupported by the CPU.
+
+namespace math
+{
+    bool computeTransformsSSE4(const TransformBatchArrays& arrays, std::size_t begin, std::size_t end)
+    {
+#if defined(__SSE4_1__)
+        detail::computeTransforms<simd::Float4>(arrays, begin, end);
+        return true;
+#else
+        return false;
+#endif
+    }
+}
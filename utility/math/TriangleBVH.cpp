@@ -0,0 +1,264 @@
+#include "TriangleBVHKernel.hpp"
+#include <utility/ThreadPool.hpp>
+#include <glm/geometric.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace math
+{
+    namespace
+    {
+        /// @brief Half of the surface area, to choose the children to pull up.
+        float area(const BVH::Node& node)
+        {
+            const glm::vec3 size = node.max - node.min;
+            return size.x * size.y + size.y * size.z + size.z * size.x;
+        }
+    }
+    
+    void TriangleBVH::build(const glm::vec3 *positions, std::size_t vertexCount, std::size_t stride,
+                            const unsigned int *indices, std::size_t indexCount)
+    {
+        const auto *bytes = reinterpret_cast<const unsigned char *>(positions);
+        const auto position = [&](unsigned int index) -> const glm::vec3& {
+            return *reinterpret_cast<const glm::vec3 *>(bytes + index * stride);
+        };
+        
+        m_nodes.clear();
+        m_bounds = {};
+        
+        const std::size_t count = indexCount / 3;
+        std::vector<AABB> boxes(count);
+        
+        ThreadPool::global().parallelFor(0, count, 4096, [&](std::size_t first, std::size_t last) {
+            for(std::size_t i = first; i < last; ++i)
+            {
+                AABB& box = boxes[i];
+                for(int corner = 0; corner < 3; ++corner)
+                {
+                    const unsigned int index = indices[i * 3 + corner];
+                    if(index < vertexCount)
+                    {
+                        box.extend(position(index));
+                    }
+                }
+            }
+        });
+        
+        BVH binary;
+        binary.build(std::move(boxes));
+        m_bounds = binary.getBounds();
+        
+        // The leaves are ranges of the indices of the binary tree, the triangles are stored in the same order
+        const std::vector<std::uint32_t>& order = binary.getIndices();
+        for(std::vector<float>& component : m_triangles.components)
+        {
+            component.assign(count + Width, 0.0f);
+        }
+        m_triangles.indices = order;
+        
+        ThreadPool::global().parallelFor(0, count, 4096, [&](std::size_t first, std::size_t last) {
+            for(std::size_t i = first; i < last; ++i)
+            {
+                const std::size_t triangle = order[i];
+                glm::vec3 corners[3];
+                for(int corner = 0; corner < 3; ++corner)
+                {
+                    const unsigned int index = indices[triangle * 3 + corner];
+                    corners[corner] = index < vertexCount ? position(index) : glm::vec3{0};
+                }
+                
+                const glm::vec3 values[3] = {corners[0], corners[1] - corners[0], corners[2] - corners[0]};
+                for(int c = 0; c < 9; ++c)
+                {
+                    m_triangles.components[c][i] = values[c / 3][c % 3];
+                }
+            }
+        });
+        
+        if(!binary.getNodes().empty())
+        {
+            m_nodes.reserve(binary.getNodes().size() / (Width / 2) + 1);
+            collapse(binary.getNodes(), 0);
+        }
+    }
+    
+    std::uint32_t TriangleBVH::collapse(const std::vector<BVH::Node>& binary, std::uint32_t index)
+    {
+        const auto result = static_cast<std::uint32_t>(m_nodes.size());
+        m_nodes.emplace_back();
+        
+        // Replace the largest inner child by its two children, until there are Width of them
+        std::uint32_t children[Width];
+        int count = 0;
+        
+        if(binary[index].isLeaf())
+        {
+            children[count++] = index;
+        }
+        else
+        {
+            children[count++] = index + 1;
+            children[count++] = binary[index].offset;
+        }
+        
+        while(count < Width)
+        {
+            int largest = -1;
+            for(int i = 0; i < count; ++i)
+            {
+                const BVH::Node& child = binary[children[i]];
+                if(!child.isLeaf() && (largest < 0 || area(child) > area(binary[children[largest]])))
+                {
+                    largest = i;
+                }
+            }
+            
+            if(largest < 0)
+            {
+                break;
+            }
+            
+            const std::uint32_t pulled = children[largest];
+            children[largest] = pulled + 1;
+            children[count++] = binary[pulled].offset;
+        }
+        
+        // The inner children are collapsed after, m_nodes may grow so the node is only written at the end
+        Node node;
+        for(int axis = 0; axis < 3; ++axis)
+        {
+            std::fill(std::begin(node.min[axis]), std::end(node.min[axis]), std::numeric_limits<float>::max());
+            std::fill(std::begin(node.max[axis]), std::end(node.max[axis]), std::numeric_limits<float>::lowest());
+        }
+        std::fill(std::begin(node.first), std::end(node.first), 0);
+        std::fill(std::begin(node.count), std::end(node.count), 0);
+        
+        for(int i = 0; i < count; ++i)
+        {
+            const BVH::Node& child = binary[children[i]];
+            for(int axis = 0; axis < 3; ++axis)
+            {
+                node.min[axis][i] = child.min[axis];
+                node.max[axis][i] = child.max[axis];
+            }
+            
+            if(child.isLeaf())
+            {
+                node.first[i] = child.offset;
+                node.count[i] = child.count;
+            }
+            else
+            {
+                node.first[i] = collapse(binary, children[i]);
+            }
+        }
+        
+        m_nodes[result] = node;
+        return result;
+    }
+    
+    std::optional<TriangleBVH::Hit> TriangleBVH::raycast(const glm::vec3& origin, const glm::vec3& direction,
+                                                         float maxDistance, simd::Level level) const
+    {
+        if(m_nodes.empty())
+        {
+            return std::nullopt;
+        }
+        
+        Ray ray;
+        ray.origin = origin;
+        ray.direction = direction;
+        ray.inverse = BVH::inverseDirection(direction);
+        for(int axis = 0; axis < 3; ++axis)
+        {
+            ray.negative[axis] = ray.inverse[axis] < 0.0f;
+        }
+        
+        // The misses are at infinity, always farther
+        ray.maxDistance = maxDistance < std::numeric_limits<float>::max() ? maxDistance
+                                                                           : std::numeric_limits<float>::max();
+        
+        const float *triangles[9];
+        for(int c = 0; c < 9; ++c)
+        {
+            triangles[c] = m_triangles.components[c].data();
+        }
+        
+        Hit hit;
+        bool done = false;
+        if(level == simd::Level::AVX2)
+        {
+            done = raycastAVX2(m_nodes.data(), triangles, ray, hit);
+        }
+        else if(level == simd::Level::SSE4)
+        {
+            done = raycastSSE4(m_nodes.data(), triangles, ray, hit);
+        }
+        
+        if(!done)
+        {
+            detail::raycast<simd::Float1>(m_nodes.data(), triangles, ray, hit);
+        }
+        
+        if(!(hit.distance < ray.maxDistance))
+        {
+            return std::nullopt;
+        }
+        
+        hit.triangle = m_triangles.indices[hit.triangle];
+        return hit;
+    }
+    
+    std::optional<TriangleBVH::Hit> TriangleBVH::intersect(const glm::vec3& origin, const glm::vec3& direction,
+                                                           const glm::vec3& a, const glm::vec3& b,
+                                                           const glm::vec3& c, float maxDistance)
+    {
+        const glm::vec3 e1 = b - a;
+        const glm::vec3 e2 = c - a;
+        const glm::vec3 p = glm::cross(direction, e2);
+        const float det = glm::dot(e1, p);
+        
+        // Parallel to the triangle
+        if(det == 0.0f)
+        {
+            return std::nullopt;
+        }
+        
+        const float invDet = 1.0f / det;
+        const glm::vec3 s = origin - a;
+        const glm::vec3 q = glm::cross(s, e1);
+        
+        Hit hit;
+        hit.barycentrics = {glm::dot(s, p) * invDet, glm::dot(direction, q) * invDet};
+        hit.distance = glm::dot(e2, q) * invDet;
+        
+        if(hit.barycentrics.x >= 0.0f && hit.barycentrics.y >= 0.0f
+           && hit.barycentrics.x + hit.barycentrics.y <= 1.0f && hit.distance >= 0.0f && hit.distance < maxDistance)
+        {
+            return hit;
+        }
+        
+        return std::nullopt;
+    }
+    
+    bool TriangleBVH::empty() const
+    {
+        return m_nodes.empty();
+    }
+    
+    AABB TriangleBVH::getBounds() const
+    {
+        return m_bounds;
+    }
+    
+    const std::vector<TriangleBVH::Node>& TriangleBVH::getNodes() const
+    {
+        return m_nodes;
+    }
+    
+    const TriangleBVH::Triangles& TriangleBVH::getTriangles() const
+    {
+        return m_triangles;
+    }
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "BVH.hpp"
+#include "simd.hpp"
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <vector>
+
+namespace math
+{
+    /// @brief Bounding volume hierarchy over the triangles of a mesh, to cast rays against millions of triangles.
+    /// @details
+    /// Built as a binary BVH over the boxes of the triangles, then collapsed into nodes of Width children: each level
+    /// pulls up the grandchildren of the largest inner children. The boxes of the children are stored by component,
+    /// so the SIMD kernel tests V::Lanes of them against the ray at once, and the triangles of the leaves are stored
+    /// the same way for the Möller-Trumbore test of V::Lanes triangles at once.
+    ///     bvh.build(&vertices[0].pos, vertices.size(), sizeof(Vertex), indices.data(), indices.size());
+    ///     if(const auto hit = bvh.raycast(origin, direction)) // hit->triangle, hit->distance
+    /// @remarks Pure CPU. The mesh is not referenced, the positions are copied.
+    class TriangleBVH
+    {
+    public:
+        /// @brief Children of a node, the lanes of the widest SIMD wrapper.
+        static constexpr int Width = 8;
+        
+        /// @brief The closest intersection of a ray with a triangle.
+        struct Hit
+        {
+            std::uint32_t triangle{0}; ///< Its indices start at 3 * triangle in the indices of build()
+            glm::vec2 barycentrics{0}; ///< The weights of its second and third vertices
+            float distance{0}; ///< Along the ray, in lengths of the direction
+        };
+        
+        /// @brief A node of Width children, their boxes stored by component.
+        /// @details The empty children have an empty box: it is missed by every ray without testing them.
+        struct alignas(64) Node
+        {
+            float min[3][Width];
+            float max[3][Width];
+            std::uint32_t first[Width]; ///< Of a leaf child: its first triangle in the arrays. Else: its node.
+            std::uint32_t count[Width]; ///< Of a leaf child: count of its triangles. 0 for the others.
+        };
+        
+        /// @brief A ray, with what the kernels compute once for all the nodes.
+        struct Ray
+        {
+            glm::vec3 origin;
+            glm::vec3 direction;
+            glm::vec3 inverse; ///< See BVH::inverseDirection()
+            bool negative[3]; ///< Sign of each component of the direction: the side of the boxes entered first
+            float maxDistance;
+        };
+        
+        /// @brief The triangles in the order of the leaves, by component: the first vertex and the two edges from it.
+        /// @details Padded by Width triangles, so the kernels can load V::Lanes of them from any leaf.
+        struct Triangles
+        {
+            std::vector<float> components[9]; ///< v0.x, v0.y, v0.z, e1.x, e1.y, e1.z, e2.x, e2.y, e2.z
+            std::vector<std::uint32_t> indices; ///< The index of each triangle in the mesh
+        };
+        
+        /// @brief Build the tree over the triangles of a mesh.
+        /// @param positions The position of the first vertex, the next ones are stride bytes further.
+        void build(const glm::vec3 *positions, std::size_t vertexCount, std::size_t stride,
+                   const unsigned int *indices, std::size_t indexCount);
+        
+        /// @brief Find the closest triangle hit by a ray, both sides of the triangles.
+        /// @param direction Not necessarily normalized, the distances are in lengths of it.
+        /// @param level The instruction set to use. Defaults to the best one supported by the CPU.
+        std::optional<Hit> raycast(const glm::vec3& origin, const glm::vec3& direction,
+                                   float maxDistance = std::numeric_limits<float>::max(),
+                                   simd::Level level = simd::detectLevel()) const;
+        
+        /// @brief Möller-Trumbore test of a single triangle, for the meshes without tree.
+        /// @returns The hit, with triangle left to 0, if closer than maxDistance.
+        static std::optional<Hit> intersect(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& a,
+                                            const glm::vec3& b, const glm::vec3& c, float maxDistance);
+        
+        bool empty() const;
+        
+        /// @brief Bounds of all the triangles.
+        AABB getBounds() const;
+        
+        const std::vector<Node>& getNodes() const;
+        const Triangles& getTriangles() const;
+    
+    private:
+        /// @brief Collapse the binary node and its descendants into a node at the end of m_nodes.
+        /// @returns The index of the node.
+        std::uint32_t collapse(const std::vector<BVH::Node>& binary, std::uint32_t node);
+        
+        std::vector<Node> m_nodes; ///< The root first
+        Triangles m_triangles;
+        AABB m_bounds;
+    };
+    
+    /// @name
+    /// @brief Kernels for each instruction set, find the closest hit of a ray in the tree.
+    /// @param triangles The 9 arrays of TriangleBVH::Triangles::components.
+    /// @param hit Its distance is set to the max distance of the ray before, and stays there if nothing is closer. Its
+    /// triangle is the position in the arrays, not in the mesh.
+    /// @remarks Only call them if the CPU supports the instruction set.
+    /// @returns false if the kernel was not compiled with the instruction set enabled, nothing is computed.
+    /// @{
+    bool raycastSSE4(const TriangleBVH::Node *nodes, const float *const *triangles, const TriangleBVH::Ray& ray,
+                     TriangleBVH::Hit& hit);
+    bool raycastAVX2(const TriangleBVH::Node *nodes, const float *const *triangles, const TriangleBVH::Ray& ray,
+                     TriangleBVH::Hit& hit);
+    /// @}
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include "TriangleBVH.hpp"
+
+namespace math
+{
+    namespace detail
+    {
+        /// @brief Traversal of the tree, written once for any wrapper of simd.hpp.
+        /// @details The boxes of V::Lanes children are tested at once, the hit ones are visited from the closest, then
+        /// the Möller-Trumbore test runs on V::Lanes triangles of a leaf at once.
+        /// TriangleBVH::Width must be a multiple of V::Lanes.
+        template<typename V>
+        void raycast(const TriangleBVH::Node *nodes, const float *const *triangles, const TriangleBVH::Ray& ray,
+                     TriangleBVH::Hit& hit)
+        {
+            constexpr int Width = TriangleBVH::Width;
+            constexpr int Lanes = static_cast<int>(V::Lanes);
+            
+            // A node waiting, with the distance where the ray enters it
+            struct Entry
+            {
+                std::uint32_t first;
+                std::uint32_t count;
+                float distance;
+            };
+            
+            // Each level replaces a node by at most Width children
+            Entry stack[BVH::MaxDepth * (Width - 1) + 1];
+            int size = 0;
+            stack[size++] = {0, 0, 0.0f};
+            
+            float closest = ray.maxDistance;
+            hit.distance = closest;
+            
+            const V origin[3] = {V::set1(ray.origin.x), V::set1(ray.origin.y), V::set1(ray.origin.z)};
+            const V direction[3] = {V::set1(ray.direction.x), V::set1(ray.direction.y), V::set1(ray.direction.z)};
+            const V inverse[3] = {V::set1(ray.inverse.x), V::set1(ray.inverse.y), V::set1(ray.inverse.z)};
+            const V zero = V::set1(0.0f);
+            const V one = V::set1(1.0f);
+            
+            while(size > 0)
+            {
+                const Entry entry = stack[--size];
+                
+                // A closer hit was found since it was pushed
+                if(entry.distance > closest)
+                {
+                    continue;
+                }
+                
+                if(entry.count > 0)
+                {
+                    // The lanes past the leaf read the next triangles or the padding, they are ignored
+                    const std::uint32_t end = entry.first + entry.count;
+                    for(std::uint32_t i = entry.first; i < end; i += Lanes)
+                    {
+                        V v0[3], e1[3], e2[3];
+                        for(int c = 0; c < 3; ++c)
+                        {
+                            v0[c] = V::load(triangles[c] + i);
+                            e1[c] = V::load(triangles[3 + c] + i);
+                            e2[c] = V::load(triangles[6 + c] + i);
+                        }
+                        
+                        const V p[3] = {direction[1] * e2[2] - direction[2] * e2[1],
+                                        direction[2] * e2[0] - direction[0] * e2[2],
+                                        direction[0] * e2[1] - direction[1] * e2[0]};
+                        const V det = fmadd(e1[0], p[0], fmadd(e1[1], p[1], e1[2] * p[2]));
+                        const V invDet = one / det;
+                        
+                        const V s[3] = {origin[0] - v0[0], origin[1] - v0[1], origin[2] - v0[2]};
+                        const V q[3] = {s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2],
+                                        s[0] * e1[1] - s[1] * e1[0]};
+                        
+                        const V u = fmadd(s[0], p[0], fmadd(s[1], p[1], s[2] * p[2])) * invDet;
+                        const V v = fmadd(direction[0], q[0], fmadd(direction[1], q[1], direction[2] * q[2])) * invDet;
+                        const V t = fmadd(e2[0], q[0], fmadd(e2[1], q[1], e2[2] * q[2])) * invDet;
+                        
+                        float dets[Lanes], us[Lanes], vs[Lanes], ts[Lanes];
+                        det.store(dets);
+                        u.store(us);
+                        v.store(vs);
+                        t.store(ts);
+                        
+                        // A parallel triangle has a null determinant, its NaN fail all the comparisons
+                        for(int lane = 0; lane < Lanes && i + lane < end; ++lane)
+                        {
+                            if(dets[lane] != 0.0f && us[lane] >= 0.0f && vs[lane] >= 0.0f && us[lane] + vs[lane] <= 1.0f
+                               && ts[lane] >= 0.0f && ts[lane] < closest)
+                            {
+                                closest = ts[lane];
+                                hit.triangle = i + lane;
+                                hit.barycentrics.x = us[lane];
+                                hit.barycentrics.y = vs[lane];
+                                hit.distance = closest;
+                            }
+                        }
+                    }
+                    continue;
+                }
+                
+                // Slabs of the children: the planes entered first are on the side given by the sign of the direction
+                const TriangleBVH::Node& node = nodes[entry.first];
+                float entries[Width], exits[Width];
+                
+                for(int j = 0; j < Width; j += Lanes)
+                {
+                    V near[3], far[3];
+                    for(int axis = 0; axis < 3; ++axis)
+                    {
+                        const float *lower = node.min[axis] + j;
+                        const float *upper = node.max[axis] + j;
+                        near[axis] = (V::load(ray.negative[axis] ? upper : lower) - origin[axis]) * inverse[axis];
+                        far[axis] = (V::load(ray.negative[axis] ? lower : upper) - origin[axis]) * inverse[axis];
+                    }
+                    
+                    max(max(near[0], near[1]), max(near[2], zero)).store(entries + j);
+                    min(min(far[0], far[1]), min(far[2], V::set1(closest))).store(exits + j);
+                }
+                
+                // The children hit, the farthest first so the closest is pushed last and popped first
+                Entry children[Width];
+                int count = 0;
+                
+                for(int j = 0; j < Width; ++j)
+                {
+                    if(!(entries[j] <= exits[j]))
+                    {
+                        continue;
+                    }
+                    
+                    const Entry child{node.first[j], node.count[j], entries[j]};
+                    int k = count++;
+                    for(; k > 0 && children[k - 1].distance < child.distance; --k)
+                    {
+                        children[k] = children[k - 1];
+                    }
+                    children[k] = child;
+                }
+                
+                for(int k = 0; k < count; ++k)
+                {
+                    stack[size++] = children[k];
+                }
+            }
+        }
+    }
+}
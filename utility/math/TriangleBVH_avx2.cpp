@@ -0,0 +1,19 @@
+#include "TriangleBVHKernel.hpp"
+
+// Compiled with -mavx2 -mfma, only called when the CPU supports it.
+// Only the Float8 kernel is instantiated here, never code shared with the other translation units,
+// otherwise the linker could keep a copy with instructions unsupported by the CPU.
+
+namespace math
+{
+    bool raycastAVX2(const TriangleBVH::Node *nodes, const float *const *triangles, const TriangleBVH::Ray& ray,
+                     TriangleBVH::Hit& hit)
+    {
+#if defined(__AVX2__) && defined(__FMA__)
+        detail::raycast<simd::Float8>(nodes, triangles, ray, hit);
+        return true;
+#else
+        return false;
+#endif
+    }
+}
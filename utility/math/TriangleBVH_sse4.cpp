@@ -0,0 +1,19 @@
+#include "TriangleBVHKernel.hpp"
+
+// Compiled with -msse4.1, only called when the CPU supports it.
+// Only the Float4 kernel is instantiated here, never code shared with the other translation units,
+// otherwise the linker could keep a copy with instructions unsupported by the CPU.
+
+namespace math
+{
+    bool raycastSSE4(const TriangleBVH::Node *nodes, const float *const *triangles, const TriangleBVH::Ray& ray,
+                     TriangleBVH::Hit& hit)
+    {
+#if defined(__SSE4_1__)
+        detail::raycast<simd::Float4>(nodes, triangles, ray, hit);
+        return true;
+#else
+        return false;
+#endif
+    }
+}
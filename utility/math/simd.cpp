@@ -0,0 +1,43 @@
+#include "simd.hpp"
+
+namespace simd
+{
+    Level detectLevel()
+    {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        // Cached, the CPU will not change while running
+        static const Level level = [] {
+            if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+            {
+                return Level::AVX2;
+            }
+            
+            if(__builtin_cpu_supports("sse4.1"))
+            {
+                return Level::SSE4;
+            }
+            
+            return Level::Scalar;
+        }();
+        
+        return level;
+#else
+        return Level::Scalar;
+#endif
+    }
+    
+    const char *toString(Level level)
+    {
+        switch(level)
+        {
+            case Level::AVX2:
+                return "AVX2";
+                
+            case Level::SSE4:
+                return "SSE4.1";
+                
+            default:
+                return "Scalar";
+        }
+    }
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+
+#if defined(__SSE4_1__) || defined(__AVX2__)
+#   include <immintrin.h>
+#endif
+
+/// @brief Minimal SIMD wrappers, to write a kernel once as a template and instantiate it for each instruction set.
+/// @details
+/// Each wrapper exposes the same interface: Lanes, load(), set1(), store() and the arithmetic operators.
+/// Float1 is always available and is the scalar fallback.
+/// Float4 and Float8 are only defined in the translation units compiled with the matching flags
+/// (-msse4.1, -mavx2 -mfma), so the rest of the program still runs on any CPU: see detectSimdLevel().
+namespace simd
+{
+    /// @brief Instruction sets, ordered from the least to the most capable.
+    enum class Level
+    {
+        Scalar,
+        SSE4,
+        AVX2
+    };
+    
+    /// @brief Get the best instruction set supported by the CPU running the program.
+    Level detectLevel();
+    
+    /// @returns A printable name of the instruction set.
+    const char *toString(Level level);
+    
+    struct Float1
+    {
+        static constexpr std::size_t Lanes = 1;
+        
+        float v;
+        
+        static Float1 load(const float *p) { return {*p}; }
+        static Float1 set1(float f) { return {f}; }
+        void store(float *p) const { *p = v; }
+        
+        friend Float1 operator+(Float1 a, Float1 b) { return {a.v + b.v}; }
+        friend Float1 operator-(Float1 a, Float1 b) { return {a.v - b.v}; }
+        friend Float1 operator*(Float1 a, Float1 b) { return {a.v * b.v}; }
+        friend Float1 operator/(Float1 a, Float1 b) { return {a.v / b.v}; }
+        
+        /// @returns a * b + c
+        friend Float1 fmadd(Float1 a, Float1 b, Float1 c) { return {a.v * b.v + c.v}; }
+        friend Float1 min(Float1 a, Float1 b) { return {a.v < b.v ? a.v : b.v}; }
+        friend Float1 max(Float1 a, Float1 b) { return {a.v > b.v ? a.v : b.v}; }
+        friend Float1 sqrt(Float1 a) { return {std::sqrt(a.v)}; }
+        
+        /// @returns a where the sign bit of test is set, else b
+        friend Float1 selectNegative(Float1 test, Float1 a, Float1 b) { return {std::signbit(test.v) ? a.v : b.v}; }
+    };
+
+#ifdef __SSE4_1__
+    struct Float4
+    {
+        static constexpr std::size_t Lanes = 4;
+        
+        __m128 v;
+        
+        static Float4 load(const float *p) { return {_mm_loadu_ps(p)}; }
+        static Float4 set1(float f) { return {_mm_set1_ps(f)}; }
+        void store(float *p) const { _mm_storeu_ps(p, v); }
+        
+        friend Float4 operator+(Float4 a, Float4 b) { return {_mm_add_ps(a.v, b.v)}; }
+        friend Float4 operator-(Float4 a, Float4 b) { return {_mm_sub_ps(a.v, b.v)}; }
+        friend Float4 operator*(Float4 a, Float4 b) { return {_mm_mul_ps(a.v, b.v)}; }
+        friend Float4 operator/(Float4 a, Float4 b) { return {_mm_div_ps(a.v, b.v)}; }
+        
+        /// @remarks No FMA in SSE4, the multiplication is rounded before the addition
+        friend Float4 fmadd(Float4 a, Float4 b, Float4 c) { return {_mm_add_ps(_mm_mul_ps(a.v, b.v), c.v)}; }
+        friend Float4 min(Float4 a, Float4 b) { return {_mm_min_ps(a.v, b.v)}; }
+        friend Float4 max(Float4 a, Float4 b) { return {_mm_max_ps(a.v, b.v)}; }
+        friend Float4 sqrt(Float4 a) { return {_mm_sqrt_ps(a.v)}; }
+        friend Float4 selectNegative(Float4 test, Float4 a, Float4 b) { return {_mm_blendv_ps(b.v, a.v, test.v)}; }
+    };
+#endif
+
+#if defined(__AVX2__) && defined(__FMA__)
+    struct Float8
+    {
+        static constexpr std::size_t Lanes = 8;
+        
+        __m256 v;
+        
+        static Float8 load(const float *p) { return {_mm256_loadu_ps(p)}; }
+        static Float8 set1(float f) { return {_mm256_set1_ps(f)}; }
+        void store(float *p) const { _mm256_storeu_ps(p, v); }
+        
+        friend Float8 operator+(Float8 a, Float8 b) { return {_mm256_add_ps(a.v, b.v)}; }
+        friend Float8 operator-(Float8 a, Float8 b) { return {_mm256_sub_ps(a.v, b.v)}; }
+        friend Float8 operator*(Float8 a, Float8 b) { return {_mm256_mul_ps(a.v, b.v)}; }
+        friend Float8 operator/(Float8 a, Float8 b) { return {_mm256_div_ps(a.v, b.v)}; }
+        
+        friend Float8 fmadd(Float8 a, Float8 b, Float8 c) { return {_mm256_fmadd_ps(a.v, b.v, c.v)}; }
+        friend Float8 min(Float8 a, Float8 b) { return {_mm256_min_ps(a.v, b.v)}; }
+        friend Float8 max(Float8 a, Float8 b) { return {_mm256_max_ps(a.v, b.v)}; }
+        friend Float8 sqrt(Float8 a) { return {_mm256_sqrt_ps(a.v)}; }
+        friend Float8 selectNegative(Float8 test, Float8 a, Float8 b) { return {_mm256_blendv_ps(b.v, a.v, test.v)}; }
+    };
+#endif
+}
@@ -0,0 +1,309 @@
+#include "RasterizerKernel.hpp"
+#include <utility/ThreadPool.hpp>
+#include <glm/common.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace raster
+{
+    namespace
+    {
+        /// @brief In pixels. The top and left edges are pushed out by it, the others in: a center on an edge shared
+        /// by two triangles is drawn once even if the rounding differs between them, which matters with the blending.
+        constexpr float FillRuleBias = 1.0f / 1024.0f;
+        
+        Vertex mix(const Vertex& a, const Vertex& b, float t)
+        {
+            return {glm::mix(a.clip, b.clip, t), glm::mix(a.pos, b.pos, t), glm::mix(a.nor, b.nor, t),
+                    a.clipDistance + (b.clipDistance - a.clipDistance) * t};
+        }
+    }
+    
+    Rasterizer::Rasterizer(glm::ivec2 size)
+    {
+        resize(size);
+    }
+    
+    void Rasterizer::resize(glm::ivec2 size)
+    {
+        size = glm::max(size, glm::ivec2{1});
+        if(size == m_size)
+        {
+            return;
+        }
+        
+        m_size = size;
+        m_padded = (size + TileSize - 1) / TileSize * TileSize;
+        m_tiles = m_padded / TileSize;
+        
+        const std::size_t pixels = static_cast<std::size_t>(m_padded.x) * m_padded.y;
+        for(std::vector<float>& plane : m_color)
+        {
+            plane.assign(pixels, 0.0f);
+        }
+        m_depth.assign(pixels, 1.0f);
+        m_stencil.assign(pixels, 0.0f);
+        
+        m_bins.assign(static_cast<std::size_t>(m_tiles.x) * m_tiles.y, {});
+    }
+    
+    void Rasterizer::clear(const glm::vec4& color, float depth, std::uint8_t stencil)
+    {
+        for(int c = 0; c < 4; ++c)
+        {
+            std::fill(m_color[c].begin(), m_color[c].end(), color[c]);
+        }
+        std::fill(m_depth.begin(), m_depth.end(), depth);
+        std::fill(m_stencil.begin(), m_stencil.end(), static_cast<float>(stencil));
+        
+        m_draws.clear();
+        m_triangles.clear();
+        for(std::vector<std::uint32_t>& bin : m_bins)
+        {
+            bin.clear();
+        }
+    }
+    
+    void Rasterizer::draw(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+                          const State& state, const Shading& shading)
+    {
+        const auto draw = static_cast<std::uint32_t>(m_draws.size());
+        m_draws.push_back({state, shading});
+        
+        for(std::size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            const Vertex *triangle[3] = {&vertices[indices[i]], &vertices[indices[i + 1]], &vertices[indices[i + 2]]};
+            
+            // Out of the same side of the frustum
+            bool outside = false;
+            for(int axis = 0; axis < 3 && !outside; ++axis)
+            {
+                bool above = true, below = true;
+                for(const Vertex *vertex : triangle)
+                {
+                    above = above && vertex->clip[axis] > vertex->clip.w;
+                    below = below && vertex->clip[axis] < -vertex->clip.w;
+                }
+                outside = above || below;
+            }
+            
+            if(outside)
+            {
+                continue;
+            }
+            
+            // Sutherland-Hodgman against the near plane z = -w, like Mirror::screenBounds()
+            Vertex clipped[4];
+            int count = 0;
+            
+            for(int j = 0; j < 3; ++j)
+            {
+                const Vertex& a = *triangle[j];
+                const Vertex& b = *triangle[(j + 1) % 3];
+                const float da = a.clip.z + a.clip.w;
+                const float db = b.clip.z + b.clip.w;
+                
+                if(da >= 0.0f)
+                {
+                    clipped[count++] = a;
+                }
+                
+                if((da >= 0.0f) != (db >= 0.0f))
+                {
+                    clipped[count++] = mix(a, b, da / (da - db));
+                }
+            }
+            
+            for(int j = 2; j < count; ++j)
+            {
+                addTriangle(clipped[0], clipped[j - 1], clipped[j], draw);
+            }
+        }
+    }
+    
+    void Rasterizer::addTriangle(const Vertex& a, const Vertex& b, const Vertex& c, std::uint32_t draw)
+    {
+        const Vertex *vertices[3] = {&a, &b, &c};
+        
+        // To pixels, the depth to [0, 1] like the depth buffer of OpenGL
+        glm::vec3 p[3];
+        float values[3][AttributeCount];
+        for(int i = 0; i < 3; ++i)
+        {
+            const Vertex& vertex = *vertices[i];
+            const float invW = 1.0f / vertex.clip.w;
+            const glm::vec3 ndc = glm::vec3{vertex.clip} * invW;
+            p[i] = {(glm::vec2{ndc} * 0.5f + 0.5f) * glm::vec2{m_size}, ndc.z * 0.5f + 0.5f};
+            
+            const float attributes[AttributeCount] = {
+                p[i].z, invW,
+                vertex.pos.x * invW, vertex.pos.y * invW, vertex.pos.z * invW,
+                vertex.nor.x * invW, vertex.nor.y * invW, vertex.nor.z * invW,
+                vertex.clipDistance * invW
+            };
+            std::copy(std::begin(attributes), std::end(attributes), values[i]);
+        }
+        
+        float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[2].x - p[0].x) * (p[1].y - p[0].y);
+        if(!(std::abs(area) > 1e-8f))
+        {
+            return;
+        }
+        
+        // No face culling, like Scene::resetGL(): in counter-clockwise order so the edge functions are positive inside
+        if(area < 0.0f)
+        {
+            std::swap(p[1], p[2]);
+            std::swap(values[1], values[2]);
+            area = -area;
+        }
+        
+        // The pixels whose center is in the bounds
+        const glm::vec2 min = glm::min(glm::vec2{p[0]}, glm::min(glm::vec2{p[1]}, glm::vec2{p[2]}));
+        const glm::vec2 max = glm::max(glm::vec2{p[0]}, glm::max(glm::vec2{p[1]}, glm::vec2{p[2]}));
+        
+        Triangle triangle;
+        triangle.min = glm::max(glm::ivec2{glm::ceil(min - 0.5f)}, glm::ivec2{0});
+        triangle.max = glm::min(glm::ivec2{glm::floor(max - 0.5f)}, m_size - 1);
+        triangle.draw = draw;
+        
+        if(triangle.min.x > triangle.max.x || triangle.min.y > triangle.max.y)
+        {
+            return;
+        }
+        
+        // The planes are relative to the first pixel, the coordinates stay small
+        triangle.origin = triangle.min;
+        for(glm::vec3& point : p)
+        {
+            point.x -= static_cast<float>(triangle.origin.x);
+            point.y -= static_cast<float>(triangle.origin.y);
+        }
+        
+        for(int i = 0; i < 3; ++i)
+        {
+            const glm::vec3& from = p[i];
+            const glm::vec3& to = p[(i + 1) % 3];
+            float *edge = triangle.edges[i];
+            
+            edge[0] = from.y - to.y;
+            edge[1] = to.x - from.x;
+            edge[2] = -(edge[0] * from.x + edge[1] * from.y);
+            
+            // Top edge: horizontal, going left in counter-clockwise order. Left edge: going down.
+            const bool topLeft = (edge[0] == 0.0f && edge[1] < 0.0f) || edge[0] > 0.0f;
+            const float bias = FillRuleBias * std::hypot(edge[0], edge[1]);
+            edge[2] += topLeft ? bias : -bias;
+        }
+        
+        const glm::vec2 d1 = glm::vec2{p[1]} - glm::vec2{p[0]};
+        const glm::vec2 d2 = glm::vec2{p[2]} - glm::vec2{p[0]};
+        for(int attribute = 0; attribute < AttributeCount; ++attribute)
+        {
+            const float v0 = values[0][attribute];
+            const float v1 = values[1][attribute] - v0;
+            const float v2 = values[2][attribute] - v0;
+            float *plane = triangle.planes[attribute];
+            
+            plane[0] = (v1 * d2.y - v2 * d1.y) / area;
+            plane[1] = (v2 * d1.x - v1 * d2.x) / area;
+            plane[2] = v0 - plane[0] * p[0].x - plane[1] * p[0].y;
+        }
+        
+        const auto index = static_cast<std::uint32_t>(m_triangles.size());
+        m_triangles.push_back(triangle);
+        
+        for(int y = triangle.min.y / TileSize; y <= triangle.max.y / TileSize; ++y)
+        {
+            for(int x = triangle.min.x / TileSize; x <= triangle.max.x / TileSize; ++x)
+            {
+                m_bins[static_cast<std::size_t>(y) * m_tiles.x + x].push_back(index);
+            }
+        }
+    }
+    
+    void Rasterizer::flush(simd::Level level)
+    {
+        m_stats = {m_draws.size(), m_triangles.size(), 0};
+        for(const std::vector<std::uint32_t>& bin : m_bins)
+        {
+            m_stats.binned += bin.size();
+        }
+        
+        const Targets targets{{m_color[0].data(), m_color[1].data(), m_color[2].data(), m_color[3].data()},
+                              m_depth.data(), m_stencil.data(), m_padded.x};
+        
+        // The tiles don't share any pixel, so each one is a task
+        ThreadPool::global().parallelFor(0, m_bins.size(), 1, [&](std::size_t first, std::size_t last) {
+            for(std::size_t i = first; i < last; ++i)
+            {
+                const std::vector<std::uint32_t>& bin = m_bins[i];
+                if(bin.empty())
+                {
+                    continue;
+                }
+                
+                const glm::ivec2 origin = glm::ivec2{static_cast<int>(i) % m_tiles.x, static_cast<int>(i) / m_tiles.x}
+                                          * TileSize;
+                const Tile tile{origin, origin + TileSize};
+                
+                const Triangle *triangles = m_triangles.data();
+                bool done = false;
+                if(level == simd::Level::AVX2)
+                {
+                    done = shadeTileAVX2(triangles, bin.data(), bin.size(), m_draws.data(), tile, targets);
+                }
+                else if(level == simd::Level::SSE4)
+                {
+                    done = shadeTileSSE4(triangles, bin.data(), bin.size(), m_draws.data(), tile, targets);
+                }
+                
+                if(!done)
+                {
+                    detail::shadeTile<simd::Float1>(triangles, bin.data(), bin.size(), m_draws.data(), tile, targets);
+                }
+            }
+        });
+        
+        m_draws.clear();
+        m_triangles.clear();
+        for(std::vector<std::uint32_t>& bin : m_bins)
+        {
+            bin.clear();
+        }
+    }
+    
+    gl::Image Rasterizer::read() const
+    {
+        gl::Image image;
+        image.size = m_size;
+        image.pixels.resize(static_cast<std::size_t>(m_size.x) * m_size.y * 4);
+        
+        for(int y = 0; y < m_size.y; ++y)
+        {
+            for(int x = 0; x < m_size.x; ++x)
+            {
+                const std::size_t source = static_cast<std::size_t>(y) * m_padded.x + x;
+                unsigned char *pixel = &image.pixels[(static_cast<std::size_t>(y) * m_size.x + x) * 4];
+                
+                for(int c = 0; c < 4; ++c)
+                {
+                    const float value = std::clamp(m_color[c][source], 0.0f, 1.0f);
+                    pixel[c] = static_cast<unsigned char>(std::lround(value * 255.0f));
+                }
+            }
+        }
+        
+        return image;
+    }
+    
+    glm::ivec2 Rasterizer::getSize() const
+    {
+        return m_size;
+    }
+    
+    Rasterizer::Stats Rasterizer::getStats() const
+    {
+        return m_stats;
+    }
+}
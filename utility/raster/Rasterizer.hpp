@@ -0,0 +1,195 @@
+#pragma once
+
+#include <utility/gl/Image.hpp>
+#include <utility/math/simd.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// @brief A rasterizer on the CPU, for the machines without GPU.
+namespace raster
+{
+    /// @brief A vertex transformed by the caller, the output of base.vert.
+    struct Vertex
+    {
+        glm::vec4 clip{0, 0, 0, 1}; ///< gl_Position
+        glm::vec3 pos{0}; ///< World coordinates, for the lighting
+        glm::vec3 nor{0}; ///< World coordinates, not normalized after the interpolation, like base.frag
+        float clipDistance{1}; ///< The pixels where it is negative are discarded
+    };
+    
+    /// @brief The fixed function state of a draw, the subset of OpenGL used by the Renderer.
+    struct State
+    {
+        enum class DepthFunc
+        {
+            Less, ///< Passes if lower or equal, the depth of the triangles sharing an edge is rounded differently
+            Always
+        };
+        
+        enum class StencilFunc
+        {
+            Always,
+            Equal ///< Passes where the stencil is stencilRef
+        };
+        
+        DepthFunc depthFunc{DepthFunc::Less};
+        bool depthWrite{true};
+        bool colorWrite{true};
+        
+        StencilFunc stencilFunc{StencilFunc::Always};
+        std::uint8_t stencilRef{0};
+        bool stencilReplace{false}; ///< Write stencilRef where the depth test passes
+        
+        bool blend{false}; ///< GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA
+        bool clipDistance{false}; ///< Discard where Vertex::clipDistance is negative
+    };
+    
+    /// @brief The uniforms of lighting.glsl, without textures nor shadows.
+    struct Shading
+    {
+        glm::vec4 color{1}; ///< u_DiffuseColor
+        float ambient{0};
+        float diffuse{1};
+        float specularExponent{16.0f};
+        glm::vec4 specularColor{1, 1, 0, 1};
+        float opacity{1};
+        
+        bool diffuseTerm{true}; ///< DIFFUSE
+        bool specularTerm{true}; ///< SPECULAR
+        
+        glm::vec3 lightDir{0, -1, 0};
+        glm::vec3 eye{0}; ///< Position of the camera, in world coordinates
+    };
+    
+    /// @brief Rasterize triangles with the Phong lighting of base.frag into a color, depth and stencil buffer.
+    /// @details
+    /// The draws are queued, then flush() runs them: the triangles are clipped by the near plane, projected and binned
+    /// into tiles of TileSize x TileSize pixels. The tiles are rasterized and shaded in parallel on the ThreadPool,
+    /// each one running the triangles in the order of the draws, so the stencil and the blending work like on a GPU.
+    /// The pixels are shaded by the SIMD kernel of the CPU: each lane is a pixel of a row. The attributes are
+    /// interpolated with the perspective correction.
+    ///     rasterizer.resize(viewport);
+    ///     rasterizer.clear(glm::vec4{0});
+    ///     rasterizer.draw(vertices, indices, state, shading);
+    ///     rasterizer.flush();
+    ///     gl::Image image = rasterizer.read();
+    /// @remarks Pure CPU, no OpenGL call.
+    class Rasterizer
+    {
+    public:
+        /// @brief Pixels of the side of a tile, a multiple of the widest SIMD lanes.
+        static constexpr int TileSize = 64;
+        
+        struct Stats
+        {
+            std::size_t draws{0};
+            std::size_t triangles{0}; ///< After the clipping, by the last flush()
+            std::size_t binned{0}; ///< Triangles in the bins, a triangle is in all the tiles it overlaps
+        };
+        
+        explicit Rasterizer(glm::ivec2 size = {1, 1});
+        
+        /// @brief Resize the buffers, their content is lost.
+        void resize(glm::ivec2 size);
+        
+        /// @brief Fill the buffers, like glClear() with all the bits.
+        /// @remarks The draws queued are dropped, flush() them first.
+        void clear(const glm::vec4& color, float depth = 1.0f, std::uint8_t stencil = 0);
+        
+        /// @brief Queue the triangles of a draw, drawn by flush().
+        /// @param indices 3 per triangle.
+        void draw(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const State& state,
+                  const Shading& shading);
+        
+        /// @brief Rasterize the draws queued.
+        /// @param level The instruction set to use. Defaults to the best one supported by the CPU.
+        void flush(simd::Level level = simd::detectLevel());
+        
+        /// @brief The color buffer, 8 bits RGBA with the first row at the bottom, like glReadPixels().
+        gl::Image read() const;
+        
+        glm::ivec2 getSize() const;
+        
+        Stats getStats() const;
+        
+        /// @brief The interpolated attributes, each one a plane a * x + b * y + c in pixels.
+        enum Attribute
+        {
+            AttrDepth, ///< Depth in [0, 1], linear in screen space
+            AttrInvW, ///< 1 / w, the others are divided by w
+            AttrPosX,
+            AttrPosY,
+            AttrPosZ,
+            AttrNorX,
+            AttrNorY,
+            AttrNorZ,
+            AttrClip,
+            AttributeCount
+        };
+        
+        /// @brief A triangle in pixels, ready to be rasterized.
+        /// @details The planes are relative to origin, to keep the precision of the floats on large buffers.
+        struct Triangle
+        {
+            float edges[3][3]; ///< a, b, c of each edge function, positive inside
+            float planes[AttributeCount][3];
+            glm::ivec2 origin;
+            glm::ivec2 min, max; ///< Pixels covered, inclusive
+            std::uint32_t draw;
+        };
+        
+        struct Draw
+        {
+            State state;
+            Shading shading;
+        };
+        
+        /// @brief Pixels of a tile, [min, max).
+        struct Tile
+        {
+            glm::ivec2 min, max;
+        };
+        
+        /// @brief The buffers, one float per pixel and per plane.
+        struct Targets
+        {
+            float *color[4];
+            float *depth;
+            float *stencil;
+            int width;
+        };
+    
+    private:
+        /// @brief Project a triangle already clipped by the near plane, and bin it.
+        void addTriangle(const Vertex& a, const Vertex& b, const Vertex& c, std::uint32_t draw);
+        
+        glm::ivec2 m_size{0};
+        glm::ivec2 m_padded{0}; ///< Multiple of TileSize
+        glm::ivec2 m_tiles{0};
+        
+        std::vector<float> m_color[4];
+        std::vector<float> m_depth;
+        std::vector<float> m_stencil;
+        
+        std::vector<Draw> m_draws;
+        std::vector<Triangle> m_triangles;
+        std::vector<std::vector<std::uint32_t>> m_bins; ///< Triangles overlapping each tile, in the order of the draws
+        
+        Stats m_stats;
+    };
+    
+    /// @name
+    /// @brief Kernels for each instruction set, rasterize and shade the triangles of a tile in order.
+    /// @remarks Only call them if the CPU supports the instruction set.
+    /// @returns false if the kernel was not compiled with the instruction set enabled, nothing is computed.
+    /// @{
+    bool shadeTileSSE4(const Rasterizer::Triangle *triangles, const std::uint32_t *indices, std::size_t count,
+                       const Rasterizer::Draw *draws, Rasterizer::Tile tile, const Rasterizer::Targets& targets);
+    bool shadeTileAVX2(const Rasterizer::Triangle *triangles, const std::uint32_t *indices, std::size_t count,
+                       const Rasterizer::Draw *draws, Rasterizer::Tile tile, const Rasterizer::Targets& targets);
+    /// @}
+}
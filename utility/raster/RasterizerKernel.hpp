@@ -0,0 +1,225 @@
+#pragma once
+
+#include "Rasterizer.hpp"
+#include <math.h>
+
+namespace raster
+{
+    namespace detail
+    {
+        /// @brief Evaluate a plane of a triangle on the lanes.
+        template<typename V>
+        V evaluate(const float plane[3], V x, V y)
+        {
+            return fmadd(V::set1(plane[0]), x, fmadd(V::set1(plane[1]), y, V::set1(plane[2])));
+        }
+        
+        /// @returns If all the lanes are negative.
+        template<typename V>
+        bool allNegative(V value)
+        {
+            float lanes[V::Lanes];
+            value.store(lanes);
+            
+            for(std::size_t lane = 0; lane < V::Lanes; ++lane)
+            {
+                if(!(lanes[lane] < 0.0f))
+                {
+                    return false;
+                }
+            }
+            
+            return true;
+        }
+        
+        /// @brief getLighting() of lighting.glsl on the lanes, without the textures nor the shadows.
+        template<typename V>
+        void shade(const Shading& shading, const V pos[3], const V nor[3], V out[4])
+        {
+            const V zero = V::set1(0.0f);
+            const V color[4] = {V::set1(shading.color.r), V::set1(shading.color.g), V::set1(shading.color.b),
+                                V::set1(shading.color.a)};
+            
+            const V ambient = V::set1(shading.ambient);
+            for(int c = 0; c < 3; ++c)
+            {
+                out[c] = ambient * color[c];
+            }
+            
+            const V light[3] = {V::set1(shading.lightDir.x), V::set1(shading.lightDir.y), V::set1(shading.lightDir.z)};
+            const V lightDotNormal = fmadd(light[0], nor[0], fmadd(light[1], nor[1], light[2] * nor[2]));
+            
+            if(shading.diffuseTerm)
+            {
+                const V diffuse = max(zero - lightDotNormal, zero) * V::set1(shading.diffuse);
+                for(int c = 0; c < 3; ++c)
+                {
+                    out[c] = fmadd(diffuse, color[c], out[c]);
+                }
+            }
+            
+            if(shading.specularTerm)
+            {
+                // reflect(u_LightDirection, nor), against the direction from the camera
+                const V eyes[3] = {pos[0] - V::set1(shading.eye.x), pos[1] - V::set1(shading.eye.y),
+                                   pos[2] - V::set1(shading.eye.z)};
+                const V length = sqrt(fmadd(eyes[0], eyes[0], fmadd(eyes[1], eyes[1], eyes[2] * eyes[2])));
+                const V twice = V::set1(2.0f) * lightDotNormal;
+                
+                V specular = zero;
+                for(int c = 0; c < 3; ++c)
+                {
+                    specular = specular - (light[c] - twice * nor[c]) * eyes[c];
+                }
+                specular = max(specular / length, zero);
+                
+                // No SIMD pow(), and powf() is not inlined so it is safe to call from the kernels
+                float lanes[V::Lanes];
+                specular.store(lanes);
+                for(std::size_t lane = 0; lane < V::Lanes; ++lane)
+                {
+                    // Most of the pixels have no highlight
+                    if(lanes[lane] > 0.0f)
+                    {
+                        lanes[lane] = powf(lanes[lane], shading.specularExponent);
+                    }
+                }
+                specular = V::load(lanes);
+                
+                const float specularColor[3] = {shading.specularColor.r, shading.specularColor.g,
+                                                shading.specularColor.b};
+                for(int c = 0; c < 3; ++c)
+                {
+                    out[c] = fmadd(specular, V::set1(specularColor[c]), out[c]);
+                }
+            }
+            
+            // Clamped like a fixed point framebuffer
+            const V one = V::set1(1.0f);
+            for(int c = 0; c < 3; ++c)
+            {
+                out[c] = min(max(out[c], zero), one);
+            }
+            out[3] = V::set1(shading.opacity < 0.0f ? 0.0f : shading.opacity > 1.0f ? 1.0f : shading.opacity);
+        }
+        
+        /// @brief Rasterization and shading of a tile, written once for any wrapper of simd.hpp.
+        /// @details The width of the tile must be a multiple of V::Lanes.
+        template<typename V>
+        void shadeTile(const Rasterizer::Triangle *triangles, const std::uint32_t *indices, std::size_t count,
+                       const Rasterizer::Draw *draws, Rasterizer::Tile tile, const Rasterizer::Targets& targets)
+        {
+            float centers[V::Lanes];
+            for(std::size_t lane = 0; lane < V::Lanes; ++lane)
+            {
+                centers[lane] = static_cast<float>(lane) + 0.5f;
+            }
+            const V offsets = V::load(centers);
+            const int lanes = static_cast<int>(V::Lanes);
+            
+            const V zero = V::set1(0.0f);
+            const V one = V::set1(1.0f);
+            
+            for(std::size_t i = 0; i < count; ++i)
+            {
+                const Rasterizer::Triangle& triangle = triangles[indices[i]];
+                const State& state = draws[triangle.draw].state;
+                const Shading& shading = draws[triangle.draw].shading;
+                
+                // The lanes start on a multiple of the lanes from the tile, the pixels out of the triangle fail the
+                // edges. No std::min() nor std::max(): their copy compiled here could be kept by the linker.
+                const int firstX = triangle.min.x > tile.min.x ? triangle.min.x : tile.min.x;
+                const int beginX = tile.min.x + (firstX - tile.min.x) / lanes * lanes;
+                const int endX = triangle.max.x + 1 < tile.max.x ? triangle.max.x + 1 : tile.max.x;
+                const int beginY = triangle.min.y > tile.min.y ? triangle.min.y : tile.min.y;
+                const int endY = triangle.max.y + 1 < tile.max.y ? triangle.max.y + 1 : tile.max.y;
+                
+                const V stencilRef = V::set1(state.stencilRef);
+                
+                for(int y = beginY; y < endY; ++y)
+                {
+                    const V fy = V::set1(static_cast<float>(y - triangle.origin.y) + 0.5f);
+                    const std::size_t row = static_cast<std::size_t>(y) * targets.width;
+                    
+                    for(int x = beginX; x < endX; x += lanes)
+                    {
+                        const V fx = V::set1(static_cast<float>(x - triangle.origin.x)) + offsets;
+                        const std::size_t index = row + x;
+                        
+                        // Each test is negative where it fails
+                        V pass = min(evaluate<V>(triangle.edges[0], fx, fy),
+                                     min(evaluate<V>(triangle.edges[1], fx, fy),
+                                         evaluate<V>(triangle.edges[2], fx, fy)));
+                        if(allNegative(pass))
+                        {
+                            continue;
+                        }
+                        
+                        const V depth = evaluate<V>(triangle.planes[Rasterizer::AttrDepth], fx, fy);
+                        const V currentDepth = V::load(targets.depth + index);
+                        if(state.depthFunc == State::DepthFunc::Less)
+                        {
+                            pass = min(pass, currentDepth - depth);
+                        }
+                        
+                        const V currentStencil = V::load(targets.stencil + index);
+                        if(state.stencilFunc == State::StencilFunc::Equal)
+                        {
+                            const V difference = currentStencil - stencilRef;
+                            pass = min(pass, V::set1(0.5f) - max(difference, zero - difference));
+                        }
+                        
+                        const V w = one / evaluate<V>(triangle.planes[Rasterizer::AttrInvW], fx, fy);
+                        if(state.clipDistance)
+                        {
+                            pass = min(pass, evaluate<V>(triangle.planes[Rasterizer::AttrClip], fx, fy) * w);
+                        }
+                        
+                        if(allNegative(pass))
+                        {
+                            continue;
+                        }
+                        
+                        if(state.depthWrite)
+                        {
+                            selectNegative(pass, currentDepth, depth).store(targets.depth + index);
+                        }
+                        
+                        if(state.stencilReplace)
+                        {
+                            selectNegative(pass, currentStencil, stencilRef).store(targets.stencil + index);
+                        }
+                        
+                        if(!state.colorWrite)
+                        {
+                            continue;
+                        }
+                        
+                        V pos[3], nor[3];
+                        for(int c = 0; c < 3; ++c)
+                        {
+                            pos[c] = evaluate<V>(triangle.planes[Rasterizer::AttrPosX + c], fx, fy) * w;
+                            nor[c] = evaluate<V>(triangle.planes[Rasterizer::AttrNorX + c], fx, fy) * w;
+                        }
+                        
+                        V color[4];
+                        shade<V>(shading, pos, nor, color);
+                        
+                        for(int c = 0; c < 4; ++c)
+                        {
+                            const V current = V::load(targets.color[c] + index);
+                            V result = color[c];
+                            
+                            if(state.blend)
+                            {
+                                result = fmadd(color[c], color[3], current * (one - color[3]));
+                            }
+                            
+                            selectNegative(pass, current, result).store(targets.color[c] + index);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
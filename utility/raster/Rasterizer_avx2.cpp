@@ -0,0 +1,19 @@
+#include "RasterizerKernel.hpp"
+
+// Compiled with -mavx2 -mfma, only called when the CPU supports it.
+// Only the Float8 kernel is instantiated here, never code shared with the other translation units,
+// otherwise the linker could keep a copy with instructions unsupported by the CPU.
+
+namespace raster
+{
+    bool shadeTileAVX2(const Rasterizer::Triangle *triangles, const std::uint32_t *indices, std::size_t count,
+                       const Rasterizer::Draw *draws, Rasterizer::Tile tile, const Rasterizer::Targets& targets)
+    {
+#if defined(__AVX2__) && defined(__FMA__)
+        detail::shadeTile<simd::Float8>(triangles, indices, count, draws, tile, targets);
+        return true;
+#else
+        return false;
+#endif
+    }
+}
@@ -0,0 +1,19 @@
+#include "RasterizerKernel.hpp"
+
+// Compiled with -msse4.1, only called when the CPU supports it.
+// Only the Float4 kernel is instantiated here, never code shared with the other translation units,
+// otherwise the linker could keep a copy with instructions unsupported by the CPU.
+
+namespace raster
+{
+    bool shadeTileSSE4(const Rasterizer::Triangle *triangles, const std::uint32_t *indices, std::size_t count,
+                       const Rasterizer::Draw *draws, Rasterizer::Tile tile, const Rasterizer::Targets& targets)
+    {
+#if defined(__SSE4_1__)
+        detail::shadeTile<simd::Float4>(triangles, indices, count, draws, tile, targets);
+        return true;
+#else
+        return false;
+#endif
+    }
+}
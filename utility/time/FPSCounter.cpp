@@ -1,12 +1,29 @@
-
 #include "FPSCounter.hpp"
+#include <algorithm>
+#include <cmath>
 
-FPSCounter::FPSCounter(Time snapshot)
-    : snapshot(snapshot), m_count(0), m_elapsed(), m_fps(0.0f)
+FPSCounter::FPSCounter(Time snapshot, float spikeFactor)
+    : snapshot(snapshot), spikeFactor(spikeFactor), m_count(0), m_elapsed(), m_fps(0.0f), m_lastFrame(Time::now())
 {
 }
 
 void FPSCounter::onFrame()
+{
+    const Time now = Time::now();
+    const Time frameTime = now - m_lastFrame;
+    m_lastFrame = now;
+
+    onFrame(frameTime);
+}
+
+void FPSCounter::start()
+{
+    m_lastFrame = Time::now();
+    m_elapsed.restart();
+    m_count = 0;
+}
+
+void FPSCounter::onFrame(Time frameTime)
 {
     m_count++;
 
@@ -14,6 +31,59 @@ void FPSCounter::onFrame()
     {
         reset();
     }
+
+    const float ms = frameTime.asSeconds() * 1000.0f;
+
+    // Compared to the median before the frame, so a long stutter doesn't hide itself.
+    // Not before enough frames, the first ones are often slower (shader compilation, first uploads)
+    m_spike = m_size >= HistorySize / 4 && ms > spikeFactor * m_stats.p50;
+    if(m_spike)
+    {
+        m_spikeCount++;
+    }
+
+    push(ms);
+
+    m_stats.min = m_sorted[0];
+    m_stats.max = m_sorted[m_size - 1];
+    m_stats.mean = static_cast<float>(m_sum / m_size);
+    m_stats.p50 = percentile(50);
+    m_stats.p95 = percentile(95);
+    m_stats.p99 = percentile(99);
+}
+
+void FPSCounter::push(float ms)
+{
+    const auto begin = m_sorted.begin();
+    auto end = m_sorted.begin() + m_size;
+
+    if(m_size == HistorySize)
+    {
+        // Remove the oldest one from the sorted window, it is replaced in the ring
+        const float oldest = m_history[m_next];
+        const auto it = std::lower_bound(begin, end, oldest);
+        std::move(it + 1, end, it);
+        --end;
+        m_sum -= oldest;
+    }
+    else
+    {
+        m_size++;
+    }
+
+    const auto it = std::upper_bound(begin, end, ms);
+    std::move_backward(it, end, end + 1);
+    *it = ms;
+    m_sum += ms;
+
+    m_history[m_next] = ms;
+    m_next = (m_next + 1) % HistorySize;
+}
+
+float FPSCounter::percentile(float p) const
+{
+    const auto rank = static_cast<std::size_t>(std::ceil(p / 100.0f * m_size));
+    return m_sorted[std::clamp<std::size_t>(rank, 1, m_size) - 1];
 }
 
 float FPSCounter::getFPS() const
@@ -21,11 +91,33 @@ float FPSCounter::getFPS() const
     return m_fps;
 }
 
-void FPSCounter::reset()
+const FPSCounter::Stats& FPSCounter::getStats() const
 {
-    m_fps = static_cast<float>(m_count) / m_elapsed.restart().asSeconds();
-    m_count = 0;
+    return m_stats;
 }
 
+bool FPSCounter::isSpike() const
+{
+    return m_spike;
+}
 
+unsigned int FPSCounter::getSpikeCount() const
+{
+    return m_spikeCount;
+}
 
+const float *FPSCounter::getHistory() const
+{
+    return m_history.data();
+}
+
+std::size_t FPSCounter::getHistoryOffset() const
+{
+    return m_next;
+}
+
+void FPSCounter::reset()
+{
+    m_fps = static_cast<float>(m_count) / m_elapsed.restart().asSeconds();
+    m_count = 0;
+}
@@ -1,32 +1,83 @@
 #pragma once
 
 #include "Clock.hpp"
+#include <array>
+#include <cstddef>
 
-/// @brief Count the FPS.
+/// @brief Count the FPS, and keep the statistics of the last frame times.
 /// @remarks Stored as a time utility because the definition of 'frame' may be anything. Even if obviously the main
 /// purpose is to count FPSes. It only measure how many times an unspecified event occured between two point of time,
 /// and gives the average of events per second.
+/// @details
+/// Averages hide the stutters, so the durations of the last HistorySize frames are also kept in a ring buffer and in
+/// a sorted window, updated on each frame without allocation: the percentiles are read directly from the window.
 class FPSCounter
 {
 public:
-    explicit FPSCounter(Time snapshot = Time::milliseconds(400));
+    /// @brief Count of frames in the history.
+    static constexpr std::size_t HistorySize = 240;
 
-    /// @brief Notify one frame
+    /// @brief Statistics of the frame times in the history, in milliseconds.
+    struct Stats
+    {
+        float min{0};
+        float max{0};
+        float mean{0};
+        float p50{0};
+        float p95{0};
+        float p99{0};
+    };
+
+    /// @param spikeFactor A frame is a spike if it is longer than spikeFactor times the median of the history.
+    explicit FPSCounter(Time snapshot = Time::milliseconds(400), float spikeFactor = 2.0f);
+
+    /// @brief Notify one frame, its duration is the time since the previous one, or since start().
     void onFrame();
 
+    /// @brief Measure the next frame from now, for example once the assets are loaded, so the loading is not counted
+    /// as a frame.
+    void start();
+
+    /// @brief Notify one frame of a known duration, for example from a simulated clock.
+    void onFrame(Time frameTime);
+
     /// @brief Get the fps measured. Do not change between two snapshots.
     float getFPS() const;
 
+    const Stats& getStats() const;
+
+    /// @brief Check if the last frame was a spike.
+    bool isSpike() const;
+
+    /// @brief Count of spikes since the creation.
+    unsigned int getSpikeCount() const;
+
+    /// @name
+    /// @brief The frame times in milliseconds, as a ring buffer in the format of ImGui::PlotLines().
+    /// @details The oldest frame is at getHistoryOffset(), the history is full of zeros at first.
+    /// @{
+    const float *getHistory() const;
+    std::size_t getHistoryOffset() const;
+    /// @}
+
     /// @brief The duration of a snapshot.
     /// @details A snapshot is an interval of time in which we count the frames, to have a statistically accurate
     /// measure. Then, the fps is calculated as fps = framesPassed / snapshot.asSeconds().
     /// May be changed at any time.
     Time snapshot;
 
+    float spikeFactor;
+
 private:
     /// @brief If the snapshot ended, then we store the FPS and reset the timer.
     void reset();
 
+    /// @brief Replace the oldest frame time by a new one, in the ring and in the sorted window.
+    void push(float ms);
+
+    /// @brief Nearest-rank percentile of the sorted window.
+    float percentile(float p) const;
+
     /// @brief Count of frames since the beginning of the snapshot.
     int m_count;
 
@@ -35,5 +86,22 @@ private:
 
     /// @brief FPS count for the previous snapshot (cache).
     float m_fps;
-};
 
+    /// @brief When the previous frame was notified.
+    Time m_lastFrame;
+
+    /// @brief The frame times in the order they were notified, m_next is the oldest one.
+    std::array<float, HistorySize> m_history{};
+    std::size_t m_next{0};
+
+    /// @brief The m_size first elements are the frame times of the history, sorted.
+    std::array<float, HistorySize> m_sorted{};
+    std::size_t m_size{0};
+
+    /// @brief Sum of the history, for the mean.
+    double m_sum{0};
+
+    Stats m_stats;
+    bool m_spike{false};
+    unsigned int m_spikeCount{0};
+};
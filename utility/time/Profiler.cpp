@@ -0,0 +1,146 @@
+#include "Profiler.hpp"
+#include "Trace.hpp"
+#include <utility/gl/extensions.hpp>
+#include <cassert>
+
+Profiler::Scope::Scope(Profiler *profiler, const char *name)
+    : m_profiler{profiler}
+{
+    if(m_profiler)
+    {
+        m_profiler->push(name);
+    }
+}
+
+Profiler::Scope::~Scope()
+{
+    if(m_profiler)
+    {
+        m_profiler->pop();
+    }
+}
+
+void Profiler::beginFrame()
+{
+    assert(m_stack.empty() && "The previous frame has not ended");
+    
+    if(!m_calibrated)
+    {
+        GLint64 timestamp = 0;
+        glGetInteger64v(GL_TIMESTAMP, &timestamp);
+        m_gpuOffset = Time::now() - toTime(timestamp);
+        m_calibrated = true;
+    }
+    
+    Frame& frame = m_frames[m_current];
+    
+    if(frame.pending)
+    {
+        collect(frame);
+        frame.pending = false;
+    }
+    
+    frame.samples.clear();
+    push("Frame");
+}
+
+void Profiler::endFrame()
+{
+    pop();
+    assert(m_stack.empty() && "A scope of the frame has not ended");
+    
+    m_frames[m_current].pending = true;
+    m_current = (m_current + 1) % Latency;
+}
+
+void Profiler::push(const char *name)
+{
+    Frame& frame = m_frames[m_current];
+    
+    const int index = static_cast<int>(frame.samples.size());
+    const int parent = m_stack.empty() ? -1 : m_stack.back();
+    const int depth = static_cast<int>(m_stack.size());
+    
+    if(frame.queries.size() < 2 * frame.samples.size() + 2)
+    {
+        frame.queries.resize(2 * frame.samples.size() + 2);
+    }
+    
+    if(gl::ext::KHR_debug)
+    {
+        gl::ext::pushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, index, -1, name);
+    }
+    
+    const Time now = Time::now();
+    frame.samples.push_back({name, parent, depth, now, now});
+    glQueryCounter(frame.queries[2 * index], GL_TIMESTAMP);
+    
+    m_stack.push_back(index);
+}
+
+void Profiler::pop()
+{
+    assert(!m_stack.empty());
+    
+    Frame& frame = m_frames[m_current];
+    const int index = m_stack.back();
+    m_stack.pop_back();
+    
+    glQueryCounter(frame.queries[2 * index + 1], GL_TIMESTAMP);
+    
+    Sample& sample = frame.samples[index];
+    sample.cpuEnd = Time::now();
+    trace::record(sample.name, "cpu", sample.cpuBegin, sample.cpuEnd);
+    
+    if(gl::ext::KHR_debug)
+    {
+        gl::ext::popDebugGroup();
+    }
+}
+
+void Profiler::collect(const Frame& frame)
+{
+    if(frame.samples.empty())
+    {
+        return;
+    }
+    
+    // The timestamps complete in order, so if the last one is available all are
+    GLint available = 0;
+    glGetQueryObjectiv(frame.queries[2 * frame.samples.size() - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+    
+    if(!available)
+    {
+        return;
+    }
+    
+    m_results.resize(frame.samples.size());
+    
+    for(std::size_t i = 0; i < frame.samples.size(); ++i)
+    {
+        const Sample& sample = frame.samples[i];
+        
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(frame.queries[2 * i], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(frame.queries[2 * i + 1], GL_QUERY_RESULT, &end);
+        
+        Result& result = m_results[i];
+        result.name = sample.name;
+        result.parent = sample.parent;
+        result.depth = sample.depth;
+        result.cpuMs = (sample.cpuEnd - sample.cpuBegin).asSeconds() * 1000.0f;
+        result.gpuMs = static_cast<float>(end - begin) / 1e6f;
+        
+        trace::recordGpu(sample.name, toTime(begin), toTime(end));
+    }
+}
+
+Time Profiler::toTime(GLuint64 timestamp) const
+{
+    return m_gpuOffset + Time::microseconds(static_cast<std::int64_t>(timestamp / 1000));
+}
+
+const std::vector<Profiler::Result>& Profiler::getResults() const
+{
+    return m_results;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "Time.hpp"
+#include <utility/gl/gl.hpp>
+#include <array>
+#include <vector>
+
+/// @brief Hierarchical profiler of the CPU and GPU times of the scopes of the frames.
+/// @details
+/// A scope measures its CPU time with Time::now() and its GPU time with two GL_TIMESTAMP queries, which can be
+/// nested unlike GL_TIME_ELAPSED. The queries of a frame are only read Latency frames later, when the GPU has
+/// finished them, so the profiler never waits for the GPU. The scopes are also KHR_debug groups, so external tools
+/// (RenderDoc, apitrace, Nsight...) show the same hierarchy, and are recorded to the trace (see Trace.hpp) with their
+/// GPU timestamps converted to the origin of Time.
+///     profiler.beginFrame();
+///     {
+///         Profiler::Scope scope{&profiler, "Scene"};
+///         scene.draw(...);
+///     }
+///     profiler.endFrame();
+/// @remarks The names are not copied, they must outlive the results: use string literals.
+class Profiler
+{
+public:
+    /// @brief Count of frames between a measure and its results.
+    static constexpr std::size_t Latency = 4;
+    
+    /// @brief The times of a scope.
+    struct Result
+    {
+        const char *name{nullptr};
+        int parent{-1}; ///< Index of the enclosing scope in the results, -1 for the frame itself
+        int depth{0};
+        float cpuMs{0};
+        float gpuMs{0};
+    };
+    
+    /// @brief Measure from the construction to the destruction.
+    class Scope
+    {
+    public:
+        /// @param profiler Can be nullptr, then nothing is measured.
+        Scope(Profiler *profiler, const char *name);
+        ~Scope();
+        
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+        
+    private:
+        Profiler *m_profiler;
+    };
+    
+    /// @brief Begin the root scope of a frame, and collect the results of the frame Latency frames ago.
+    void beginFrame();
+    
+    void endFrame();
+    
+    /// @name
+    /// @brief Begin and end a scope, inside a frame. Prefer Scope.
+    /// @{
+    void push(const char *name);
+    void pop();
+    /// @}
+    
+    /// @brief The scopes of the last frame with its results available, in the order they began.
+    /// @details The first one is the whole frame.
+    const std::vector<Result>& getResults() const;
+    
+private:
+    struct Sample
+    {
+        const char *name;
+        int parent;
+        int depth;
+        Time cpuBegin, cpuEnd;
+    };
+    
+    /// @brief The samples of a frame, and their queries: the begin and end timestamps of the sample i are the queries
+    /// 2 * i and 2 * i + 1. The vectors keep their capacity, so the steady state doesn't allocate.
+    struct Frame
+    {
+        std::vector<Sample> samples;
+        std::vector<gl::raii::Query> queries;
+        bool pending{false}; ///< If the results are not collected yet
+    };
+    
+    /// @brief Read the results of a frame if the GPU has finished it, else keep the previous results.
+    void collect(const Frame& frame);
+    
+    /// @brief Convert a GL_TIMESTAMP to the origin of Time.
+    Time toTime(GLuint64 timestamp) const;
+    
+    std::array<Frame, Latency> m_frames;
+    std::size_t m_current{0};
+    
+    /// @brief Indices of the samples of the scopes not ended, in the current frame.
+    std::vector<int> m_stack;
+    
+    std::vector<Result> m_results;
+    
+    /// @brief Time::now() - GL_TIMESTAMP, measured at the first frame.
+    /// @remarks Time::now() is read just after the GPU clock, so the GPU events are at most late by a few microseconds.
+    Time m_gpuOffset;
+    bool m_calibrated{false};
+};
@@ -34,6 +34,12 @@ Time Time::milliseconds(uint32_t amount)
     return Time{std::chrono::duration_cast<duration>(dur)};
 }
 
+Time Time::microseconds(int64_t amount)
+{
+    auto dur = std::chrono::duration<int64_t, std::micro>(amount);
+    return Time{std::chrono::duration_cast<duration>(dur)};
+}
+
 float Time::asSeconds() const
 {
     auto dur = std::chrono::duration_cast<std::chrono::duration<float>>(m_duration);
@@ -46,6 +52,11 @@ uint32_t Time::asMilliseconds() const
     return dur.count();
 }
 
+int64_t Time::asMicroseconds() const
+{
+    return std::chrono::duration_cast<std::chrono::duration<int64_t, std::micro>>(m_duration).count();
+}
+
 std::ostream& operator<<(std::ostream& lhs, const Time& rhs)
 {
     lhs << rhs.asSeconds() << "s";
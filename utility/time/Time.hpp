@@ -1,6 +1,7 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
 #include <iosfwd>
 
 /// @brief Simple wrapper around std::chrono, because this API is a bit verbose and complicated...
@@ -21,6 +22,7 @@ public:
 
     static Time seconds(float amount);
     static Time milliseconds(uint32_t amount);
+    static Time microseconds(int64_t amount);
 
     /// @}
 
@@ -30,6 +32,7 @@ public:
 
     float asSeconds() const;
     uint32_t asMilliseconds() const;
+    int64_t asMicroseconds() const;
 
     /// @}
 
@@ -0,0 +1,200 @@
+#include "Trace.hpp"
+#include <array>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace trace
+{
+    namespace
+    {
+        struct Event
+        {
+            const char *name;
+            const char *category;
+            Time begin;
+            Time end;
+        };
+        
+        /// @brief Ring buffer of a thread, written only by its thread.
+        struct Buffer
+        {
+            std::array<Event, Capacity> events;
+            
+            /// @brief Count of events ever recorded, the next one is written at head % Capacity.
+            /// @details Released after the event is written, so a reader sees the events before head complete.
+            std::atomic<std::uint64_t> head{0};
+            
+            int tid{0};
+            std::atomic<const char *> name{nullptr};
+            
+            void push(const Event& event)
+            {
+                const std::uint64_t index = head.load(std::memory_order_relaxed);
+                events[index % Capacity] = event;
+                head.store(index + 1, std::memory_order_release);
+            }
+        };
+        
+        std::atomic<bool> enabled{false};
+        
+        /// @brief All the buffers ever registered, never freed so a dump can read the buffers of ended threads.
+        std::mutex registryMutex;
+        std::vector<std::unique_ptr<Buffer>> registry;
+        
+        Buffer& registerBuffer(const char *name)
+        {
+            std::lock_guard lock{registryMutex};
+            
+            auto& buffer = registry.emplace_back(std::make_unique<Buffer>());
+            buffer->tid = static_cast<int>(registry.size());
+            buffer->name = name;
+            
+            return *buffer;
+        }
+        
+        Buffer& getThreadBuffer()
+        {
+            thread_local Buffer& buffer = registerBuffer(nullptr);
+            return buffer;
+        }
+        
+        Buffer& getGpuBuffer()
+        {
+            static Buffer& buffer = registerBuffer("GPU");
+            return buffer;
+        }
+        
+        void writeString(std::ostream& out, const char *str)
+        {
+            out << '"';
+            
+            for(const char *c = str ? str : ""; *c; ++c)
+            {
+                if(*c == '"' || *c == '\\')
+                {
+                    out << '\\';
+                }
+                out << *c;
+            }
+            
+            out << '"';
+        }
+    }
+    
+    void setEnabled(bool value)
+    {
+        enabled.store(value, std::memory_order_relaxed);
+    }
+    
+    bool isEnabled()
+    {
+        return enabled.load(std::memory_order_relaxed);
+    }
+    
+    void setThreadName(const char *name)
+    {
+        getThreadBuffer().name = name;
+    }
+    
+    void record(const char *name, const char *category, Time begin, Time end)
+    {
+        if(isEnabled())
+        {
+            getThreadBuffer().push({name, category, begin, end});
+        }
+    }
+    
+    void recordGpu(const char *name, Time begin, Time end)
+    {
+        if(isEnabled())
+        {
+            getGpuBuffer().push({name, "gpu", begin, end});
+        }
+    }
+    
+    Scope::Scope(const char *name, const char *category)
+        : m_name{name}, m_category{category}, m_begin{isEnabled() ? Time::now() : Time{}}
+    {
+    }
+    
+    Scope::~Scope()
+    {
+        if(isEnabled())
+        {
+            record(m_name, m_category, m_begin, Time::now());
+        }
+    }
+    
+    bool writeChromeJson(const std::filesystem::path& path, Time last)
+    {
+        std::ofstream out{path};
+        
+        if(!out)
+        {
+            std::cerr << "Failed to write the trace " << path << std::endl;
+            return false;
+        }
+        
+        const Time since = Time::now() - last;
+        
+        out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+        bool first = true;
+        
+        std::lock_guard lock{registryMutex};
+        
+        for(const auto& buffer : registry)
+        {
+            const std::uint64_t head = buffer->head.load(std::memory_order_acquire);
+            const std::uint64_t begin = head > Capacity ? head - Capacity : 0;
+            
+            std::vector<Event> events;
+            events.reserve(head - begin);
+            for(std::uint64_t i = begin; i < head; ++i)
+            {
+                events.push_back(buffer->events[i % Capacity]);
+            }
+            
+            // The thread may have kept recording while copying: drop the events which could have been overwritten,
+            // including the one in the slot of the event being written. The fence orders the copy before the load.
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const std::uint64_t after = buffer->head.load(std::memory_order_relaxed);
+            const std::uint64_t overwritten = after + 1 > Capacity ? after + 1 - Capacity : 0;
+            const std::size_t skip = overwritten > begin ? static_cast<std::size_t>(overwritten - begin) : 0;
+            
+            if(!events.empty())
+            {
+                out << (first ? "" : ",\n") << "{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 1, \"tid\": "
+                    << buffer->tid << ", \"args\": {\"name\": ";
+                writeString(out, buffer->name ? buffer->name.load() : "Thread");
+                out << "}}";
+                first = false;
+            }
+            
+            for(std::size_t i = std::min(skip, events.size()); i < events.size(); ++i)
+            {
+                const Event& event = events[i];
+                
+                if(event.end < since)
+                {
+                    continue;
+                }
+                
+                out << ",\n{\"ph\": \"X\", \"name\": ";
+                writeString(out, event.name);
+                out << ", \"cat\": ";
+                writeString(out, event.category);
+                out << ", \"pid\": 1, \"tid\": " << buffer->tid
+                    << ", \"ts\": " << event.begin.asMicroseconds()
+                    << ", \"dur\": " << (event.end - event.begin).asMicroseconds() << "}";
+            }
+        }
+        
+        out << "\n]}" << std::endl;
+        
+        return static_cast<bool>(out);
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Time.hpp"
+#include <filesystem>
+
+/// @brief Record timed events to look at them offline, in chrome://tracing or https://ui.perfetto.dev.
+/// @details
+/// Each thread records into its own ring buffer, without lock: only the first event of a thread takes a lock, to
+/// register its buffer. The GPU has its own track, filled by the Profiler with the timestamp queries converted to
+/// the origin of Time, so the CPU and GPU events are on the same timeline.
+/// Recording is disabled by default, and costs a branch when disabled.
+namespace trace
+{
+    /// @brief Count of events kept per thread, the oldest events are overwritten.
+    constexpr std::size_t Capacity = 1 << 15;
+    
+    void setEnabled(bool enabled);
+    bool isEnabled();
+    
+    /// @brief Name of the track of the calling thread in the trace.
+    /// @remarks The name is not copied: use a string literal.
+    void setThreadName(const char *name);
+    
+    /// @brief Record an event of the calling thread.
+    /// @param name,category Not copied: use string literals.
+    void record(const char *name, const char *category, Time begin, Time end);
+    
+    /// @brief Record an event on the GPU track.
+    /// @remarks Only from the thread of the OpenGL context.
+    void recordGpu(const char *name, Time begin, Time end);
+    
+    /// @brief Record an event from the construction to the destruction.
+    class Scope
+    {
+    public:
+        Scope(const char *name, const char *category = "cpu");
+        ~Scope();
+        
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    
+    private:
+        const char *m_name;
+        const char *m_category;
+        Time m_begin;
+    };
+    
+    /// @brief Write the events which ended in the last seconds, in the Chrome trace event JSON format.
+    /// @details Perfetto opens this format too. Can be called while the other threads are recording.
+    /// @returns false and log to std::cerr if the file can't be written.
+    bool writeChromeJson(const std::filesystem::path& path, Time last = Time::seconds(10));
+}